@@ -63,3 +63,11 @@ int main (int argc, char* argv[]) {
   (void) memcpy_s(NULL,0,NULL,0);
   return 0;
 }" HAS_MEMCPY_S)
+
+check_cxx_source_compiles("
+#include <sys/mman.h>
+int main (int argc, char* argv[]) {
+  void* m = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  (void) munmap(m, 4096);
+  return 0;
+}" HAS_MMAP)
@@ -18,6 +18,7 @@ add_library(mzn
   lib/cencode.c
   lib/chain_compressor.cpp
   lib/copy.cpp
+  lib/cse_map.cpp
   lib/eval_par.cpp
   lib/file_utils.cpp
   lib/flatten.cpp
@@ -35,22 +36,27 @@ add_library(mzn
   lib/flatten/flatten_setlit.cpp
   lib/flatten/flatten_unop.cpp
   lib/flatten/flatten_vardecl.cpp
+  lib/flatten_profile.cpp
   lib/flattener.cpp
   lib/gc.cpp
   lib/htmlprinter.cpp
   lib/json_parser.cpp
   lib/lexer.lxx
+  lib/library_image.cpp
   lib/thirdparty/miniz.c
   lib/model.cpp
   lib/optimize.cpp
   lib/optimize_constraints.cpp
+  lib/parallel_flatten.cpp
   lib/output.cpp
+  lib/par_bytecode.cpp
   lib/param_config.cpp
   lib/parser.cpp
   lib/parser.yxx
   lib/passes/compile_pass.cpp
   lib/pathfileprinter.cpp
   lib/prettyprinter.cpp
+  lib/server.cpp
   lib/solns2out.cpp
   lib/solver.cpp
   lib/solver_config.cpp
@@ -73,12 +79,14 @@ add_library(mzn
   include/minizinc/chain_compressor.hh
   include/minizinc/config.hh.in
   include/minizinc/copy.hh
+  include/minizinc/cse_map.hh
   include/minizinc/eval_par.hh
   include/minizinc/exception.hh
   include/minizinc/file_utils.hh
   include/minizinc/flat_exp.hh
   include/minizinc/flatten.hh
   include/minizinc/flatten_internal.hh
+  include/minizinc/flatten_profile.hh
   include/minizinc/flattener.hh
   include/minizinc/gc.hh
   include/minizinc/hash.hh
@@ -86,9 +94,12 @@ add_library(mzn
   include/minizinc/interrupt.hh
   include/minizinc/iter.hh
   include/minizinc/json_parser.hh
+  include/minizinc/library_image.hh
   include/minizinc/model.hh
   include/minizinc/optimize.hh
   include/minizinc/optimize_constraints.hh
+  include/minizinc/par_bytecode.hh
+  include/minizinc/parallel_flatten.hh
   include/minizinc/output.hh
   include/minizinc/param_config.hh
   include/minizinc/parser.hh
@@ -96,6 +107,7 @@ add_library(mzn
   include/minizinc/pathfileprinter.hh
   include/minizinc/prettyprinter.hh
   include/minizinc/process.hh
+  include/minizinc/server.hh
   include/minizinc/solns2out.hh
   include/minizinc/solver.hh
   include/minizinc/solver_config.hh
@@ -107,52 +107,20 @@ public:
 /// %Location of an expression in the source code
 class Location {
 protected:
-  /// Internal representation of a Location
-  /// Layout depends on sizeof pointer and arguments
-  /// 32 bit pointers:
-  ///   Layout 1: filename (32 bit), first line (8 bit), last line-first line (7 bit), first column
-  ///   (6 bit), last column (7 bit) Layout 2: filename (32 bit), 4 IntLit for the lines/columns
-  /// 64 bit pointers:
-  ///   Layout 1: filename (64 bit), first line (20 bit), last line-first line (20 bit), first
-  ///   column (10 bit), last column (10 bit) Layout 2: filename (64 bit), 4 IntLit for the
-  ///   lines/columns
-  class LocVec : public ASTVec {
-  protected:
-    LocVec(const ASTString& filename, unsigned int first_line, unsigned int first_column,
-           unsigned int last_line, unsigned int last_column);
-    LocVec(const ASTString& filename, IntVal combined);
-
-  public:
-    static LocVec* a(const ASTString& filename, unsigned int first_line, unsigned int first_column,
-                     unsigned int last_line, unsigned int last_column);
-    void mark() {
-      _gcMark = 1;
-      if (_data[0] != nullptr) {
-        static_cast<ASTStringData*>(_data[0])->mark();
-      }
-    }
-
-    ASTString filename() const;
-    unsigned int firstLine() const;
-    unsigned int lastLine() const;
-    unsigned int firstColumn() const;
-    unsigned int lastColumn() const;
-  };
-
-  union LI {
-    LocVec* lv;
-    ptrdiff_t t;
-  } _locInfo;
+  /// Table that stores the contents of all locations
+  class LocTable;
+  /// Index into the location table (0 for the empty location), shifted left by one.
+  /// The lowest bit marks introduced locations.
+  unsigned int _idx;
 
-  LocVec* lv() const {
-    LI li = _locInfo;
-    li.t &= ~static_cast<ptrdiff_t>(1);
-    return li.lv;
-  }
+  /// Add a location to the table, returning its index
+  static unsigned int add(const ASTString& filename, unsigned int first_line,
+                          unsigned int first_column, unsigned int last_line,
+                          unsigned int last_column);
 
 public:
   /// Construct empty location
-  Location() { _locInfo.lv = nullptr; }
+  Location() : _idx(0) {}
 
   /// Construct location
   Location(const ASTString& filename, unsigned int first_line, unsigned int first_column,
@@ -160,38 +128,45 @@ public:
     if (last_line < first_line) {
       throw InternalError("invalid location");
     }
-    _locInfo.lv = LocVec::a(filename, first_line, first_column, last_line, last_column);
+    _idx = add(filename, first_line, first_column, last_line, last_column) << 1;
   }
 
-  Location(const ParserLocation& loc) {
-    _locInfo.lv = LocVec::a(loc.filename(), loc.firstLine(), loc.firstColumn(), loc.lastLine(),
-                            loc.lastColumn());
-  }
+  Location(const ParserLocation& loc)
+      : _idx(add(loc.filename(), loc.firstLine(), loc.firstColumn(), loc.lastLine(),
+                 loc.lastColumn())
+             << 1) {}
 
   /// Return string representation
   std::string toString() const;
 
   /// Return filename
-  ASTString filename() const { return lv() != nullptr ? lv()->filename() : ASTString(); }
+  ASTString filename() const;
 
   /// Return first line number
-  unsigned int firstLine() const { return lv() != nullptr ? lv()->firstLine() : 0; }
+  unsigned int firstLine() const;
 
   /// Return last line number
-  unsigned int lastLine() const { return lv() != nullptr ? lv()->lastLine() : 0; }
+  unsigned int lastLine() const;
 
   /// Return first column number
-  unsigned int firstColumn() const { return lv() != nullptr ? lv()->firstColumn() : 0; }
+  unsigned int firstColumn() const;
 
   /// Return last column number
-  unsigned int lastColumn() const { return lv() != nullptr ? lv()->lastColumn() : 0; }
+  unsigned int lastColumn() const;
 
   /// Return whether location is introduced by the compiler
-  bool isIntroduced() const { return _locInfo.lv == nullptr || ((_locInfo.t & 1) != 0); }
+  bool isIntroduced() const { return _idx == 0 || ((_idx & 1) != 0); }
 
   /// Mark as alive for garbage collection
   void mark() const;
 
+  /// Prepare the location table for marking (called by the garbage collector)
+  static void startMark();
+  /// Release all locations that have not been marked (called by the garbage collector)
+  static void sweep();
+  /// Return number of locations in the table
+  static size_t tableSize();
+
   /// Return location with introduced flag set
   Location introduce() const;
 
@@ -272,10 +247,10 @@ class Expression : public ASTNode {
 protected:
   /// The %MiniZinc type of the expression
   Type _type;
-  /// The annotations
-  Annotation _ann;
   /// The location of the expression
   Location _loc;
+  /// The annotations
+  Annotation _ann;
   /// The hash value of the expression
   size_t _hash;
 
@@ -624,6 +599,10 @@ public:
   SetLit(const Location& loc, IntSetVal* isv);
   /// Construct set
   SetLit(const Location& loc, FloatSetVal* fsv);
+  /// Allocate shared literal (must not be modified)
+  static SetLit* a(IntSetVal* isv);
+  /// Allocate shared literal (must not be modified)
+  static SetLit* a(FloatSetVal* fsv);
   /// Access value
   ASTExprVec<Expression> v() const { return _v; }
   /// Set value
@@ -670,6 +649,8 @@ public:
   StringLit(const Location& loc, const std::string& v);
   /// Constructor
   StringLit(const Location& loc, const ASTString& v);
+  /// Allocate shared literal (must not be modified)
+  static StringLit* a(const ASTString& v);
   /// Access value
   ASTString v() const { return _v; }
   /// Set value
@@ -716,6 +697,8 @@ public:
   }
   /// Return identifier or X_INTRODUCED plus identifier number
   ASTString str() const;
+  /// Print identifier or X_INTRODUCED plus identifier number to \a os (without creating a string)
+  void printStr(std::ostream& os) const;
   /// Access declaration
   VarDecl* decl() const {
     Expression* d = _decl;
@@ -772,13 +755,19 @@ public:
 class ArrayLit : public Expression {
   friend class Expression;
 
+public:
+  /// Kind of unboxed storage used for par arrays
+  enum ParKind { PK_NONE, PK_INT, PK_FLOAT, PK_BOOL };
+
 protected:
   /// The array
   union {
-    /// An expression vector (if _flag2==false)
+    /// An expression vector (if _flag2==false and parKind()==PK_NONE)
     ASTExprVecO<Expression*>* v;
     /// Another array literal (if _flag2==true)
     ArrayLit* al;
+    /// Unboxed values (if parKind()!=PK_NONE)
+    ASTParVecO* pv;
   } _u;
   /// The declared array dimensions
   // If _flag2 is true, then this is an array view. In that case,
@@ -786,6 +775,14 @@ protected:
   ASTIntVec _dims;
   /// Set compressed vector (initial repetitions are removed)
   void compress(const std::vector<Expression*>& v, const std::vector<int>& dims);
+  /// Store \a v as unboxed values if all elements are par literals of the same kind
+  bool storeUnboxed(const std::vector<Expression*>& v);
+  /// Return element \a i of unboxed storage
+  Expression* getUnboxed(unsigned int i) const;
+  /// Set element \a i of unboxed storage
+  void setUnboxed(unsigned int i, Expression* e);
+  /// Make this a view of unboxed array \a v with dimensions \a dims
+  void viewUnboxed(ArrayLit& v, const std::vector<std::pair<int, int> >& dims);
 
 public:
   /// Index conversion from slice to original
@@ -819,13 +816,13 @@ public:
   // The following methods are only used for copying
 
   /// Access value
-  ASTExprVec<Expression> getVec() const {
-    assert(!_flag2);
-    return _u.v;
-  }
+  /// Allocates a new vector on every call if the values are stored unboxed, so
+  /// loops that only read elements should use operator[] instead.
+  ASTExprVec<Expression> getVec() const;
   /// Set value
   void setVec(const ASTExprVec<Expression>& val) {
     assert(!_flag2);
+    _secondaryId = PK_NONE;
     _u.v = val.vec();
   }
   /// Get underlying array (if this is an array slice) or NULL
@@ -847,15 +844,42 @@ public:
   bool flat() const { return _flag1; }
   /// Set whether this array was produced by flattening
   void flat(bool b) { _flag1 = b; }
+  /// Return kind of unboxed storage (PK_NONE if elements are stored as expressions)
+  ParKind parKind() const { return static_cast<ParKind>(_secondaryId); }
+  /// Return unboxed integer values (only if parKind()==PK_INT)
+  const long long int* parInts() const {
+    assert(parKind() == PK_INT);
+    return _u.pv->ints();
+  }
+  /// Return unboxed float values (only if parKind()==PK_FLOAT)
+  const double* parFloats() const {
+    assert(parKind() == PK_FLOAT);
+    return _u.pv->floats();
+  }
+  /// Return unboxed Boolean value \a i (only if parKind()==PK_BOOL)
+  bool parBool(unsigned int i) const {
+    assert(parKind() == PK_BOOL);
+    return _u.pv->getBool(i);
+  }
   /// Return size of underlying array
-  unsigned int size() const { return (_flag2 || _u.v->flag()) ? length() : _u.v->size(); }
+  unsigned int size() const {
+    if (_secondaryId != PK_NONE) {
+      return _u.pv->size();
+    }
+    return (_flag2 || _u.v->flag()) ? length() : _u.v->size();
+  }
   /// Access element \a i
   Expression* operator[](unsigned int i) const {
+    if (_secondaryId != PK_NONE) {
+      return getUnboxed(i);
+    }
     return (_flag2 || _u.v->flag()) ? getSlice(i) : (*_u.v)[i];
   }
   /// Set element \a i
   void set(unsigned int i, Expression* e) {
-    if (_flag2 || _u.v->flag()) {
+    if (_secondaryId != PK_NONE) {
+      setUnboxed(i, e);
+    } else if (_flag2 || _u.v->flag()) {
       setSlice(i, e);
     } else {
       (*_u.v)[i] = e;
@@ -1974,6 +1998,14 @@ public:
   std::unordered_map<IntVal, WeakRef> integerMap;
   /// Keep track of allocated float literals
   std::unordered_map<FloatVal, WeakRef> floatMap;
+  /// Keep track of allocated set literals (indexed by hash value)
+  std::unordered_multimap<size_t, WeakRef> setMap;
+  /// Size of setMap at which entries for collected literals are removed
+  size_t setMapLimit = 1024;
+  /// Keep track of allocated string literals (indexed by their string)
+  ASTNodeWeakMap stringMap;
+  /// Identifiers of the operators (created on first use, see BinOp::opToString)
+  GCMarker* operatorIds = nullptr;
   /// Constructor
   Constants();
   /// Return shared BoolLit
@@ -1983,7 +2015,7 @@ public:
   void mark(MINIZINC_GC_STAT_ARGS) override;
 };
 
-/// Return static instance
+/// Return the constants of the current thread's garbage collector
 Constants& constants();
 
 }  // namespace MiniZinc
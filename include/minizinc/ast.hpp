@@ -67,11 +67,13 @@ inline IntLit* IntLit::a(MiniZinc::IntVal v) {
     }
   }
 
-  auto it = constants().integerMap.find(v);
-  if (it == constants().integerMap.end() || it->second() == nullptr) {
+  GCConcurrentLock lock;
+  auto& map = constants().integerMap;
+  auto it = map.find(v);
+  if (it == map.end() || it->second() == nullptr) {
     auto* il = new IntLit(Location().introduce(), v);
-    if (it == constants().integerMap.end()) {
-      constants().integerMap.insert(std::make_pair(v, il));
+    if (it == map.end()) {
+      map.insert(std::make_pair(v, il));
     } else {
       it->second = il;
     }
@@ -91,77 +93,6 @@ inline IntLit* IntLit::aEnum(IntVal v, unsigned int enumId) {
   return il;
 }
 
-inline ASTString Location::LocVec::filename() const {
-  return static_cast<ASTStringData*>(_data[0]);
-}
-inline unsigned int Location::LocVec::firstLine() const {
-  if (_size == 2) {
-    static const unsigned int pointerBits = sizeof(void*) * 8;
-    auto* il = static_cast<IntLit*>(_data[1]);
-    long long unsigned int mask = pointerBits <= 32 ? 0xFF : 0xFFFFF;
-    union {
-      long long int i;
-      unsigned long long int u;
-    } ui;
-    ui.i = il->v().toInt();
-    return static_cast<unsigned int>(ui.u & mask);
-  }
-  auto* il = static_cast<IntLit*>(_data[1]);
-  return il->v().toInt();
-}
-inline unsigned int Location::LocVec::lastLine() const {
-  if (_size == 2) {
-    static const unsigned int pointerBits = sizeof(void*) * 8;
-    auto* il = static_cast<IntLit*>(_data[1]);
-    long long unsigned int first_line_size = pointerBits <= 32 ? 8 : 20;
-    long long unsigned int mask = pointerBits <= 32 ? 0xFF : 0xFFFFF;
-    long long unsigned int offsetmask = pointerBits <= 32 ? 0x7F : 0xFFFFF;
-    union {
-      long long int i;
-      unsigned long long int u;
-    } ui;
-    ui.i = il->v().toInt();
-    // return first line (8 bit) + offset (7 bit)
-    return static_cast<unsigned int>((ui.u & mask) + ((ui.u >> first_line_size) & offsetmask));
-  }
-  auto* il = static_cast<IntLit*>(_data[2]);
-  return il->v().toInt();
-}
-inline unsigned int Location::LocVec::firstColumn() const {
-  if (_size == 2) {
-    static const unsigned int pointerBits = sizeof(void*) * 8;
-    auto* il = static_cast<IntLit*>(_data[1]);
-    long long unsigned int first_col_offset = pointerBits <= 32 ? 8 + 7 : 20 + 20;
-    long long unsigned int mask = pointerBits <= 32 ? 0x3F : 0x3FF;
-    union {
-      long long int i;
-      unsigned long long int u;
-    } ui;
-    ui.i = il->v().toInt();
-    // return first line (8 bit) + offset (7 bit)
-    return static_cast<unsigned int>((ui.u >> first_col_offset) & mask);
-  }
-  auto* il = static_cast<IntLit*>(_data[3]);
-  return il->v().toInt();
-}
-inline unsigned int Location::LocVec::lastColumn() const {
-  if (_size == 2) {
-    static const unsigned int pointerBits = sizeof(void*) * 8;
-    auto* il = static_cast<IntLit*>(_data[1]);
-    long long unsigned int last_col_offset = pointerBits <= 32 ? 8 + 7 + 6 : 20 + 20 + 10;
-    long long unsigned int mask = pointerBits <= 32 ? 0x7F : 0x3FF;
-    union {
-      long long int i;
-      unsigned long long int u;
-    } ui;
-    ui.i = il->v().toInt();
-    // return first line (8 bit) + offset (7 bit)
-    return static_cast<unsigned int>((ui.u >> last_col_offset) & mask);
-  }
-  auto* il = static_cast<IntLit*>(_data[4]);
-  return il->v().toInt();
-}
-
 inline FloatLit::FloatLit(const Location& loc, FloatVal v)
     : Expression(loc, E_FLOATLIT, Type::parfloat()), _v(v) {
   rehash();
@@ -175,11 +106,13 @@ inline FloatLit* FloatLit::a(MiniZinc::FloatVal v) {
     }
   }
 
-  auto it = constants().floatMap.find(v);
-  if (it == constants().floatMap.end() || it->second() == nullptr) {
+  GCConcurrentLock lock;
+  auto& map = constants().floatMap;
+  auto it = map.find(v);
+  if (it == map.end() || it->second() == nullptr) {
     auto* fl = new FloatLit(Location().introduce(), v);
-    if (it == constants().floatMap.end()) {
-      constants().floatMap.insert(std::make_pair(v, fl));
+    if (it == map.end()) {
+      map.insert(std::make_pair(v, fl));
     } else {
       it->second = fl;
     }
@@ -304,6 +237,8 @@ inline ArrayLit::ArrayLit(const Location& loc, ArrayLit& v,
       d[sliceOffset + i] = v._dims[origSliceOffset + i];
     }
     _dims = ASTIntVec(d);
+  } else if (v.parKind() != PK_NONE) {
+    viewUnboxed(v, dims);
   } else {
     std::vector<int> d(dims.size() * 2);
     for (auto i = static_cast<unsigned int>(dims.size()); (i--) != 0U;) {
@@ -316,6 +251,7 @@ inline ArrayLit::ArrayLit(const Location& loc, ArrayLit& v,
     }
     _u.v = v._u.v;
   }
+  _secondaryId = PK_NONE;
   rehash();
 }
 
@@ -333,6 +269,8 @@ inline ArrayLit::ArrayLit(const Location& loc, ArrayLit& v) : Expression(loc, E_
       d[sliceOffset + i] = v._dims[origSliceOffset + i];
     }
     _dims = ASTIntVec(d);
+  } else if (v.parKind() != PK_NONE) {
+    viewUnboxed(v, {{1, static_cast<int>(v.size())}});
   } else {
     _u.v = v._u.v;
     if (_u.v->flag()) {
@@ -344,6 +282,7 @@ inline ArrayLit::ArrayLit(const Location& loc, ArrayLit& v) : Expression(loc, E_
       // don't allocate dims vector since this is a 1d array indexed from 1
     }
   }
+  _secondaryId = PK_NONE;
   rehash();
 }
 
@@ -392,6 +331,18 @@ inline ArrayLit::ArrayLit(const Location& loc, const std::vector<std::vector<Exp
   rehash();
 }
 
+inline Expression* ArrayLit::getUnboxed(unsigned int i) const {
+  switch (parKind()) {
+    case PK_INT:
+      return intToUnboxedInt(_u.pv->ints()[i]);
+    case PK_FLOAT:
+      return doubleToUnboxedFloatVal(_u.pv->floats()[i]);
+    default:
+      assert(parKind() == PK_BOOL);
+      return constants().boollit(_u.pv->getBool(i));
+  }
+}
+
 inline ArrayAccess::ArrayAccess(const Location& loc, Expression* v,
                                 const std::vector<Expression*>& idx)
     : Expression(loc, E_ARRAYACCESS, Type()) {
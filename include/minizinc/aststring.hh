@@ -14,11 +14,13 @@
 #include <minizinc/gc.hh>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <iostream>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace MiniZinc {
 
@@ -38,6 +40,10 @@ public:
   /// Constructor
   ASTString(const std::string& s);
   /// Constructor
+  explicit ASTString(const char* s);
+  /// Constructor (string \a s of length \a n)
+  ASTString(const char* s, size_t n);
+  /// Constructor
   ASTString(ASTStringData* s) : _s(s){};
   /// Copy constructor
   ASTString(const ASTString& s) = default;
@@ -120,14 +126,32 @@ namespace MiniZinc {
 
 struct CStringHash {
 public:
-  // FIXME: This is not an amazing hash function
-  size_t operator()(const std::pair<const char*, size_t>& s) const {
-    size_t result = 0;
-    const size_t prime = 31;
-    for (size_t i = 0; i < s.second; ++i) {
-      result = s.first[i] + (result * prime);
+  /// Hash \a n bytes starting at \a s
+  static size_t hash(const char* s, size_t n) {
+    // Multiply-rotate over 8-byte words, finished with the murmur3 avalanche
+    const uint64_t m = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = n * m;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+      uint64_t w;
+      memcpy(&w, s + i, 8);
+      h = ((h ^ w) * m);
+      h = (h << 31) | (h >> 33);
     }
-    return result;
+    if (i < n) {
+      uint64_t w = 0;
+      memcpy(&w, s + i, n - i);
+      h = ((h ^ w) * m);
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+  size_t operator()(const std::pair<const char*, size_t>& s) const {
+    return hash(s.first, s.second);
   }
 };
 struct CStringEquals {
@@ -145,16 +169,38 @@ class ASTStringData : public ASTChunk {
   friend class GC::Heap;
 
 protected:
-  /// Interning Hash Map
-  using Interner = std::unordered_map<std::pair<const char*, size_t>, ASTStringData*, CStringHash,
-                                      CStringEquals>;
+  /// Interning hash table (open addressing with linear probing)
+  class Interner {
+  protected:
+    /// A table entry, caching the hash value of the string
+    struct Slot {
+      size_t hash;
+      ASTStringData* s;
+    };
+    /// The table (size is a power of two, empty slots have s==nullptr)
+    std::vector<Slot> _slots;
+    /// Number of strings in the table
+    size_t _count = 0;
+    /// Grow table so it can hold \a n strings
+    void grow(size_t n);
+
+  public:
+    /// Return interned string for \a s of length \a n with hash \a h, or nullptr
+    ASTStringData* find(const char* s, size_t n, size_t h) const;
+    /// Insert \a s (which must not be in the table yet)
+    void insert(ASTStringData* s);
+    /// Remove \a s from the table
+    void erase(const ASTStringData* s);
+  };
   static Interner& interner();
   /// Constructor
-  ASTStringData(const std::string& s);
+  ASTStringData(const char* s, size_t n, size_t h);
 
 public:
   /// Allocate and initialise as \a s
-  static ASTStringData* a(const std::string& s);
+  static ASTStringData* a(const std::string& s) { return a(s.c_str(), s.size()); }
+  /// Allocate and initialise as string \a s of length \a n
+  static ASTStringData* a(const char* s, size_t n);
   /// Return underlying C-style string
   // NOLINTNEXTLINE(readability-identifier-naming)
   const char* c_str() const { return _data + sizeof(size_t); }
@@ -174,13 +220,12 @@ public:
 
 protected:
   /// GC Destructor
-  void destroy() const {
-    assert(interner().find({this->c_str(), this->size()}) != interner().end());
-    interner().erase({this->c_str(), this->size()});
-  };
+  void destroy() const { interner().erase(this); };
 };
 
 inline ASTString::ASTString(const std::string& s) : _s(ASTStringData::a(s)) {}
+inline ASTString::ASTString(const char* s) : _s(ASTStringData::a(s, strlen(s))) {}
+inline ASTString::ASTString(const char* s, size_t n) : _s(ASTStringData::a(s, n)) {}
 
 inline size_t ASTString::size() const { return _s != nullptr ? _s->size() : 0; }
 // NOLINTNEXTLINE(readability-identifier-naming)
@@ -13,6 +13,7 @@
 
 #include <minizinc/gc.hh>
 
+#include <cstdint>
 #include <vector>
 
 namespace MiniZinc {
@@ -124,6 +125,51 @@ public:
   void mark() const { _gcMark = 1; }
 };
 
+/// Garbage collected vector of unboxed par values (integers, floats or Booleans)
+class ASTParVecO : public ASTChunk {
+protected:
+  /// Constructor
+  ASTParVecO(unsigned int n, size_t words);
+  /// Return storage words
+  uint64_t* words() { return reinterpret_cast<uint64_t*>(_data) + 1; }
+  /// Return storage words
+  const uint64_t* words() const { return reinterpret_cast<const uint64_t*>(_data) + 1; }
+
+public:
+  /// Allocate vector of \a n integers or floats
+  static ASTParVecO* a(unsigned int n);
+  /// Allocate vector of \a n Booleans
+  static ASTParVecO* aBool(unsigned int n);
+  /// Return number of values
+  unsigned int size() const {
+    return static_cast<unsigned int>(reinterpret_cast<const uint64_t*>(_data)[0]);
+  }
+  /// Return integer storage
+  long long int* ints() { return reinterpret_cast<long long int*>(words()); }
+  /// Return integer storage
+  const long long int* ints() const { return reinterpret_cast<const long long int*>(words()); }
+  /// Return float storage
+  double* floats() { return reinterpret_cast<double*>(words()); }
+  /// Return float storage
+  const double* floats() const { return reinterpret_cast<const double*>(words()); }
+  /// Return Boolean at position \a i
+  bool getBool(unsigned int i) const {
+    assert(i < size());
+    return ((words()[i / 64] >> (i % 64)) & 1U) != 0;
+  }
+  /// Set Boolean at position \a i
+  void setBool(unsigned int i, bool b) {
+    assert(i < size());
+    if (b) {
+      words()[i / 64] |= static_cast<uint64_t>(1) << (i % 64);
+    } else {
+      words()[i / 64] &= ~(static_cast<uint64_t>(1) << (i % 64));
+    }
+  }
+  /// Mark as alive for garbage collection
+  void mark() const { _gcMark = 1; }
+};
+
 /// Garbage collected vector of expressions
 template <class T>
 class ASTExprVecO : public ASTVec {
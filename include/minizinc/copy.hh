@@ -21,8 +21,16 @@ protected:
   ModelMap _modelMap;
 
   ASTNodeWeakMap _nodeMap;
+  /// Section whose collector owns the copied nodes (nullptr if it is the current collector)
+  const GCConcurrentSection* _source = nullptr;
 
 public:
+  CopyMap() = default;
+  /// Create map for copying nodes of the collector of \a source on one of its workers.
+  /// Locations, strings and the constants are then recreated in the worker's collector.
+  explicit CopyMap(const GCConcurrentSection& source);
+  /// Return the section whose collector owns the copied nodes, or nullptr
+  const GCConcurrentSection* source() const { return _source; }
   void insert(Expression* e0, Expression* e1);
   Expression* find(Expression* e);
   void insert(Item* e0, Item* e1);
@@ -42,12 +50,19 @@ public:
     ASTNode* n = _nodeMap.find(e.vec());
     return static_cast<ASTExprVecO<T*>*>(n);
   }
+  /// Number of copied nodes
+  size_t size() const { return _nodeMap.size(); }
+  /// Prepare the map for copying \a n nodes
+  void reserve(size_t n) { _nodeMap.reserve(n); }
   void clear() {
     _modelMap.clear();
     _nodeMap.clear();
   }
 };
 
+/// Return \a s as a string of the current collector (see CopyMap::source)
+ASTString copy_string(CopyMap& m, const ASTString& s);
+
 /// Create a deep copy of expression \a e
 Expression* copy(EnvI& env, Expression* e, bool followIds = false, bool copyFundecls = false,
                  bool isFlatModel = false);
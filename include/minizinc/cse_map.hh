@@ -0,0 +1,132 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/ast.hh>
+#include <minizinc/gc.hh>
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Table of common subexpressions
+ *
+ * Maps expressions to the result of flattening them. The table keeps its keys
+ * alive, while the results are weak: when the garbage collector frees a result
+ * expression, the reference in the table is set to nullptr.
+ *
+ * Entries are stored in a deque, so pointers to entries (which are the
+ * iterators of the table) stay valid when other entries are inserted. They are
+ * indexed by an open-addressing hash table with linear probing, whose slots
+ * store the hash of the key next to the entry number. A lookup only looks at
+ * entries with the same hash, and compares their keys by pointer before
+ * comparing them structurally.
+ */
+class CSEMap : public GCMarker {
+public:
+  /// Reference to an expression that is cleared when the expression is collected
+  class Ref {
+  protected:
+    Expression* _e;
+
+  public:
+    Ref(Expression* e = nullptr) : _e(e) {}
+    Expression* operator()() const { return _e; }
+    friend class CSEMap;
+  };
+  /// Result of flattening an expression
+  struct Value {
+    Ref r;
+    Ref b;
+    Value(Expression* r0, Expression* b0) : r(r0), b(b0) {}
+  };
+  /// Entry of the table
+  struct Entry {
+    Expression* first;
+    Value second;
+    Entry(Expression* e, const Value& v) : first(e), second(v) {}
+  };
+  /// Iterator type (pointer to an entry, end() is nullptr)
+  typedef Entry* iterator;
+
+protected:
+  /// Slot of the hash table
+  struct Slot {
+    /// Hash of the key
+    size_t hash;
+    /// Index of the entry, or _empty
+    unsigned int entry;
+  };
+  static const unsigned int _empty = static_cast<unsigned int>(-1);
+  /// The hash table (size is a power of two)
+  std::vector<Slot> _slots;
+  /// Base 2 logarithm of the size of the hash table
+  unsigned int _bits;
+  /// Number of keys in the table
+  size_t _size;
+  /// The entries
+  std::deque<Entry> _entries;
+  /// Indices of removed entries
+  std::vector<unsigned int> _free;
+  /// Number of successful lookups
+  unsigned long long int _hits;
+  /// Number of unsuccessful lookups
+  unsigned long long int _misses;
+  /// Number of occupied slots probed without finding the key
+  unsigned long long int _collisions;
+
+  /// Return the first slot to probe for hash \a h
+  size_t home(size_t h) const {
+    return static_cast<size_t>((static_cast<uint64_t>(h) * 0x9E3779B97F4A7C15ULL) >>
+                               (64 - _bits));
+  }
+  /// Return the slot containing \a e, or the empty slot where it would be inserted
+  size_t lookup(Expression* e, size_t h);
+  /// Double the size of the hash table
+  void grow();
+
+  /// Mark the keys
+  void mark(MINIZINC_GC_STAT_ARGS) override;
+  /// Clear the references to results that have not been marked
+  void clearWeak() override;
+
+public:
+  CSEMap();
+  /// Find \a e in the table
+  iterator find(Expression* e);
+  /// Insert mapping from \a e to \a v, unless \a e is already in the table
+  void insert(Expression* e, const Value& v);
+  /// Remove binding of \a e from the table
+  void remove(Expression* e);
+  /// End of iterator
+  iterator end() { return nullptr; }
+  /// Remove all entries
+  void clear();
+  /// Return number of keys in the table
+  size_t size() const { return _size; }
+  /// Return number of successful lookups
+  unsigned long long int hits() const { return _hits; }
+  /// Return number of unsuccessful lookups
+  unsigned long long int misses() const { return _misses; }
+  /// Return number of occupied slots probed without finding the key
+  unsigned long long int collisions() const { return _collisions; }
+
+  template <class D>
+  void dump() {
+    for (auto& e : _entries) {
+      if (e.first != nullptr) {
+        std::cerr << D::k(e.first) << ": " << D::d(e.second) << std::endl;
+      }
+    }
+  }
+};
+
+}  // namespace MiniZinc
@@ -56,6 +56,13 @@ public:
   const char* what() const throw() override { return "MiniZinc: time out"; }
 };
 
+class MemoryLimit : public Exception {
+public:
+  MemoryLimit(const std::string& msg) : Exception(msg) {}
+  ~MemoryLimit() throw() override {}
+  const char* what() const throw() override { return "MiniZinc: memory limit exceeded"; }
+};
+
 class ArithmeticError : public Exception {
 public:
   ArithmeticError(const std::string& msg) : Exception(msg) {}
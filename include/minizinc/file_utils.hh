@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,10 @@ std::string progpath();
 bool file_exists(const std::string& filename);
 /// Test if \a dirname exists and is a directory
 bool directory_exists(const std::string& dirname);
+/// Get size and modification time of \a filename, return false if it cannot be accessed
+bool file_stat(const std::string& filename, long long& size, long long& mtime);
+/// Create directory \a dirname (if it does not exist), return whether it exists afterwards
+bool create_directory(const std::string& dirname);
 /// Find executable \a filename anywhere on the path
 /// On Windows, also check extensions .exe and .bat
 std::string find_executable(const std::string& filename);
@@ -91,6 +96,36 @@ public:
   std::string name() const { return _name; }
 };
 
+/// Read-only contents of a file, memory mapped where possible
+class MappedFile {
+private:
+  const char* _data;
+  size_t _size;
+  bool _open;
+  void* _mapped;
+  std::string _contents;
+
+public:
+  /// Open \a filename (check isOpen() for success)
+  MappedFile(const std::string& filename);
+  /// Destructor (unmaps file)
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  /// Whether the file could be opened
+  bool isOpen() const { return _open; }
+  /// Whether the contents are memory mapped (rather than copied into memory)
+  bool isMapped() const { return _mapped != nullptr; }
+  /// Contents of the file (not null-terminated)
+  const char* data() const { return _data; }
+  /// Size of the file
+  size_t size() const { return _size; }
+  /// Tell the operating system that the contents will be read soon, front to back
+  void willNeed() const;
+  /// Drop the memory pages between \a begin and \a end (they are read again if accessed)
+  void release(size_t begin, size_t end) const;
+};
+
 /// Inflate string \a s
 void inflate_string(std::string& s);
 /// Deflate string \a s
@@ -42,6 +42,8 @@ struct FlatteningOptions {
   bool enableHalfReification;
   /// Timeout for flattening in milliseconds (0 means no timeout)
   unsigned long long int timeout;
+  /// Memory limit for compilation in megabytes (0 means no limit)
+  unsigned long long int memoryLimit;
   /// Create standard, DZN or JSON output
   enum OutputMode { OUTPUT_ITEM, OUTPUT_DZN, OUTPUT_JSON, OUTPUT_CHECKER } outputMode;
   /// Output objective value (only for DZN and JSON mode)
@@ -52,6 +54,10 @@ struct FlatteningOptions {
   bool hasChecker;
   /// Output detailed timing information for flattening
   bool detailedTiming;
+  /// Record a profile of the function calls made during flattening (see FlattenProfiler)
+  bool profileCalls;
+  /// Evaluate calls of par functions using compiled bytecode where possible (see ParBytecode)
+  bool parBytecode;
   /// Default constructor
   FlatteningOptions()
       : keepOutputInFzn(false),
@@ -62,10 +68,13 @@ struct FlatteningOptions {
         onlyRangeDomains(false),
         enableHalfReification(true),
         timeout(0),
+        memoryLimit(0),
         outputMode(OUTPUT_ITEM),
         outputObjective(false),
         outputOutputItem(false),
-        detailedTiming(false) {}
+        detailedTiming(false),
+        profileCalls(false),
+        parBytecode(true) {}
 };
 
 class Pass {
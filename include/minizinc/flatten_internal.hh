@@ -12,11 +12,16 @@
 #pragma once
 
 #include <minizinc/copy.hh>
+#include <minizinc/cse_map.hh>
 #include <minizinc/eval_par.hh>
 #include <minizinc/flatten.hh>
+#include <minizinc/flatten_profile.hh>
 #include <minizinc/optimize.hh>
+#include <minizinc/par_bytecode.hh>
 
 #include <cmath>
+#include <deque>
+#include <memory>
 
 // TODO: Should this be a command line option? It doesn't seem too expensive
 // #define OUTPUT_CALLTREE
@@ -93,14 +98,14 @@ public:
   VarOccurrences outputFlatVarOccurrences;
   CopyMap cmap;
   IdMap<KeepAlive> reverseMappers;
-  struct WW {
-    WeakRef r;
-    WeakRef b;
-    WW(const WeakRef& r0, const WeakRef& b0) : r(r0), b(b0) {}
-  };
-  typedef KeepAliveMap<WW> CSEMap;
+  typedef MiniZinc::CSEMap CSEMap;
+  typedef CSEMap::Value WW;
   bool ignorePartial;
   bool ignoreUnknownIds;
+  /// Number of threads for type checking function bodies
+  unsigned int typecheckThreads;
+  /// Functions that are already type checked (the shared library of a server job)
+  std::unordered_set<const FunctionI*> checkedFunctions;
   std::vector<Expression*> callStack;
   std::vector<std::pair<KeepAlive, bool> > errorStack;
   std::vector<int> idStack;
@@ -119,6 +124,19 @@ public:
   } counters;
   bool inReverseMapVar;
   FlatteningOptions fopts;
+  /// Profile of the function calls during flattening (if FlatteningOptions::profileCalls is set)
+  std::unique_ptr<FlattenProfiler> profiler;
+  /// Identifiers [first, last) generated while flattening an item of the model
+  struct ItemIds {
+    Item* item;
+    long long int first;
+    long long int last;
+  };
+  /// Identifiers generated while flattening the variable declarations and constraints of
+  /// the model (only recorded if not null, see FlattenPartition::restrict)
+  std::unique_ptr<std::vector<ItemIds> > itemIds;
+  /// Compiled bodies of par functions (used if FlatteningOptions::parBytecode is set)
+  ParBytecode parBytecode;
   unsigned int pathUse;
   ASTStringMap<Item*> reverseEnum;
 
@@ -146,19 +164,24 @@ protected:
   std::vector<VarDeclI*> _enumVarDecls;
   typedef std::unordered_map<std::string, unsigned int> ArrayEnumMap;
   ArrayEnumMap _arrayEnumMap;
-  std::vector<std::vector<unsigned int> > _arrayEnumDecls;
+  // A deque keeps references returned by getArrayEnum valid when new entries are registered
+  std::deque<std::vector<unsigned int> > _arrayEnumDecls;
   bool _collectVardecls;
 
 public:
   EnvI(Model* model0, std::ostream& outstream0 = std::cout, std::ostream& errstream0 = std::cerr);
   ~EnvI();
   long long int genId();
+  /// Return the identifier that genId returns next
+  long long int nextId() const { return _ids; }
   /// Set minimum new temporary id to \a i+1
   void minId(unsigned int i) { _ids = std::max(_ids, i + 1); }
   void cseMapInsert(Expression* e, const EE& ee);
   CSEMap::iterator cseMapFind(Expression* e);
   void cseMapRemove(Expression* e);
   CSEMap::iterator cseMapEnd();
+  /// Return the table of common subexpressions (for statistics)
+  const CSEMap& cseMap() const { return _cseMap; }
   void dump();
 
   unsigned int registerEnum(VarDeclI* vdi);
@@ -192,6 +215,8 @@ public:
   ASTStringSet& getFilenameSet() { return _filenameSet; }
 
   void copyPathMapsAndState(EnvI& env);
+  /// Copy the enum tables of \a env, whose model has been copied using \a cm
+  void copyTypeState(EnvI& env, CopyMap& cm);
   /// deprecated, use Solns2Out
   std::ostream& evalOutput(std::ostream& os, std::ostream& log);
   void createErrorStack();
@@ -0,0 +1,154 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/ast.hh>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Profile of the function calls made during flattening
+ *
+ * Records a tree of calls. Each node stands for a function called from a
+ * source location within the call of its parent node, and counts the calls,
+ * the time spent in them, and the variables and constraints added to the flat
+ * model while the node was the innermost active one. The root stands for the
+ * whole flattening process, and its children for the top-level items.
+ *
+ * Only calls whose body is flattened or evaluated (user-defined and library
+ * functions) get a node; constraints that are added for builtins are
+ * attributed to the calling function.
+ */
+class FlattenProfiler {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// Scope that is attributed to a node of the profile (does nothing without a
+  /// profiler, or outside of the scope of the root)
+  class Scope {
+  protected:
+    FlattenProfiler* _p;
+
+  public:
+    /// Enter the root of \a p
+    explicit Scope(FlattenProfiler* p) : _p(p) {
+      if (_p != nullptr) {
+        _p->enter(0);
+      }
+    }
+    /// Enter call to \a fn at \a loc
+    Scope(FlattenProfiler* p, FunctionI* fn, const Location& loc)
+        : _p(p != nullptr && !p->_stack.empty() ? p : nullptr) {
+      if (_p != nullptr) {
+        _p->enter(_p->child(fn, loc));
+      }
+    }
+    /// Enter top-level item of kind \a kind at \a loc
+    Scope(FlattenProfiler* p, const char* kind, const Location& loc)
+        : _p(p != nullptr && !p->_stack.empty() ? p : nullptr) {
+      if (_p != nullptr) {
+        _p->enter(_p->child(kind, loc));
+      }
+    }
+    ~Scope() {
+      if (_p != nullptr) {
+        _p->exit();
+      }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+protected:
+  /// Node of the call tree
+  struct Node {
+    /// Index of the parent node
+    unsigned int parent;
+    /// Name of the function, or kind of item
+    std::string name;
+    /// Location of the function definition ("file:line", empty for items)
+    std::string definition;
+    /// File name of the call site
+    std::string file;
+    /// Line of the call site
+    unsigned int line;
+    /// Whether the node stands for a function call (rather than an item)
+    bool isCall;
+    /// Number of calls
+    unsigned long long int calls;
+    /// Time spent in the calls (including children)
+    Clock::duration time;
+    /// Number of variables added, excluding children
+    unsigned long long int vars;
+    /// Number of constraints added, excluding children
+    unsigned long long int constraints;
+    Node(unsigned int parent0, std::string name0, std::string definition0, std::string file0,
+         unsigned int line0, bool isCall0)
+        : parent(parent0),
+          name(std::move(name0)),
+          definition(std::move(definition0)),
+          file(std::move(file0)),
+          line(line0),
+          isCall(isCall0),
+          calls(0),
+          time(Clock::duration::zero()),
+          vars(0),
+          constraints(0) {}
+  };
+  /// Key identifying a child node (file names are interned, so they are compared by address)
+  struct Key {
+    unsigned int parent;
+    const void* id;
+    const char* file;
+    unsigned int line;
+    bool operator==(const Key& k) const {
+      return parent == k.parent && id == k.id && file == k.file && line == k.line;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const;
+  };
+  /// The nodes (the root has index 0, every node has a larger index than its parent)
+  std::vector<Node> _nodes;
+  /// Index of the children of each node
+  std::unordered_map<Key, unsigned int, KeyHash> _children;
+  /// Active nodes and the time they were entered
+  std::vector<std::pair<unsigned int, Clock::time_point> > _stack;
+
+  /// Return child of the innermost active node for call to \a fn at \a loc
+  unsigned int child(FunctionI* fn, const Location& loc);
+  /// Return child of the innermost active node for item of kind \a kind at \a loc
+  unsigned int child(const char* kind, const Location& loc);
+  /// Make node \a n the innermost active node
+  void enter(unsigned int n);
+  /// Leave the innermost active node
+  void exit();
+
+  /// Return label of node \a n in a collapsed stack
+  std::string label(unsigned int n) const;
+
+public:
+  FlattenProfiler();
+
+  /// Count item \a i added to the flat model
+  void addItem(const Item* i);
+
+  /// Write the profile in collapsed stack format (one line per call path with
+  /// the exclusive time in microseconds), the input format of flame graph tools
+  void writeCollapsed(std::ostream& os) const;
+  /// Write the profile as JSON, aggregated by function (or item kind) and call site
+  void writeJSON(std::ostream& os) const;
+};
+
+}  // namespace MiniZinc
@@ -38,8 +38,49 @@
 
 namespace MiniZinc {
 
+/**
+ * \brief Type checked model shared by the instances of a data batch
+ *
+ * The model is parsed and type checked (without data) by the first instance.
+ * Each following instance copies it and only binds and type checks its data.
+ */
+class BatchModel {
+public:
+  /// Environment of the type checked model (nullptr if it cannot be shared)
+  std::unique_ptr<Env> env;
+  /// Messages produced while parsing the model
+  std::string messages;
+  /// Whether the model has been built (or building it has failed)
+  bool initialised = false;
+};
+
+/**
+ * \brief Type checked standard library shared by the models compiled by a server thread
+ *
+ * The library is parsed and type checked by the first model. Each following model
+ * copies it, is parsed into the copy and only type checks its own items.
+ */
+class LibraryModel {
+public:
+  /// Include paths the library was parsed with
+  std::vector<std::string> includePaths;
+  /// Environment of the type checked library (nullptr if it cannot be shared)
+  std::unique_ptr<Env> env;
+  /// Paths of the library files
+  std::vector<std::string> files;
+  /// Number of nodes copied for the last model
+  size_t copySize = 0;
+  /// Messages produced while parsing the library
+  std::string messages;
+  /// Whether the library has been built (or building it has failed)
+  bool initialised = false;
+};
+
 class Flattener {
 private:
+  /// Streams of an Env created by concurrent flattening, writing to _os and _log
+  std::unique_ptr<std::ostream> _envOs;
+  std::unique_ptr<std::ostream> _envLog;
   std::unique_ptr<Env> _pEnv;
   std::ostream& _os;
   std::ostream& _log;
@@ -63,6 +104,10 @@ public:
   void setFlagTimelimit(unsigned long long int t) { _fopts.timeout = t; }
   unsigned long long int getFlagTimelimit() const { return _fopts.timeout; }
   void setFlagOutputByDefault(bool f) { _fOutputByDefault = f; }
+  /// Share the type checked model with the other instances of a data batch
+  void setBatchModel(std::shared_ptr<BatchModel> bm) { _batchModel = std::move(bm); }
+  /// Share the type checked library with other models compiled by this thread
+  void setLibraryModel(std::shared_ptr<LibraryModel> lm) { _libraryModel = std::move(lm); }
   Env* getEnv() const {
     assert(_pEnv.get());
     return _pEnv.get();
@@ -75,6 +120,17 @@ public:
 
 private:
   Env* multiPassFlatten(const std::vector<std::unique_ptr<Pass> >& passes);
+  /// Flatten independent groups of constraints of the type checked model of \a env
+  /// on separate threads, return nullptr if the model has to be flattened sequentially
+  Env* flattenConcurrently(Env* env, CompilePassFlags& cfs);
+  /// Set up the environment by copying the batch model and binding the data,
+  /// return false if the model has to be parsed and type checked instead
+  bool instantiateBatchModel(const std::string& modelText, const std::string& modelName,
+                             const std::string& libraryImage);
+  /// Set up the environment by parsing the model into a copy of the library model and type
+  /// checking it, return false if the model has to be parsed and type checked as a whole
+  bool instantiateLibraryModel(const std::string& modelText, const std::string& modelName,
+                               const std::string& libraryImage);
 
   bool _fOutputByDefault = false;  // if the class is used in mzn2fzn, write .fzn+.ozn by default
   std::vector<std::string> _filenames;
@@ -111,12 +167,17 @@ private:
     bool outputObjective = false;
     bool outputOutputItem = false;
     bool compileSolutionCheckModel = false;
+    bool precompileLibrary = false;
+    bool noLibraryImage = false;
+    bool lazyGlobals = false;
   } _flags;
 
   int _optMIPDmaxIntvEE = 0;
   double _optMIPDmaxDensEE = 0.0;
 
   unsigned int _flagPrePasses = 1;
+  unsigned int _flagTypecheckThreads = 1;
+  unsigned int _flagFlattenThreads = 1;
 
   std::string _stdLibDir;
   std::string _globalsDir;
@@ -125,9 +186,13 @@ private:
   std::string _flagOutputFzn;
   std::string _flagOutputOzn;
   std::string _flagOutputPaths;
+  std::string _flagOutputFlattenProfile;
   FlatteningOptions::OutputMode _flagOutputMode = FlatteningOptions::OUTPUT_ITEM;
   std::string _flagSolutionCheckModel;
+  std::string _flagLibraryImage;
   FlatteningOptions _fopts;
+  std::shared_ptr<BatchModel> _batchModel;
+  std::shared_ptr<LibraryModel> _libraryModel;
 
   Timer _starttime;
 };
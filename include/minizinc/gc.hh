@@ -14,10 +14,14 @@
 #include <minizinc/config.hh>
 #include <minizinc/timer.hh>
 
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <iosfwd>
+#include <mutex>
 #include <new>
 #include <unordered_map>
+#include <vector>
 
 //#define MINIZINC_GC_STATS
 
@@ -130,21 +134,100 @@ protected:
 class Expression;
 
 class GCMarker;
+class GCMemoryLimitHandler;
 class KeepAlive;
 class WeakRef;
 
 class ASTNodeWeakMap;
 class ASTStringData;
 
-/// Garbage collector
+class Constants;
+Constants& constants();
+
+/**
+ * \brief Table of root handles
+ *
+ * Slots are allocated in chunks that are never moved, so a pointer to a slot
+ * is a stable handle. Copies of a KeepAlive or WeakRef share the slot and only
+ * increment its reference count. Marking scans the chunks linearly.
+ */
+class GCHandleTable {
+public:
+  /// A handle
+  struct Slot {
+    /// The referenced expression (nullptr once a weak reference is cleared)
+    Expression* e;
+    /// Number of KeepAlive or WeakRef objects sharing this slot (atomic, as the workers of a
+    /// GCConcurrentSection can copy the same handle)
+    std::atomic<unsigned int> refs;
+  };
+
+private:
+  /// Number of slots per chunk
+  static const unsigned int _chunkSize = 4096;
+  /// The chunks
+  std::vector<Slot*> _chunks;
+  /// Released slots available for reuse
+  std::vector<Slot*> _free;
+  /// Number of slots used in the last chunk
+  unsigned int _lastUsed;
+
+public:
+  GCHandleTable() : _lastUsed(_chunkSize) {}
+  ~GCHandleTable();
+  GCHandleTable(const GCHandleTable&) = delete;
+  GCHandleTable& operator=(const GCHandleTable&) = delete;
+
+  /// Return a new slot referencing \a e
+  Slot* acquire(Expression* e);
+  /// Return slot \a s (which must not be referenced any more) to the table
+  void release(Slot* s) {
+    s->e = nullptr;
+    _free.push_back(s);
+  }
+  /// Call \a f on every slot that is currently in use
+  template <class F>
+  void forEach(F f) {
+    for (unsigned int i = 0; i < _chunks.size(); i++) {
+      unsigned int n = i + 1 == _chunks.size() ? _lastUsed : _chunkSize;
+      Slot* chunk = _chunks[i];
+      for (unsigned int j = 0; j < n; j++) {
+        if (chunk[j].refs != 0) {
+          f(chunk[j]);
+        }
+      }
+    }
+  }
+  /// Number of slots currently in use
+  size_t size() const {
+    return (_chunks.empty() ? 0 : (_chunks.size() - 1) * _chunkSize + _lastUsed) - _free.size();
+  }
+  /// Number of slots allocated in total
+  size_t capacity() const { return _chunks.size() * _chunkSize; }
+};
+
+/**
+ * \brief Garbage collector
+ *
+ * Every thread that creates nodes has its own collector. Interned strings and
+ * the nodes returned by constants() belong to the collector of the thread that
+ * created them, so nodes cannot be passed between threads (except to the
+ * workers of a GCConcurrentSection).
+ */
 class GC {
   friend class ASTNode;
+  friend class Expression;
   friend class ASTVec;
   friend class ASTChunk;
   friend class ASTStringData;
   friend class KeepAlive;
   friend class WeakRef;
   friend class ASTNodeWeakMap;
+  friend class GCMemoryLimitHandler;
+  friend class GCConcurrentSection;
+  friend class GCConcurrentLock;
+  friend class Location;
+  friend Constants& constants();
 
 private:
   class Heap;
@@ -158,18 +241,42 @@ private:
   int _timeoutCount;
   /// Timer for timeout
   Timer _timeoutTimer;
+  /// Innermost handler for exceeding the memory limit
+  GCMemoryLimitHandler* _memoryLimitHandler;
+  /// Table of source locations of the nodes in this collector (managed by Location)
+  void* _locations;
+  /// Table of the strings interned in this collector (managed by ASTStringData)
+  void* _interner;
+  /// Nodes shared by all models in this collector (see constants())
+  Constants* _constants;
+  /// Whether the collector is shared by several threads (see GCConcurrentSection)
+  bool _concurrent;
+  /// Mutex protecting the collector while it is shared
+  std::recursive_mutex _mutex;
   /// Return thread-local GC object
   static GC*& gc();
+  /// Return thread-local GC object, creating it if necessary
+  static GC* current();
+  /// Return lock on the collector's mutex, which is only acquired if the collector is shared
+  std::unique_lock<std::recursive_mutex> concurrentLock() {
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::defer_lock);
+    if (_concurrent) {
+      lock.lock();
+    }
+    return lock;
+  }
   /// Constructor
   GC();
 
   /// Allocate garbage collected memory
   void* alloc(size_t size);
+  /// Return the stack shared by all (possibly nested) calls to Expression::mark
+  static std::vector<const Expression*>& markStack();
 
-  static void addKeepAlive(KeepAlive* e);
-  static void removeKeepAlive(KeepAlive* e);
-  static void addWeakRef(WeakRef* e);
-  static void removeWeakRef(WeakRef* e);
+  static GCHandleTable::Slot* addKeepAlive(Expression* e);
+  static void removeKeepAlive(GCHandleTable::Slot* s);
+  static GCHandleTable::Slot* addWeakRef(Expression* e);
+  static void removeWeakRef(GCHandleTable::Slot* s);
   static void addNodeWeakMap(ASTNodeWeakMap* m);
   static void removeNodeWeakMap(ASTNodeWeakMap* m);
 
@@ -186,6 +293,8 @@ public:
   static void add(GCMarker* m);
   /// Remove model \a m from root set
   static void remove(GCMarker* m);
+  /// Test if \a n has been marked by the running collection (for GCMarker::clearWeak)
+  static bool marked(const ASTNode* n) { return n->_gcMark != 0U; }
 
   /// Put a mark on the trail
   static void mark();
@@ -196,9 +305,13 @@ public:
 
   /// Set timeout of \a t milliseconds, 0 means disable
   static void setTimeout(unsigned long long int t);
+  /// Set memory limit of \a m bytes, 0 means disable
+  static void setMemoryLimit(size_t m);
 
   /// Return maximum allocated memory (high water mark)
   static size_t maxMem();
+  /// Print collector and allocation statistics in mzn-stat format
+  static void printStatistics(std::ostream& os);
 };
 
 /// Automatic garbage collection lock
@@ -210,23 +323,93 @@ public:
   ~GCLock();
 };
 
+/**
+ * \brief Section in which other threads share the collector of the current thread
+ *
+ * While the section is active, garbage collection is disabled, and allocation,
+ * root handles, the string interner and other state shared by the threads are
+ * protected by a mutex (see GCConcurrentLock). A worker thread must create a
+ * GCConcurrentSection::Worker before it creates or modifies any nodes.
+ */
+class GCConcurrentSection {
+private:
+  GC* _gc;
+
+public:
+  /// Start section for the collector of the current thread
+  GCConcurrentSection();
+  /// End section (all workers must have finished)
+  ~GCConcurrentSection();
+  GCConcurrentSection(const GCConcurrentSection&) = delete;
+  GCConcurrentSection& operator=(const GCConcurrentSection&) = delete;
+
+  /// Use the collector of a section in the current thread
+  class Worker {
+  private:
+    GC* _prev;
+
+  public:
+    Worker(const GCConcurrentSection& s);
+    ~Worker();
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+  };
+};
+
+/// Lock for state shared by the threads of a GCConcurrentSection (no-op outside of sections)
+class GCConcurrentLock {
+private:
+  std::unique_lock<std::recursive_mutex> _lock;
+
+public:
+  GCConcurrentLock() : _lock(GC::current()->concurrentLock()) {}
+};
+
 /// Expression wrapper that is a member of the root set
 class KeepAlive {
   friend class GC;
 
 private:
   Expression* _e;
-  KeepAlive* _p;
-  KeepAlive* _n;
+  /// Handle in the root table (nullptr for null or unboxed expressions)
+  GCHandleTable::Slot* _s;
+  void release() {
+    if (_s != nullptr && --_s->refs == 0) {
+      GC::removeKeepAlive(_s);
+    }
+  }
 
 public:
   KeepAlive(Expression* e = nullptr);
-  ~KeepAlive();
-  KeepAlive(const KeepAlive& e);
-  KeepAlive& operator=(const KeepAlive& e);
+  ~KeepAlive() { release(); }
+  KeepAlive(const KeepAlive& e) : _e(e._e), _s(e._s) {
+    if (_s != nullptr) {
+      ++_s->refs;
+    }
+  }
+  KeepAlive(KeepAlive&& e) noexcept : _e(e._e), _s(e._s) { e._s = nullptr; }
+  KeepAlive& operator=(const KeepAlive& e) {
+    if (_s != e._s) {
+      if (e._s != nullptr) {
+        ++e._s->refs;
+      }
+      release();
+      _s = e._s;
+    }
+    _e = e._e;
+    return *this;
+  }
+  KeepAlive& operator=(KeepAlive&& e) noexcept {
+    if (this != &e) {
+      release();
+      _e = e._e;
+      _s = e._s;
+      e._s = nullptr;
+    }
+    return *this;
+  }
   Expression* operator()() { return _e; }
   Expression* operator()() const { return _e; }
-  KeepAlive* next() const { return _n; }
 };
 
 /// Expression wrapper that is a member of the root set
@@ -234,19 +417,47 @@ class WeakRef {
   friend class GC;
 
 private:
+  /// The expression if it is unboxed (or null)
   Expression* _e;
-  WeakRef* _p;
-  WeakRef* _n;
-  bool _valid;
+  /// Handle in the weak reference table (nullptr for null or unboxed expressions)
+  GCHandleTable::Slot* _s;
+  void release() {
+    if (_s != nullptr && --_s->refs == 0) {
+      GC::removeWeakRef(_s);
+    }
+  }
 
 public:
   WeakRef(Expression* e = nullptr);
-  ~WeakRef();
-  WeakRef(const WeakRef& e);
-  WeakRef& operator=(const WeakRef& e);
-  Expression* operator()() { return _valid ? _e : nullptr; }
-  Expression* operator()() const { return _valid ? _e : nullptr; }
-  WeakRef* next() const { return _n; }
+  ~WeakRef() { release(); }
+  WeakRef(const WeakRef& e) : _e(e._e), _s(e._s) {
+    if (_s != nullptr) {
+      ++_s->refs;
+    }
+  }
+  WeakRef(WeakRef&& e) noexcept : _e(e._e), _s(e._s) { e._s = nullptr; }
+  WeakRef& operator=(const WeakRef& e) {
+    if (_s != e._s) {
+      if (e._s != nullptr) {
+        ++e._s->refs;
+      }
+      release();
+      _s = e._s;
+    }
+    _e = e._e;
+    return *this;
+  }
+  WeakRef& operator=(WeakRef&& e) noexcept {
+    if (this != &e) {
+      release();
+      _e = e._e;
+      _s = e._s;
+      e._s = nullptr;
+    }
+    return *this;
+  }
+  Expression* operator()() { return _s != nullptr ? _s->e : _e; }
+  Expression* operator()() const { return _s != nullptr ? _s->e : _e; }
 };
 
 class ASTNodeWeakMap {
@@ -258,9 +469,8 @@ private:
 
 protected:
   typedef std::unordered_map<ASTNode*, ASTNode*> NodeMap;
-  ASTNodeWeakMap* _p;
-  ASTNodeWeakMap* _n;
-  ASTNodeWeakMap* next() const { return _n; }
+  /// Position in the collector's table of weak maps
+  size_t _idx;
   NodeMap _m;
 
 public:
@@ -269,6 +479,31 @@ public:
   void insert(ASTNode* n0, ASTNode* n1);
   ASTNode* find(ASTNode* n);
   void clear() { _m.clear(); }
+  size_t size() const { return _m.size(); }
+  void reserve(size_t n) { _m.reserve(n); }
+};
+
+/**
+ * \brief Abstract base class for handlers of memory limit violations
+ *
+ * While a handler exists, the collector calls its exceeded() method (innermost
+ * handler only) before throwing a MemoryLimit exception, so that the context
+ * of the failing allocation can be recorded before the stack is unwound.
+ */
+class GCMemoryLimitHandler {
+  friend class GC;
+
+private:
+  /// Enclosing handler
+  GCMemoryLimitHandler* _prev;
+
+protected:
+  /// Called when the memory limit has been exceeded
+  virtual void exceeded() = 0;
+
+public:
+  GCMemoryLimitHandler();
+  virtual ~GCMemoryLimitHandler();
 };
 
 /**
@@ -286,6 +521,9 @@ private:
 protected:
   /// Mark garbage collected objects that
   virtual void mark(MINIZINC_GC_STAT_ARGS) = 0;
+  /// Clear references to objects that have not been marked (called after all
+  /// roots have been marked)
+  virtual void clearWeak() {}
 
 public:
   GCMarker() { GC::add(this); }
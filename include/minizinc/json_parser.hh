@@ -49,21 +49,47 @@ protected:
   int _line;
   int _column;
   std::string _filename;
+  /// Current position in the input buffer
+  const char* _pos;
+  /// End of the input buffer
+  const char* _end;
+  /// Stream to read further input from (or nullptr if the whole input is in memory)
+  std::istream* _is;
+  /// Buffer holding the current chunk of a streamed input
+  std::vector<char> _chunk;
   Location errLocation() const;
-  Token readToken(std::istream& is);
-  void expectToken(std::istream& is, TokenT t);
-  std::string expectString(std::istream& is);
-  void expectEof(std::istream& is);
-  Token parseEnumString(std::istream& is);
-  Expression* parseExp(std::istream& is, bool parseObjects = true, bool possibleString = true);
-  ArrayLit* parseArray(std::istream& is, bool possibleString = true);
-  Expression* parseObject(std::istream& is, bool possibleString = true);
+  /// Start reading from the memory block \a data of size \a size
+  void initInput(const char* data, size_t size);
+  /// Start reading from stream \a is in chunks
+  void initInput(std::istream& is);
+  /// Read the next chunk of a streamed input, keeping the text from _pos onwards
+  bool refill();
+  /// Make sure the character at _pos+i is available, return false at end of input
+  bool available(size_t i) {
+    while (_pos + i >= _end) {
+      if (!refill()) {
+        return false;
+      }
+    }
+    return true;
+  }
+  Token readToken();
+  Token readString();
+  Token readNumber();
+  void expectKeyword(const char* kw, size_t len);
+  void expectToken(TokenT t);
+  std::string expectString();
+  void expectEof();
+  Token parseEnumString();
+  Expression* parseExp(bool parseObjects = true, bool possibleString = true);
+  ArrayLit* parseArray(bool possibleString = true);
+  Expression* parseObject(bool possibleString = true);
 
-  void parseModel(Model* m, std::istream& is, bool isData);
+  void parseModel(Model* m, bool isData);
   static Expression* coerceArray(TypeInst* intendedTI, ArrayLit* al);
 
 public:
-  JSONParser(EnvI& env) : _env(env) {}
+  JSONParser(EnvI& env) : _env(env), _pos(nullptr), _end(nullptr), _is(nullptr) {}
   /// Parses \a filename as MiniZinc data and creates assign items in \a m
   void parse(Model* m, const std::string& filename, bool isData = true);
   /// Parses \a data as JSON-encoded MiniZinc data and creates assign items in \a m
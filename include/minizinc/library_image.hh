@@ -0,0 +1,41 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/model.hh>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Precompiled image of the parsed standard library
+ *
+ * The image contains the models of all files included (directly or
+ * indirectly) by the library root files, exactly as produced by the parser.
+ * It is only valid for the include paths and the compiler version it was
+ * created with, and it becomes stale as soon as any of the library files
+ * (or the include directories) change.
+ */
+class LibraryImage {
+public:
+  /// Models for the library root files (in the order they were parsed)
+  std::vector<Model*> roots;
+  /// All library models, indexed by the canonical name used to include them
+  std::map<std::string, Model*> models;
+
+  /// Default image file name for the given \a includePaths (empty if unavailable)
+  static std::string defaultFile(const std::vector<std::string>& includePaths);
+  /// Write image for \a includePaths to \a filename, return whether it succeeded
+  bool write(const std::string& filename, const std::vector<std::string>& includePaths) const;
+  /// Read image from \a filename, return false if it is missing, corrupt or stale
+  bool read(const std::string& filename, const std::vector<std::string>& includePaths);
+};
+
+}  // namespace MiniZinc
@@ -122,6 +122,36 @@ protected:
     TCheckedDecl boundsDisj = {false, nullptr};        // SCIP's bound disjunction
   } _fnDecls;
 
+  /// Key of the function dispatch cache
+  struct DispatchKey {
+    ASTString id;
+    bool strictEnums;
+    std::vector<int> t;
+    bool operator==(const DispatchKey& k) const {
+      return id == k.id && strictEnums == k.strictEnums && t == k.t;
+    }
+  };
+  struct DispatchKeyHash {
+    size_t operator()(const DispatchKey& k) const;
+  };
+  /// Cache of function matches, indexed by function name and argument types
+  mutable std::unordered_map<DispatchKey, FunctionI*, DispatchKeyHash> _dispatchCache;
+  /// Key of the current cache lookup (reused to avoid allocations)
+  mutable DispatchKey _dispatchKey;
+  /// Number of function matches answered by the dispatch cache
+  mutable unsigned long long int _dispatchHits;
+  /// Number of function matches computed and stored in the dispatch cache
+  mutable unsigned long long int _dispatchMisses;
+
+  /// Start a dispatch cache lookup for \a id (argument types are added to _dispatchKey.t)
+  void dispatchKey(const ASTString& id, bool strictEnums) const;
+  /// Return cached match for the current key, or nullptr
+  FunctionI* dispatchFind() const;
+  /// Store \a fi as the match for the current key
+  void dispatchInsert(FunctionI* fi) const;
+  /// Invalidate the dispatch cache after the function table changed
+  void dispatchClear();
+
 public:
   /// Construct empty model
   Model();
@@ -182,6 +212,10 @@ public:
                        FunctionI* g) const;
   /// Merge all builtin functions into \a m
   void mergeStdLib(EnvI& env, Model* m) const;
+  /// Return number of function matches answered by the dispatch cache
+  unsigned long long int dispatchCacheHits() const;
+  /// Return number of function matches computed and stored in the dispatch cache
+  unsigned long long int dispatchCacheMisses() const;
 
   /// Return item \a i
   Item*& operator[](unsigned int i);
@@ -14,6 +14,10 @@
 #include <minizinc/flatten_internal.hh>
 #include <minizinc/hash.hh>
 
+#include <deque>
+#include <string>
+#include <unordered_map>
+
 namespace MiniZinc {
 
 class OptimizeRegistry {
@@ -22,7 +26,10 @@ public:
   typedef ConstraintStatus (*optimizer)(EnvI& env, Item* i, Call* c, Expression*& rewrite);
 
 protected:
-  ASTStringMap<optimizer> _m;
+  /// Names of the registered calls (copied, as the registry is shared by all threads)
+  std::deque<std::string> _names;
+  /// Optimizers indexed by call name
+  std::unordered_map<std::pair<const char*, size_t>, optimizer, CStringHash, CStringEquals> _m;
 
 public:
   void reg(const ASTString& call, optimizer opt);
@@ -0,0 +1,95 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/ast.hh>
+#include <minizinc/values.hh>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Bytecode compiler and interpreter for par function bodies
+ *
+ * The body of a function that returns a par int, bool or float is compiled
+ * into code for a register machine the first time the function is evaluated.
+ * The machine has separate registers for integers (also used for Booleans),
+ * floats and arrays, and works on unboxed values, so evaluating a call does
+ * not allocate any expressions.
+ *
+ * The compiler supports literals, parameters, global parameters, let
+ * expressions without domains, array accesses, if-then-else, the arithmetic,
+ * comparison and Boolean operators, abs, min, max, bool2int and int2float,
+ * calls of other compiled functions, and sum, forall and exists over
+ * comprehensions whose generators range over intervals or index sets. A
+ * function whose body uses anything else is evaluated by the tree-walking
+ * evaluator.
+ *
+ * Running a program has no side effects. If it fails (because of a division
+ * by zero, an array access out of bounds, an overflow, or a global parameter
+ * that has not been evaluated yet), the call is evaluated by the tree-walking
+ * evaluator instead, which computes the value or reports the error. Calls of
+ * other functions made by a program are not recorded by the FlattenProfiler.
+ */
+class ParBytecode {
+public:
+  /// Compiled function body
+  class Program;
+
+protected:
+  class Compiler;
+  /// Compiled bodies (including the ones that could not be compiled)
+  std::unordered_map<FunctionI*, std::unique_ptr<Program> > _programs;
+  /// Integer registers
+  std::vector<IntVal> _ints;
+  /// Float registers
+  std::vector<FloatVal> _floats;
+  /// Array registers
+  std::vector<ArrayLit*> _arrays;
+  /// Number of calls evaluated by a program
+  unsigned long long int _calls;
+  /// Number of calls whose program failed
+  unsigned long long int _fallbacks;
+
+  /// Return program for \a fn, compiling it if necessary (nullptr if it cannot be compiled)
+  Program* program(FunctionI* fn);
+  /// Return program for \a fn with result kind \a kind, with the parameter registers set
+  /// to \a args (nullptr if the call cannot be evaluated by a program)
+  Program* prepare(FunctionI* fn, const std::vector<Expression*>& args, int kind);
+  /// Run \a p with registers starting at the given offsets
+  bool run(Program* p, size_t ib, size_t fb, size_t ab, unsigned int depth);
+  /// Run \a p prepared for a call, recording whether it succeeded
+  bool run(Program* p);
+
+public:
+  ParBytecode();
+  ~ParBytecode();
+  ParBytecode(const ParBytecode&) = delete;
+  ParBytecode& operator=(const ParBytecode&) = delete;
+
+  /// Evaluate call of \a fn with par arguments \a args into \a ret (returns false if not
+  /// evaluated)
+  bool evalInt(FunctionI* fn, const std::vector<Expression*>& args, IntVal& ret);
+  /// Evaluate call of \a fn with par arguments \a args into \a ret (returns false if not
+  /// evaluated)
+  bool evalBool(FunctionI* fn, const std::vector<Expression*>& args, bool& ret);
+  /// Evaluate call of \a fn with par arguments \a args into \a ret (returns false if not
+  /// evaluated)
+  bool evalFloat(FunctionI* fn, const std::vector<Expression*>& args, FloatVal& ret);
+
+  /// Return number of calls evaluated by a program
+  unsigned long long int calls() const { return _calls; }
+  /// Return number of calls that fell back to the tree-walking evaluator after a program failed
+  unsigned long long int fallbacks() const { return _fallbacks; }
+  /// Return number of functions that have been compiled
+  unsigned int compiled() const;
+};
+
+}  // namespace MiniZinc
@@ -0,0 +1,77 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/flatten.hh>
+#include <minizinc/model.hh>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Partition of a model into groups of constraints that can be flattened independently
+ *
+ * Two constraints are put into the same group if they (transitively) share a
+ * top-level variable, either directly, through the right hand side of a
+ * variable declaration, or through the body of a user-defined function. Calls
+ * to user-defined functions that return variables but only have par arguments
+ * are common subexpressions, so all constraints calling such a function end
+ * up in the same group. The solve item and all constraints that do not
+ * mention any variable belong to group 0.
+ *
+ * Every group is flattened in its own Env, which holds a copy of the type
+ * checked model restricted to the constraints of the group. The flat models of
+ * groups 1..n-1 are then merged into the flat model of group 0. Each group
+ * keeps the declarations of all variables, so the output model is the same in
+ * all groups. Before merging, each group removes the connected components of
+ * its flat model that contain variables owned by another group, and clears the
+ * output declarations of those variables. Components without top-level
+ * variables are kept by the group that owns the item that introduced them.
+ *
+ * Par arrays introduced for different groups are merged if they are equal,
+ * and introduced variables are renamed using fresh identifiers of group 0, so
+ * the merged model contains the same items as the result of sequential
+ * flattening, up to the names of introduced variables and the item order.
+ */
+class FlattenPartition {
+public:
+  /// Number of groups
+  unsigned int groups = 0;
+  /// Group of each constraint item, in the order of iter_items
+  std::vector<unsigned int> constraintGroup;
+  /// Group of each top-level variable
+  std::unordered_map<std::string, unsigned int> varGroup;
+
+  /// Partition the type checked model of \a env into at most \a n groups.
+  /// Returns false if the model cannot be split into at least two groups.
+  bool compute(EnvI& env, unsigned int n);
+  /// Remove the constraints of other groups from the type checked model of \a env,
+  /// and the solve item unless \a group is 0, and record the variables introduced by
+  /// each item during flattening. Returns false if \a env does not match the
+  /// partitioned model.
+  bool restrict(EnvI& env, unsigned int group) const;
+  /// Remove the variables of other groups from the flat and output model of \a env.
+  /// Returns false if they are connected to variables or constraints of \a group.
+  bool removeForeign(EnvI& env, unsigned int group) const;
+  /// Merge the flat models of \a groups (for groups 1..n-1) into \a env (group 0).
+  /// Returns false if a model could not be merged.
+  bool merge(EnvI& env, const std::vector<EnvI*>& groups) const;
+
+  /// Return the name of \a vd in the flat model
+  static std::string name(const VarDecl* vd);
+};
+
+/// Run \a job on a thread of a pool shared by all flattening jobs of the process.
+/// Returns false if no thread could be started. The threads, and the garbage
+/// collectors they create, are kept until the process exits.
+bool run_flatten_job(const std::function<void()>& job);
+
+}  // namespace MiniZinc
@@ -28,6 +28,7 @@ protected:
   std::unordered_set<std::string> _blacklist;
   std::unordered_map<std::string, std::string> _boolSwitches;
   void addValue(const ASTString& flag, Expression* e);
+  void addModel(Model& m);
   static std::string flagName(const ASTString& flag);
   static std::string modelToString(Model& model);
 
@@ -35,6 +36,8 @@ public:
   ParamConfig() {}
   /// Load a configuration from a JSON file
   void load(const std::string& filename);
+  /// Load a configuration from a string containing a JSON object
+  void loadFromString(const std::string& data);
   /// Add given parameter to blacklist
   void blacklist(const std::string& disallowed);
   /// Add given parameters to blacklist
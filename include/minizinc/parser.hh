@@ -74,17 +74,22 @@ struct ParseWorkItem {
 /// %State of the %MiniZinc parser
 class ParserState {
 public:
-  ParserState(const std::string& f, const std::string& b, std::ostream& err0,
+  ParserState(const std::string& f, const char* b, size_t len, std::ostream& err0,
               const std::vector<std::string>& includePaths0, std::vector<ParseWorkItem>& files0,
               std::map<std::string, Model*>& seenModels0, MiniZinc::Model* model0, bool isDatafile0,
               bool isFlatZinc0, bool isSTDLib0, bool parseDocComments0)
       : filename(f.c_str()),
-        buf(b.c_str()),
+        buf(b),
         pos(0),
-        length(static_cast<unsigned int>(b.size())),
+        length(len),
+        textLength(len),
+        mappedFile(nullptr),
+        releasedPos(0),
         lineStartPos(0),
         nTokenNextStart(1),
         hadNewline(false),
+        startLine(1),
+        startColumn(1),
         includePaths(includePaths0),
         files(files0),
         seenModels(seenModels0),
@@ -95,17 +100,33 @@ public:
         parseDocComments(parseDocComments0),
         hadError(false),
         err(err0) {}
+  ParserState(const std::string& f, const std::string& b, std::ostream& err0,
+              const std::vector<std::string>& includePaths0, std::vector<ParseWorkItem>& files0,
+              std::map<std::string, Model*>& seenModels0, MiniZinc::Model* model0, bool isDatafile0,
+              bool isFlatZinc0, bool isSTDLib0, bool parseDocComments0)
+      : ParserState(f, b.c_str(), b.size(), err0, includePaths0, files0, seenModels0, model0,
+                    isDatafile0, isFlatZinc0, isSTDLib0, parseDocComments0) {}
 
   const char* filename;
 
   void* yyscanner;
+  /// Input buffer (not necessarily null-terminated, e.g. when memory mapped)
   const char* buf;
-  unsigned int pos, length;
-
-  int lineStartPos;
+  size_t pos, length;
+  /// Length of the text at \a buf (which may extend beyond the parsed part)
+  size_t textLength;
+  /// File mapped at \a buf (if any), pages that have been scanned are released
+  const FileUtils::MappedFile* mappedFile;
+  size_t releasedPos;
+
+  size_t lineStartPos;
   int nTokenNextStart;
   bool hadNewline;
 
+  /// Source location of the first character that is parsed
+  unsigned int startLine;
+  unsigned int startColumn;
+
   const std::vector<std::string>& includePaths;
   std::vector<ParseWorkItem>& files;
   std::map<std::string, Model*>& seenModels;
@@ -122,15 +143,15 @@ public:
   std::string stringBuffer;
 
   void printCurrentLine(int firstCol, int lastCol) {
-    const char* eol_c = strchr(buf + lineStartPos, '\n');
-    if (eol_c != nullptr) {
-      if (eol_c == buf + lineStartPos) {
-        return;
-      }
-      err << std::string(buf + lineStartPos, eol_c - (buf + lineStartPos));
-    } else {
-      err << buf + lineStartPos;
+    if (lineStartPos > textLength) {
+      return;
+    }
+    const char* line = buf + lineStartPos;
+    const auto* eol_c = static_cast<const char*>(memchr(line, '\n', textLength - lineStartPos));
+    if (eol_c == line) {
+      return;
     }
+    err << std::string(line, eol_c != nullptr ? eol_c - line : buf + textLength - line);
     err << std::endl;
     for (int i = 0; i < firstCol - 1; i++) {
       err << " ";
@@ -145,12 +166,26 @@ public:
     if (pos >= length) {
       return 0;
     }
-    int num = std::min(length - pos, lexBufSize);
+    auto num = static_cast<int>(std::min(length - pos, static_cast<size_t>(lexBufSize)));
     memcpy(lexBuf, buf + pos, num);
     pos += num;
+    // Keep the current line for error messages
+    if (mappedFile != nullptr && lineStartPos >= releasedPos + (16 << 20)) {
+      size_t offset = buf - mappedFile->data();
+      mappedFile->release(offset + releasedPos, offset + lineStartPos);
+      releasedPos = lineStartPos;
+    }
     return num;
   }
 
+  /// Start parsing at offset \a p into the buffer (which must start at the beginning of a line)
+  void startAt(size_t p, unsigned int line, unsigned int column) {
+    pos = p;
+    nTokenNextStart += static_cast<int>(p);
+    startLine = line;
+    startColumn = column;
+  }
+
   std::string canonicalFilename(const std::string& f) const;
 };
 
@@ -158,7 +193,24 @@ Model* parse(Env& env, const std::vector<std::string>& filename,
              const std::vector<std::string>& datafiles, const std::string& textModel,
              const std::string& textModelName, const std::vector<std::string>& includePaths,
              bool isFlatZinc, bool ignoreStdlib, bool parseDocComments, bool verbose,
-             std::ostream& err);
+             std::ostream& err, const std::string& libraryImage = "",
+             bool lazyGlobals = false);
+
+/** \brief Parse a model that includes \a library instead of the standard library
+ *
+ * The model takes ownership of \a library (e.g. a copy of a model returned by parse_library),
+ * and including any of the \a libraryFiles refers to it.
+ */
+Model* parse(Env& env, Model* library, const std::vector<std::string>& libraryFiles,
+             const std::vector<std::string>& filename, const std::vector<std::string>& datafiles,
+             const std::string& textModel, const std::string& textModelName,
+             const std::vector<std::string>& includePaths, bool isFlatZinc,
+             bool parseDocComments, bool verbose, std::ostream& err, bool lazyGlobals = false);
+
+/// Parse the standard library on its own, storing the paths of its files in \a libraryFiles
+Model* parse_library(Env& env, const std::vector<std::string>& includePaths, bool verbose,
+                     std::ostream& err, const std::string& libraryImage,
+                     std::vector<std::string>& libraryFiles);
 
 Model* parse_from_string(Env& env, const std::string& text, const std::string& filename,
                          const std::vector<std::string>& includePaths, bool isFlatZinc,
@@ -169,4 +221,8 @@ Model* parse_data(Env& env, Model* m, const std::vector<std::string>& datafiles,
                   const std::vector<std::string>& includePaths, bool isFlatZinc, bool ignoreStdlib,
                   bool parseDocComments, bool verbose, std::ostream& err);
 
+/// Parse the standard library and store it as a precompiled image in \a imageFile
+bool precompile_library(const std::vector<std::string>& includePaths, const std::string& imageFile,
+                        bool verbose, std::ostream& err);
+
 }  // namespace MiniZinc
@@ -26,6 +26,7 @@ struct CompilePassFlags {
   bool modelCheckOnly;
   bool modelInterfaceOnly;
   bool allowMultiAssign;
+  bool typechecked;
 };
 
 class CompilePass : public Pass {
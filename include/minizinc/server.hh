@@ -0,0 +1,94 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#pragma once
+
+#include <minizinc/solver.hh>
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MiniZinc {
+
+/**
+ * \brief Compiler server processing a stream of jobs in a single process
+ *
+ * Each job is a JSON object on a single line, using the same format as
+ * command-line parameter files. The key \c model-text can be used to pass
+ * the model source code directly. The options of a job are appended to the
+ * options the server was started with, and the job is run by a fresh
+ * MznSolver (and therefore with its own Env). The solver configurations are
+ * only loaded once and shared by all jobs.
+ *
+ * The output of a job is followed by a line
+ * <tt>%%%mzn-job-end: <exit status></tt> on the standard output.
+ *
+ * Jobs can be run concurrently by a fixed set of threads. Each thread has its
+ * own garbage collector, which it keeps for all the jobs it runs. The output
+ * of a job is then collected and printed in the order of the input.
+ *
+ * In batch mode, the jobs are given by a list of data files. Each data file
+ * is solved with the model given in the options, and the type checked model
+ * is shared by all instances. The output of an instance is preceded by a line
+ * <tt>%%%mzn-batch-instance: <data file></tt>.
+ */
+class MznServer {
+protected:
+  /// Options passed to every job
+  std::vector<std::string> _args;
+  /// Name of the executable
+  std::string _exeName;
+  /// Solver configurations, populated by the first job
+  std::unique_ptr<SolverConfigs> _solverConfigs;
+  /// Protects _solverConfigs while jobs run concurrently
+  std::mutex _solverConfigsMutex;
+  /// Type checked model shared by the instances of a batch
+  std::shared_ptr<BatchModel> _batchModel;
+  /// Type checked library shared by the jobs run without a pool
+  std::shared_ptr<LibraryModel> _library;
+  /// Threads running jobs concurrently (created by the first call to serve)
+  struct JobPool;
+  std::unique_ptr<JobPool> _pool;
+
+  /// Run the job given by the JSON object \a job using the library \a library of the
+  /// current thread, writing to \a os and \a log, return the exit status
+  int runJob(const std::string& job, const std::shared_ptr<LibraryModel>& library,
+             std::ostream& os, std::ostream& log);
+  /// Run a solver with options \a args and model text \a modelText, writing to
+  /// \a os and \a log, return the exit status
+  int runArgs(const std::vector<std::string>& args, const std::string& modelText,
+              const std::shared_ptr<LibraryModel>& library, std::ostream& os,
+              std::ostream& log);
+  /// Run the batch instance for data file \a dataFile, return the exit status
+  int runInstance(const std::string& dataFile);
+  /// Run the jobs of the pool until it is stopped (executed by each thread of the pool)
+  void work();
+
+public:
+  MznServer(std::vector<std::string> args, std::string exeName);
+  ~MznServer();
+
+  /// Check if \a args request server mode, and remove the server options from \a args
+  static bool processOptions(std::vector<std::string>& args, std::string& socketPath,
+                             unsigned int& threads);
+  /// Check if \a args request batch mode, and remove the batch options from \a args
+  static bool processBatchOptions(std::vector<std::string>& args, std::string& listFile,
+                                  unsigned int& workers);
+
+  /// Run jobs read from \a is until the end of the stream, using \a threads threads
+  void serve(std::istream& is, unsigned int threads = 1);
+  /// Listen on the Unix domain socket \a path and run the jobs of each connection
+  /// using \a threads threads (only returns if an error occurs)
+  void serve(const std::string& path, unsigned int threads = 1);
+  /// Solve the instances given by the data files listed in \a listFile, using
+  /// \a workers worker processes, return the exit status
+  int runBatch(const std::string& listFile, unsigned int workers);
+};
+
+}  // namespace MiniZinc
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -84,6 +85,8 @@ protected:
   virtual SolverInstanceBase* doCreateSI(Env&, std::ostream&, SolverInstanceBase::Options* opt) = 0;
   typedef std::vector<std::unique_ptr<SolverInstanceBase>> SIStorage;
   SIStorage _sistorage;
+  /// Protects _sistorage, as instances can be created by several threads
+  std::mutex _sistorageMutex;
 
   SolverFactory() { get_global_solver_registry()->addSolverFactory(this); }
 
@@ -111,7 +114,8 @@ public:
   SolverInstanceBase* createSI(Env& env, std::ostream& log, SolverInstanceBase::Options* opt);
   /// also providing a manual destroy function.
   /// there is no need to call it upon overall finish - that is taken care of
-  void destroySI(SolverInstanceBase* pSI);
+  /// (returns false if \a pSI was not created by this factory)
+  bool destroySI(SolverInstanceBase* pSI);
 
   /// Process an item in the command line.
   /// Leaving this now like this because this seems simpler.
@@ -136,6 +140,8 @@ private:
   enum OptionStatus { OPTION_OK, OPTION_ERROR, OPTION_FINISH };
   /// Solver configurations
   SolverConfigs _solverConfigs;
+  /// Whether the solver configurations have been populated
+  bool _solverConfigsPopulated = false;
   Flattener _flt;
   SolverInstanceBase* _si = nullptr;
   SolverInstanceBase::Options* _siOpt = nullptr;
@@ -165,6 +171,9 @@ public:
   int flagOverallTimeLimit = 0;
 
   MznSolver(std::ostream& os = std::cout, std::ostream& log = std::cerr);
+  /// Constructor reusing the populated solver configurations \a solverConfigs
+  MznSolver(const SolverConfigs& solverConfigs, std::ostream& os = std::cout,
+            std::ostream& log = std::cerr);
   ~MznSolver();
 
   SolverInstance::Status run(const std::vector<std::string>& args,
@@ -181,6 +190,16 @@ public:
     return _siOpt;
   }
   bool getFlagVerbose() const { return flagVerbose; /*getFlt()->getFlagVerbose();*/ }
+  /// Share the type checked model with the other instances of a data batch
+  void setBatchModel(std::shared_ptr<BatchModel> bm) { _flt.setBatchModel(std::move(bm)); }
+  /// Share the type checked library with other models compiled by this thread
+  void setLibraryModel(std::shared_ptr<LibraryModel> lm) {
+    _flt.setLibraryModel(std::move(lm));
+  }
+  /// Solver configurations (or nullptr if they have not been populated yet)
+  const SolverConfigs* getSolverConfigs() const {
+    return _solverConfigsPopulated ? &_solverConfigs : nullptr;
+  }
   void printUsage();
 
 private:
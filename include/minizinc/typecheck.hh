@@ -50,6 +50,8 @@ public:
   void push();
   /// Pop topmost scope
   void pop();
+  /// Return number of scopes on the stack
+  size_t size() const { return _s.size(); }
 
   /// Return declaration for \a ident, or NULL if not found
   VarDecl* find(Id* ident);
@@ -62,14 +64,15 @@ public:
 class TopoSorter {
 public:
   typedef std::vector<VarDecl*> Decls;
-  typedef std::unordered_map<VarDecl*, int> PosMap;
 
   /// List of all declarations
   Decls decls;
   /// Scoped declarations
   Scopes scopes;
-  /// Map from declarations to positions
-  PosMap pos;
+  /// Declarations by dense id (the id is stored in the declaration's payload while sorting)
+  Decls ids;
+  /// Position in \a decls for each dense id, or -1 while the declaration is being sorted
+  std::vector<int> pos;
   /// The model
   Model* model;
 
@@ -84,15 +87,65 @@ public:
   VarDecl* checkId(EnvI& env, Id* ident, const Location& loc);
   /// Run the topological sorting for expression \a e
   void run(EnvI& env, Expression* e);
+  /// Return dense id of \a vd, or -1 if it has not been seen yet
+  int denseId(VarDecl* vd) const {
+    int i = vd->payload();
+    return i >= 0 && i < static_cast<int>(ids.size()) && ids[i] == vd ? i : -1;
+  }
+
+protected:
+  /// Kinds of work items of the traversal in run
+  enum TaskKind {
+    TK_VISIT,            ///< Visit expression
+    TK_VISIT_ANN,        ///< Visit annotation, removing it if it contains unknown identifiers
+    TK_OPERAND,          ///< Visit operand of a binary operator
+    TK_PUSH,             ///< Push inner scope
+    TK_PUSH_TOPLEVEL,    ///< Push toplevel scope
+    TK_POP,              ///< Pop scope
+    TK_ADD,              ///< Add declaration to current scope
+    TK_DECL_DONE,        ///< Append finished declaration to \a decls
+    TK_LET_DONE          ///< Sort declarations of finished let expression
+  };
+  struct Task {
+    TaskKind kind;
+    Expression* e;
+    /// Expression annotated by \a e (for TK_VISIT_ANN)
+    Expression* annotated;
+    Task(TaskKind kind0, Expression* e0, Expression* annotated0 = nullptr)
+        : kind(kind0), e(e0), annotated(annotated0) {}
+  };
+  /// Work stack of run
+  std::vector<Task> _todo;
+  /// Look up declaration of \a ident, checking for circular definitions
+  VarDecl* find(EnvI& env, Id* ident, const Location& loc);
+  /// Push the tasks for visiting \a e
+  void visit(EnvI& env, Expression* e);
 };
 
-/// Type check the model \a m
+/// Type check the model \a m (creating par versions of functions unless \a makePar is false)
 void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
-               bool ignoreUndefinedParameters, bool allowMultiAssignment, bool isFlatZinc = false);
+               bool ignoreUndefinedParameters, bool allowMultiAssignment, bool isFlatZinc = false,
+               bool makePar = true);
 
 /// Type check new assign item \a ai in model \a m
 void typecheck(Env& env, Model* m, AssignI* ai);
 
+/** \brief Bind the assignments in \a data to the parameters of the type checked model \a m
+ *
+ * Returns false (leaving \a m partially bound) if the data cannot be bound without type
+ * checking the whole model again, e.g. because it contains type errors, defines enums, uses
+ * comprehensions, or does not define all parameters.
+ */
+bool typecheck_data(Env& env, Model* m, Model* data);
+
+/** \brief Check that the functions of \a m that were type checked in advance (see
+ * EnvI::checkedFunctions) are not affected by overloads that \a m adds
+ *
+ * Returns false if a call in an already checked function would resolve differently when
+ * type checking \a m as a whole.
+ */
+bool check_library_overloading(Env& env, Model* m);
+
 /// Output description of parameters and output variables to \a os
 void output_model_interface(Env& env, Model* m, std::ostream& os,
                             const std::vector<std::string>& skipDirs);
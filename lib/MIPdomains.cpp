@@ -102,7 +102,7 @@ enum EnumStatIdx_MIPD {
   N_POSTs_clEEFound,
   N_POSTs_size
 };
-extern std::vector<double> MIPD_stats;
+extern thread_local std::vector<double> MIPD_stats;
 
 enum EnumReifType { RIT_None, RIT_Static, RIT_Reif, RIT_Halfreif };
 enum EnumConstrType { CT_None, CT_Comparison, CT_SetIn, CT_Encode };
@@ -246,7 +246,8 @@ static std::ostream& operator<<(std::ostream& os, LinEqHelper<Coefs, Vars>& led)
   }
   os << " ] * [ ";
   for (auto v : led.vd) {
-    os << v->id()->str() << ' ';
+    v->id()->printStr(os);
+    os << ' ';
   }
   os << " ] ) == " << led.rhs;
   return os;
@@ -266,7 +267,7 @@ typedef LinEqHelper<std::vector<double>, std::vector<VarDecl*> > LinEq;
 //       double rhs;
 //     };
 
-std::vector<double> MIPD_stats(N_POSTs_size);
+thread_local std::vector<double> MIPD_stats(N_POSTs_size);
 
 template <class T>
 static std::vector<T> make_vec(T t1, T t2) {
@@ -294,7 +295,7 @@ public:
     getEnv();
     fVerbose = fV;
   }
-  static bool fVerbose;
+  static thread_local bool fVerbose;
   const int nMaxIntv2Bits = 0;           // Maximal interval length to enforce equality encoding
   const double dMaxNValueDensity = 3.0;  // Maximal ratio cardInt() / size() of a domain
                                          // to enforce ee
@@ -788,7 +789,7 @@ private:
               }
             }
           } else if (al->size() == 1) {
-            static int nn = 0;
+            static thread_local int nn = 0;
             if (++nn <= 7) {
               std::cerr << "  MIPD: LIN_EQ with 1 variable::: " << std::flush;
               std::cerr << (*c) << std::endl;
@@ -1052,7 +1053,7 @@ private:
 
     class LinEqGraph : public TMatrixVars {
     public:
-      static double dCoefMin, dCoefMax;
+      static thread_local double dCoefMin, dCoefMax;
       /// Stores the arc (x1, x2) as x1 = a*x2 + b
       /// so that a constraint on x2, say x2<=c <-> f,
       /// is equivalent to one for x1:  x1 <=/>= a*c+b <-> f
@@ -2297,7 +2298,7 @@ void SetOfIntervals<N>::split2Bits() {
   *(Base*)this = std::move(bsNew);
 }
 
-bool MIPD::fVerbose = false;
+thread_local bool MIPD::fVerbose = false;
 
 void mip_domains(Env& env, bool fVerbose, int nmi, double dmd) {
   MIPD mipd(&env, fVerbose, nmi, dmd);
@@ -2307,7 +2308,7 @@ void mip_domains(Env& env, bool fVerbose, int nmi, double dmd) {
   }
 }
 
-double MIPD::TCliqueSorter::LinEqGraph::dCoefMin = +1e100;
-double MIPD::TCliqueSorter::LinEqGraph::dCoefMax = -1e100;
+thread_local double MIPD::TCliqueSorter::LinEqGraph::dCoefMin = +1e100;
+thread_local double MIPD::TCliqueSorter::LinEqGraph::dCoefMax = -1e100;
 
 }  // namespace MiniZinc
@@ -19,56 +19,211 @@
 #include <minizinc/prettyprinter.hh>
 
 #include <limits>
+#include <unordered_map>
 
 namespace MiniZinc {
 
-Location::LocVec* Location::LocVec::a(const ASTString& filename, unsigned int first_line,
-                                      unsigned int first_column, unsigned int last_line,
-                                      unsigned int last_column) {
-  static const unsigned int pointerBits = sizeof(void*) * 8;
-  if (pointerBits <= 32) {
-    if (first_line < (1 << 8) && last_line - first_line < (1 << 7) && first_column < (1 << 6) &&
-        last_column < (1 << 7)) {
-      long long int combined = first_line;
-      combined |= (last_line - first_line) << 8;
-      combined |= (first_column) << (8 + 7);
-      combined |= (last_column) << (8 + 7 + 6);
-      auto* v = static_cast<LocVec*>(alloc(2));
-      new (v) LocVec(filename, combined);
-      return v;
-    }
-  } else if (pointerBits >= 64) {
-    if (first_line < (1 << 20) && last_line - first_line < (1 << 20) && first_column < (1 << 10) &&
-        last_column < (1 << 10)) {
-      long long int combined = first_line;
-      combined |= (static_cast<long long int>(last_line - first_line)) << 20;
-      combined |= (static_cast<long long int>(first_column)) << (20 + 20);
-      combined |= (static_cast<long long int>(last_column)) << (20 + 20 + 10);
-      auto* v = static_cast<LocVec*>(alloc(2));
-      new (v) LocVec(filename, combined);
-      return v;
-    }
-  }
-
-  auto* v = static_cast<LocVec*>(alloc(5));
-  new (v) LocVec(filename, first_line, first_column, last_line, last_column);
-  return v;
-}
-
-Location::LocVec::LocVec(const ASTString& filename, IntVal combined) : ASTVec(2) {
-  *(_data + 0) = filename.aststr();
-  *(_data + 1) = IntLit::a(combined);
-}
-
-Location::LocVec::LocVec(const ASTString& filename, unsigned int first_line,
-                         unsigned int first_column, unsigned int last_line,
-                         unsigned int last_column)
-    : ASTVec(5) {
-  *(_data + 0) = filename.aststr();
-  *(_data + 1) = IntLit::a(first_line);
-  *(_data + 2) = IntLit::a(last_line);
-  *(_data + 3) = IntLit::a(first_column);
-  *(_data + 4) = IntLit::a(last_column);
+/**
+ * \brief Table of source locations
+ *
+ * Locations only store a 32 bit index into this table. File names are
+ * interned into a separate table, and the line and column numbers of a
+ * location are stored in a single packed entry, with the last line encoded
+ * relative to the first line. Locations whose last line or column does not fit
+ * into the packed encoding store them in an overflow table.
+ *
+ * Entries that are not marked during garbage collection are reused.
+ */
+class Location::LocTable {
+public:
+  /// A location
+  struct Entry {
+    /// File name index (or \a freeEntry if the entry is unused)
+    unsigned int file;
+    unsigned int firstLine;
+    unsigned int firstColumn;
+    /// Either (last line - first line) << columnBits | last column,
+    /// or overflowFlag | index into the overflow table
+    unsigned int extent;
+  };
+  static const unsigned int freeEntry = std::numeric_limits<unsigned int>::max();
+  static const unsigned int columnBits = 20;
+  static const unsigned int lineDeltaBits = 11;
+  static const unsigned int overflowFlag = 1U << (columnBits + lineDeltaBits);
+  /// Number of entries in the cache of recently added locations
+  static const unsigned int cacheSize = 1 << 12;
+
+  /// The file names
+  std::vector<ASTString> files;
+  /// Map from file names to their index
+  std::unordered_map<ASTString, unsigned int> fileIds;
+  /// The locations (entry 0 is the empty location)
+  std::vector<Entry> entries;
+  /// Mark bits for the entries
+  std::vector<bool> marks;
+  /// Last line and column of locations that cannot be packed
+  std::vector<std::pair<unsigned int, unsigned int>> overflow;
+  /// Unused entries
+  std::vector<unsigned int> freeEntries;
+  /// Unused overflow entries
+  std::vector<unsigned int> freeOverflow;
+  /// Direct-mapped cache of recently added locations, used to share identical entries
+  std::vector<unsigned int> cache;
+
+  LocTable() : entries(1, {freeEntry, 0, 0, 0}), marks(1, false), cache(cacheSize, 0) {}
+
+  /// Return the table of the current thread's garbage collector
+  static LocTable& table() {
+    GC* gc = GC::current();
+    if (gc->_locations == nullptr) {
+      gc->_locations = new LocTable();
+    }
+    return *static_cast<LocTable*>(gc->_locations);
+  }
+
+  unsigned int fileId(const ASTString& filename) {
+    auto it = fileIds.find(filename);
+    if (it != fileIds.end()) {
+      return it->second;
+    }
+    auto id = static_cast<unsigned int>(files.size());
+    files.push_back(filename);
+    fileIds.insert(std::make_pair(filename, id));
+    return id;
+  }
+
+  const Entry& get(unsigned int idx) const { return entries[idx >> 1]; }
+
+  unsigned int lastLine(const Entry& e) const {
+    if ((e.extent & overflowFlag) != 0) {
+      return overflow[e.extent & ~overflowFlag].first;
+    }
+    return e.firstLine + (e.extent >> columnBits);
+  }
+  unsigned int lastColumn(const Entry& e) const {
+    if ((e.extent & overflowFlag) != 0) {
+      return overflow[e.extent & ~overflowFlag].second;
+    }
+    return e.extent & ((1U << columnBits) - 1);
+  }
+
+  unsigned int add(const ASTString& filename, unsigned int first_line, unsigned int first_column,
+                   unsigned int last_line, unsigned int last_column) {
+    Entry e = {fileId(filename), first_line, first_column, 0};
+    bool packed = last_line - first_line < (1U << lineDeltaBits) && last_column < (1U << columnBits);
+    if (packed) {
+      e.extent = ((last_line - first_line) << columnBits) | last_column;
+    }
+    size_t h = e.file;
+    h = h * 31 + first_line;
+    h = h * 31 + first_column;
+    h = h * 31 + last_line;
+    h = h * 31 + last_column;
+    unsigned int& cached = cache[(h ^ (h >> 12)) & (cacheSize - 1)];
+    if (cached != 0) {
+      const Entry& c = entries[cached];
+      if (c.file == e.file && c.firstLine == first_line && c.firstColumn == first_column &&
+          lastLine(c) == last_line && lastColumn(c) == last_column) {
+        return cached;
+      }
+    }
+    if (!packed) {
+      unsigned int o;
+      if (freeOverflow.empty()) {
+        o = static_cast<unsigned int>(overflow.size());
+        overflow.emplace_back(last_line, last_column);
+      } else {
+        o = freeOverflow.back();
+        freeOverflow.pop_back();
+        overflow[o] = std::make_pair(last_line, last_column);
+      }
+      e.extent = overflowFlag | o;
+    }
+    unsigned int idx;
+    if (freeEntries.empty()) {
+      if (entries.size() >= (1U << 31)) {
+        throw InternalError("too many locations");
+      }
+      idx = static_cast<unsigned int>(entries.size());
+      entries.push_back(e);
+      marks.push_back(false);
+    } else {
+      idx = freeEntries.back();
+      freeEntries.pop_back();
+      entries[idx] = e;
+    }
+    cached = idx;
+    return idx;
+  }
+
+  void startMark() {
+    std::fill(marks.begin(), marks.end(), false);
+    for (auto& f : files) {
+      f.mark();
+    }
+  }
+
+  void sweep() {
+    for (unsigned int i = 1; i < entries.size(); i++) {
+      Entry& e = entries[i];
+      if (!marks[i] && e.file != freeEntry) {
+        if ((e.extent & overflowFlag) != 0) {
+          freeOverflow.push_back(e.extent & ~overflowFlag);
+        }
+        e.file = freeEntry;
+        freeEntries.push_back(i);
+      }
+    }
+    std::fill(cache.begin(), cache.end(), 0);
+  }
+};
+
+unsigned int Location::add(const ASTString& filename, unsigned int first_line,
+                           unsigned int first_column, unsigned int last_line,
+                           unsigned int last_column) {
+  GCConcurrentLock lock;
+  return LocTable::table().add(filename, first_line, first_column, last_line, last_column);
+}
+
+ASTString Location::filename() const {
+  if (_idx == 0) {
+    return ASTString();
+  }
+  LocTable& t = LocTable::table();
+  return t.files[t.get(_idx).file];
+}
+
+unsigned int Location::firstLine() const {
+  return _idx == 0 ? 0 : LocTable::table().get(_idx).firstLine;
+}
+
+unsigned int Location::lastLine() const {
+  if (_idx == 0) {
+    return 0;
+  }
+  LocTable& t = LocTable::table();
+  return t.lastLine(t.get(_idx));
+}
+
+unsigned int Location::firstColumn() const {
+  return _idx == 0 ? 0 : LocTable::table().get(_idx).firstColumn;
+}
+
+unsigned int Location::lastColumn() const {
+  if (_idx == 0) {
+    return 0;
+  }
+  LocTable& t = LocTable::table();
+  return t.lastColumn(t.get(_idx));
+}
+
+void Location::startMark() { LocTable::table().startMark(); }
+
+void Location::sweep() { LocTable::table().sweep(); }
+
+size_t Location::tableSize() {
+  LocTable& t = LocTable::table();
+  return t.entries.size() - 1 - t.freeEntries.size();
 }
 
 Location Location::nonalloc;
@@ -85,15 +240,15 @@ std::string Location::toString() const {
 }
 
 void Location::mark() const {
-  if (lv() != nullptr) {
-    lv()->mark();
+  if (_idx != 0) {
+    LocTable::table().marks[_idx >> 1] = true;
   }
 }
 
 Location Location::introduce() const {
   Location l = *this;
-  if (l._locInfo.lv != nullptr) {
-    l._locInfo.t |= 1;
+  if (l._idx != 0) {
+    l._idx |= 1;
   }
   return l;
 }
@@ -137,10 +292,12 @@ void Expression::mark(Expression* e) {
   if (e == nullptr || e->isUnboxedVal()) {
     return;
   }
-  std::vector<const Expression*> stack;
-  stack.reserve(1000);
+  // The stack is shared between nested calls (through Item::mark), so each
+  // call only processes the entries it pushed itself
+  std::vector<const Expression*>& stack = GC::markStack();
+  const size_t base = stack.size();
   stack.push_back(e);
-  while (!stack.empty()) {
+  while (stack.size() > base) {
     const Expression* cur = stack.back();
     stack.pop_back();
     if (!cur->isUnboxedVal() && cur->_gcMark == 0U) {
@@ -174,6 +331,8 @@ void Expression::mark(Expression* e) {
         case Expression::E_ARRAYLIT:
           if (cur->_flag2) {
             pushstack(cur->cast<ArrayLit>()->_u.al);
+          } else if (cur->_secondaryId != ArrayLit::PK_NONE) {
+            cur->cast<ArrayLit>()->_u.pv->mark();
           } else {
             pushall(ASTExprVec<Expression>(cur->cast<ArrayLit>()->_u.v));
           }
@@ -269,6 +428,52 @@ void SetLit::rehash() {
   }
 }
 
+namespace {
+IntSetVal* setlit_value(SetLit* sl, IntSetVal* /*unused*/) { return sl->isv(); }
+FloatSetVal* setlit_value(SetLit* sl, FloatSetVal* /*unused*/) { return sl->fsv(); }
+
+template <class S, class R, class V>
+SetLit* shared_setlit(S* s, const Type& t) {
+  std::hash<V> h;
+  size_t hv = 0;
+  for (R r(s); r(); ++r) {
+    hv ^= h(r.min()) + 0x9e3779b9 + (hv << 6) + (hv >> 2);
+    hv ^= h(r.max()) + 0x9e3779b9 + (hv << 6) + (hv >> 2);
+  }
+  GCConcurrentLock lock;
+  auto& setMap = constants().setMap;
+  auto range = setMap.equal_range(hv);
+  for (auto it = range.first; it != range.second; ++it) {
+    auto* sl = Expression::cast<SetLit>(it->second());
+    if (sl != nullptr && sl->type() == t && sl->ann().isEmpty()) {
+      R r0(s);
+      R r1(setlit_value(sl, s));
+      if (Ranges::equal(r0, r1)) {
+        return sl;
+      }
+    }
+  }
+  auto* sl = new SetLit(Location().introduce(), s);
+  if (setMap.size() >= constants().setMapLimit) {
+    // remove entries for literals that have been garbage collected
+    for (auto it = setMap.begin(); it != setMap.end();) {
+      it = it->second() == nullptr ? setMap.erase(it) : std::next(it);
+    }
+    constants().setMapLimit = std::max(static_cast<size_t>(1024), setMap.size() * 2);
+  }
+  setMap.emplace(hv, WeakRef(sl));
+  return sl;
+}
+}  // namespace
+
+SetLit* SetLit::a(IntSetVal* isv) {
+  return shared_setlit<IntSetVal, IntSetRanges, IntVal>(isv, Type::parsetint());
+}
+
+SetLit* SetLit::a(FloatSetVal* fsv) {
+  return shared_setlit<FloatSetVal, FloatSetRanges, FloatVal>(fsv, Type::parsetfloat());
+}
+
 void BoolLit::rehash() {
   initHash();
   std::hash<bool> h;
@@ -280,6 +485,25 @@ void StringLit::rehash() {
   combineHash(_v.hash());
 }
 
+StringLit* StringLit::a(const ASTString& v) {
+  if (v.aststr() == nullptr) {
+    return new StringLit(Location().introduce(), v);
+  }
+  GCConcurrentLock lock;
+  ASTNodeWeakMap& stringMap = constants().stringMap;
+  if (ASTNode* n = stringMap.find(v.aststr())) {
+    auto* sl = static_cast<StringLit*>(n);
+    if (sl->type() == Type::parstring() && sl->ann().isEmpty()) {
+      return sl;
+    }
+    // the shared literal has been modified, so don't hand it out again
+    return new StringLit(Location().introduce(), v);
+  }
+  auto* sl = new StringLit(Location().introduce(), v);
+  stringMap.insert(v.aststr(), sl);
+  return sl;
+}
+
 void Id::rehash() {
   initHash();
   std::hash<long long int> h;
@@ -301,9 +525,15 @@ ASTString Id::str() const {
   if (idn() == -1) {
     return v();
   }
-  std::ostringstream oss;
-  oss << "X_INTRODUCED_" << idn() << "_";
-  return oss.str();
+  return ASTString("X_INTRODUCED_" + std::to_string(idn()) + "_");
+}
+
+void Id::printStr(std::ostream& os) const {
+  if (idn() == -1) {
+    os << v();
+  } else {
+    os << "X_INTRODUCED_" << idn() << "_";
+  }
 }
 
 void TIId::rehash() {
@@ -327,7 +557,7 @@ int ArrayLit::min(unsigned int i) const {
 int ArrayLit::max(unsigned int i) const {
   if (_dims.size() == 0) {
     assert(i == 0);
-    return static_cast<int>(_u.v->size());
+    return static_cast<int>(_secondaryId != PK_NONE ? _u.pv->size() : _u.v->size());
   }
   return _dims[2 * i + 1];
 }
@@ -409,6 +639,7 @@ ArrayLit::ArrayLit(const Location& loc, ArrayLit* v, const std::vector<std::pair
     : Expression(loc, E_ARRAYLIT, Type()) {
   _flag1 = false;
   _flag2 = true;
+  _secondaryId = PK_NONE;
   _u.al = v;
   assert(slice.size() == v->dims());
   std::vector<int> d(dims.size() * 2 + 2 * slice.size());
@@ -424,8 +655,127 @@ ArrayLit::ArrayLit(const Location& loc, ArrayLit* v, const std::vector<std::pair
   _dims = ASTIntVec(d);
 }
 
+bool ArrayLit::storeUnboxed(const std::vector<Expression*>& v) {
+  if (v.empty() || v[0] == nullptr) {
+    return false;
+  }
+  auto n = static_cast<unsigned int>(v.size());
+  if (v[0]->isUnboxedInt()) {
+    for (auto* e : v) {
+      if (!e->isUnboxedInt()) {
+        return false;
+      }
+    }
+    _u.pv = ASTParVecO::a(n);
+    long long int* ints = _u.pv->ints();
+    for (unsigned int i = 0; i < n; i++) {
+      ints[i] = v[i]->unboxedIntToIntVal().toInt();
+    }
+    _secondaryId = PK_INT;
+    return true;
+  }
+  if (v[0]->isUnboxedFloatVal()) {
+    for (auto* e : v) {
+      if (!e->isUnboxedFloatVal()) {
+        return false;
+      }
+    }
+    _u.pv = ASTParVecO::a(n);
+    double* floats = _u.pv->floats();
+    for (unsigned int i = 0; i < n; i++) {
+      floats[i] = v[i]->unboxedFloatToFloatVal().toDouble();
+    }
+    _secondaryId = PK_FLOAT;
+    return true;
+  }
+  if (!v[0]->isUnboxedVal() && v[0]->isa<BoolLit>()) {
+    Expression* t = constants().literalTrue;
+    Expression* f = constants().literalFalse;
+    for (auto* e : v) {
+      if (e != t && e != f) {
+        return false;
+      }
+    }
+    _u.pv = ASTParVecO::aBool(n);
+    for (unsigned int i = 0; i < n; i++) {
+      _u.pv->setBool(i, v[i] == t);
+    }
+    _secondaryId = PK_BOOL;
+    return true;
+  }
+  return false;
+}
+
+void ArrayLit::setUnboxed(unsigned int i, Expression* e) {
+  switch (parKind()) {
+    case PK_INT:
+      if (e->isUnboxedInt()) {
+        _u.pv->ints()[i] = e->unboxedIntToIntVal().toInt();
+        return;
+      }
+      break;
+    case PK_FLOAT:
+      if (e->isUnboxedFloatVal()) {
+        _u.pv->floats()[i] = e->unboxedFloatToFloatVal().toDouble();
+        return;
+      }
+      break;
+    default:
+      assert(parKind() == PK_BOOL);
+      if (e == constants().literalTrue || e == constants().literalFalse) {
+        _u.pv->setBool(i, e == constants().literalTrue);
+        return;
+      }
+      break;
+  }
+  // Element cannot be stored unboxed, switch to an expression vector
+  std::vector<Expression*> elems(size());
+  for (unsigned int j = 0; j < elems.size(); j++) {
+    elems[j] = getUnboxed(j);
+  }
+  elems[i] = e;
+  _secondaryId = PK_NONE;
+  _u.v = ASTExprVec<Expression>(elems).vec();
+}
+
+void ArrayLit::viewUnboxed(ArrayLit& v, const std::vector<std::pair<int, int> >& dims) {
+  // The unboxed values cannot be shared directly, since setUnboxed may have to replace
+  // them by an expression vector. Refer to v instead, like a slice covering all of it.
+  _flag2 = true;
+  _u.al = &v;
+  std::vector<int> d(dims.size() * 2 + v.dims() * 2);
+  for (auto i = static_cast<unsigned int>(dims.size()); (i--) != 0U;) {
+    d[i * 2] = dims[i].first;
+    d[i * 2 + 1] = dims[i].second;
+  }
+  int sliceOffset = static_cast<int>(dims.size()) * 2;
+  for (auto i = v.dims(); (i--) != 0U;) {
+    d[sliceOffset + i * 2] = v.min(i);
+    d[sliceOffset + i * 2 + 1] = v.max(i);
+  }
+  _dims = ASTIntVec(d);
+}
+
+ASTExprVec<Expression> ArrayLit::getVec() const {
+  assert(!_flag2);
+  if (_secondaryId != PK_NONE) {
+    std::vector<Expression*> elems(size());
+    for (unsigned int i = 0; i < elems.size(); i++) {
+      elems[i] = getUnboxed(i);
+    }
+    return ASTExprVec<Expression>(elems);
+  }
+  return _u.v;
+}
+
 void ArrayLit::compress(const std::vector<Expression*>& v, const std::vector<int>& dims) {
-  if (v.size() >= 4 && Expression::equal(v[0], v[1]) && Expression::equal(v[1], v[2]) &&
+  _secondaryId = PK_NONE;
+  if (storeUnboxed(v)) {
+    if (dims.size() != 2 || dims[0] != 1) {
+      // only allocate dims vector if it is not a 1d array indexed from 1
+      _dims = ASTIntVec(dims);
+    }
+  } else if (v.size() >= 4 && Expression::equal(v[0], v[1]) && Expression::equal(v[1], v[2]) &&
       Expression::equal(v[2], v[3])) {
     std::vector<Expression*> compress(v.size());
     compress[0] = v[0];
@@ -472,6 +822,11 @@ void ArrayLit::rehash() {
   }
   if (_flag2) {
     combineHash(Expression::hash(_u.al));
+  } else if (_secondaryId != PK_NONE) {
+    for (unsigned int i = _u.pv->size(); (i--) != 0U;) {
+      combineHash(h(static_cast<int>(i)));
+      combineHash(Expression::hash(getUnboxed(i)));
+    }
   } else {
     for (unsigned int i = _u.v->size(); (i--) != 0U;) {
       combineHash(h(static_cast<int>(i)));
@@ -698,8 +1053,14 @@ public:
   }
 
   static OpToString& o() {
-    static OpToString _o;
-    return _o;
+    Constants& c = constants();
+    if (c.operatorIds == nullptr) {
+      GCConcurrentLock lock;
+      if (c.operatorIds == nullptr) {
+        c.operatorIds = new OpToString();
+      }
+    }
+    return *static_cast<OpToString*>(c.operatorIds);
   }
 
   void mark(MINIZINC_GC_STAT_ARGS) override {
@@ -1950,8 +2311,11 @@ void Constants::mark(MINIZINC_GC_STAT_ARGS) {
 const int Constants::max_array_size;
 
 Constants& constants() {
-  static Constants _c;
-  return _c;
+  GC* gc = GC::current();
+  if (gc->_constants == nullptr) {
+    gc->_constants = new Constants();
+  }
+  return *gc->_constants;
 }
 
 Annotation::~Annotation() { delete _s; }
@@ -54,29 +54,108 @@ int ASTString::levenshteinDistance(const ASTString& other) const {
 }
 
 ASTStringData::Interner& ASTStringData::interner() {
-  static Interner _interner;
-  return _interner;
+  // Strings are allocated by a collector, so every collector has its own table
+  GC* gc = GC::current();
+  if (gc->_interner == nullptr) {
+    gc->_interner = new Interner();
+  }
+  return *static_cast<Interner*>(gc->_interner);
+}
+
+void ASTStringData::Interner::grow(size_t n) {
+  // Keep the load factor below 3/4
+  size_t cap = _slots.empty() ? 1024 : _slots.size();
+  while (n * 4 >= cap * 3) {
+    cap *= 2;
+  }
+  if (cap == _slots.size()) {
+    return;
+  }
+  std::vector<Slot> old(cap, Slot{0, nullptr});
+  old.swap(_slots);
+  const size_t mask = cap - 1;
+  for (const Slot& slot : old) {
+    if (slot.s != nullptr) {
+      size_t i = slot.hash & mask;
+      while (_slots[i].s != nullptr) {
+        i = (i + 1) & mask;
+      }
+      _slots[i] = slot;
+    }
+  }
+}
+
+ASTStringData* ASTStringData::Interner::find(const char* s, size_t n, size_t h) const {
+  if (_slots.empty()) {
+    return nullptr;
+  }
+  const size_t mask = _slots.size() - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    const Slot& slot = _slots[i];
+    if (slot.s == nullptr) {
+      return nullptr;
+    }
+    if (slot.hash == h && slot.s->size() == n && memcmp(slot.s->c_str(), s, n) == 0) {
+      return slot.s;
+    }
+  }
+}
+
+void ASTStringData::Interner::insert(ASTStringData* s) {
+  grow(_count + 1);
+  const size_t mask = _slots.size() - 1;
+  size_t i = s->hash() & mask;
+  while (_slots[i].s != nullptr) {
+    i = (i + 1) & mask;
+  }
+  _slots[i] = Slot{s->hash(), s};
+  _count++;
+}
+
+void ASTStringData::Interner::erase(const ASTStringData* s) {
+  const size_t mask = _slots.size() - 1;
+  size_t i = s->hash() & mask;
+  while (_slots[i].s != s) {
+    assert(_slots[i].s != nullptr);
+    i = (i + 1) & mask;
+  }
+  // Backward shift deletion: move later entries of the probe sequence into the gap
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (_slots[j].s == nullptr) {
+      break;
+    }
+    size_t k = _slots[j].hash & mask;
+    if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+      _slots[i] = _slots[j];
+      i = j;
+    }
+  }
+  _slots[i] = Slot{0, nullptr};
+  _count--;
 }
 
-ASTStringData::ASTStringData(const std::string& s)
-    : ASTChunk(s.size() + sizeof(size_t) + 1, ASTNode::NID_STR) {
-  memcpy_s(_data + sizeof(size_t), s.size() + 1, s.c_str(), s.size());
-  *(_data + sizeof(size_t) + s.size()) = 0;
-  std::hash<std::string> h;
-  reinterpret_cast<size_t*>(_data)[0] = h(s);
+ASTStringData::ASTStringData(const char* s, size_t n, size_t h)
+    : ASTChunk(n + sizeof(size_t) + 1, ASTNode::NID_STR) {
+  memcpy_s(_data + sizeof(size_t), n + 1, s, n);
+  *(_data + sizeof(size_t) + n) = 0;
+  reinterpret_cast<size_t*>(_data)[0] = h;
 }
 
-ASTStringData* ASTStringData::a(const std::string& s) {
-  if (s.empty()) {
+ASTStringData* ASTStringData::a(const char* s, size_t n) {
+  if (n == 0) {
     return nullptr;
   }
-  auto it = interner().find({s.c_str(), s.size()});
-  if (it != interner().end()) {
-    return it->second;
+  size_t h = CStringHash::hash(s, n);
+  GCConcurrentLock lock;
+  if (ASTStringData* as = interner().find(s, n, h)) {
+    return as;
   }
-  auto* as = static_cast<ASTStringData*>(alloc(1 + sizeof(size_t) + s.size()));
-  new (as) ASTStringData(s);
-  interner().emplace(std::make_pair(as->c_str(), as->size()), as);
+  auto* as = static_cast<ASTStringData*>(alloc(1 + sizeof(size_t) + n));
+  new (as) ASTStringData(s, n, h);
+  interner().insert(as);
   return as;
 }
+
 }  // namespace MiniZinc
@@ -11,6 +11,8 @@
 
 #include <minizinc/astvec.hh>
 
+#include <algorithm>
+
 namespace MiniZinc {
 
 ASTIntVecO::ASTIntVecO(const std::vector<int>& v) : ASTChunk(sizeof(int) * v.size()) {
@@ -25,4 +27,23 @@ ASTIntVecO* ASTIntVecO::a(const std::vector<int>& v) {
   return ao;
 }
 
+ASTParVecO::ASTParVecO(unsigned int n, size_t words)
+    : ASTChunk(sizeof(uint64_t) * (words + 1)) {
+  reinterpret_cast<uint64_t*>(_data)[0] = n;
+  std::fill(this->words(), this->words() + words, 0);
+}
+
+ASTParVecO* ASTParVecO::a(unsigned int n) {
+  auto* ao = static_cast<ASTParVecO*>(alloc(sizeof(uint64_t) * (n + 1)));
+  new (ao) ASTParVecO(n, n);
+  return ao;
+}
+
+ASTParVecO* ASTParVecO::aBool(unsigned int n) {
+  size_t words = (n + 63) / 64;
+  auto* ao = static_cast<ASTParVecO*>(alloc(sizeof(uint64_t) * (words + 1)));
+  new (ao) ASTParVecO(n, words);
+  return ao;
+}
+
 }  // namespace MiniZinc
\ No newline at end of file
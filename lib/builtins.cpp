@@ -23,9 +23,11 @@
 #include <minizinc/support/regex.hh>
 #include <minizinc/typecheck.hh>
 
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <iomanip>
+#include <mutex>
 #include <random>
 #include <regex>
 
@@ -109,6 +111,10 @@ IntVal b_int_min(EnvI& env, Call* call) {
         if (al->size() == 0) {
           throw ResultUndefinedError(env, al->loc(), "minimum of empty array is undefined");
         }
+        if (al->parKind() == ArrayLit::PK_INT) {
+          const long long int* v = al->parInts();
+          return *std::min_element(v, v + al->size());
+        }
         IntVal m = eval_int(env, (*al)[0]);
         for (unsigned int i = 1; i < al->size(); i++) {
           m = std::min(m, eval_int(env, (*al)[i]));
@@ -134,6 +140,10 @@ IntVal b_int_max(EnvI& env, Call* call) {
         if (al->size() == 0) {
           throw ResultUndefinedError(env, al->loc(), "maximum of empty array is undefined");
         }
+        if (al->parKind() == ArrayLit::PK_INT) {
+          const long long int* v = al->parInts();
+          return *std::max_element(v, v + al->size());
+        }
         IntVal m = eval_int(env, (*al)[0]);
         for (unsigned int i = 1; i < al->size(); i++) {
           m = std::max(m, eval_int(env, (*al)[i]));
@@ -501,6 +511,13 @@ IntVal b_sum_int(EnvI& env, Call* call) {
     return 0;
   }
   IntVal m = 0;
+  if (al->parKind() == ArrayLit::PK_INT) {
+    const long long int* v = al->parInts();
+    for (unsigned int i = 0; i < al->size(); i++) {
+      m += v[i];
+    }
+    return m;
+  }
   for (unsigned int i = 0; i < al->size(); i++) {
     m += eval_int(env, (*al)[i]);
   }
@@ -515,6 +532,13 @@ IntVal b_product_int(EnvI& env, Call* call) {
     return 1;
   }
   IntVal m = 1;
+  if (al->parKind() == ArrayLit::PK_INT) {
+    const long long int* v = al->parInts();
+    for (unsigned int i = 0; i < al->size(); i++) {
+      m *= v[i];
+    }
+    return m;
+  }
   for (unsigned int i = 0; i < al->size(); i++) {
     m *= eval_int(env, (*al)[i]);
   }
@@ -529,6 +553,13 @@ FloatVal b_product_float(EnvI& env, Call* call) {
     return 1;
   }
   FloatVal m = 1.0;
+  if (al->parKind() == ArrayLit::PK_FLOAT) {
+    const double* v = al->parFloats();
+    for (unsigned int i = 0; i < al->size(); i++) {
+      m *= v[i];
+    }
+    return m;
+  }
   for (unsigned int i = 0; i < al->size(); i++) {
     m *= eval_float(env, (*al)[i]);
   }
@@ -675,6 +706,13 @@ FloatVal b_sum_float(EnvI& env, Call* call) {
     return 0;
   }
   FloatVal m = 0;
+  if (al->parKind() == ArrayLit::PK_FLOAT) {
+    const double* v = al->parFloats();
+    for (unsigned int i = 0; i < al->size(); i++) {
+      m += v[i];
+    }
+    return m;
+  }
   for (unsigned int i = 0; i < al->size(); i++) {
     m += eval_float(env, (*al)[i]);
   }
@@ -692,6 +730,10 @@ FloatVal b_float_min(EnvI& env, Call* call) {
         if (al->size() == 0) {
           throw EvalError(env, al->loc(), "min on empty array undefined");
         }
+        if (al->parKind() == ArrayLit::PK_FLOAT) {
+          const double* v = al->parFloats();
+          return *std::min_element(v, v + al->size());
+        }
         FloatVal m = eval_float(env, (*al)[0]);
         for (unsigned int i = 1; i < al->size(); i++) {
           m = std::min(m, eval_float(env, (*al)[i]));
@@ -717,6 +759,10 @@ FloatVal b_float_max(EnvI& env, Call* call) {
         if (al->size() == 0) {
           throw EvalError(env, al->loc(), "max on empty array undefined");
         }
+        if (al->parKind() == ArrayLit::PK_FLOAT) {
+          const double* v = al->parFloats();
+          return *std::max_element(v, v + al->size());
+        }
         FloatVal m = eval_float(env, (*al)[0]);
         for (unsigned int i = 1; i < al->size(); i++) {
           m = std::max(m, eval_float(env, (*al)[i]));
@@ -1188,6 +1234,14 @@ bool b_forall_par(EnvI& env, Call* call) {
   }
   GCLock lock;
   ArrayLit* al = eval_array_lit(env, call->arg(0));
+  if (al->parKind() == ArrayLit::PK_BOOL) {
+    for (unsigned int i = al->size(); (i--) != 0U;) {
+      if (!al->parBool(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
   for (unsigned int i = al->size(); (i--) != 0U;) {
     if (!eval_bool(env, (*al)[i])) {
       return false;
@@ -1201,6 +1255,14 @@ bool b_exists_par(EnvI& env, Call* call) {
   }
   GCLock lock;
   ArrayLit* al = eval_array_lit(env, call->arg(0));
+  if (al->parKind() == ArrayLit::PK_BOOL) {
+    for (unsigned int i = al->size(); (i--) != 0U;) {
+      if (al->parBool(i)) {
+        return true;
+      }
+    }
+    return false;
+  }
   for (unsigned int i = al->size(); (i--) != 0U;) {
     if (eval_bool(env, (*al)[i])) {
       return true;
@@ -1813,8 +1875,9 @@ Expression* b_output_json_parameters(EnvI& env, Call* call) {
         } else {
           s << ",\n";
         }
-        s << "  \"" << vd->id()->str() << "\""
-          << " : ";
+        s << "  \"";
+        vd->id()->printStr(s);
+        s << "\" : ";
         auto* sl = new StringLit(Location().introduce(), s.str());
         _outputVars.push_back(sl);
 
@@ -2255,7 +2318,7 @@ Expression* b_set_to_ranges_float(EnvI& env, Call* call) {
 
 std::default_random_engine& rnd_generator() {
   // TODO: initiate with seed if given as annotation/in command line
-  static std::default_random_engine g;
+  static thread_local std::default_random_engine g;
   return g;
 }
 
@@ -2760,6 +2823,9 @@ Expression* b_regular_from_string(EnvI& env, Call* call) {
 
   std::unique_ptr<REG> regex;
   try {
+    // The regular expression parser is not reentrant
+    static std::mutex regexMutex;
+    std::lock_guard<std::mutex> guard(regexMutex);
     regex = regex_from_string(expr, *dom);
   } catch (const std::exception& e) {
     throw SyntaxError(call->arg(1)->loc(), e.what());
@@ -1,4 +1,4 @@
 set(lexer_lxx_md5_cached "6346180a9a94e9f5218239f10ce67a32")
-set(parser_yxx_md5_cached "95616f87b6ecbe14f80175ec8369e696")
+set(parser_yxx_md5_cached "1473968b39331489c63440e1b39db1a7")
 set(regex_lexer_lxx_md5_cached "8906a52bfa0c5ae26354cb272348e656")
 set(regex_parser_yxx_md5_cached "68ec070becef5e161c3b97d085b0810e")
\ No newline at end of file
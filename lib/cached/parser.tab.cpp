@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.7.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -46,10 +46,10 @@
    USER NAME SPACE" below.  */
 
 /* Identify Bison output, and Bison version.  */
-#define YYBISON 30704
+#define YYBISON 30802
 
 /* Bison version string.  */
-#define YYBISON_VERSION "3.7.4"
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
@@ -450,6 +450,18 @@ typedef int_least16_t yytype_int16;
 typedef short yytype_int16;
 #endif
 
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
 #if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
 typedef __UINT_LEAST8_TYPE__ yytype_uint8;
 #elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
@@ -547,17 +559,23 @@ typedef int yy_state_fast_t;
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && ! defined __ICC && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                            \
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
     _Pragma ("GCC diagnostic push")                                     \
     _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
 # define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
@@ -787,45 +805,45 @@ static const yytype_uint8 yytranslate[] =
 };
 
 #if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int16 yyrline[] =
 {
-       0,   286,   286,   288,   290,   293,   302,   311,   320,   329,
-     331,   334,   342,   351,   351,   353,   369,   373,   375,   377,
-     378,   380,   382,   384,   386,   388,   391,   391,   391,   392,
-     392,   392,   392,   392,   393,   396,   419,   425,   432,   442,
-     460,   476,   480,   489,   494,   503,   504,   508,   516,   517,
-     521,   525,   531,   533,   540,   545,   550,   557,   561,   571,
-     581,   589,   599,   608,   619,   632,   642,   643,   648,   649,
-     651,   656,   657,   661,   665,   670,   670,   673,   675,   679,
-     687,   691,   693,   697,   698,   704,   713,   716,   724,   732,
-     741,   749,   758,   767,   780,   781,   785,   787,   789,   791,
-     793,   795,   797,   802,   808,   811,   813,   817,   819,   821,
-     830,   841,   844,   846,   852,   853,   855,   857,   859,   861,
-     870,   879,   881,   883,   885,   887,   889,   891,   893,   895,
-     897,   902,   907,   912,   917,   923,   925,   938,   939,   941,
-     943,   945,   947,   949,   951,   953,   955,   957,   959,   961,
-     963,   965,   967,   969,   971,   973,   975,   977,   986,   995,
-     997,   999,  1001,  1003,  1005,  1007,  1009,  1011,  1013,  1018,
-    1023,  1028,  1033,  1039,  1041,  1048,  1060,  1062,  1066,  1068,
-    1070,  1072,  1074,  1076,  1079,  1081,  1084,  1086,  1089,  1091,
-    1094,  1096,  1098,  1100,  1102,  1104,  1106,  1108,  1110,  1112,
-    1114,  1115,  1118,  1120,  1123,  1124,  1127,  1129,  1132,  1133,
-    1136,  1138,  1141,  1142,  1145,  1147,  1150,  1151,  1154,  1156,
-    1159,  1160,  1163,  1165,  1168,  1169,  1170,  1173,  1174,  1179,
-    1181,  1187,  1192,  1200,  1207,  1216,  1218,  1223,  1229,  1232,
-    1235,  1237,  1239,  1245,  1247,  1249,  1257,  1259,  1262,  1265,
-    1268,  1270,  1274,  1276,  1280,  1282,  1293,  1304,  1344,  1347,
-    1352,  1359,  1364,  1368,  1374,  1381,  1397,  1398,  1402,  1404,
-    1406,  1408,  1410,  1412,  1414,  1416,  1418,  1420,  1422,  1424,
-    1426,  1428,  1430,  1432,  1434,  1436,  1438,  1440,  1442,  1444,
-    1446,  1448,  1450,  1452,  1454,  1456,  1460,  1468,  1500,  1502,
-    1504,  1505,  1525,  1579,  1599,  1654,  1657,  1663,  1669,  1671,
-    1675,  1682,  1691,  1693,  1701,  1703,  1712,  1712,  1715,  1721,
-    1732,  1733,  1736,  1738,  1742,  1746,  1750,  1752,  1754,  1756,
-    1758,  1760,  1762,  1764,  1766,  1768,  1770,  1772,  1774,  1776,
-    1778,  1780,  1782,  1784,  1786,  1788,  1790,  1792,  1794,  1796,
-    1798,  1800,  1802,  1804,  1806,  1808,  1810
+       0,   290,   290,   292,   294,   297,   306,   315,   324,   333,
+     335,   338,   346,   355,   355,   357,   373,   377,   379,   381,
+     382,   384,   386,   388,   390,   392,   395,   395,   395,   396,
+     396,   396,   396,   396,   397,   400,   423,   429,   436,   446,
+     464,   480,   484,   493,   498,   507,   508,   512,   520,   521,
+     525,   529,   535,   537,   544,   549,   554,   561,   565,   575,
+     585,   593,   603,   612,   623,   636,   646,   647,   652,   653,
+     655,   660,   661,   665,   669,   674,   674,   677,   679,   683,
+     691,   695,   697,   701,   702,   708,   717,   720,   728,   736,
+     745,   753,   762,   771,   784,   785,   789,   791,   793,   795,
+     797,   799,   801,   806,   812,   815,   817,   821,   823,   825,
+     834,   845,   848,   850,   856,   857,   859,   861,   863,   865,
+     874,   883,   885,   887,   889,   891,   893,   895,   897,   899,
+     901,   906,   911,   916,   921,   927,   929,   942,   943,   945,
+     947,   949,   951,   953,   955,   957,   959,   961,   963,   965,
+     967,   969,   971,   973,   975,   977,   979,   981,   990,   999,
+    1001,  1003,  1005,  1007,  1009,  1011,  1013,  1015,  1017,  1022,
+    1027,  1032,  1037,  1043,  1045,  1052,  1064,  1066,  1070,  1072,
+    1074,  1076,  1078,  1080,  1083,  1085,  1088,  1090,  1093,  1095,
+    1098,  1100,  1102,  1104,  1106,  1108,  1110,  1112,  1114,  1116,
+    1118,  1119,  1122,  1124,  1127,  1128,  1131,  1133,  1136,  1137,
+    1140,  1142,  1145,  1146,  1149,  1151,  1154,  1155,  1158,  1160,
+    1163,  1164,  1167,  1169,  1172,  1173,  1174,  1177,  1178,  1183,
+    1185,  1191,  1196,  1204,  1211,  1220,  1222,  1227,  1233,  1236,
+    1239,  1241,  1243,  1249,  1251,  1253,  1261,  1263,  1266,  1269,
+    1272,  1274,  1278,  1280,  1284,  1286,  1297,  1308,  1348,  1351,
+    1356,  1363,  1368,  1372,  1378,  1385,  1401,  1402,  1406,  1408,
+    1410,  1412,  1414,  1416,  1418,  1420,  1422,  1424,  1426,  1428,
+    1430,  1432,  1434,  1436,  1438,  1440,  1442,  1444,  1446,  1448,
+    1450,  1452,  1454,  1456,  1458,  1460,  1464,  1472,  1504,  1506,
+    1508,  1509,  1529,  1583,  1603,  1658,  1661,  1667,  1673,  1675,
+    1679,  1686,  1695,  1697,  1705,  1707,  1716,  1716,  1719,  1725,
+    1736,  1737,  1740,  1742,  1746,  1750,  1754,  1756,  1758,  1760,
+    1762,  1764,  1766,  1768,  1770,  1772,  1774,  1776,  1778,  1780,
+    1782,  1784,  1786,  1788,  1790,  1792,  1794,  1796,  1798,  1800,
+    1802,  1804,  1806,  1808,  1810,  1812,  1814
 };
 #endif
 
@@ -902,29 +920,6 @@ yysymbol_name (yysymbol_kind_t yysymbol)
 }
 #endif
 
-#ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_int16 yytoknum[] =
-{
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279,   280,   281,   282,   283,   284,
-     285,   286,   287,   288,   289,   290,   291,   292,   293,   294,
-     295,   296,   297,   298,   299,   300,   301,   302,   303,   304,
-     305,   306,   307,   308,   309,   310,   311,   312,   313,   314,
-     315,   316,   317,   318,   319,   320,   321,   322,   323,   324,
-     325,   326,   327,   328,   329,   330,   331,   332,   333,   334,
-     335,   336,   337,   338,   339,   340,   341,   342,   343,   344,
-     345,   346,   347,   348,   349,   350,   351,   352,   353,   354,
-     355,   356,   357,   358,   359,   360,   361,   362,   363,   364,
-     365,   366,   367,   368,   369,   370,   371,   372,   373,   374,
-     375,   376,   377,   378,   379,   380,   381,   382,   383,   384,
-     385,   386,   387,    59,   123,   125,    40,    41,    44,    58,
-     124
-};
-#endif
-
 #define YYPACT_NINF (-427)
 
 #define yypact_value_is_default(Yyn) \
@@ -935,8 +930,8 @@ static const yytype_int16 yytoknum[] =
 #define yytable_value_is_error(Yyn) \
   ((Yyn) == YYTABLE_NINF)
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
 static const yytype_int16 yypact[] =
 {
      888,   -78,   -39,   -38,   -16,    -9,  -427,  3705,  -427,  -427,
@@ -1000,9 +995,9 @@ static const yytype_int16 yypact[] =
     -427,  -427,  -427,  3705,  5000,  5000,  -427,  5000
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
 static const yytype_int16 yydefact[] =
 {
        0,     0,   192,   190,   196,   182,   229,     0,   102,   103,
@@ -1066,7 +1061,7 @@ static const yytype_int16 yydefact[] =
       47,    50,   265,     0,   245,   247,    63,   267
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int16 yypgoto[] =
 {
     -427,  -427,  -427,  -427,   200,  -427,   -63,   358,  -427,  -427,
@@ -1079,10 +1074,10 @@ static const yytype_int16 yypgoto[] =
     -427,   -66,   -33,  -171,  -427,  -427
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
+/* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int16 yydefgoto[] =
 {
-      -1,    72,    73,    74,    75,   168,    76,    77,   180,    78,
+       0,    72,    73,    74,    75,   168,    76,    77,   180,    78,
       79,   499,   500,   538,   540,    80,    81,    82,    83,    84,
       85,    86,   513,   277,   402,   403,   307,   404,    87,   278,
      279,    88,    89,   125,    90,   219,   220,   221,   156,   152,
@@ -1092,9 +1087,9 @@ static const yytype_int16 yydefgoto[] =
      450,   289,   145,   297,   146,   443
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int16 yytable[] =
 {
      131,   151,   290,   285,   134,   140,   286,   133,   310,   293,
@@ -2149,8 +2144,8 @@ static const yytype_int16 yycheck[] =
       92,    93,    94,    95,    96,    97,    -1,    -1,   100,   101
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
 static const yytype_uint8 yystos[] =
 {
        0,     1,     3,     4,     5,     6,     8,     9,    12,    13,
@@ -2214,7 +2209,7 @@ static const yytype_uint8 yystos[] =
        8,     6,    29,    51,   182,   182,   163,   182
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_uint8 yyr1[] =
 {
        0,   141,   142,   143,   143,   144,   144,   144,   144,   144,
@@ -2255,7 +2250,7 @@ static const yytype_uint8 yyr1[] =
      216,   216,   216,   216,   216,   216,   216
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
        0,     2,     1,     0,     2,     1,     2,     3,     4,     2,
@@ -2305,6 +2300,7 @@ enum { YYENOMEM = -2 };
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
@@ -2372,12 +2368,19 @@ do {                                            \
 } while (0)
 
 
-/* YY_LOCATION_PRINT -- Print the location on the stream.
+/* YYLOCATION_PRINT -- Print the location on the stream.
    This macro was not mandated originally: define only if we know
    we won't break user code: when these are the locations we know.  */
 
-# ifndef YY_LOCATION_PRINT
-#  if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
+# ifndef YYLOCATION_PRINT
+
+#  if defined YY_LOCATION_PRINT
+
+   /* Temporary convenience wrapper in case some people defined the
+      undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YYLOCATION_PRINT(File, Loc)  YY_LOCATION_PRINT(File, *(Loc))
+
+#  elif defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
 
 /* Print *YYLOCP on YYO.  Private, do not rely on its existence. */
 
@@ -2405,15 +2408,23 @@ yy_location_print_ (FILE *yyo, YYLTYPE const * const yylocp)
         res += YYFPRINTF (yyo, "-%d", end_col);
     }
   return res;
- }
+}
+
+#   define YYLOCATION_PRINT  yy_location_print_
 
-#   define YY_LOCATION_PRINT(File, Loc)          \
-  yy_location_print_ (File, &(Loc))
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT(File, Loc)  YYLOCATION_PRINT(File, &(Loc))
 
 #  else
-#   define YY_LOCATION_PRINT(File, Loc) ((void) 0)
+
+#   define YYLOCATION_PRINT(File, Loc) ((void) 0)
+    /* Temporary convenience wrapper in case some people defined the
+       undocumented and private YY_LOCATION_PRINT macros.  */
+#   define YY_LOCATION_PRINT  YYLOCATION_PRINT
+
 #  endif
-# endif /* !defined YY_LOCATION_PRINT */
+# endif /* !defined YYLOCATION_PRINT */
 
 
 # define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
@@ -2437,17 +2448,13 @@ yy_symbol_value_print (FILE *yyo,
                        yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, YYLTYPE const * const yylocationp, void *parm)
 {
   FILE *yyoutput = yyo;
-  YYUSE (yyoutput);
-  YYUSE (yylocationp);
-  YYUSE (parm);
+  YY_USE (yyoutput);
+  YY_USE (yylocationp);
+  YY_USE (parm);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yykind < YYNTOKENS)
-    YYPRINT (yyo, yytoknum[yykind], *yyvaluep);
-# endif
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yykind);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
@@ -2463,7 +2470,7 @@ yy_symbol_print (FILE *yyo,
   YYFPRINTF (yyo, "%s %s (",
              yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  YY_LOCATION_PRINT (yyo, *yylocationp);
+  YYLOCATION_PRINT (yyo, yylocationp);
   YYFPRINTF (yyo, ": ");
   yy_symbol_value_print (yyo, yykind, yyvaluep, yylocationp, parm);
   YYFPRINTF (yyo, ")");
@@ -2832,15 +2839,15 @@ static void
 yydestruct (const char *yymsg,
             yysymbol_kind_t yykind, YYSTYPE *yyvaluep, YYLTYPE *yylocationp, void *parm)
 {
-  YYUSE (yyvaluep);
-  YYUSE (yylocationp);
-  YYUSE (parm);
+  YY_USE (yyvaluep);
+  YY_USE (yylocationp);
+  YY_USE (parm);
   if (!yymsg)
     yymsg = "Deleting";
   YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yykind);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
@@ -2930,10 +2937,15 @@ YYLTYPE yylloc = yyloc_default;
 
   yychar = YYEMPTY; /* Cause a token to be read.  */
 
+
 /* User initialization code.  */
 {
   GCLock lock;
-  yylloc.filename(ASTString(static_cast<ParserState*>(parm)->filename));
+  ParserState* pp = static_cast<ParserState*>(parm);
+  yylloc.filename(ASTString(pp->filename));
+  yylloc.firstLine(pp->startLine);
+  yylloc.lastLine(pp->startLine);
+  yylloc.lastColumn(pp->startColumn - 1);
 }
 
 
@@ -2963,7 +2975,7 @@ yysetstate:
 
   if (yyss + yystacksize - 1 <= yyssp)
 #if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    goto yyexhaustedlab;
+    YYNOMEM;
 #else
     {
       /* Get the current used size of the three stacks, in elements.  */
@@ -2994,7 +3006,7 @@ yysetstate:
 # else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
@@ -3005,7 +3017,7 @@ yysetstate:
           YY_CAST (union yyalloc *,
                    YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
         YYSTACK_RELOCATE (yyls_alloc, yyls);
@@ -3029,6 +3041,7 @@ yysetstate:
     }
 #endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
+
   if (yystate == YYFINAL)
     YYACCEPT;
 
@@ -5208,7 +5221,7 @@ yyerrlab:
           }
         yyerror (&yylloc, parm, yymsgp);
         if (yysyntax_error_status == YYENOMEM)
-          goto yyexhaustedlab;
+          YYNOMEM;
       }
     }
 
@@ -5245,6 +5258,7 @@ yyerrorlab:
      label yyerrorlab therefore never appears in user code.  */
   if (0)
     YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -5308,7 +5322,7 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
 /*-----------------------------------.
@@ -5316,24 +5330,22 @@ yyacceptlab:
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
-#if 1
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
   yyerror (&yylloc, parm, YY_("memory exhausted"));
   yyresult = 2;
-  goto yyreturn;
-#endif
+  goto yyreturnlab;
 
 
-/*-------------------------------------------------------.
-| yyreturn -- parsing is finished, clean up and return.  |
-`-------------------------------------------------------*/
-yyreturn:
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
   if (yychar != YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
@@ -35,7 +35,81 @@ IntSetVal* CopyMap::find(IntSetVal* e) { return static_cast<IntSetVal*>(_nodeMap
 void CopyMap::insert(FloatSetVal* e0, FloatSetVal* e1) { _nodeMap.insert(e0, e1); }
 FloatSetVal* CopyMap::find(FloatSetVal* e) { return static_cast<FloatSetVal*>(_nodeMap.find(e)); }
 
-Location copy_location(CopyMap& m, const Location& _loc) { return _loc; }
+namespace {
+
+/// Return the nodes shared by all models of the current collector, which are compared by identity
+std::vector<Expression*> shared_constants() {
+  return {constants().literalTrue,
+          constants().literalFalse,
+          constants().absent,
+          constants().ctx.root,
+          constants().ctx.pos,
+          constants().ctx.neg,
+          constants().ctx.mix,
+          constants().ann.output_var,
+          constants().ann.add_to_output,
+          constants().ann.output_only,
+          constants().ann.mzn_check_var,
+          constants().ann.is_defined_var,
+          constants().ann.is_reverse_map,
+          constants().ann.promise_total,
+          constants().ann.maybe_partial,
+          constants().ann.user_cut,
+          constants().ann.lazy_constraint,
+          constants().ann.mzn_break_here,
+          constants().ann.rhs_from_assignment,
+          constants().ann.domain_change_constraint,
+          constants().ann.mzn_was_undefined,
+          constants().ann.array_check_form};
+}
+
+}  // namespace
+
+CopyMap::CopyMap(const GCConcurrentSection& source) : _source(&source) {
+  std::vector<Expression*> from;
+  {
+    GCConcurrentSection::Worker w(source);
+    from = shared_constants();
+  }
+  std::vector<Expression*> to = shared_constants();
+  for (unsigned int i = 0; i < from.size(); i++) {
+    insert(from[i], to[i]);
+  }
+}
+
+ASTString copy_string(CopyMap& m, const ASTString& s) {
+  if (m.source() == nullptr || s.size() == 0) {
+    return s;
+  }
+  return ASTString(s.c_str(), s.size());
+}
+
+Location copy_location(CopyMap& m, const Location& _loc) {
+  if (m.source() == nullptr) {
+    return _loc;
+  }
+  // Locations are stored in a table of the collector that owns them
+  ASTString filename;
+  unsigned int firstLine;
+  unsigned int firstColumn;
+  unsigned int lastLine;
+  unsigned int lastColumn;
+  bool introduced;
+  {
+    GCConcurrentSection::Worker w(*m.source());
+    filename = _loc.filename();
+    firstLine = _loc.firstLine();
+    firstColumn = _loc.firstColumn();
+    lastLine = _loc.lastLine();
+    lastColumn = _loc.lastColumn();
+    introduced = _loc.isIntroduced();
+  }
+  if (filename.size() == 0 && firstLine == 0 && lastLine == 0) {
+    return Location();
+  }
+  Location loc(copy_string(m, filename), firstLine, firstColumn, lastLine, lastColumn);
+  return introduced ? loc.introduce() : loc;
+}
 Location copy_location(CopyMap& m, Expression* e) { return copy_location(m, e->loc()); }
 Location copy_location(CopyMap& m, Item* i) { return copy_location(m, i->loc()); }
 
@@ -103,11 +177,11 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
       ret = c;
     } break;
     case Expression::E_BOOLLIT: {
-      ret = e;
+      ret = m.source() == nullptr ? e : constants().boollit(e->cast<BoolLit>()->v());
     } break;
     case Expression::E_STRINGLIT: {
       auto* sl = e->cast<StringLit>();
-      auto* c = new StringLit(copy_location(m, e), sl->v());
+      auto* c = new StringLit(copy_location(m, e), copy_string(m, sl->v()));
       m.insert(e, c);
       ret = c;
     } break;
@@ -164,7 +238,7 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
         if (id->idn() != -1) {
           c = new Id(copy_location(m, e), id->idn(), nullptr);
         } else {
-          c = new Id(copy_location(m, e), id->v(), nullptr);
+          c = new Id(copy_location(m, e), copy_string(m, id->v()), nullptr);
         }
       }
       m.insert(e, c);
@@ -198,6 +272,15 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
             slice);
         m.insert(e, c);
         ret = c;
+      } else if (al->parKind() != ArrayLit::PK_NONE) {
+        // Unboxed par values do not need to be copied
+        std::vector<Expression*> elems(al->size());
+        for (unsigned int i = al->size(); (i--) != 0U;) {
+          elems[i] = (*al)[i];
+        }
+        auto* c = new ArrayLit(copy_location(m, e), elems, dims);
+        m.insert(e, c);
+        ret = c;
       } else {
         auto* c = new ArrayLit(copy_location(m, e), std::vector<Expression*>(), dims);
         m.insert(e, c);
@@ -277,7 +360,7 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
       auto* c = new BinOp(copy_location(m, e), nullptr, b->op(), nullptr);
       if (b->decl() != nullptr) {
         if (copyFundecls) {
-          c->decl(Item::cast<FunctionI>(copy(env, m, b->decl())));
+          c->decl(Item::cast<FunctionI>(copy(env, m, b->decl(), false, true, isFlatModel)));
         } else {
           c->decl(b->decl());
         }
@@ -292,7 +375,7 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
       UnOp* c = new UnOp(copy_location(m, e), b->op(), nullptr);
       if (b->decl() != nullptr) {
         if (copyFundecls) {
-          c->decl(Item::cast<FunctionI>(copy(env, m, b->decl())));
+          c->decl(Item::cast<FunctionI>(copy(env, m, b->decl(), false, true, isFlatModel)));
         } else {
           c->decl(b->decl());
         }
@@ -303,11 +386,11 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
     } break;
     case Expression::E_CALL: {
       Call* ca = e->cast<Call>();
-      Call* c = new Call(copy_location(m, e), ca->id(), std::vector<Expression*>());
+      Call* c = new Call(copy_location(m, e), copy_string(m, ca->id()), std::vector<Expression*>());
 
       if (ca->decl() != nullptr) {
         if (copyFundecls) {
-          c->decl(Item::cast<FunctionI>(copy(env, m, ca->decl())));
+          c->decl(Item::cast<FunctionI>(copy(env, m, ca->decl(), false, true, isFlatModel)));
         } else {
           c->decl(ca->decl());
         }
@@ -325,7 +408,7 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
       auto* vd = e->cast<VarDecl>();
       VarDecl* c;
       if (vd->id()->hasStr()) {
-        c = new VarDecl(copy_location(m, e), nullptr, vd->id()->v(), nullptr);
+        c = new VarDecl(copy_location(m, e), nullptr, copy_string(m, vd->id()->v()), nullptr);
       } else {
         c = new VarDecl(copy_location(m, e), nullptr, vd->id()->idn(), nullptr);
       }
@@ -333,6 +416,9 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
       c->introduced(vd->introduced());
       if (isFlatModel && vd->flat() == vd) {
         c->flat(c);
+      } else if (m.source() != nullptr) {
+        // Flat declarations of another collector cannot be referenced
+        c->flat(nullptr);
       } else {
         c->flat(vd->flat());
       }
@@ -383,7 +469,7 @@ Expression* copy(EnvI& env, CopyMap& m, Expression* e, bool followIds, bool copy
     } break;
     case Expression::E_TIID: {
       TIId* t = e->cast<TIId>();
-      TIId* c = new TIId(copy_location(m, e), t->v());
+      TIId* c = new TIId(copy_location(m, e), copy_string(m, t->v()));
       m.insert(e, c);
       ret = c;
     } break;
@@ -419,7 +505,7 @@ Item* copy(EnvI& env, CopyMap& m, Item* i, bool followIds, bool copyFundecls, bo
   switch (i->iid()) {
     case Item::II_INC: {
       auto* ii = i->cast<IncludeI>();
-      auto* c = new IncludeI(copy_location(m, i), ii->f());
+      auto* c = new IncludeI(copy_location(m, i), copy_string(m, ii->f()));
       m.insert(i, c);
       c->m(copy(env, m, ii->m()), ii->own());
       return c;
@@ -433,7 +519,7 @@ Item* copy(EnvI& env, CopyMap& m, Item* i, bool followIds, bool copyFundecls, bo
     }
     case Item::II_ASN: {
       auto* a = i->cast<AssignI>();
-      auto* c = new AssignI(copy_location(m, i), a->id(), nullptr);
+      auto* c = new AssignI(copy_location(m, i), copy_string(m, a->id()), nullptr);
       m.insert(i, c);
       c->e(copy(env, m, a->e(), followIds, copyFundecls, isFlatModel));
       c->decl(static_cast<VarDecl*>(copy(env, m, a->decl(), followIds, copyFundecls, isFlatModel)));
@@ -478,10 +564,14 @@ Item* copy(EnvI& env, CopyMap& m, Item* i, bool followIds, bool copyFundecls, bo
         params[j] = static_cast<VarDecl*>(
             copy(env, m, f->params()[j], followIds, copyFundecls, isFlatModel));
       }
+      // Only functions copied as part of a whole model keep their standard library status
       auto* c = new FunctionI(
-          copy_location(m, i), f->id(),
+          copy_location(m, i), copy_string(m, f->id()),
           static_cast<TypeInst*>(copy(env, m, f->ti(), followIds, copyFundecls, isFlatModel)),
-          params, copy(env, m, f->e(), followIds, copyFundecls, isFlatModel));
+          params, nullptr, copyFundecls && f->fromStdLib());
+      // Register the copy before copying the body, so that recursive calls refer to it
+      m.insert(i, c);
+      c->e(copy(env, m, f->e(), followIds, copyFundecls, isFlatModel));
       c->builtins.e = f->builtins.e;
       c->builtins.i = f->builtins.i;
       c->builtins.f = f->builtins.f;
@@ -490,7 +580,6 @@ Item* copy(EnvI& env, CopyMap& m, Item* i, bool followIds, bool copyFundecls, bo
       c->builtins.str = f->builtins.str;
 
       copy_ann(env, m, f->ann(), c->ann(), followIds, copyFundecls, isFlatModel);
-      m.insert(i, c);
       return c;
     }
     default:
@@ -511,16 +600,32 @@ Model* copy(EnvI& env, CopyMap& cm, Model* m, bool isFlatModel) {
   if (Model* cached = cm.find(m)) {
     return cached;
   }
+  // The constants are shared by all models, and are compared by identity
+  for (Expression* e : shared_constants()) {
+    cm.insert(e, e);
+  }
   auto* c = new Model;
+  c->setFilename(copy_string(cm, m->filename()));
+  c->setFilepath(copy_string(cm, m->filepath()));
   for (auto& i : *m) {
-    c->addItem(copy(env, cm, i, false, true));
+    if (!i->removed()) {
+      c->addItem(copy(env, cm, i, false, true, isFlatModel));
+    }
   }
 
+  // Copy the function table entry by entry, so that overloads are resolved in the same order
   for (auto& it : m->_fnmap) {
+    std::vector<Model::FnEntry>& entries = c->_fnmap[copy_string(cm, it.first)];
     for (auto& i : it.second) {
-      c->registerFn(env, copy(env, cm, i.fi, false, true, isFlatModel)->cast<FunctionI>());
+      Model::FnEntry fe(copy(env, cm, i.fi, false, true, isFlatModel)->cast<FunctionI>());
+      fe.t = i.t;
+      fe.isPolymorphic = i.isPolymorphic;
+      entries.push_back(fe);
     }
   }
+  for (auto& it : m->_revmapmap) {
+    c->_revmapmap[it.first] = copy(env, cm, it.second, false, true, isFlatModel)->cast<FunctionI>();
+  }
   cm.insert(m, c);
   return c;
 }
@@ -0,0 +1,137 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/cse_map.hh>
+
+namespace MiniZinc {
+
+namespace {
+/// Clear \a r if it refers to an expression that has not been marked
+void clear_unmarked(CSEMap::Ref& r, Expression* e) {
+  if (e != nullptr && !e->isUnboxedVal() && !GC::marked(e)) {
+    r = nullptr;
+  }
+}
+}  // namespace
+
+CSEMap::CSEMap() : _bits(6), _size(0), _hits(0), _misses(0), _collisions(0) {
+  _slots.resize(static_cast<size_t>(1) << _bits, Slot{0, _empty});
+}
+
+size_t CSEMap::lookup(Expression* e, size_t h) {
+  const size_t mask = _slots.size() - 1;
+  for (size_t i = home(h);; i = (i + 1) & mask) {
+    const Slot& s = _slots[i];
+    if (s.entry == _empty) {
+      return i;
+    }
+    if (s.hash == h) {
+      Expression* k = _entries[s.entry].first;
+      if (k == e || Expression::equal(k, e)) {
+        return i;
+      }
+    }
+    ++_collisions;
+  }
+}
+
+void CSEMap::grow() {
+  std::vector<Slot> old(static_cast<size_t>(1) << (_bits + 1), Slot{0, _empty});
+  old.swap(_slots);
+  ++_bits;
+  const size_t mask = _slots.size() - 1;
+  for (const Slot& s : old) {
+    if (s.entry != _empty) {
+      size_t i = home(s.hash);
+      while (_slots[i].entry != _empty) {
+        i = (i + 1) & mask;
+      }
+      _slots[i] = s;
+    }
+  }
+}
+
+CSEMap::iterator CSEMap::find(Expression* e) {
+  Slot& s = _slots[lookup(e, Expression::hash(e))];
+  if (s.entry == _empty) {
+    ++_misses;
+    return end();
+  }
+  ++_hits;
+  return &_entries[s.entry];
+}
+
+void CSEMap::insert(Expression* e, const Value& v) {
+  assert(e != nullptr);
+  const size_t h = Expression::hash(e);
+  size_t i = lookup(e, h);
+  if (_slots[i].entry != _empty) {
+    return;
+  }
+  // Keep the load factor at most 3/4
+  if ((_size + 1) * 4 > _slots.size() * 3) {
+    grow();
+    i = lookup(e, h);
+  }
+  unsigned int idx;
+  if (_free.empty()) {
+    idx = static_cast<unsigned int>(_entries.size());
+    _entries.emplace_back(e, v);
+  } else {
+    idx = _free.back();
+    _free.pop_back();
+    _entries[idx] = Entry(e, v);
+  }
+  _slots[i] = Slot{h, idx};
+  ++_size;
+}
+
+void CSEMap::remove(Expression* e) {
+  size_t i = lookup(e, Expression::hash(e));
+  if (_slots[i].entry == _empty) {
+    return;
+  }
+  _entries[_slots[i].entry] = Entry(nullptr, Value(nullptr, nullptr));
+  _free.push_back(_slots[i].entry);
+  --_size;
+  // Move entries of the following cluster that would not be found any more
+  // into the gap (backward shift deletion)
+  const size_t mask = _slots.size() - 1;
+  for (size_t j = (i + 1) & mask; _slots[j].entry != _empty; j = (j + 1) & mask) {
+    size_t h = home(_slots[j].hash);
+    bool stays = i <= j ? (i < h && h <= j) : (i < h || h <= j);
+    if (!stays) {
+      _slots[i] = _slots[j];
+      i = j;
+    }
+  }
+  _slots[i].entry = _empty;
+}
+
+void CSEMap::clear() {
+  _bits = 6;
+  std::vector<Slot>(static_cast<size_t>(1) << _bits, Slot{0, _empty}).swap(_slots);
+  _entries.clear();
+  _free.clear();
+  _size = 0;
+}
+
+void CSEMap::mark(MINIZINC_GC_STAT_ARGS) {
+  for (auto& e : _entries) {
+    Expression::mark(e.first);
+  }
+}
+
+void CSEMap::clearWeak() {
+  for (auto& e : _entries) {
+    if (e.first != nullptr) {
+      clear_unmarked(e.second.r, e.second.r());
+      clear_unmarked(e.second.b, e.second.b());
+    }
+  }
+}
+
+}  // namespace MiniZinc
@@ -163,7 +163,7 @@ public:
   typedef std::string Val;
   typedef std::string ArrayVal;
   static std::string e(EnvI& env, Expression* e) { return eval_string(env, e); }
-  static Expression* exp(const std::string& e) { return new StringLit(Location(), e); }
+  static Expression* exp(const std::string& e) { return StringLit::a(ASTString(e)); }
   static void checkRetVal(EnvI& env, const Val& v, FunctionI* fi) {}
 };
 class EvalStringLit : public EvalBase {
@@ -171,7 +171,7 @@ public:
   typedef StringLit* Val;
   typedef Expression* ArrayVal;
   static StringLit* e(EnvI& env, Expression* e) {
-    return new StringLit(Location(), eval_string(env, e));
+    return StringLit::a(ASTString(eval_string(env, e)));
   }
   static Expression* exp(Expression* e) { return e; }
 };
@@ -278,7 +278,7 @@ class EvalIntSet : public EvalBase {
 public:
   typedef IntSetVal* Val;
   static IntSetVal* e(EnvI& env, Expression* e) { return eval_intset(env, e); }
-  static Expression* exp(IntSetVal* e) { return new SetLit(Location(), e); }
+  static Expression* exp(IntSetVal* e) { return SetLit::a(e); }
   static void checkRetVal(EnvI& env, Val v, FunctionI* fi) {
     if ((fi->ti()->domain() != nullptr) && !fi->ti()->domain()->isa<TIId>()) {
       IntSetVal* isv = eval_intset(env, fi->ti()->domain());
@@ -295,7 +295,7 @@ class EvalFloatSet : public EvalBase {
 public:
   typedef FloatSetVal* Val;
   static FloatSetVal* e(EnvI& env, Expression* e) { return eval_floatset(env, e); }
-  static Expression* exp(FloatSetVal* e) { return new SetLit(Location(), e); }
+  static Expression* exp(FloatSetVal* e) { return SetLit::a(e); }
   static void checkRetVal(EnvI& env, Val v, FunctionI* fi) {
     if ((fi->ti()->domain() != nullptr) && !fi->ti()->domain()->isa<TIId>()) {
       FloatSetVal* fsv = eval_floatset(env, fi->ti()->domain());
@@ -390,6 +390,28 @@ void check_dom(EnvI& env, Id* arg, FloatVal dom_min, FloatVal dom_max, Expressio
   }
 }
 
+/// Evaluate body of \a decl using compiled bytecode (returns false if not evaluated)
+template <class Eval>
+bool eval_call_bytecode(EnvI& env, FunctionI* decl, const std::vector<Expression*>& params,
+                        typename Eval::Val& ret) {
+  return false;
+}
+template <>
+bool eval_call_bytecode<EvalIntVal>(EnvI& env, FunctionI* decl,
+                                    const std::vector<Expression*>& params, IntVal& ret) {
+  return env.fopts.parBytecode && env.parBytecode.evalInt(decl, params, ret);
+}
+template <>
+bool eval_call_bytecode<EvalBoolVal>(EnvI& env, FunctionI* decl,
+                                     const std::vector<Expression*>& params, bool& ret) {
+  return env.fopts.parBytecode && env.parBytecode.evalBool(decl, params, ret);
+}
+template <>
+bool eval_call_bytecode<EvalFloatVal>(EnvI& env, FunctionI* decl,
+                                      const std::vector<Expression*>& params, FloatVal& ret) {
+  return env.fopts.parBytecode && env.parBytecode.evalFloat(decl, params, ret);
+}
+
 template <class Eval, class CallClass = Call>
 typename Eval::Val eval_call(EnvI& env, CallClass* ce) {
   std::vector<Expression*> previousParameters(ce->decl()->params().size());
@@ -442,7 +464,13 @@ typename Eval::Val eval_call(EnvI& env, CallClass* ce) {
       }
     }
   }
-  typename Eval::Val ret = Eval::e(env, ce->decl()->e());
+  typename Eval::Val ret;
+  {
+    FlattenProfiler::Scope profile_scope(env.profiler.get(), ce->decl(), ce->loc());
+    if (!eval_call_bytecode<Eval>(env, ce->decl(), params, ret)) {
+      ret = Eval::e(env, ce->decl()->e());
+    }
+  }
   Eval::checkRetVal(env, ret, ce->decl());
   for (unsigned int i = ce->decl()->params().size(); i--;) {
     VarDecl* vd = ce->decl()->params()[i];
@@ -20,7 +20,9 @@
 #include <minizinc/exception.hh>
 #include <minizinc/file_utils.hh>
 
+#include <algorithm>
 #include <cstring>
+#include <fstream>
 #include <sstream>
 #include <string>
 
@@ -40,6 +42,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #ifdef _MSC_VER
 #include "Shlwapi.h"
 #pragma comment(lib, "Shlwapi.lib")
@@ -124,6 +131,35 @@ bool directory_exists(const std::string& dirname) {
 #endif
 }
 
+bool file_stat(const std::string& filename, long long& size, long long& mtime) {
+#ifdef _MSC_VER
+  struct _stat64 info;
+  if (_wstat64(utf8_to_wide(filename).c_str(), &info) != 0) {
+    return false;
+  }
+#else
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) {
+    return false;
+  }
+#endif
+  size = static_cast<long long>(info.st_size);
+  mtime = static_cast<long long>(info.st_mtime);
+  return true;
+}
+
+bool create_directory(const std::string& dirname) {
+  if (directory_exists(dirname)) {
+    return true;
+  }
+#ifdef _MSC_VER
+  _wmkdir(utf8_to_wide(dirname).c_str());
+#else
+  mkdir(dirname.c_str(), 0755);
+#endif
+  return directory_exists(dirname);
+}
+
 std::string file_path(const std::string& filename, const std::string& basePath) {
 #ifdef _MSC_VER
   LPWSTR lpFilePart;
@@ -474,6 +510,66 @@ TmpDir::~TmpDir() {
 #endif
 }
 
+MappedFile::MappedFile(const std::string& filename)
+    : _data(nullptr), _size(0), _open(false), _mapped(nullptr) {
+#ifdef HAS_MMAP
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+      void* m = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED) {
+        _mapped = m;
+        _data = static_cast<const char*>(m);
+        _size = static_cast<size_t>(info.st_size);
+        _open = true;
+      }
+    }
+    close(fd);
+  }
+  if (_open) {
+    return;
+  }
+#endif
+  std::ifstream is(FILE_PATH(filename), std::ios::binary);
+  if (is.is_open()) {
+    _contents.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    _data = _contents.data();
+    _size = _contents.size();
+    _open = true;
+  }
+}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+  if (_mapped != nullptr) {
+    munmap(_mapped, _size);
+  }
+#endif
+}
+
+void MappedFile::willNeed() const {
+#ifdef HAS_MMAP
+  if (_mapped != nullptr) {
+    madvise(_mapped, _size, MADV_SEQUENTIAL);
+    madvise(_mapped, _size, MADV_WILLNEED);
+  }
+#endif
+}
+
+void MappedFile::release(size_t begin, size_t end) const {
+#ifdef HAS_MMAP
+  if (_mapped != nullptr) {
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    begin = (begin + page - 1) / page * page;
+    end = std::min(end, _size) / page * page;
+    if (begin < end) {
+      madvise(static_cast<char*>(_mapped) + begin, end - begin, MADV_DONTNEED);
+    }
+  }
+#endif
+}
+
 std::vector<std::string> parse_cmd_line(const std::string& s) {
   // Break the string up at whitespace, except inside quotes, but ignore escaped quotes
   std::vector<std::string> c;
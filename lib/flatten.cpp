@@ -679,6 +679,7 @@ EnvI::EnvI(Model* model0, std::ostream& outstream0, std::ostream& errstream0)
       maxPathDepth(0),
       ignorePartial(false),
       ignoreUnknownIds(false),
+      typecheckThreads(1),
       maxCallStack(0),
       inRedundantConstraint(0),
       inSymmetryBreakingConstraint(0),
@@ -740,21 +741,18 @@ void EnvI::cseMapInsert(Expression* e, const EE& ee) {
   if (e->type().isPar() && !e->isa<ArrayLit>()) {
     return;
   }
-  KeepAlive ka(e);
-  _cseMap.insert(ka, WW(ee.r(), ee.b()));
+  _cseMap.insert(e, WW(ee.r(), ee.b()));
   Call* c = e->dynamicCast<Call>();
   if ((c != nullptr) && c->id() == constants().ids.bool_not && c->arg(0)->isa<Id>() &&
       ee.r()->isa<Id>() && ee.b() == constants().boollit(true)) {
     Call* neg_c = new Call(Location().introduce(), c->id(), {ee.r()});
     neg_c->type(c->type());
     neg_c->decl(c->decl());
-    KeepAlive neg_ka(neg_c);
-    _cseMap.insert(neg_ka, WW(c->arg(0), ee.b()));
+    _cseMap.insert(neg_c, WW(c->arg(0), ee.b()));
   }
 }
 EnvI::CSEMap::iterator EnvI::cseMapFind(Expression* e) {
-  KeepAlive ka(e);
-  auto it = _cseMap.find(ka);
+  auto it = _cseMap.find(e);
   if (it != _cseMap.end()) {
     if (it->second.r() != nullptr) {
       VarDecl* it_vd = it->second.r()->isa<Id>() ? it->second.r()->cast<Id>()->decl()
@@ -772,8 +770,7 @@ EnvI::CSEMap::iterator EnvI::cseMapFind(Expression* e) {
   return it;
 }
 void EnvI::cseMapRemove(Expression* e) {
-  KeepAlive ka(e);
-  _cseMap.remove(ka);
+  _cseMap.remove(e);
 }
 EnvI::CSEMap::iterator EnvI::cseMapEnd() { return _cseMap.end(); }
 void EnvI::dump() {
@@ -798,6 +795,9 @@ void EnvI::flatAddItem(Item* i) {
     return;
   }
   _flat->addItem(i);
+  if (profiler != nullptr) {
+    profiler->addItem(i);
+  }
 
   Expression* toAnnotate = nullptr;
   Expression* toAdd = nullptr;
@@ -878,6 +878,22 @@ void EnvI::copyPathMapsAndState(EnvI& env) {
   _reversePathMap = env.getReversePathMap();
 }
 
+void EnvI::copyTypeState(EnvI& env, CopyMap& cm) {
+  _ids = std::max(_ids, env._ids);
+  _enumVarDecls.resize(env._enumVarDecls.size());
+  for (unsigned int i = 0; i < env._enumVarDecls.size(); i++) {
+    Item* vdi = cm.find(env._enumVarDecls[i]);
+    _enumVarDecls[i] = vdi != nullptr ? vdi->cast<VarDeclI>() : env._enumVarDecls[i];
+    _enumMap[_enumVarDecls[i]] = i;
+  }
+  _arrayEnumMap = env._arrayEnumMap;
+  _arrayEnumDecls = env._arrayEnumDecls;
+  for (auto& it : env.reverseEnum) {
+    Item* i = cm.find(it.second);
+    reverseEnum[copy_string(cm, it.first)] = i != nullptr ? i : it.second;
+  }
+}
+
 void EnvI::flatRemoveExpr(Expression* e, Item* i) {
   std::vector<VarDecl*> toRemove;
   CollectDecls cd(varOccurrences, toRemove, i);
@@ -951,6 +967,7 @@ VarDeclI* EnvI::getEnum(unsigned int i) const {
   return _enumVarDecls[i - 1];
 }
 unsigned int EnvI::registerArrayEnum(const std::vector<unsigned int>& arrayEnum) {
+  GCConcurrentLock lock;
   std::ostringstream oss;
   for (unsigned int i : arrayEnum) {
     assert(i <= _enumVarDecls.size());
@@ -968,6 +985,7 @@ unsigned int EnvI::registerArrayEnum(const std::vector<unsigned int>& arrayEnum)
   return ret + 1;
 }
 const std::vector<unsigned int>& EnvI::getArrayEnum(unsigned int i) const {
+  GCConcurrentLock lock;
   assert(i > 0 && i <= _arrayEnumDecls.size());
   return _arrayEnumDecls[i - 1];
 }
@@ -1076,6 +1094,7 @@ void EnvI::addWarning(const std::string& msg) {
 }
 
 void EnvI::createErrorStack() {
+  GCConcurrentLock lock;
   errorStack.clear();
   for (auto i = static_cast<unsigned int>(callStack.size()); (i--) != 0U;) {
     Expression* e = callStack[i]->untag();
@@ -1442,7 +1461,8 @@ void populate_output(Env& env) {
       }
       if (has_output_ann) {
         std::ostringstream s;
-        s << vd->id()->str() << " = ";
+        vd->id()->printStr(s);
+        s << " = ";
 
         auto* vd_output = copy(env.envi(), vd)->cast<VarDecl>();
         Type vd_t = vd_output->type();
@@ -1642,7 +1662,7 @@ bool check_domain_constraints(EnvI& env, Call* c) {
         Ranges::Const<IntVal> cr(lb, IntVal::infinity());
         Ranges::Inter<IntVal, IntSetRanges, Ranges::Const<IntVal>> i(dr, cr);
         IntSetVal* newibv = IntSetVal::ai(i);
-        id->decl()->ti()->domain(new SetLit(Location().introduce(), newibv));
+        id->decl()->ti()->domain(SetLit::a(newibv));
         id->decl()->ti()->setComputedDomain(false);
       } else {
         id->decl()->ti()->domain(
@@ -1667,7 +1687,7 @@ bool check_domain_constraints(EnvI& env, Call* c) {
         Ranges::Const<IntVal> cr(-IntVal::infinity(), ub);
         Ranges::Inter<IntVal, IntSetRanges, Ranges::Const<IntVal>> i(dr, cr);
         IntSetVal* newibv = IntSetVal::ai(i);
-        id->decl()->ti()->domain(new SetLit(Location().introduce(), newibv));
+        id->decl()->ti()->domain(SetLit::a(newibv));
         id->decl()->ti()->setComputedDomain(false);
       } else {
         id->decl()->ti()->domain(
@@ -1708,10 +1728,10 @@ bool check_domain_constraints(EnvI& env, Call* c) {
           Ranges::Const<IntVal> cr(lb, ub);
           Ranges::Inter<IntVal, IntSetRanges, Ranges::Const<IntVal>> i(dr, cr);
           IntSetVal* newibv = IntSetVal::ai(i);
-          id->decl()->ti()->domain(new SetLit(Location().introduce(), newibv));
+          id->decl()->ti()->domain(SetLit::a(newibv));
           id->decl()->ti()->setComputedDomain(false);
         } else {
-          id->decl()->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(lb, ub)));
+          id->decl()->ti()->domain(SetLit::a(IntSetVal::a(lb, ub)));
         }
         return false;
       }
@@ -2856,6 +2876,20 @@ void flatten(Env& e, FlatteningOptions opt) {
   try {
     EnvI& env = e.envi();
     env.fopts = opt;
+    if (opt.profileCalls && env.profiler == nullptr) {
+      env.profiler.reset(new FlattenProfiler());
+    }
+    FlattenProfiler::Scope profile_scope(env.profiler.get());
+
+    // Record the flattening context when running out of memory
+    class MemoryLimitContext : public GCMemoryLimitHandler {
+    protected:
+      EnvI& _env;
+      void exceeded() override { _env.createErrorStack(); }
+
+    public:
+      MemoryLimitContext(EnvI& env0) : _env(env0) {}
+    } memoryLimitContext(env);
 
     bool onlyRangeDomains = false;
     if (opt.onlyRangeDomains) {
@@ -2870,6 +2904,21 @@ void flatten(Env& e, FlatteningOptions opt) {
     }
 
     bool hadSolveItem = false;
+    // Record the identifiers generated while flattening an item (see EnvI::itemIds)
+    class RecordIds {
+    protected:
+      EnvI& _env;
+      Item* _item;
+      long long int _first;
+
+    public:
+      RecordIds(EnvI& env, Item* item) : _env(env), _item(item), _first(env.nextId()) {}
+      ~RecordIds() {
+        if (_env.itemIds != nullptr && _env.nextId() > _first) {
+          _env.itemIds->push_back({_item, _first, _env.nextId()});
+        }
+      }
+    };
     // Flatten main model
     class FV : public ItemVisitor {
     public:
@@ -2881,6 +2930,8 @@ void flatten(Env& e, FlatteningOptions opt) {
       bool enter(Item* i) const { return !(i->isa<ConstraintI>() && env.failed()); }
       void vVarDeclI(VarDeclI* v) {
         ItemTimer item_timer(v->loc(), timingMap);
+        FlattenProfiler::Scope profile_scope(env.profiler.get(), "var", v->loc());
+        RecordIds record_ids(env, v);
         v->e()->ann().remove(constants().ann.output_var);
         v->e()->ann().removeCall(constants().ann.output_array);
         if (v->e()->ann().contains(constants().ann.output_only)) {
@@ -2944,6 +2995,8 @@ void flatten(Env& e, FlatteningOptions opt) {
       }
       void vConstraintI(ConstraintI* ci) {
         ItemTimer item_timer(ci->loc(), timingMap);
+        FlattenProfiler::Scope profile_scope(env.profiler.get(), "constraint", ci->loc());
+        RecordIds record_ids(env, ci);
         (void)flat_exp(env, Ctx(), ci->e(), constants().varTrue, constants().varTrue);
       }
       void vSolveI(SolveI* si) {
@@ -2951,6 +3004,7 @@ void flatten(Env& e, FlatteningOptions opt) {
           throw FlatteningError(env, si->loc(), "Only one solve item allowed");
         }
         ItemTimer item_timer(si->loc(), timingMap);
+        FlattenProfiler::Scope profile_scope(env.profiler.get(), "solve", si->loc());
         hadSolveItem = true;
         GCLock lock;
         SolveI* nsi = nullptr;
@@ -3958,7 +4012,7 @@ std::vector<Expression*> cleanup_vardecl(EnvI& env, VarDeclI* vdi, VarDecl* vd,
     al->make1d();
     IntSetVal* isv = IntSetVal::a(1, al->length());
     if (vd->ti()->ranges().size() == 1) {
-      vd->ti()->ranges()[0]->domain(new SetLit(Location().introduce(), isv));
+      vd->ti()->ranges()[0]->domain(SetLit::a(isv));
     } else {
       std::vector<TypeInst*> r(1);
       r[0] = new TypeInst(vd->ti()->ranges()[0]->loc(), vd->ti()->ranges()[0]->type(),
@@ -4232,8 +4286,8 @@ void oldflatzinc(Env& e) {
                 if (Id* ident = c->arg(i)->dynamicCast<Id>()) {
                   if (ident->type().dim() > 0) {
                     if (auto* al = Expression::dynamicCast<ArrayLit>(ident->decl()->e())) {
-                      for (auto* e : al->getVec()) {
-                        if (auto* ident = e->dynamicCast<Id>()) {
+                      for (unsigned int j = 0; j < al->size(); j++) {
+                        if (auto* ident = (*al)[j]->dynamicCast<Id>()) {
                           checkId(cur, ident);
                         }
                       }
@@ -4242,8 +4296,8 @@ void oldflatzinc(Env& e) {
                     checkId(cur, ident);
                   }
                 } else if (auto* al = c->arg(i)->dynamicCast<ArrayLit>()) {
-                  for (auto* e : al->getVec()) {
-                    if (auto* ident = e->dynamicCast<Id>()) {
+                  for (unsigned int j = 0; j < al->size(); j++) {
+                    if (auto* ident = (*al)[j]->dynamicCast<Id>()) {
                       checkId(cur, ident);
                     }
                   }
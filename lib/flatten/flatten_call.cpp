@@ -1165,6 +1165,7 @@ EE flatten_call(EnvI& env, const Ctx& input_ctx, Expression* e, VarDecl* r, VarD
           }
         }
       } else {
+        FlattenProfiler::Scope profile_scope(env.profiler.get(), decl, c->loc());
         std::vector<KeepAlive> previousParameters(decl->params().size());
         for (unsigned int i = decl->params().size(); (i--) != 0U;) {
           VarDecl* vd = decl->params()[i];
@@ -103,14 +103,14 @@ EE flatten_id(EnvI& env, const Ctx& ctx, Expression* e, VarDecl* r, VarDecl* b,
             if (!isv->contains(v)) {
               env.fail();
             }
-            vd->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(v, v)));
+            vd->ti()->domain(SetLit::a(IntSetVal::a(v, v)));
           } else if (vd->type() == Type::varfloat()) {
             FloatSetVal* fsv = eval_floatset(env, vd->ti()->domain());
             FloatVal v = eval_float(env, rete);
             if (!fsv->contains(v)) {
               env.fail();
             }
-            vd->ti()->domain(new SetLit(Location().introduce(), FloatSetVal::a(v, v)));
+            vd->ti()->domain(SetLit::a(FloatSetVal::a(v, v)));
           } else if (vd->type() == Type::varsetint()) {
             IntSetVal* isv = eval_intset(env, vd->ti()->domain());
             IntSetVal* v = eval_intset(env, rete);
@@ -119,7 +119,7 @@ EE flatten_id(EnvI& env, const Ctx& ctx, Expression* e, VarDecl* r, VarDecl* b,
             if (!Ranges::subset(v_r, isv_r)) {
               env.fail();
             }
-            vd->ti()->domain(new SetLit(Location().introduce(), v));
+            vd->ti()->domain(SetLit::a(v));
           }
           // If we made it to here, the new domain is equal to the RHS
           vd->ti()->setComputedDomain(true);
@@ -0,0 +1,205 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/file_utils.hh>
+#include <minizinc/flatten_profile.hh>
+#include <minizinc/prettyprinter.hh>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace MiniZinc {
+
+namespace {
+/// Return \a d in milliseconds
+double to_ms(FlattenProfiler::Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+std::string to_string(const ASTString& s) {
+  return s.c_str() == nullptr ? std::string() : std::string(s.c_str(), s.size());
+}
+std::string location_string(const Location& loc) {
+  std::ostringstream oss;
+  oss << loc.filename() << ":" << loc.firstLine();
+  return oss.str();
+}
+}  // namespace
+
+size_t FlattenProfiler::KeyHash::operator()(const Key& k) const {
+  size_t h = std::hash<const void*>()(k.id);
+  h ^= std::hash<const void*>()(k.file) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  h ^= std::hash<unsigned int>()(k.line) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  h ^= std::hash<unsigned int>()(k.parent) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  return h;
+}
+
+FlattenProfiler::FlattenProfiler() { _nodes.emplace_back(0, "flatten", "", "", 0, false); }
+
+unsigned int FlattenProfiler::child(FunctionI* fn, const Location& loc) {
+  assert(!_stack.empty());
+  Key key{_stack.back().first, fn, loc.filename().c_str(), loc.firstLine()};
+  auto it = _children.find(key);
+  if (it != _children.end()) {
+    return it->second;
+  }
+  auto n = static_cast<unsigned int>(_nodes.size());
+  _nodes.emplace_back(key.parent, to_string(fn->id()), location_string(fn->loc()),
+                      to_string(loc.filename()), key.line, true);
+  _children.emplace(key, n);
+  return n;
+}
+
+unsigned int FlattenProfiler::child(const char* kind, const Location& loc) {
+  assert(!_stack.empty());
+  Key key{_stack.back().first, kind, loc.filename().c_str(), loc.firstLine()};
+  auto it = _children.find(key);
+  if (it != _children.end()) {
+    return it->second;
+  }
+  auto n = static_cast<unsigned int>(_nodes.size());
+  _nodes.emplace_back(key.parent, kind, "", to_string(loc.filename()), key.line, false);
+  _children.emplace(key, n);
+  return n;
+}
+
+void FlattenProfiler::enter(unsigned int n) {
+  _nodes[n].calls++;
+  _stack.emplace_back(n, Clock::now());
+}
+
+void FlattenProfiler::exit() {
+  assert(!_stack.empty());
+  _nodes[_stack.back().first].time += Clock::now() - _stack.back().second;
+  _stack.pop_back();
+}
+
+void FlattenProfiler::addItem(const Item* i) {
+  if (_stack.empty()) {
+    return;
+  }
+  Node& n = _nodes[_stack.back().first];
+  if (i->iid() == Item::II_VD) {
+    n.vars++;
+  } else if (i->iid() == Item::II_CON) {
+    n.constraints++;
+  }
+}
+
+std::string FlattenProfiler::label(unsigned int n) const {
+  const Node& node = _nodes[n];
+  if (n == 0) {
+    return node.name;
+  }
+  std::ostringstream oss;
+  oss << node.name << " (" << (node.file.empty() ? "?" : FileUtils::base_name(node.file)) << ":"
+      << node.line << ")";
+  return oss.str();
+}
+
+void FlattenProfiler::writeCollapsed(std::ostream& os) const {
+  // Exclusive time of each node
+  std::vector<Clock::duration> self(_nodes.size());
+  for (unsigned int i = 0; i < _nodes.size(); i++) {
+    self[i] = _nodes[i].time;
+  }
+  for (auto i = static_cast<unsigned int>(_nodes.size()); (--i) != 0U;) {
+    self[_nodes[i].parent] -= _nodes[i].time;
+  }
+  std::vector<std::string> stacks(_nodes.size());
+  for (unsigned int i = 0; i < _nodes.size(); i++) {
+    stacks[i] = i == 0 ? label(i) : stacks[_nodes[i].parent] + ";" + label(i);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(self[i]).count();
+    if (us > 0) {
+      os << stacks[i] << " " << us << "\n";
+    }
+  }
+}
+
+void FlattenProfiler::writeJSON(std::ostream& os) const {
+  // Totals of the subtree of each node
+  std::vector<unsigned long long int> vars(_nodes.size());
+  std::vector<unsigned long long int> constraints(_nodes.size());
+  std::vector<Clock::duration> children(_nodes.size(), Clock::duration::zero());
+  for (unsigned int i = 0; i < _nodes.size(); i++) {
+    vars[i] = _nodes[i].vars;
+    constraints[i] = _nodes[i].constraints;
+  }
+  for (auto i = static_cast<unsigned int>(_nodes.size()); (--i) != 0U;) {
+    vars[_nodes[i].parent] += vars[i];
+    constraints[_nodes[i].parent] += constraints[i];
+    children[_nodes[i].parent] += _nodes[i].time;
+  }
+
+  // Aggregate nodes by function and call site. Inclusive totals of recursive
+  // calls are only counted for the outermost call.
+  struct Entry {
+    const Node* node;
+    unsigned long long int calls = 0;
+    Clock::duration time = Clock::duration::zero();
+    Clock::duration selfTime = Clock::duration::zero();
+    unsigned long long int vars = 0;
+    unsigned long long int selfVars = 0;
+    unsigned long long int constraints = 0;
+    unsigned long long int selfConstraints = 0;
+  };
+  typedef std::tuple<std::string, std::string, std::string, unsigned int> EntryKey;
+  std::map<EntryKey, Entry> entries;
+  std::vector<EntryKey> keys(_nodes.size());
+  for (unsigned int i = 1; i < _nodes.size(); i++) {
+    const Node& n = _nodes[i];
+    keys[i] = EntryKey(n.name, n.definition, n.file, n.line);
+    Entry& e = entries[keys[i]];
+    e.node = &n;
+    e.calls += n.calls;
+    e.selfTime += n.time - children[i];
+    e.selfVars += n.vars;
+    e.selfConstraints += n.constraints;
+    bool nested = false;
+    for (unsigned int p = n.parent; p != 0 && !nested; p = _nodes[p].parent) {
+      nested = keys[p] == keys[i];
+    }
+    if (!nested) {
+      e.time += n.time;
+      e.vars += vars[i];
+      e.constraints += constraints[i];
+    }
+  }
+  std::vector<const Entry*> sorted;
+  sorted.reserve(entries.size());
+  for (const auto& e : entries) {
+    sorted.push_back(&e.second);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Entry* e0, const Entry* e1) { return e0->time > e1->time; });
+
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(3);
+  oss << "{\n  \"time\": " << to_ms(_nodes[0].time) << ",\n  \"vars\": " << vars[0]
+      << ",\n  \"constraints\": " << constraints[0] << ",\n  \"entries\": [";
+  bool first = true;
+  for (const Entry* e : sorted) {
+    oss << (first ? "\n" : ",\n") << "    {\"kind\": \"" << (e->node->isCall ? "call" : "item")
+        << "\", \"name\": \"" << Printer::escapeStringLit(e->node->name) << "\"";
+    if (e->node->isCall) {
+      oss << ", \"definition\": \"" << Printer::escapeStringLit(e->node->definition) << "\"";
+    }
+    oss << ", \"file\": \"" << Printer::escapeStringLit(e->node->file)
+        << "\", \"line\": " << e->node->line << ", \"calls\": " << e->calls
+        << ", \"time\": " << to_ms(e->time) << ", \"selfTime\": " << to_ms(e->selfTime)
+        << ", \"vars\": " << e->vars << ", \"selfVars\": " << e->selfVars
+        << ", \"constraints\": " << e->constraints
+        << ", \"selfConstraints\": " << e->selfConstraints << "}";
+    first = false;
+  }
+  oss << "\n  ]\n}\n";
+  os << oss.str();
+}
+
+}  // namespace MiniZinc
@@ -16,10 +16,15 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include <minizinc/copy.hh>
 #include <minizinc/flattener.hh>
+#include <minizinc/library_image.hh>
+#include <minizinc/parallel_flatten.hh>
 #include <minizinc/pathfileprinter.hh>
 
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
 
 #ifdef HAS_GECODE
 #include <minizinc/solvers/gecode_solverinstance.hh>
@@ -88,8 +93,30 @@ void Flattener::printHelp(ostream& os) const {
      << "  --no-half-reifications\n    Only use fully reified constraints, even when a half "
         "reified constraint is defined."
      << std::endl
+     << "  --compiler-memory-limit <n>\n    Abort compilation if it requires more than <n> "
+        "Mbytes of memory."
+     << std::endl
      << "  --compile-solution-checker <file>.mzc.mzn\n    Compile solution checker model"
      << std::endl
+     << "  --precompile-library\n    Parse the standard library of the selected solver and store "
+        "it as a\n    precompiled image that is used instead of parsing the library files."
+     << std::endl
+     << "  --library-image <file>\n    Use <file> as the precompiled library image (default: in "
+        "the user\n    configuration directory)."
+     << std::endl
+     << "  --no-library-image\n    Always parse the standard library files." << std::endl
+     << "  --lazy-globals\n    Only load the global constraint definitions that the model "
+        "uses\n    (when it includes globals.mzn)."
+     << std::endl
+     << "  --typecheck-threads <n>\n    Type check the bodies of functions and predicates using "
+        "<n> threads."
+     << std::endl
+     << "  --flatten-threads <n>\n    Flatten independent groups of constraints using up to <n> "
+        "threads."
+     << std::endl
+     << "  --no-par-bytecode\n    Evaluate par functions using the expression tree instead of "
+        "compiled\n    bytecode."
+     << std::endl
      << std::endl
      << "Flattener two-pass options:" << std::endl
      << "  --two-pass\n    Flatten twice to make better flattening decisions for the target"
@@ -136,6 +163,10 @@ void Flattener::printHelp(ostream& os) const {
      << std::endl
      << "  --output-detailed-timing\n    Output detailed profiling information of compilation time"
      << std::endl
+     << "  --output-flatten-profile <file>\n    Output a profile of the function calls made during "
+        "flattening to <file>,\n    as collapsed stacks for flame graph tools, or as JSON if <file> "
+        "ends in .json"
+     << std::endl
      << "  --output-to-stdout, --output-fzn-to-stdout\n    Print generated FlatZinc to standard "
         "output"
      << std::endl
@@ -200,6 +231,9 @@ bool Flattener::processOption(int& i, std::vector<std::string>& argv,
     _flags.outputPathsStdout = true;
   } else if (cop.getOption("--output-detailed-timing")) {
     _fopts.detailedTiming = true;
+  } else if (cop.getOption("--output-flatten-profile", &buffer)) {
+    _flagOutputFlattenProfile = FileUtils::file_path(buffer, workingDir);
+    _fopts.profileCalls = true;
   } else if (cop.getOption("--output-mode", &buffer)) {
     if (buffer == "dzn") {
       _flagOutputMode = FlatteningOptions::OUTPUT_DZN;
@@ -335,8 +369,33 @@ bool Flattener::processOption(int& i, std::vector<std::string>& argv,
     _flags.allowMultiAssign = true;
   } else if (cop.getOption("--no-half-reifications")) {
     _fopts.enableHalfReification = false;
+  } else if (cop.getOption("--compiler-memory-limit", &intBuffer)) {
+    if (intBuffer <= 0) {
+      return false;
+    }
+    _fopts.memoryLimit = static_cast<unsigned long long int>(intBuffer);
   } else if (string(argv[i]) == "--input-is-flatzinc") {
     _isFlatzinc = true;
+  } else if (cop.get("--precompile-library")) {
+    _flags.precompileLibrary = true;
+  } else if (cop.getOption("--library-image", &buffer)) {
+    _flagLibraryImage = FileUtils::file_path(buffer, workingDir);
+  } else if (cop.get("--no-library-image")) {
+    _flags.noLibraryImage = true;
+  } else if (cop.get("--lazy-globals")) {
+    _flags.lazyGlobals = true;
+  } else if (cop.getOption("--typecheck-threads", &intBuffer)) {
+    if (intBuffer <= 0) {
+      return false;
+    }
+    _flagTypecheckThreads = static_cast<unsigned int>(intBuffer);
+  } else if (cop.getOption("--flatten-threads", &intBuffer)) {
+    if (intBuffer <= 0) {
+      return false;
+    }
+    _flagFlattenThreads = static_cast<unsigned int>(intBuffer);
+  } else if (cop.getOption("--no-par-bytecode")) {
+    _fopts.parBytecode = false;
   } else if (cop.getOption("--compile-solution-checker", &buffer)) {
     if (buffer.length() >= 8 && buffer.substr(buffer.length() - 8, string::npos) == ".mzc.mzn") {
       _flags.compileSolutionCheckModel = true;
@@ -441,14 +500,371 @@ Env* Flattener::multiPassFlatten(const vector<unique_ptr<Pass> >& passes) {
   return pre_env;
 }
 
+Env* Flattener::flattenConcurrently(Env* env, CompilePassFlags& cfs) {
+  FlattenPartition partition;
+  {
+    GCLock lock;
+    if (!partition.compute(env->envi(), _flagFlattenThreads)) {
+      return nullptr;
+    }
+  }
+  if (_flags.verbose) {
+    _log << " (" << partition.groups << " groups)";
+  }
+
+  struct Group {
+    std::unique_ptr<Env> env;
+    std::ostringstream out;
+    std::ostringstream log;
+    bool ok = false;
+    bool copied = false;
+    bool done = false;
+    bool merged = false;
+    bool finished = false;
+  };
+  // The Env of group 0 is kept if flattening succeeds, its output is buffered until then
+  std::unique_ptr<std::ostream> os0(new std::ostream(nullptr));
+  std::unique_ptr<std::ostream> log0(new std::ostream(nullptr));
+  std::vector<std::unique_ptr<Group> > groups(partition.groups);
+  for (auto& g : groups) {
+    g.reset(new Group());
+  }
+  std::mutex mutex;
+  std::condition_variable cond;
+
+  // Every group copies the type checked model, so that all its expressions belong to the
+  // garbage collector of the thread that flattens it. The other groups copy it while the
+  // collector of env is shared with them, and the model of env is kept for the fallback.
+  auto copyModel = [&](unsigned int g, std::ostream& os, std::ostream& log,
+                       const GCConcurrentSection* section) {
+    Group& group = *groups[g];
+    try {
+      group.env.reset(new Env(nullptr, os, log));
+      GCLock lock;
+      std::unique_ptr<CopyMap> cm(section == nullptr ? new CopyMap() : new CopyMap(*section));
+      Model* m = copy(group.env->envi(), *cm, env->model());
+      group.env->model(m);
+      group.env->envi().copyTypeState(env->envi(), *cm);
+      if (section == nullptr) {
+        group.env->envi().warnings = env->envi().warnings;
+        group.env->envi().deprecationWarnings = env->envi().deprecationWarnings;
+      }
+    } catch (...) {
+      group.env.reset();
+    }
+  };
+  auto flattenGroup = [&](unsigned int g) {
+    Group& group = *groups[g];
+    if (group.env == nullptr) {
+      return;
+    }
+    try {
+      {
+        GCLock lock;
+        if (!partition.restrict(group.env->envi(), g)) {
+          return;
+        }
+      }
+      FlatteningOptions opts = _fopts;
+      opts.outputObjective = opts.outputObjective && g == 0;
+      CompilePassFlags gcfs = cfs;
+      gcfs.verbose = false;
+      CompilePass pass(group.env.get(), opts, gcfs, _stdLibDir + "/" + _globalsDir + "/",
+                       _includePaths, false, false);
+      if (pass.run(group.env.get(), group.log) == nullptr || group.env->envi().failed()) {
+        return;
+      }
+      GCLock lock;
+      group.ok = partition.removeForeign(group.env->envi(), g);
+    } catch (...) {
+      group.ok = false;
+    }
+  };
+
+  // Make sure no worker is left waiting for the merge, and all of them have released
+  // their Env before returning
+  class Release {
+  public:
+    std::vector<std::unique_ptr<Group> >& groups;
+    std::mutex& mutex;
+    std::condition_variable& cond;
+    Release(std::vector<std::unique_ptr<Group> >& groups0, std::mutex& mutex0,
+            std::condition_variable& cond0)
+        : groups(groups0), mutex(mutex0), cond(cond0) {}
+    ~Release() {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (auto& g : groups) {
+        g->merged = true;
+      }
+      cond.notify_all();
+      cond.wait(lock, [this] {
+        for (unsigned int i = 1; i < groups.size(); i++) {
+          if (!groups[i]->finished) {
+            return false;
+          }
+        }
+        return true;
+      });
+    }
+  } release(groups, mutex, cond);
+
+  unsigned long long int timeout = _fopts.timeout;
+  unsigned long long int memoryLimit = _fopts.memoryLimit;
+  {
+    GCConcurrentSection section;
+    for (unsigned int g = 1; g < partition.groups; g++) {
+      Group* group = groups[g].get();
+      bool launched = run_flatten_job([&, g, group, timeout, memoryLimit]() {
+        GC::setTimeout(timeout);
+        GC::setMemoryLimit(static_cast<size_t>(memoryLimit * 1024 * 1024));
+        copyModel(g, group->out, group->log, &section);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          group->copied = true;
+        }
+        cond.notify_all();
+        flattenGroup(g);
+        GC::setTimeout(0);
+        GC::setMemoryLimit(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        group->done = true;
+        cond.notify_all();
+        cond.wait(lock, [group] { return group->merged; });
+        lock.unlock();
+        group->env.reset();
+        lock.lock();
+        group->finished = true;
+        cond.notify_all();
+      });
+      if (!launched) {
+        std::lock_guard<std::mutex> lock(mutex);
+        group->copied = true;
+        group->done = true;
+        group->finished = true;
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&groups] {
+      for (unsigned int i = 1; i < groups.size(); i++) {
+        if (!groups[i]->copied) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  os0->rdbuf(groups[0]->out.rdbuf());
+  log0->rdbuf(groups[0]->log.rdbuf());
+  copyModel(0, *os0, *log0, nullptr);
+  flattenGroup(0);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&groups] {
+      for (unsigned int i = 1; i < groups.size(); i++) {
+        if (!groups[i]->done) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+  // Messages of the other groups cannot be told apart from those printed by group 0
+  // (e.g. traces in variable declarations), so they are flattened sequentially
+  bool ok = true;
+  for (unsigned int g = 0; g < partition.groups; g++) {
+    ok = ok && groups[g]->ok &&
+         (g == 0 || (groups[g]->out.tellp() <= 0 && groups[g]->log.tellp() <= 0));
+  }
+  if (ok) {
+    GCLock lock;
+    std::vector<EnvI*> others;
+    for (unsigned int g = 1; g < partition.groups; g++) {
+      others.push_back(&groups[g]->env->envi());
+    }
+    ok = partition.merge(groups[0]->env->envi(), others);
+  }
+  if (!ok) {
+    if (_flags.verbose) {
+      _log << " (falling back to sequential flattening)";
+    }
+    return nullptr;
+  }
+  _os << groups[0]->out.str();
+  _log << groups[0]->log.str();
+  os0->rdbuf(_os.rdbuf());
+  log0->rdbuf(_log.rdbuf());
+  _envOs = std::move(os0);
+  _envLog = std::move(log0);
+  return groups[0]->env.release();
+}
+
+bool Flattener::instantiateBatchModel(const std::string& modelText, const std::string& modelName,
+                                      const std::string& libraryImage) {
+  if (!_batchModel->initialised) {
+    _batchModel->initialised = true;
+    std::unique_ptr<Env> env(new Env(nullptr, _os, _log));
+    std::stringstream errstream;
+    Model* m = parse(*env, _filenames, std::vector<std::string>(), modelText,
+                     modelName.empty() ? "stdin" : modelName, _includePaths, false, false, false,
+                     _flags.verbose, errstream, libraryImage, _flags.lazyGlobals);
+    if (m == nullptr) {
+      return false;
+    }
+    env->model(m);
+    env->envi().typecheckThreads = _flagTypecheckThreads;
+    // Enums that are defined in the data need a full type check for each instance
+    class CheckEnums : public ItemVisitor {
+    public:
+      bool dataEnum = false;
+      void vVarDeclI(VarDeclI* vdi) {
+        if (vdi->e()->ti()->isEnum() && vdi->e()->e() == nullptr) {
+          dataEnum = true;
+        }
+      }
+    } _ce;
+    iter_items(_ce, m);
+    if (_ce.dataEnum) {
+      return false;
+    }
+    GCLock lock;
+    std::vector<TypeError> typeErrors;
+    MiniZinc::typecheck(*env, m, typeErrors, true, _flags.allowMultiAssign);
+    if (!typeErrors.empty()) {
+      return false;
+    }
+    _batchModel->messages = errstream.str();
+    _batchModel->env = std::move(env);
+  }
+  if (_batchModel->env == nullptr) {
+    return false;
+  }
+
+  Env& bEnv = *_batchModel->env;
+  std::unique_ptr<Env> env(new Env(nullptr, _os, _log));
+  GCLock lock;
+  CopyMap cm;
+  Model* m = copy(env->envi(), cm, bEnv.model());
+  env->model(m);
+  env->envi().copyTypeState(bEnv.envi(), cm);
+  env->envi().warnings = bEnv.envi().warnings;
+  env->envi().deprecationWarnings = bEnv.envi().deprecationWarnings;
+
+  std::stringstream errstream;
+  Model* data = parse_data(*env, new Model, _datafiles, _includePaths, false, true, false,
+                           _flags.verbose, errstream);
+  bool bound = data != nullptr && typecheck_data(*env, m, data);
+  delete data;
+  if (!bound) {
+    return false;
+  }
+  _log << _batchModel->messages;
+  _pEnv = std::move(env);
+  return true;
+}
+
+bool Flattener::instantiateLibraryModel(const std::string& modelText,
+                                        const std::string& modelName,
+                                        const std::string& libraryImage) {
+  if (_libraryModel->initialised && _libraryModel->includePaths != _includePaths) {
+    // Compiled for a different solver library
+    _libraryModel->env.reset();
+    _libraryModel->files.clear();
+    _libraryModel->initialised = false;
+  }
+  if (!_libraryModel->initialised) {
+    _libraryModel->initialised = true;
+    _libraryModel->includePaths = _includePaths;
+    std::unique_ptr<Env> env(new Env(nullptr, _os, _log));
+    std::stringstream errstream;
+    std::vector<std::string> files;
+    Model* m =
+        parse_library(*env, _includePaths, _flags.verbose, errstream, libraryImage, files);
+    if (m == nullptr) {
+      return false;
+    }
+    env->model(m);
+    env->envi().typecheckThreads = _flagTypecheckThreads;
+    GCLock lock;
+    std::vector<TypeError> typeErrors;
+    // Par versions of the library functions depend on the model, and are created for each model
+    MiniZinc::typecheck(*env, m, typeErrors, true, false, false, false);
+    if (!typeErrors.empty()) {
+      return false;
+    }
+    // Library parameters left undefined can still be assigned by each model
+    class ResetUndefined : public ItemVisitor {
+    public:
+      static void vVarDeclI(VarDeclI* vdi) {
+        if (vdi->e()->ann().contains(constants().ann.mzn_was_undefined)) {
+          vdi->e()->e(nullptr);
+          vdi->e()->ann().remove(constants().ann.mzn_was_undefined);
+        }
+      }
+    } _ru;
+    iter_items(_ru, m);
+    _libraryModel->messages = errstream.str();
+    _libraryModel->files = std::move(files);
+    _libraryModel->env = std::move(env);
+  }
+  if (_libraryModel->env == nullptr) {
+    return false;
+  }
+
+  Env& lEnv = *_libraryModel->env;
+  std::unique_ptr<Env> env(new Env(nullptr, _os, _log));
+  GCLock lock;
+  CopyMap cm;
+  cm.reserve(_libraryModel->copySize);
+  Model* lib = copy(env->envi(), cm, lEnv.model());
+  _libraryModel->copySize = cm.size();
+  env->envi().copyTypeState(lEnv.envi(), cm);
+  env->envi().warnings = lEnv.envi().warnings;
+  env->envi().deprecationWarnings = lEnv.envi().deprecationWarnings;
+  env->envi().typecheckThreads = _flagTypecheckThreads;
+  for (auto& fi : lib->functions()) {
+    env->envi().checkedFunctions.insert(&fi);
+  }
+
+  std::stringstream errstream;
+  Model* m = parse(*env, lib, _libraryModel->files, _filenames, _datafiles, modelText,
+                   modelName.empty() ? "stdin" : modelName, _includePaths, false, false,
+                   _flags.verbose, errstream, _flags.lazyGlobals);
+  if (m == nullptr) {
+    return false;
+  }
+  env->model(m);
+  std::vector<TypeError> typeErrors;
+  try {
+    MiniZinc::typecheck(*env, m, typeErrors, false, _flags.allowMultiAssign);
+  } catch (Exception&) {
+    return false;
+  }
+  if (!typeErrors.empty() || !check_library_overloading(*env, env->model())) {
+    return false;
+  }
+
+  _log << _libraryModel->messages << errstream.str();
+  _pEnv = std::move(env);
+  return true;
+}
+
 class FlattenTimeout {
 public:
   FlattenTimeout(unsigned long long int t) { GC::setTimeout(t); }
   ~FlattenTimeout() { GC::setTimeout(0); }
 };
 
+class FlattenMemoryLimit {
+public:
+  FlattenMemoryLimit(unsigned long long int m) {
+    GC::setMemoryLimit(static_cast<size_t>(m * 1024 * 1024));
+  }
+  ~FlattenMemoryLimit() { GC::setMemoryLimit(0); }
+};
+
 void Flattener::flatten(const std::string& modelString, const std::string& modelName) {
   FlattenTimeout flatten_timeout(_fopts.timeout);
+  FlattenMemoryLimit flatten_memory_limit(_fopts.memoryLimit);
   Timer flatten_time;
   _starttime.reset();
 
@@ -462,7 +878,8 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
     _flagSolutionCheckModel = "";
   }
 
-  if (_filenames.empty() && !_flags.stdinInput && modelString.empty()) {
+  if (_filenames.empty() && !_flags.stdinInput && modelString.empty() &&
+      !_flags.precompileLibrary) {
     throw Error("Error: no model file given.");
   }
 
@@ -485,6 +902,35 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
     }
   }
 
+  std::string libraryImage;
+  if (!_flags.noLibraryImage) {
+    libraryImage = _flagLibraryImage.empty() ? LibraryImage::defaultFile(_includePaths)
+                                             : _flagLibraryImage;
+  }
+  if (_flags.precompileLibrary) {
+    if (libraryImage.empty()) {
+      throw Error("Error: no file name for the library image, use --library-image <file>.");
+    }
+    if (_flagLibraryImage.empty()) {
+      std::string cacheDir = FileUtils::dir_name(libraryImage);
+      FileUtils::create_directory(FileUtils::dir_name(cacheDir));
+      FileUtils::create_directory(cacheDir);
+    }
+    if (_flags.verbose) {
+      _log << "Precompiling library into " << libraryImage << " ..." << std::endl;
+    }
+    std::stringstream errstream;
+    if (!precompile_library(_includePaths, libraryImage, _flags.verbose, errstream)) {
+      throw Error(errstream.str());
+    }
+    _log << errstream.str();
+    if (_flags.verbose) {
+      _log << " done (" << _starttime.stoptime() << ")" << std::endl;
+    }
+    status = SolverInstance::NONE;
+    return;
+  }
+
   if (_flagOutputBase.empty()) {
     if (_filenames.empty()) {
       _flagOutputBase = "mznout";
@@ -653,17 +1099,38 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
       }
       _log << " ..." << std::endl;
     }
-    errstream.str("");
-    m = parse(*env, _filenames, _datafiles, modelText, modelName.empty() ? "stdin" : modelName,
-              _includePaths, _isFlatzinc, false, false, _flags.verbose, errstream);
-    if (!_globalsDir.empty()) {
-      _includePaths.erase(_includePaths.begin());
-    }
-    if (m == nullptr) {
-      throw Error(errstream.str());
+    // Instances of a data batch share the type checked model, and models compiled by a
+    // server share the type checked library, where possible
+    bool canShare = _flags.typecheck && !_isFlatzinc && !_flags.twoPass &&
+                    _flagSolutionCheckModel.empty() && !_flags.instanceCheckOnly &&
+                    !_flags.modelCheckOnly && !_flags.modelInterfaceOnly &&
+                    !_flags.modelTypesOnly;
+    bool typechecked =
+        canShare &&
+        ((_batchModel != nullptr && instantiateBatchModel(modelText, modelName, libraryImage)) ||
+         (_libraryModel != nullptr &&
+          instantiateLibraryModel(modelText, modelName, libraryImage)));
+    if (typechecked) {
+      env = getEnv();
+      m = env->model();
+      if (!_globalsDir.empty()) {
+        _includePaths.erase(_includePaths.begin());
+      }
+    } else {
+      errstream.str("");
+      m = parse(*env, _filenames, _datafiles, modelText, modelName.empty() ? "stdin" : modelName,
+                _includePaths, _isFlatzinc, false, false, _flags.verbose, errstream, libraryImage,
+                _flags.lazyGlobals);
+      if (!_globalsDir.empty()) {
+        _includePaths.erase(_includePaths.begin());
+      }
+      if (m == nullptr) {
+        throw Error(errstream.str());
+      }
+      _log << errstream.str();
+      env->model(m);
+      env->envi().typecheckThreads = _flagTypecheckThreads;
     }
-    _log << errstream.str();
-    env->model(m);
     if (_flags.typecheck) {
       if (_flags.verbose) {
         _log << " done parsing (" << _starttime.stoptime() << ")" << std::endl;
@@ -762,27 +1229,55 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
           cfs.modelCheckOnly = _flags.modelCheckOnly;
           cfs.modelInterfaceOnly = _flags.modelInterfaceOnly;
           cfs.allowMultiAssign = _flags.allowMultiAssign;
+          cfs.typechecked = typechecked;
 
-          std::vector<unique_ptr<Pass> > managed_passes;
-
-          if (_flags.twoPass) {
-            std::string library = _stdLibDir + (_flags.gecode ? "/gecode_presolver/" : "/std/");
-            bool differentLibrary = (library != _stdLibDir + "/" + _globalsDir + "/");
-            managed_passes.emplace_back(new CompilePass(env, pass_opts, cfs, library, _includePaths,
-                                                        true, differentLibrary));
-#ifdef HAS_GECODE
-            if (_flags.gecode) {
-              managed_passes.emplace_back(new GecodePass(&gopts));
+          // Independent groups of constraints can be flattened on separate threads. The
+          // model is type checked first; if it cannot be split, or flattening any of the
+          // groups fails, it is flattened sequentially below.
+          Env* out_env = nullptr;
+          if (_flagFlattenThreads > 1 && !typechecked && !_flags.twoPass &&
+              !_fopts.hasChecker && _fopts.outputMode != FlatteningOptions::OUTPUT_CHECKER &&
+              !_fopts.collectMznPaths && !_fopts.keepOutputInFzn && !_fopts.detailedTiming &&
+              !_fopts.profileCalls && !_flags.newfzn) {
+            {
+              GCLock lock;
+              vector<TypeError> typeErrors;
+              MiniZinc::typecheck(*env, m, typeErrors, false, _flags.allowMultiAssign);
+              if (!typeErrors.empty()) {
+                std::ostringstream errstream;
+                for (auto& typeError : typeErrors) {
+                  errstream << typeError.what() << ": " << typeError.msg() << std::endl;
+                  errstream << typeError.loc() << std::endl;
+                }
+                throw Error(errstream.str());
+              }
             }
-#endif
+            cfs.typechecked = true;
+            out_env = flattenConcurrently(env, cfs);
           }
-          managed_passes.emplace_back(new CompilePass(env, _fopts, cfs,
-                                                      _stdLibDir + "/" + _globalsDir + "/",
-                                                      _includePaths, _flags.twoPass, false));
 
-          Env* out_env = multiPassFlatten(managed_passes);
           if (out_env == nullptr) {
-            exit(EXIT_FAILURE);
+            std::vector<unique_ptr<Pass> > managed_passes;
+
+            if (_flags.twoPass) {
+              std::string library = _stdLibDir + (_flags.gecode ? "/gecode_presolver/" : "/std/");
+              bool differentLibrary = (library != _stdLibDir + "/" + _globalsDir + "/");
+              managed_passes.emplace_back(new CompilePass(env, pass_opts, cfs, library,
+                                                          _includePaths, true, differentLibrary));
+#ifdef HAS_GECODE
+              if (_flags.gecode) {
+                managed_passes.emplace_back(new GecodePass(&gopts));
+              }
+#endif
+            }
+            managed_passes.emplace_back(new CompilePass(env, _fopts, cfs,
+                                                        _stdLibDir + "/" + _globalsDir + "/",
+                                                        _includePaths, _flags.twoPass, false));
+
+            out_env = multiPassFlatten(managed_passes);
+            if (out_env == nullptr) {
+              exit(EXIT_FAILURE);
+            }
           }
 
           if (out_env != env) {
@@ -854,6 +1349,20 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
           }
 
           _os << "%%%mzn-stat: flatTime=" << flatten_time.s() << endl;
+          if (env->model() != nullptr) {
+            _os << "%%%mzn-stat: fnDispatchCacheHits=" << env->model()->dispatchCacheHits() << endl;
+            _os << "%%%mzn-stat: fnDispatchCacheMisses=" << env->model()->dispatchCacheMisses()
+                << endl;
+          }
+          const CSEMap& cse = env->envi().cseMap();
+          _os << "%%%mzn-stat: cseHits=" << cse.hits() << endl;
+          _os << "%%%mzn-stat: cseMisses=" << cse.misses() << endl;
+          _os << "%%%mzn-stat: cseCollisions=" << cse.collisions() << endl;
+          const ParBytecode& pb = env->envi().parBytecode;
+          _os << "%%%mzn-stat: parBytecodeFunctions=" << pb.compiled() << endl;
+          _os << "%%%mzn-stat: parBytecodeCalls=" << pb.calls() << endl;
+          _os << "%%%mzn-stat: parBytecodeFallbacks=" << pb.fallbacks() << endl;
+          GC::printStatistics(_os);
           _os << "%%%mzn-stat-end" << endl << endl;
         }
 
@@ -881,6 +1390,27 @@ void Flattener::flatten(const std::string& modelString, const std::string& model
           }
         }
 
+        if (!_flagOutputFlattenProfile.empty() && env->envi().profiler != nullptr) {
+          if (_flags.verbose) {
+            _log << "Printing flattening profile to '" << _flagOutputFlattenProfile << "' ..."
+                 << std::flush;
+          }
+          const std::string& profileFile = _flagOutputFlattenProfile;
+          std::ofstream ofs(FILE_PATH(profileFile), ios::out);
+          check_io_status(ofs.good(), " I/O error: cannot open profile output file. ");
+          if (profileFile.size() >= 5 &&
+              profileFile.compare(profileFile.size() - 5, 5, ".json") == 0) {
+            env->envi().profiler->writeJSON(ofs);
+          } else {
+            env->envi().profiler->writeCollapsed(ofs);
+          }
+          check_io_status(ofs.good(), " I/O error: cannot write profile output file. ");
+          ofs.close();
+          if (_flags.verbose) {
+            _log << " done (" << _starttime.stoptime() << ")" << std::endl;
+          }
+        }
+
         if ((_fopts.collectMznPaths || _flags.twoPass) && !_flags.keepMznPaths) {
           class RemovePathAnnotations : public ItemVisitor {
           public:
@@ -16,9 +16,17 @@
 #include <minizinc/model.hh>
 #include <minizinc/timer.hh>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <iostream>
+#include <sstream>
 #include <vector>
 
+#ifdef HAS_MMAP
+#include <sys/mman.h>
+#endif
+
 namespace MiniZinc {
 
 GC*& GC::gc() {
@@ -32,6 +40,14 @@ GC*& GC::gc() {
   return gc;
 }
 
+GC* GC::current() {
+  GC*& g = gc();
+  if (g == nullptr) {
+    g = new GC();
+  }
+  return g;
+}
+
 bool GC::locked() {
   assert(gc());
   return gc()->_lockCount > 0;
@@ -55,25 +71,28 @@ public:
   HeapPage* next;
   size_t size;
   size_t used;
+  /// Number of bytes mapped from the operating system (0 if allocated using malloc)
+  size_t mapped;
   char data[1];
-  HeapPage(HeapPage* n, size_t s) : next(n), size(s), used(0) {}
+  HeapPage(HeapPage* n, size_t s, size_t m) : next(n), size(s), used(0), mapped(m) {}
 };
 
 /// Memory managed by the garbage collector
 class GC::Heap {
   friend class GC;
-#if defined(MINIZINC_GC_STATS)
   static const char* _nodeid[Item::II_END + 1];
+#if defined(MINIZINC_GC_STATS)
   std::map<int, GCStat> gc_stats;
 #endif
 protected:
   static const size_t _min_gcThreshold;
+  static const size_t _min_nurserySize;
 
   HeapPage* _page;
   GCMarker* _rootset;
-  KeepAlive* _roots;
-  WeakRef* _weakRefs;
-  ASTNodeWeakMap* _nodeWeakMaps;
+  GCHandleTable _roots;
+  GCHandleTable _weakRefs;
+  std::vector<ASTNodeWeakMap*> _nodeWeakMaps;
   static const int _max_fl = 5;
   FreeListNode* _fl[_max_fl + 1];
   static const size_t _fl_size[_max_fl + 1];
@@ -81,12 +100,9 @@ protected:
     size_t size = _size;
     assert(size <= _fl_size[_max_fl]);
     assert(size >= _fl_size[0]);
-    size -= sizeof(Item);
+    size -= sizeof(FreeListNode);
     assert(size % sizeof(void*) == 0);
-    size /= sizeof(void*);
-    assert(size >= 1);
-    int slot = static_cast<int>(size) - 1;
-    return slot;
+    return static_cast<int>(size / sizeof(void*));
   }
 
   /// Total amount of memory allocated
@@ -95,8 +111,43 @@ protected:
   size_t _freeMem;
   /// Memory threshold for next garbage collection
   size_t _gcThreshold;
+  /// Maximum amount of memory to allocate (0 for no limit)
+  size_t _memoryLimit;
   /// High water mark of all allocated memory
   size_t _maxAllocedMem;
+  /// Memory handed out since the last garbage collection (the nursery)
+  size_t _youngMem;
+  /// Amount of young memory to allocate before the next collection
+  size_t _nurserySize;
+  /// Amount of young memory to allocate before the next collection close to the memory limit
+  size_t _limitNurserySize;
+
+  /// Stack used for marking expressions
+  std::vector<const Expression*> _markStack;
+
+  /// A node found to be garbage during sweeping
+  struct NodeInfo {
+    ASTNode* n;
+    size_t ns;
+    NodeInfo(ASTNode* n0, size_t ns0) : n(n0), ns(ns0) {}
+  };
+  /// Garbage nodes of the page currently being swept
+  std::vector<NodeInfo> _freeNodes;
+
+  /// Number of garbage collections
+  unsigned long long int _collections;
+  /// Time spent marking (in seconds)
+  double _markTime;
+  /// Time spent sweeping (in seconds)
+  double _sweepTime;
+  /// Number of allocations served from a free list
+  unsigned long long int _flHits;
+  /// Number of free list allocations that had to use fresh memory
+  unsigned long long int _flMisses;
+  /// Number of heap pages currently allocated
+  size_t _pageCount;
+  /// Memory reclaimed from garbage nodes of each kind
+  size_t _freedMem[Item::II_END + 1];
 
   /// A trail item
   struct TItem {
@@ -111,26 +162,101 @@ protected:
   Heap()
       : _page(nullptr),
         _rootset(nullptr),
-        _roots(nullptr),
-        _weakRefs(nullptr),
-        _nodeWeakMaps(nullptr),
         _allocedMem(0),
         _freeMem(0),
         _gcThreshold(_min_gcThreshold),
-        _maxAllocedMem(0) {
+        _memoryLimit(0),
+        _maxAllocedMem(0),
+        _youngMem(0),
+        _nurserySize(_min_nurserySize),
+        _limitNurserySize(_min_nurserySize),
+        _collections(0),
+        _markTime(0.0),
+        _sweepTime(0.0),
+        _flHits(0),
+        _flMisses(0),
+        _pageCount(0) {
     for (int i = _max_fl + 1; (i--) != 0;) {
       _fl[i] = nullptr;
     }
+    for (int i = Item::II_END + 1; (i--) != 0;) {
+      _freedMem[i] = 0;
+    }
   }
 
   /// Default size of pages to allocate
   static const size_t pageSize = 1 << 20;
+  /// Size (and alignment) of pages allocated for large heaps, suitable for huge pages
+  static const size_t hugePageSize = 1 << 21;
+  /// Heap size from which huge pages are used
+  static const size_t hugePageHeapSize = 1 << 26;
+  /// Granularity of memory obtained from the operating system
+  static const size_t osPageSize = 1 << 12;
+  /// Minimum size of large objects that are mapped directly
+  static const size_t mappedObjectSize = 1 << 16;
+
+  /// Obtain \a bytes of memory from the operating system, aligned to \a align if non-zero
+  static void* mapMemory(size_t bytes, size_t align) {
+#ifdef HAS_MMAP
+    void* m = mmap(nullptr, bytes + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (m == MAP_FAILED) {
+      return nullptr;
+    }
+    if (align == 0) {
+      return m;
+    }
+    // Trim the mapping to an aligned region
+    auto start = reinterpret_cast<uintptr_t>(m);
+    uintptr_t aligned = (start + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    if (aligned > start) {
+      munmap(m, aligned - start);
+    }
+    if (start + align > aligned) {
+      munmap(reinterpret_cast<void*>(aligned + bytes), start + align - aligned);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(aligned);
+#else
+    return ::malloc(bytes);
+#endif
+  }
+  /// Return \a bytes of memory at \a m to the operating system
+  static void unmapMemory(void* m, size_t bytes) {
+#ifdef HAS_MMAP
+    munmap(m, bytes);
+#else
+    ::free(m);
+#endif
+  }
 
   HeapPage* allocPage(size_t s, bool exact = false) {
+    size_t align = 0;
+    size_t mapped;
+    if (exact) {
+      mapped = s < mappedObjectSize ? 0 : sizeof(HeapPage) + s - 1;
+    } else {
+      size_t ps = pageSize;
+      if (_allocedMem >= hugePageHeapSize) {
+        // Large heap: use pages that the operating system can back with huge pages
+        ps = hugePageSize;
+        align = hugePageSize;
+      }
+      mapped = std::max(sizeof(HeapPage) + s - 1, ps);
+    }
+    mapped = (mapped + osPageSize - 1) & ~(osPageSize - 1);
     if (!exact) {
-      s = std::max(s, pageSize);
+      // Use the whole mapping, keeping the page size word-aligned
+      s = (mapped - (sizeof(HeapPage) - 1)) & ~static_cast<size_t>(7);
+    }
+    if (_memoryLimit != 0 && _allocedMem + s > _memoryLimit) {
+      // Cannot collect while locked, so the limit is exceeded
+      memoryLimitExceeded();
     }
-    auto* newPage = static_cast<HeapPage*>(::malloc(sizeof(HeapPage) + s - 1));
+    auto* newPage = static_cast<HeapPage*>(mapped == 0 ? ::malloc(sizeof(HeapPage) + s - 1)
+                                                       : mapMemory(mapped, align));
     if (newPage == nullptr) {
       throw InternalError("out of memory");
     }
@@ -140,8 +266,9 @@ protected:
     _allocedMem += s;
     _maxAllocedMem = std::max(_maxAllocedMem, _allocedMem);
     _freeMem += s;
+    _pageCount++;
     if (exact && (_page != nullptr)) {
-      new (newPage) HeapPage(_page->next, s);
+      new (newPage) HeapPage(_page->next, s, mapped);
       _page->next = newPage;
     } else {
       if (_page != nullptr) {
@@ -159,7 +286,7 @@ protected:
           assert(_allocedMem >= _freeMem);
         }
       }
-      new (newPage) HeapPage(_page, s);
+      new (newPage) HeapPage(_page, s, mapped);
       _page = newPage;
     }
     return newPage;
@@ -204,8 +331,10 @@ protected:
       FreeListNode* p = _fl[slot];
       _fl[slot] = p->next;
       _freeMem -= size;
+      _flHits++;
       return p;
     }
+    _flMisses++;
     return alloc(size);
   }
 
@@ -216,8 +345,19 @@ protected:
               << (_gcThreshold / 1024) << "\n";
 #endif
     size_t old_free = _freeMem;
+    Timer timer;
     mark();
+    _markTime += timer.s();
+    timer.reset();
     sweep();
+    _sweepTime += timer.s();
+    _collections++;
+    // Long-lived nodes have to be marked again in every collection. To amortise
+    // that cost, size the nursery relative to the memory that survived, so that
+    // large long-lived heaps (e.g. the flat model) are not re-scanned each time a
+    // single size class runs out of free nodes.
+    _youngMem = 0;
+    _nurserySize = std::max(_min_nurserySize, (_allocedMem - _freeMem) / 4);
     // GC strategy:
     // increase threshold if either
     //   a) we haven't been able to put much on the free list (comapred to before GC), or
@@ -237,10 +377,20 @@ protected:
 #endif
   }
   void rungc() {
-    if (_allocedMem > _gcThreshold) {
+    if (_allocedMem > _gcThreshold && _youngMem > _nurserySize) {
       trigger();
+    } else if (_memoryLimit != 0 && _allocedMem + _nurserySize > _memoryLimit &&
+               _youngMem > _limitNurserySize) {
+      // Close to the memory limit: collect without waiting for a full nursery. Every
+      // collection marks all live memory, so double the wait after each of them, but
+      // keep it below half of the memory that can still be added to the heap.
+      trigger();
+      size_t headroom = _memoryLimit - std::min(_memoryLimit, _allocedMem);
+      _limitNurserySize =
+          std::max(_min_nurserySize, std::min(_limitNurserySize * 2, headroom / 2));
     }
   }
+  void memoryLimitExceeded();
   void mark();
   void sweep();
 
@@ -297,45 +447,44 @@ protected:
         break;
     }
     ns += ((8 - (ns & 7)) & 7);
-    return ns;
+    return std::max(ns, _fl_size[0]);
   }
 };
 
 const size_t GC::Heap::_min_gcThreshold = 10LL * 1024LL;
+const size_t GC::Heap::_min_nurserySize = 64LL * 1024LL;
 
-#ifdef MINIZINC_GC_STATS
 const char* GC::Heap::_nodeid[] = {
-    "FreeList      ",  // NID_FL
-    "Chunk         ",  // NID_CHUNK
-    "Vec           ",  // NID_VEC
-    "Str           ",  // NID_STR
-    "IntLit        ",  // E_INTLIT
-    "FloatLit      ",  // E_FLOATLIT
-    "SetLit        ",  // E_SETLIT
-    "BoolLit       ",  // E_BOOLLIT
-    "StringLit     ",  // E_STRINGLIT
-    "Id            ",  // E_ID
-    "AnonVar       ",  // E_ANON
-    "ArrayLit      ",  // E_ARRAYLIT
-    "ArrayAccess   ",  // E_ARRAYACCESS
-    "Comprehension ",  // E_COMP
-    "ITE           ",  // E_ITE
-    "BinOp         ",  // E_BINOP
-    "UnOp          ",  // E_UNOP
-    "Call          ",  // E_CALL
-    "VarDecl       ",  // E_VARDECL
-    "Let           ",  // E_LET
-    "TypeInst      ",  // E_TI
-    "TIId          ",  // E_TIID
-    "IncludeI      ",  // II_INC
-    "VarDeclI      ",  // II_VD
-    "AssignI       ",  // II_ASN
-    "ConstraintI   ",  // II_CON
-    "SolveI        ",  // II_SOL
-    "OutputI       ",  // II_OUT
-    "FunctionI     "   // II_FUN
+    "FreeList",       // NID_FL
+    "Chunk",          // NID_CHUNK
+    "Vec",            // NID_VEC
+    "Str",            // NID_STR
+    "IntLit",         // E_INTLIT
+    "FloatLit",       // E_FLOATLIT
+    "SetLit",         // E_SETLIT
+    "BoolLit",        // E_BOOLLIT
+    "StringLit",      // E_STRINGLIT
+    "Id",             // E_ID
+    "AnonVar",        // E_ANON
+    "ArrayLit",       // E_ARRAYLIT
+    "ArrayAccess",    // E_ARRAYACCESS
+    "Comprehension",  // E_COMP
+    "ITE",            // E_ITE
+    "BinOp",          // E_BINOP
+    "UnOp",           // E_UNOP
+    "Call",           // E_CALL
+    "VarDecl",        // E_VARDECL
+    "Let",            // E_LET
+    "TypeInst",       // E_TI
+    "TIId",           // E_TIID
+    "IncludeI",       // II_INC
+    "VarDeclI",       // II_VD
+    "AssignI",        // II_ASN
+    "ConstraintI",    // II_CON
+    "SolveI",         // II_SOL
+    "OutputI",        // II_OUT
+    "FunctionI"       // II_FUN
 };
-#endif
 
 void GC::setTimeout(unsigned long long int t) {
   if (gc() == nullptr) {
@@ -345,10 +494,47 @@ void GC::setTimeout(unsigned long long int t) {
   gc()->_timeoutTimer.reset();
 }
 
+void GC::setMemoryLimit(size_t m) {
+  if (gc() == nullptr) {
+    gc() = new GC();
+  }
+  gc()->_heap->_memoryLimit = m;
+}
+
+void GC::Heap::memoryLimitExceeded() {
+  std::ostringstream oss;
+  oss << "more than " << (_memoryLimit / (1024 * 1024)) << " Mbytes required";
+  // Disable the limit so that error handling can still allocate
+  _memoryLimit = 0;
+  if (GC::gc()->_memoryLimitHandler != nullptr) {
+    GC::gc()->_memoryLimitHandler->exceeded();
+  }
+  throw MemoryLimit(oss.str());
+}
+
+GCMemoryLimitHandler::GCMemoryLimitHandler() {
+  if (GC::gc() == nullptr) {
+    GC::gc() = new GC();
+  }
+  _prev = GC::gc()->_memoryLimitHandler;
+  GC::gc()->_memoryLimitHandler = this;
+}
+
+GCMemoryLimitHandler::~GCMemoryLimitHandler() {
+  assert(GC::gc()->_memoryLimitHandler == this);
+  GC::gc()->_memoryLimitHandler = _prev;
+}
+
 void GC::lock() {
   if (gc() == nullptr) {
     gc() = new GC();
   }
+  if (gc()->_concurrent) {
+    // Collection is disabled while the collector is shared
+    std::lock_guard<std::recursive_mutex> guard(gc()->_mutex);
+    gc()->_lockCount++;
+    return;
+  }
   // If a timeout has been specified, first check counter
   // before checking timer (counter is much cheaper, introduces
   // less overhead)
@@ -366,6 +552,7 @@ void GC::lock() {
   gc()->_lockCount++;
 }
 void GC::unlock() {
+  auto lock = gc()->concurrentLock();
   assert(locked());
   gc()->_lockCount--;
 }
@@ -378,16 +565,45 @@ void GC::trigger() {
 
 const size_t GC::Heap::pageSize;
 
+// Every node must be large enough to be turned into a FreeListNode when it is freed
 const size_t GC::Heap::_fl_size[GC::Heap::_max_fl + 1] = {
-    sizeof(Item) + 1 * sizeof(void*), sizeof(Item) + 2 * sizeof(void*),
-    sizeof(Item) + 3 * sizeof(void*), sizeof(Item) + 4 * sizeof(void*),
-    sizeof(Item) + 5 * sizeof(void*), sizeof(Item) + 6 * sizeof(void*),
+    sizeof(FreeListNode) + 0 * sizeof(void*), sizeof(FreeListNode) + 1 * sizeof(void*),
+    sizeof(FreeListNode) + 2 * sizeof(void*), sizeof(FreeListNode) + 3 * sizeof(void*),
+    sizeof(FreeListNode) + 4 * sizeof(void*), sizeof(FreeListNode) + 5 * sizeof(void*),
 };
 
-GC::GC() : _heap(new Heap()), _lockCount(0), _timeout(0), _timeoutCount(0) {}
+GC::GC()
+    : _heap(new Heap()),
+      _lockCount(0),
+      _timeout(0),
+      _timeoutCount(0),
+      _memoryLimitHandler(nullptr),
+      _locations(nullptr),
+      _interner(nullptr),
+      _constants(nullptr),
+      _concurrent(false) {}
+
+GCConcurrentSection::GCConcurrentSection() : _gc(GC::current()) {
+  assert(!_gc->_concurrent);
+  GC::lock();
+  _gc->_concurrent = true;
+}
+
+GCConcurrentSection::~GCConcurrentSection() {
+  _gc->_concurrent = false;
+  GC::unlock();
+}
+
+GCConcurrentSection::Worker::Worker(const GCConcurrentSection& s) : _prev(GC::gc()) {
+  GC::gc() = s._gc;
+}
+
+GCConcurrentSection::Worker::~Worker() { GC::gc() = _prev; }
 
 void GC::add(GCMarker* m) {
-  GC* gc = GC::gc();
+  // Registering a root may be the first use of the collector on a thread
+  GC* gc = GC::current();
+  auto lock = gc->concurrentLock();
   if (gc->_heap->_rootset != nullptr) {
     m->_rootsNext = gc->_heap->_rootset;
     m->_rootsPrev = m->_rootsNext->_rootsPrev;
@@ -400,6 +616,7 @@ void GC::add(GCMarker* m) {
 
 void GC::remove(GCMarker* m) {
   GC* gc = GC::gc();
+  auto lock = gc->concurrentLock();
   if (m->_rootsNext == m) {
     gc->_heap->_rootset = nullptr;
   } else {
@@ -412,9 +629,13 @@ void GC::remove(GCMarker* m) {
 }
 
 void* GC::alloc(size_t size) {
+  auto lock = concurrentLock();
   assert(locked());
+  // Small nodes are padded so that they can be put on a free list
+  size = std::max(size, GC::Heap::_fl_size[0]);
+  _heap->_youngMem += size;
   void* ret;
-  if (size < GC::Heap::_fl_size[0] || size > GC::Heap::_fl_size[GC::Heap::_max_fl]) {
+  if (size > GC::Heap::_fl_size[GC::Heap::_max_fl]) {
     ret = _heap->alloc(size, true);
   } else {
     ret = _heap->fl(size);
@@ -429,14 +650,16 @@ void GC::Heap::mark() {
   gc_stats.clear();
 #endif
 
-  for (KeepAlive* e = _roots; e != nullptr; e = e->next()) {
-    if (((*e)() != nullptr) && (*e)()->_gcMark == 0U) {
-      Expression::mark((*e)());
+  Location::startMark();
+
+  _roots.forEach([&](GCHandleTable::Slot& s) {
+    if (s.e->_gcMark == 0U) {
+      Expression::mark(s.e);
 #if defined(MINIZINC_GC_STATS)
-      gc_stats[(*e)()->_id].keepalive++;
+      gc_stats[s.e->_id].keepalive++;
 #endif
     }
-  }
+  });
 #if defined(MINIZINC_GC_STATS)
   std::cerr << "+";
 #endif
@@ -454,29 +677,19 @@ void GC::Heap::mark() {
     Expression::mark(_trail[i].v);
   }
 
-  bool fixPrev = false;
-  WeakRef* prevWr = nullptr;
-  for (WeakRef* wr = _weakRefs; wr != nullptr; wr = wr->next()) {
-    if (fixPrev) {
-      fixPrev = false;
-      removeWeakRef(prevWr);
-      prevWr->_n = nullptr;
-      prevWr->_p = nullptr;
-    }
-    if (((*wr)() != nullptr) && (*wr)()->_gcMark == 0U) {
-      wr->_e = nullptr;
-      wr->_valid = false;
-      fixPrev = true;
-      prevWr = wr;
+  _weakRefs.forEach([](GCHandleTable::Slot& s) {
+    if (s.e != nullptr && s.e->_gcMark == 0U) {
+      s.e = nullptr;
     }
-  }
-  if (fixPrev) {
-    removeWeakRef(prevWr);
-    prevWr->_n = nullptr;
-    prevWr->_p = nullptr;
-  }
+  });
 
-  for (ASTNodeWeakMap* wr = _nodeWeakMaps; wr != nullptr; wr = wr->next()) {
+  m = _rootset;
+  do {
+    m->clearWeak();
+    m = m->_rootsNext;
+  } while (m != _rootset);
+
+  for (ASTNodeWeakMap* wr : _nodeWeakMaps) {
     std::vector<ASTNode*> toRemove;
     for (auto n : wr->_m) {
       if (n.first->_gcMark == 0U || n.second->_gcMark == 0U) {
@@ -498,18 +711,21 @@ void GC::Heap::sweep() {
 #if defined(MINIZINC_GC_STATS)
   std::cerr << "=============== GC sweep =============\n";
 #endif
+  // The free lists are rebuilt from scratch, so that pages that only contain
+  // free nodes can be returned to the operating system
+  for (int i = _max_fl + 1; (i--) != 0;) {
+    _fl[i] = nullptr;
+  }
+  Location::sweep();
   HeapPage* p = _page;
   HeapPage* prev = nullptr;
   while (p != nullptr) {
     size_t off = 0;
     bool wholepage = true;
-    struct NodeInfo {
-      ASTNode* n;
-      size_t ns;
-      NodeInfo(ASTNode* n0, size_t ns0) : n(n0), ns(ns0) {}
-    };
-    std::vector<NodeInfo> freeNodes;
-    freeNodes.reserve(100);
+    std::vector<NodeInfo>& freeNodes = _freeNodes;
+    freeNodes.clear();
+    // Memory of nodes that were already free before this collection
+    size_t oldFree = 0;
     while (off < p->used) {
       auto* n = reinterpret_cast<ASTNode*>(p->data + off);
       size_t ns = nodesize(n);
@@ -519,7 +735,10 @@ void GC::Heap::sweep() {
       stats.first++;
       stats.total += ns;
 #endif
-      if (n->_gcMark == 0U) {
+      if (n->_id == static_cast<unsigned int>(ASTNode::NID_FL)) {
+        freeNodes.emplace_back(n, ns);
+        oldFree += ns;
+      } else if (n->_gcMark == 0U) {
         switch (static_cast<int>(n->_id)) {
           case Item::II_FUN:
             static_cast<FunctionI*>(n)->ann().~Annotation();
@@ -540,6 +759,7 @@ void GC::Heap::sweep() {
               static_cast<Expression*>(n)->ann().~Annotation();
             }
         }
+        _freedMem[n->_id] += ns;
         if (ns >= _fl_size[0] && ns <= _fl_size[_max_fl]) {
           freeNodes.emplace_back(n, ns);
         } else {
@@ -551,9 +771,7 @@ void GC::Heap::sweep() {
         stats.second++;
 #endif
         wholepage = false;
-        if (n->_id != static_cast<unsigned int>(ASTNode::NID_FL)) {
-          n->_gcMark = 0;
-        }
+        n->_gcMark = 0;
       }
       off += ns;
     }
@@ -570,11 +788,17 @@ void GC::Heap::sweep() {
       HeapPage* pf = p;
       p = p->next;
       _allocedMem -= pf->size;
+      _freeMem -= oldFree;
       if (pf->size - pf->used >= _fl_size[0]) {
         _freeMem -= (pf->size - pf->used);
       }
       assert(_allocedMem >= _freeMem);
-      ::free(pf);
+      _pageCount--;
+      if (pf->mapped == 0) {
+        ::free(pf);
+      } else {
+        unmapMemory(pf, pf->mapped);
+      }
     } else {
       for (auto ni : freeNodes) {
         auto* fln = static_cast<FreeListNode*>(ni.n);
@@ -585,6 +809,7 @@ void GC::Heap::sweep() {
         gc_stats[fln->_id].second++;
 #endif
       }
+      _freeMem -= oldFree;
       assert(_allocedMem >= _freeMem);
       prev = p;
       p = p->next;
@@ -612,16 +837,18 @@ ASTVec::ASTVec(size_t size) : ASTNode(NID_VEC), _size(size) {}
 void* ASTVec::alloc(size_t size) {
   size_t s = sizeof(ASTVec) + (size <= 2 ? 0 : size - 2) * sizeof(void*);
   s += ((8 - (s & 7)) & 7);
-  return GC::gc()->alloc(s);
+  return GC::current()->alloc(s);
 }
 
 ASTChunk::ASTChunk(size_t size, unsigned int id) : ASTNode(id), _size(size) {}
 void* ASTChunk::alloc(size_t size) {
   size_t s = sizeof(ASTChunk) + (size <= 4 ? 0 : size - 4) * sizeof(char);
   s += ((8 - (s & 7)) & 7);
-  return GC::gc()->alloc(s);
+  return GC::current()->alloc(s);
 }
 
+std::vector<const Expression*>& GC::markStack() { return gc()->_heap->_markStack; }
+
 void GC::mark() {
   GC* gc = GC::gc();
   gc->_heap->_trail.emplace_back(nullptr, nullptr);
@@ -646,143 +873,121 @@ size_t GC::maxMem() {
   return gc->_heap->_maxAllocedMem;
 }
 
-void* ASTNode::operator new(size_t size) { return GC::gc()->alloc(size); }
-
-void GC::addKeepAlive(KeepAlive* e) {
-  assert(e->_p == nullptr);
-  assert(e->_n == nullptr);
-  e->_n = GC::gc()->_heap->_roots;
-  if (GC::gc()->_heap->_roots != nullptr) {
-    GC::gc()->_heap->_roots->_p = e;
+void GC::printStatistics(std::ostream& os) {
+  if (GC::gc() == nullptr) {
+    return;
   }
-  GC::gc()->_heap->_roots = e;
-}
-void GC::removeKeepAlive(KeepAlive* e) {
-  if (e->_p != nullptr) {
-    e->_p->_n = e->_n;
-  } else {
-    assert(GC::gc()->_heap->_roots == e);
-    GC::gc()->_heap->_roots = e->_n;
+  Heap* h = GC::gc()->_heap;
+  // Every node ever allocated has either been reclaimed by a collection or is
+  // still on the heap, so the live nodes complete the per-kind totals
+  size_t allocated[Item::II_END + 1];
+  std::copy(h->_freedMem, h->_freedMem + Item::II_END + 1, allocated);
+  for (HeapPage* p = h->_page; p != nullptr; p = p->next) {
+    size_t off = 0;
+    while (off < p->used) {
+      auto* n = reinterpret_cast<ASTNode*>(p->data + off);
+      size_t ns = Heap::nodesize(n);
+      if (n->_id != ASTNode::NID_FL) {
+        allocated[n->_id] += ns;
+      }
+      off += ns;
+    }
   }
-  if (e->_n != nullptr) {
-    e->_n->_p = e->_p;
+  unsigned long long int flRequests = h->_flHits + h->_flMisses;
+  os << "%%%mzn-stat: gcCollections=" << h->_collections << std::endl
+     << "%%%mzn-stat: gcMarkTime=" << h->_markTime << std::endl
+     << "%%%mzn-stat: gcSweepTime=" << h->_sweepTime << std::endl
+     << "%%%mzn-stat: gcPages=" << h->_pageCount << std::endl
+     << "%%%mzn-stat: gcMemory=" << h->_allocedMem << std::endl
+     << "%%%mzn-stat: gcMaxMemory=" << h->_maxAllocedMem << std::endl
+     << "%%%mzn-stat: gcFreeListHitRate="
+     << (flRequests == 0 ? 0.0
+                         : static_cast<double>(h->_flHits) / static_cast<double>(flRequests))
+     << std::endl
+     << "%%%mzn-stat: gcKeepAlives=" << h->_roots.size() << std::endl
+     << "%%%mzn-stat: gcWeakRefs=" << h->_weakRefs.size() << std::endl
+     << "%%%mzn-stat: gcLocations=" << Location::tableSize() << std::endl;
+  for (int i = ASTNode::NID_FL + 1; i <= Item::II_END; i++) {
+    if (allocated[i] != 0) {
+      os << "%%%mzn-stat: gcAllocated" << Heap::_nodeid[i] << "=" << allocated[i] << std::endl;
+    }
   }
 }
 
-KeepAlive::KeepAlive(Expression* e) : _e(e), _p(nullptr), _n(nullptr) {
-  if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->addKeepAlive(this);
-  }
-}
-KeepAlive::~KeepAlive() {
-  if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->removeKeepAlive(this);
-  }
-}
-KeepAlive::KeepAlive(const KeepAlive& e) : _e(e._e), _p(nullptr), _n(nullptr) {
-  if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->addKeepAlive(this);
+void* ASTNode::operator new(size_t size) { return GC::current()->alloc(size); }
+
+GCHandleTable::~GCHandleTable() {
+  for (auto* c : _chunks) {
+    delete[] c;
   }
 }
-KeepAlive& KeepAlive::operator=(const KeepAlive& e) {
-  if (this != &e) {
-    if ((_e != nullptr) && !_e->isUnboxedVal()) {
-      if (e._e == nullptr || e._e->isUnboxedVal()) {
-        GC::gc()->removeKeepAlive(this);
-        _p = _n = nullptr;
-      }
-    } else {
-      if (e._e != nullptr && !e._e->isUnboxedVal()) {
-        GC::gc()->addKeepAlive(this);
-      }
+
+GCHandleTable::Slot* GCHandleTable::acquire(Expression* e) {
+  Slot* s;
+  if (!_free.empty()) {
+    s = _free.back();
+    _free.pop_back();
+  } else {
+    if (_lastUsed == _chunkSize) {
+      _chunks.push_back(new Slot[_chunkSize]);
+      _lastUsed = 0;
     }
-    _e = e._e;
+    s = &_chunks.back()[_lastUsed++];
   }
-  return *this;
+  s->e = e;
+  s->refs = 1;
+  return s;
 }
 
-void GC::addWeakRef(WeakRef* e) {
-  assert(e->_p == nullptr);
-  assert(e->_n == nullptr);
-  e->_n = GC::gc()->_heap->_weakRefs;
-  if (GC::gc()->_heap->_weakRefs != nullptr) {
-    GC::gc()->_heap->_weakRefs->_p = e;
-  }
-  GC::gc()->_heap->_weakRefs = e;
+GCHandleTable::Slot* GC::addKeepAlive(Expression* e) {
+  auto lock = gc()->concurrentLock();
+  return gc()->_heap->_roots.acquire(e);
 }
-void GC::removeWeakRef(MiniZinc::WeakRef* e) {
-  if (e->_p != nullptr) {
-    e->_p->_n = e->_n;
-  } else {
-    assert(GC::gc()->_heap->_weakRefs == e);
-    GC::gc()->_heap->_weakRefs = e->_n;
-  }
-  if (e->_n != nullptr) {
-    e->_n->_p = e->_p;
-  }
+void GC::removeKeepAlive(GCHandleTable::Slot* s) {
+  auto lock = gc()->concurrentLock();
+  gc()->_heap->_roots.release(s);
+}
+GCHandleTable::Slot* GC::addWeakRef(Expression* e) {
+  auto lock = gc()->concurrentLock();
+  return gc()->_heap->_weakRefs.acquire(e);
+}
+void GC::removeWeakRef(GCHandleTable::Slot* s) {
+  auto lock = gc()->concurrentLock();
+  gc()->_heap->_weakRefs.release(s);
 }
+
 void GC::addNodeWeakMap(ASTNodeWeakMap* m) {
-  assert(m->_p == nullptr);
-  assert(m->_n == nullptr);
-  m->_n = GC::gc()->_heap->_nodeWeakMaps;
-  if (GC::gc()->_heap->_nodeWeakMaps != nullptr) {
-    GC::gc()->_heap->_nodeWeakMaps->_p = m;
-  }
-  GC::gc()->_heap->_nodeWeakMaps = m;
+  auto lock = gc()->concurrentLock();
+  std::vector<ASTNodeWeakMap*>& maps = gc()->_heap->_nodeWeakMaps;
+  m->_idx = maps.size();
+  maps.push_back(m);
 }
 void GC::removeNodeWeakMap(ASTNodeWeakMap* m) {
-  if (m->_p != nullptr) {
-    m->_p->_n = m->_n;
-  } else {
-    assert(GC::gc()->_heap->_nodeWeakMaps == m);
-    GC::gc()->_heap->_nodeWeakMaps = m->_n;
-  }
-  if (m->_n != nullptr) {
-    m->_n->_p = m->_p;
-  }
+  auto lock = gc()->concurrentLock();
+  std::vector<ASTNodeWeakMap*>& maps = gc()->_heap->_nodeWeakMaps;
+  assert(maps[m->_idx] == m);
+  maps[m->_idx] = maps.back();
+  maps[m->_idx]->_idx = m->_idx;
+  maps.pop_back();
 }
 
-WeakRef::WeakRef(Expression* e) : _e(e), _p(nullptr), _n(nullptr), _valid(true) {
+KeepAlive::KeepAlive(Expression* e) : _e(e), _s(nullptr) {
   if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->addWeakRef(this);
+    _s = GC::addKeepAlive(_e);
   }
 }
-WeakRef::~WeakRef() {
-  if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->removeWeakRef(this);
-  }
-}
-WeakRef::WeakRef(const WeakRef& e) : _e(e()), _p(nullptr), _n(nullptr), _valid(true) {
-  if ((_e != nullptr) && !_e->isUnboxedVal()) {
-    GC::gc()->addWeakRef(this);
-  }
-}
-WeakRef& WeakRef::operator=(const WeakRef& e) {
-  if (this != &e) {
-    // Test if this WeakRef is currently active in the GC
-    bool isActive = ((_e != nullptr) && !_e->isUnboxedVal());
-    if (isActive) {
-      // Yes, active WeakRef.
-      // If after assigning WeakRef should be inactive, remove it.
-      if (e() == nullptr || e()->isUnboxedVal()) {
-        GC::gc()->removeWeakRef(this);
-        _n = _p = nullptr;
-      }
-    }
-    _e = e();
-    _valid = true;
 
-    // If this WeakRef was not active but now should be, add it
-    if (!isActive && _e != nullptr && !_e->isUnboxedVal()) {
-      GC::gc()->addWeakRef(this);
-    }
+WeakRef::WeakRef(Expression* e) : _e(nullptr), _s(nullptr) {
+  if ((e != nullptr) && !e->isUnboxedVal()) {
+    _s = GC::addWeakRef(e);
+  } else {
+    _e = e;
   }
-  return *this;
 }
 
-ASTNodeWeakMap::ASTNodeWeakMap() : _p(nullptr), _n(nullptr) { GC::gc()->addNodeWeakMap(this); }
+ASTNodeWeakMap::ASTNodeWeakMap() : _idx(0) { GC::addNodeWeakMap(this); }
 
-ASTNodeWeakMap::~ASTNodeWeakMap() { GC::gc()->removeNodeWeakMap(this); }
+ASTNodeWeakMap::~ASTNodeWeakMap() { GC::removeNodeWeakMap(this); }
 
 void ASTNodeWeakMap::insert(ASTNode* n0, ASTNode* n1) { _m.insert(std::make_pair(n0, n1)); }
 
@@ -13,7 +13,12 @@
 #include <minizinc/iter.hh>
 #include <minizinc/json_parser.hh>
 
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include <utility>
 
@@ -31,11 +36,11 @@ protected:
 public:
   Token() : t(T_EOF) {}
   std::string s;
-  int i;
+  long long int i;
   double d;
   bool b;
   Token(std::string s0) : t(T_STRING), s(std::move(s0)) {}
-  Token(int i0) : t(T_INT), i(i0), d(i0) {}
+  Token(long long int i0) : t(T_INT), i(i0), d(static_cast<double>(i0)) {}
   Token(double d0) : t(T_FLOAT), d(d0) {}
   Token(bool b0) : t(T_BOOL), i(static_cast<int>(b0)), d(static_cast<double>(b0)), b(b0) {}
   static Token listOpen() { return Token(T_LIST_OPEN); }
@@ -88,179 +93,259 @@ Location JSONParser::errLocation() const {
   return loc;
 }
 
-JSONParser::Token JSONParser::readToken(istream& is) {
-  string result;
-  char buf[1];
-  enum { S_NOTHING, S_STRING, S_STRING_ESCAPE, S_INT, S_FLOAT } state;
-  state = S_NOTHING;
-  while (is.good()) {
-    is.read(buf, sizeof(buf));
-    _column += sizeof(buf);
-    if (is.eof()) {
+void JSONParser::initInput(const char* data, size_t size) {
+  _pos = data;
+  _end = data + size;
+  _is = nullptr;
+  _line = 0;
+  _column = 0;
+}
+
+void JSONParser::initInput(std::istream& is) {
+  _chunk.resize(1 << 20);
+  _pos = _chunk.data();
+  _end = _pos;
+  _is = &is;
+  _line = 0;
+  _column = 0;
+}
+
+bool JSONParser::refill() {
+  if (_is == nullptr || !_is->good()) {
+    return false;
+  }
+  size_t keep = _end - _pos;
+  if (keep * 2 > _chunk.size()) {
+    // The current token fills most of the buffer, so grow it
+    std::vector<char> bigger(keep * 2);
+    std::memcpy(bigger.data(), _pos, keep);
+    _chunk.swap(bigger);
+  } else if (keep > 0) {
+    std::memmove(_chunk.data(), _pos, keep);
+  }
+  _is->read(_chunk.data() + keep, static_cast<std::streamsize>(_chunk.size() - keep));
+  auto n = static_cast<size_t>(_is->gcount());
+  _pos = _chunk.data();
+  _end = _pos + keep + n;
+  return n > 0;
+}
+
+JSONParser::Token JSONParser::readToken() {
+  for (;;) {
+    if (_pos == _end && !refill()) {
       return Token::eof();
     }
-    if (!is.good()) {
-      throw JSONError(_env, errLocation(), "tokenization failed");
+    char c = *_pos;
+    switch (c) {
+      case '\n':
+        _line++;
+        _column = 0;
+        _pos++;
+        continue;
+      case ' ':
+      case '\t':
+      case '\r':
+        _column++;
+        _pos++;
+        continue;
+      case '"':
+        return readString();
+      case 't':
+        expectKeyword("true", 4);
+        return Token(true);
+      case 'f':
+        expectKeyword("false", 5);
+        return Token(false);
+      case 'n':
+        expectKeyword("null", 4);
+        return Token::null();
+      default:
+        break;
     }
-    switch (state) {
-      case S_NOTHING:
-        switch (buf[0]) {
-          case '\n':
-            _line++;
-            _column = 0;
-            // fall through
-          case ' ':
-          case '\t':
-          case '\r':
-            break;
-          case '[':
-            return Token::listOpen();
-          case ']':
-            return Token::listClose();
-          case '{':
-            return Token::objOpen();
-          case '}':
-            return Token::objClose();
-          case ',':
-            return Token::comma();
-          case ':':
-            return Token::colon();
-          case '"':
-            result = "";
-            state = S_STRING;
-            break;
-          case 't': {
-            char rest[3];
-            is.read(rest, sizeof(rest));
-            _column += sizeof(rest);
-            if (!is.good() || std::strncmp(rest, "rue", 3) != 0) {
-              throw JSONError(_env, errLocation(), "unexpected token `" + string(rest) + "'");
-            }
-            state = S_NOTHING;
-            return Token(true);
-          } break;
-          case 'f': {
-            char rest[4];
-            is.read(rest, sizeof(rest));
-            _column += sizeof(rest);
-            if (!is.good() || std::strncmp(rest, "alse", 4) != 0) {
-              throw JSONError(_env, errLocation(), "unexpected token `" + string(rest) + "'");
-            }
-            state = S_NOTHING;
-            return Token(false);
-          } break;
-          case 'n': {
-            char rest[3];
-            is.read(rest, sizeof(rest));
-            _column += sizeof(rest);
-            if (!is.good() || std::strncmp(rest, "ull", 3) != 0) {
-              throw JSONError(_env, errLocation(), "unexpected token `" + string(rest) + "'");
-            }
-            state = S_NOTHING;
-            return Token::null();
-          } break;
-          default:
-            if ((buf[0] >= '0' && buf[0] <= '9') || (buf[0] == '-')) {
-              result = buf[0];
-              state = S_INT;
-            } else {
-              throw JSONError(_env, errLocation(), "unexpected token `" + string(1, buf[0]) + "'");
-            }
-            break;
-        }
+    if ((c >= '0' && c <= '9') || c == '-') {
+      return readNumber();
+    }
+    _column++;
+    _pos++;
+    switch (c) {
+      case '[':
+        return Token::listOpen();
+      case ']':
+        return Token::listClose();
+      case '{':
+        return Token::objOpen();
+      case '}':
+        return Token::objClose();
+      case ',':
+        return Token::comma();
+      case ':':
+        return Token::colon();
+      default:
+        throw JSONError(_env, errLocation(), "unexpected token `" + string(1, c) + "'");
+    }
+  }
+}
+
+void JSONParser::expectKeyword(const char* kw, size_t len) {
+  size_t n = 1;
+  while (n < len && available(n) && _pos[n] == kw[n]) {
+    n++;
+  }
+  if (n < len) {
+    while (n < len && available(n)) {
+      n++;
+    }
+    string rest(_pos + 1, n - 1);
+    _column += static_cast<int>(n);
+    _pos += n;
+    throw JSONError(_env, errLocation(), "unexpected token `" + rest + "'");
+  }
+  _column += static_cast<int>(len);
+  _pos += len;
+}
+
+JSONParser::Token JSONParser::readString() {
+  // precondition: *_pos is the opening quote
+  string result;
+  size_t i = 1;
+  for (;;) {
+    if (!available(i)) {
+      _column += static_cast<int>(i);
+      _pos += i;
+      throw JSONError(_env, errLocation(), "unexpected end of file in string");
+    }
+    const char* start = _pos + i;
+    const char* p = start;
+    while (p != _end && *p != '"' && *p != '\\') {
+      ++p;
+    }
+    result.append(start, p);
+    i = p - _pos;
+    if (p == _end) {
+      continue;
+    }
+    if (*p == '"') {
+      _column += static_cast<int>(i + 1);
+      _pos += i + 1;
+      return Token(std::move(result));
+    }
+    // escape sequence
+    if (!available(i + 1)) {
+      continue;
+    }
+    char e = _pos[i + 1];
+    switch (e) {
+      case 'n':
+        result += '\n';
         break;
-      case S_STRING_ESCAPE:
-        switch (buf[0]) {
-          case 'n':
-            result += "\n";
-            break;
-          case 't':
-            result += "\t";
-            break;
-          case '"':
-            result += "\"";
-            break;
-          case '\\':
-            result += "\\";
-            break;
-          default:
-            result += "\\";
-            result += buf[0];
-            break;
-        }
-        state = S_STRING;
+      case 't':
+        result += '\t';
         break;
-      case S_STRING:
-        if (buf[0] == '"') {
-          state = S_NOTHING;
-          return Token(result);
-        }
-        if (buf[0] == '\\') {
-          state = S_STRING_ESCAPE;
-        } else {
-          result += buf[0];
-        }
+      case '"':
+        result += '"';
         break;
-      case S_INT:
-        if (buf[0] == '.') {
-          result += buf[0];
-          state = S_FLOAT;
-        } else if (buf[0] >= '0' && buf[0] <= '9') {
-          result += buf[0];
-        } else {
-          is.unget();
-          std::istringstream iss(result);
-          int v;
-          iss >> v;
-          state = S_NOTHING;
-          return Token(v);
-        }
+      case '\\':
+        result += '\\';
         break;
-      case S_FLOAT:
-        if (buf[0] >= '0' && buf[0] <= '9') {
-          result += buf[0];
-        } else {
-          is.unget();
-          std::istringstream iss(result);
-          double v;
-          iss >> v;
-          state = S_NOTHING;
-          return Token(v);
-        }
+      default:
+        result += '\\';
+        result += e;
         break;
     }
+    i += 2;
+  }
+}
+
+JSONParser::Token JSONParser::readNumber() {
+  // precondition: *_pos is a digit or a minus sign
+  size_t i = _pos[0] == '-' ? 1 : 0;
+  size_t firstDigit = i;
+  while (available(i) && _pos[i] >= '0' && _pos[i] <= '9') {
+    i++;
+  }
+  size_t lastDigit = i;
+  bool isFloat = false;
+  if (available(i) && _pos[i] == '.') {
+    isFloat = true;
+    i++;
+    while (available(i) && _pos[i] >= '0' && _pos[i] <= '9') {
+      i++;
+    }
+  }
+  if (available(i) && (_pos[i] == 'e' || _pos[i] == 'E')) {
+    isFloat = true;
+    i++;
+    if (available(i) && (_pos[i] == '+' || _pos[i] == '-')) {
+      i++;
+    }
+    while (available(i) && _pos[i] >= '0' && _pos[i] <= '9') {
+      i++;
+    }
+  }
+  const char* text = _pos;
+  _column += static_cast<int>(i);
+  _pos += i;
+  if (lastDigit == firstDigit) {
+    throw JSONError(_env, errLocation(), "unexpected token `" + string(text, i) + "'");
   }
-  if (result.empty()) {
-    // EOF
-    return Token();
+  if (!isFloat) {
+    long long v = 0;
+    for (size_t j = firstDigit; j < lastDigit; j++) {
+      int d = text[j] - '0';
+      if (v > (std::numeric_limits<long long>::max() - d) / 10) {
+        throw JSONError(_env, errLocation(), "integer literal out of range");
+      }
+      v = v * 10 + d;
+    }
+    return Token(firstDigit == 1 ? -v : v);
   }
-  throw JSONError(_env, errLocation(), "unexpected token `" + string(result) + "'");
+  // strtod needs a null-terminated string, numbers are short so copy to the stack
+  char buf[64];
+  std::string longText;
+  const char* s = buf;
+  if (i < sizeof(buf)) {
+    std::memcpy(buf, text, i);
+    buf[i] = '\0';
+  } else {
+    longText.assign(text, i);
+    s = longText.c_str();
+  }
+  char* endptr;
+  errno = 0;
+  double v = std::strtod(s, &endptr);
+  if (endptr != s + i) {
+    throw JSONError(_env, errLocation(), "unexpected token `" + string(s) + "'");
+  }
+  if (errno == ERANGE && (v == HUGE_VAL || v == -HUGE_VAL)) {
+    throw JSONError(_env, errLocation(), "float literal out of range");
+  }
+  return Token(v);
 }
 
-void JSONParser::expectToken(istream& is, JSONParser::TokenT t) {
-  Token rt = readToken(is);
+void JSONParser::expectToken(JSONParser::TokenT t) {
+  Token rt = readToken();
   if (rt.t != t) {
     throw JSONError(_env, errLocation(), "unexpected token");
   }
 }
 
-string JSONParser::expectString(istream& is) {
-  Token rt = readToken(is);
+string JSONParser::expectString() {
+  Token rt = readToken();
   if (rt.t != T_STRING) {
     throw JSONError(_env, errLocation(), "unexpected token, expected string");
   }
   return rt.s;
 }
 
-void JSONParser::expectEof(istream& is) {
-  Token rt = readToken(is);
+void JSONParser::expectEof() {
+  Token rt = readToken();
   if (rt.t != T_EOF) {
     throw JSONError(_env, errLocation(), "unexpected token, expected end of file");
   }
 }
 
-JSONParser::Token JSONParser::parseEnumString(istream& is) {
-  Token next = readToken(is);
+JSONParser::Token JSONParser::parseEnumString() {
+  Token next = readToken();
   if (next.t != T_STRING) {
     throw JSONError(_env, errLocation(), "invalid enum object");
   }
@@ -276,18 +361,18 @@ JSONParser::Token JSONParser::parseEnumString(istream& is) {
   return next;
 }
 
-Expression* JSONParser::parseObject(istream& is, bool possibleString) {
+Expression* JSONParser::parseObject(bool possibleString) {
   // precondition: found T_OBJ_OPEN
-  Token objid = readToken(is);
+  Token objid = readToken();
   if (objid.t != T_STRING) {
     throw JSONError(_env, errLocation(), "invalid object");
   }
-  expectToken(is, T_COLON);
+  expectToken(T_COLON);
   if (objid.s == "set") {
-    expectToken(is, T_LIST_OPEN);
+    expectToken(T_LIST_OPEN);
     vector<Token> elems;
     TokenT listT = T_COLON;  // dummy marker
-    for (Token next = readToken(is); next.t != T_LIST_CLOSE; next = readToken(is)) {
+    for (Token next = readToken(); next.t != T_LIST_CLOSE; next = readToken()) {
       switch (next.t) {
         case T_COMMA:
           break;
@@ -330,13 +415,13 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
             throw JSONError(_env, errLocation(), "invalid set literal");
           }
           listT = T_OBJ_OPEN;
-          Token enumid = readToken(is);
+          Token enumid = readToken();
           if (enumid.t != T_STRING || enumid.s != "e") {
             throw JSONError(_env, errLocation(), "invalid enum object");
           }
-          expectToken(is, T_COLON);
-          Token next = parseEnumString(is);
-          expectToken(is, T_OBJ_CLOSE);
+          expectToken(T_COLON);
+          Token next = parseEnumString();
+          expectToken(T_OBJ_CLOSE);
           elems.push_back(next);
           break;
         }
@@ -345,7 +430,7 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
             throw JSONError(_env, errLocation(), "invalid set literal");
           }
 
-          next = readToken(is);
+          next = readToken();
           if (next.t == T_INT) {
             if (listT != T_FLOAT) {
               listT = T_INT;
@@ -357,9 +442,9 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
           }
           elems.push_back(next);
 
-          expectToken(is, T_COMMA);
+          expectToken(T_COMMA);
 
-          next = readToken(is);
+          next = readToken();
           if (next.t == T_INT) {
             if (listT != T_FLOAT) {
               listT = T_INT;
@@ -371,13 +456,13 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
           }
           elems.push_back(next);
 
-          expectToken(is, T_LIST_CLOSE);
+          expectToken(T_LIST_CLOSE);
           break;
         default:
           throw JSONError(_env, errLocation(), "invalid set literal");
       }
     }
-    expectToken(is, T_OBJ_CLOSE);
+    expectToken(T_OBJ_CLOSE);
 
     if (listT == T_INT) {
       unsigned int n = elems.size() / 2;
@@ -414,7 +499,7 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
         break;
       case T_BOOL:
         for (unsigned int i = 0; i < elems.size(); i++) {
-          elems_e[i] = new BoolLit(Location().introduce(), elems[i].b);
+          elems_e[i] = constants().boollit(elems[i].b);
         }
         break;
       case T_STRING:
@@ -433,14 +518,14 @@ Expression* JSONParser::parseObject(istream& is, bool possibleString) {
     return new SetLit(Location().introduce(), elems_e);
   }
   if (objid.s == "e") {
-    Token next = parseEnumString(is);
-    expectToken(is, T_OBJ_CLOSE);
+    Token next = parseEnumString();
+    expectToken(T_OBJ_CLOSE);
     return new Id(Location().introduce(), ASTString(next.s), nullptr);
   }
   throw JSONError(_env, errLocation(), "invalid object");
 }
 
-ArrayLit* JSONParser::parseArray(std::istream& is, bool possibleString) {
+ArrayLit* JSONParser::parseArray(bool possibleString) {
   // precondition: opening parenthesis has been read
   vector<Expression*> exps;
   vector<pair<int, int> > dims;
@@ -449,7 +534,7 @@ ArrayLit* JSONParser::parseArray(std::istream& is, bool possibleString) {
   hadDim.push_back(false);
   Token next;
   for (;;) {
-    next = readToken(is);
+    next = readToken();
     if (next.t != T_LIST_OPEN) {
       break;
     }
@@ -500,7 +585,7 @@ ArrayLit* JSONParser::parseArray(std::istream& is, bool possibleString) {
         if (!hadDim[curDim]) {
           dims[curDim].second++;
         }
-        exps.push_back(new BoolLit(Location().introduce(), next.b));
+        exps.push_back(constants().boollit(next.b));
         break;
       case T_NULL:
         if (!hadDim[curDim]) {
@@ -512,13 +597,13 @@ ArrayLit* JSONParser::parseArray(std::istream& is, bool possibleString) {
         if (!hadDim[curDim]) {
           dims[curDim].second++;
         }
-        exps.push_back(parseObject(is));
+        exps.push_back(parseObject());
         break;
       default:
         throw JSONError(_env, errLocation(), "cannot parse JSON file");
         break;
     }
-    next = readToken(is);
+    next = readToken();
   }
 list_done:
   unsigned int expectedSize = 1;
@@ -532,8 +617,8 @@ list_done:
   return new ArrayLit(Location().introduce(), exps, dims);
 }
 
-Expression* JSONParser::parseExp(std::istream& is, bool parseObjects, bool possibleString) {
-  Token next = readToken(is);
+Expression* JSONParser::parseExp(bool parseObjects, bool possibleString) {
+  Token next = readToken();
   switch (next.t) {
     case T_INT:
       return IntLit::a(next.i);
@@ -546,13 +631,13 @@ Expression* JSONParser::parseExp(std::istream& is, bool parseObjects, bool possi
       }
       return new StringLit(Location().introduce(), next.s);
     case T_BOOL:
-      return new BoolLit(Location().introduce(), next.b);
+      return constants().boollit(next.b);
     case T_NULL:
       return constants().absent;
     case T_OBJ_OPEN:
-      return parseObjects ? parseObject(is, possibleString) : nullptr;
+      return parseObjects ? parseObject(possibleString) : nullptr;
     case T_LIST_OPEN:
-      return parseArray(is, possibleString);
+      return parseArray(possibleString);
     default:
       throw JSONError(_env, errLocation(), "cannot parse JSON file");
       break;
@@ -607,7 +692,7 @@ Expression* JSONParser::coerceArray(TypeInst* intendedTI, ArrayLit* al) {
   return c;
 }
 
-void JSONParser::parseModel(Model* m, std::istream& is, bool isData) {
+void JSONParser::parseModel(Model* m, bool isData) {
   // precondition: found T_OBJ_OPEN
   ASTStringMap<TypeInst*> knownIds;
   if (isData) {
@@ -626,17 +711,17 @@ void JSONParser::parseModel(Model* m, std::istream& is, bool isData) {
     iter_items(_varDecls, m);
   }
   for (;;) {
-    string ident = expectString(is);
-    expectToken(is, T_COLON);
+    string ident = expectString();
+    expectToken(T_COLON);
     auto it = knownIds.find(ident);
     bool possibleString = it == knownIds.end() ||
                           (!it->second->isEnum() && it->second->type().bt() != Type::BT_UNKNOWN);
-    Expression* e = parseExp(is, isData, possibleString);
+    Expression* e = parseExp(isData, possibleString);
     if (ident[0] != '_' && (!isData || it != knownIds.end())) {
       if (e == nullptr) {
         // This is a nested object
         auto* subModel = new Model;
-        parseModel(subModel, is, isData);
+        parseModel(subModel, isData);
         auto* ii = new IncludeI(Location().introduce(), ident);
         ii->m(subModel, true);
         m->addItem(ii);
@@ -655,7 +740,7 @@ void JSONParser::parseModel(Model* m, std::istream& is, bool isData) {
         m->addItem(ai);
       }
     }
-    Token next = readToken(is);
+    Token next = readToken();
     if (next.t == T_OBJ_CLOSE) {
       break;
     }
@@ -665,26 +750,35 @@ void JSONParser::parseModel(Model* m, std::istream& is, bool isData) {
   }
 }
 
+namespace {
+/// Input stream buffer reading directly from memory (without copying it)
+class MemoryBuf : public std::streambuf {
+public:
+  MemoryBuf(const char* data, size_t size) {
+    char* b = const_cast<char*>(data);
+    setg(b, b, b + size);
+  }
+};
+}  // namespace
+
 void JSONParser::parse(Model* m, const std::string& filename0, bool isData) {
   _filename = filename0;
   ifstream is(FILE_PATH(_filename), ios::in);
   if (!is.good()) {
     throw JSONError(_env, Location().introduce(), "cannot open file " + _filename);
   }
-  _line = 0;
-  _column = 0;
-  expectToken(is, T_OBJ_OPEN);
-  parseModel(m, is, isData);
-  expectEof(is);
+  initInput(is);
+  expectToken(T_OBJ_OPEN);
+  parseModel(m, isData);
+  expectEof();
+  _is = nullptr;
 }
 
 void JSONParser::parseFromString(Model* m, const std::string& data, bool isData) {
-  istringstream iss(data);
-  _line = 0;
-  _column = 0;
-  expectToken(iss, T_OBJ_OPEN);
-  parseModel(m, iss, isData);
-  expectEof(iss);
+  initInput(data.data(), data.size());
+  expectToken(T_OBJ_OPEN);
+  parseModel(m, isData);
+  expectEof();
 }
 
 namespace {
@@ -703,7 +797,8 @@ bool is_json(std::istream& is) {
 }  // namespace
 
 bool JSONParser::stringIsJSON(const std::string& data) {
-  std::istringstream iss(data);
+  MemoryBuf buf(data.data(), data.size());
+  istream iss(&buf);
   return is_json(iss);
 }
 
@@ -0,0 +1,1051 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/config.hh>
+#include <minizinc/file_utils.hh>
+#include <minizinc/hash.hh>
+#include <minizinc/library_image.hh>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace MiniZinc {
+
+namespace {
+
+/// Magic number at the start of every image
+const char image_magic[8] = {'M', 'Z', 'N', 'L', 'I', 'B', '\0', '\1'};
+/// Version of the image format, increase whenever the encoding changes
+const unsigned int image_format = 1;
+
+std::string compiler_version() {
+  return std::string(MZN_VERSION_MAJOR) + "." + MZN_VERSION_MINOR + "." + MZN_VERSION_PATCH +
+         " " + MZN_BUILD_REF;
+}
+
+/// Tags identifying the encoded expressions
+enum ExpTag : unsigned char {
+  T_NULL,
+  T_REF,
+  T_ABSENT,
+  T_DECLID,
+  T_INTLIT,
+  T_FLOATLIT,
+  T_BOOLLIT,
+  T_SETLIT,
+  T_STRINGLIT,
+  T_ID,
+  T_ANON,
+  T_ARRAYLIT,
+  T_ARRAYACCESS,
+  T_COMP,
+  T_ITE,
+  T_BINOP,
+  T_UNOP,
+  T_CALL,
+  T_VARDECL,
+  T_LET,
+  T_TI,
+  T_TIID
+};
+
+/// Error while encoding or decoding an image
+class ImageError : public std::exception {};
+
+class ImageWriter {
+protected:
+  std::string _buf;
+  std::unordered_map<std::string, unsigned int> _strings;
+  std::unordered_map<const void*, unsigned int> _nodes;
+  std::unordered_map<Model*, unsigned int> _models;
+
+  void registerNode(const void* n) {
+    auto idx = static_cast<unsigned int>(_nodes.size());
+    _nodes.insert(std::make_pair(n, idx));
+  }
+
+public:
+  ImageWriter(const std::vector<Model*>& models) {
+    for (auto* m : models) {
+      auto idx = static_cast<unsigned int>(_models.size());
+      _models.insert(std::make_pair(m, idx));
+    }
+  }
+  const std::string& buffer() const { return _buf; }
+
+  void raw(const char* s, size_t n) { _buf.append(s, n); }
+  void byte(unsigned char b) { _buf.push_back(static_cast<char>(b)); }
+  void u(unsigned long long int v) {
+    while (v >= 0x80) {
+      byte(static_cast<unsigned char>(v | 0x80));
+      v >>= 7;
+    }
+    byte(static_cast<unsigned char>(v));
+  }
+  void i(long long int v) {
+    u((static_cast<unsigned long long int>(v) << 1) ^ static_cast<unsigned long long int>(v >> 63));
+  }
+  void d(double v) {
+    char b[sizeof(double)];
+    std::memcpy(b, &v, sizeof(double));
+    raw(b, sizeof(double));
+  }
+  void str(const std::string& s) {
+    u(s.size());
+    raw(s.c_str(), s.size());
+  }
+  void intVal(const IntVal& v) {
+    if (v.isFinite()) {
+      byte(0);
+      i(v.toInt());
+    } else {
+      byte(v.isPlusInfinity() ? 1 : 2);
+    }
+  }
+  void floatVal(const FloatVal& v) {
+    if (v.isFinite()) {
+      byte(0);
+      d(v.toDouble());
+    } else {
+      byte(v.isPlusInfinity() ? 1 : 2);
+    }
+  }
+  /// Strings are stored once, later occurrences refer to the first one
+  void s(const ASTString& as) {
+    if (as.aststr() == nullptr) {
+      u(0);
+      return;
+    }
+    std::string st(as.c_str(), as.size());
+    auto it = _strings.find(st);
+    if (it != _strings.end()) {
+      u(it->second + 2);
+    } else {
+      auto idx = static_cast<unsigned int>(_strings.size());
+      _strings.insert(std::make_pair(st, idx));
+      u(1);
+      str(st);
+    }
+  }
+  void loc(const Location& l) {
+    if (l.filename().size() == 0 && l.firstLine() == 0 && l.lastLine() == 0) {
+      byte(0);
+      return;
+    }
+    byte(l.isIntroduced() ? 2 : 1);
+    s(l.filename());
+    u(l.firstLine());
+    u(l.firstColumn());
+    u(l.lastLine());
+    u(l.lastColumn());
+  }
+  void type(const Type& t) {
+    i(t.toInt());
+    byte(t.cv() ? 1 : 0);
+  }
+  void ann(const Annotation& a) {
+    std::vector<Expression*> anns(a.begin(), a.end());
+    u(anns.size());
+    for (auto* e : anns) {
+      exp(e);
+    }
+  }
+  void exps(const std::vector<Expression*>& es) {
+    u(es.size());
+    for (auto* e : es) {
+      exp(e);
+    }
+  }
+  template <class T>
+  void exps(const ASTExprVec<T>& es) {
+    u(es.size());
+    for (unsigned int j = 0; j < es.size(); j++) {
+      exp(es[j]);
+    }
+  }
+  void exp(Expression* e);
+  void item(Item* item);
+  void model(Model* m);
+};
+
+void ImageWriter::exp(Expression* e) {
+  if (e == nullptr) {
+    byte(T_NULL);
+    return;
+  }
+  auto it = _nodes.find(e);
+  if (it != _nodes.end()) {
+    byte(T_REF);
+    u(it->second);
+    return;
+  }
+  if (e == constants().absent) {
+    byte(T_ABSENT);
+    return;
+  }
+  switch (e->eid()) {
+    case Expression::E_INTLIT:
+      byte(T_INTLIT);
+      intVal(e->cast<IntLit>()->v());
+      return;
+    case Expression::E_FLOATLIT:
+      byte(T_FLOATLIT);
+      floatVal(e->cast<FloatLit>()->v());
+      return;
+    case Expression::E_BOOLLIT:
+      byte(T_BOOLLIT);
+      byte(e->cast<BoolLit>()->v() ? 1 : 0);
+      return;
+    case Expression::E_SETLIT: {
+      auto* sl = e->cast<SetLit>();
+      byte(T_SETLIT);
+      loc(e->loc());
+      if (IntSetVal* isv = sl->isv()) {
+        byte(1);
+        u(isv->size());
+        for (unsigned int j = 0; j < isv->size(); j++) {
+          intVal(isv->min(j));
+          intVal(isv->max(j));
+        }
+      } else if (FloatSetVal* fsv = sl->fsv()) {
+        byte(2);
+        u(fsv->size());
+        for (unsigned int j = 0; j < fsv->size(); j++) {
+          floatVal(fsv->min(j));
+          floatVal(fsv->max(j));
+        }
+      } else {
+        byte(0);
+        exps(sl->v());
+      }
+    } break;
+    case Expression::E_STRINGLIT:
+      byte(T_STRINGLIT);
+      loc(e->loc());
+      s(e->cast<StringLit>()->v());
+      break;
+    case Expression::E_ID: {
+      Id* id = e->cast<Id>();
+      if (id->decl() != nullptr) {
+        if (!id->decl()->isa<VarDecl>() || id->decl()->cast<VarDecl>()->id() != id) {
+          throw ImageError();
+        }
+        // The identifier of a declaration is created together with the declaration
+        byte(T_DECLID);
+        exp(id->decl());
+        return;
+      }
+      byte(T_ID);
+      loc(e->loc());
+      if (id->hasStr()) {
+        byte(1);
+        s(id->v());
+      } else {
+        byte(0);
+        i(id->idn());
+      }
+    } break;
+    case Expression::E_ANON:
+      byte(T_ANON);
+      loc(e->loc());
+      break;
+    case Expression::E_ARRAYLIT: {
+      auto* al = e->cast<ArrayLit>();
+      if (al->getSliceLiteral() != nullptr) {
+        throw ImageError();
+      }
+      byte(T_ARRAYLIT);
+      loc(e->loc());
+      u(al->dims());
+      for (unsigned int j = 0; j < al->dims(); j++) {
+        i(al->min(j));
+        i(al->max(j));
+      }
+      u(al->size());
+      for (unsigned int j = 0; j < al->size(); j++) {
+        exp((*al)[j]);
+      }
+    } break;
+    case Expression::E_ARRAYACCESS: {
+      auto* aa = e->cast<ArrayAccess>();
+      byte(T_ARRAYACCESS);
+      loc(e->loc());
+      exp(aa->v());
+      exps(aa->idx());
+    } break;
+    case Expression::E_COMP: {
+      auto* c = e->cast<Comprehension>();
+      byte(T_COMP);
+      loc(e->loc());
+      byte(c->set() ? 1 : 0);
+      u(c->numberOfGenerators());
+      for (unsigned int j = 0; j < c->numberOfGenerators(); j++) {
+        u(c->numberOfDecls(j));
+        for (unsigned int k = 0; k < c->numberOfDecls(j); k++) {
+          exp(c->decl(j, k));
+        }
+        exp(c->in(j));
+        exp(c->where(j));
+      }
+      exp(c->e());
+    } break;
+    case Expression::E_ITE: {
+      ITE* ite = e->cast<ITE>();
+      byte(T_ITE);
+      loc(e->loc());
+      u(ite->size());
+      for (unsigned int j = 0; j < ite->size(); j++) {
+        exp(ite->ifExpr(j));
+        exp(ite->thenExpr(j));
+      }
+      exp(ite->elseExpr());
+    } break;
+    case Expression::E_BINOP: {
+      auto* bo = e->cast<BinOp>();
+      byte(T_BINOP);
+      loc(e->loc());
+      u(bo->op());
+      exp(bo->lhs());
+      exp(bo->rhs());
+    } break;
+    case Expression::E_UNOP: {
+      UnOp* uo = e->cast<UnOp>();
+      byte(T_UNOP);
+      loc(e->loc());
+      u(uo->op());
+      exp(uo->e());
+    } break;
+    case Expression::E_CALL: {
+      Call* c = e->cast<Call>();
+      byte(T_CALL);
+      loc(e->loc());
+      s(c->id());
+      u(c->argCount());
+      for (unsigned int j = 0; j < c->argCount(); j++) {
+        exp(c->arg(j));
+      }
+    } break;
+    case Expression::E_VARDECL: {
+      auto* vd = e->cast<VarDecl>();
+      byte(T_VARDECL);
+      loc(e->loc());
+      loc(vd->id()->loc());
+      if (vd->id()->hasStr()) {
+        byte(1);
+        s(vd->id()->v());
+      } else {
+        byte(0);
+        i(vd->id()->idn());
+      }
+      byte((vd->toplevel() ? 1 : 0) | (vd->introduced() ? 2 : 0));
+      exp(vd->ti());
+      exp(vd->e());
+      registerNode(vd);
+      registerNode(vd->id());
+      ann(e->ann());
+      type(e->type());
+      return;
+    }
+    case Expression::E_LET: {
+      Let* let = e->cast<Let>();
+      byte(T_LET);
+      loc(e->loc());
+      exps(let->let());
+      exp(let->in());
+    } break;
+    case Expression::E_TI: {
+      auto* ti = e->cast<TypeInst>();
+      byte(T_TI);
+      loc(e->loc());
+      byte(ti->isEnum() ? 1 : 0);
+      exps(ti->ranges());
+      exp(ti->domain());
+    } break;
+    case Expression::E_TIID:
+      byte(T_TIID);
+      loc(e->loc());
+      s(e->cast<TIId>()->v());
+      break;
+    default:
+      throw ImageError();
+  }
+  registerNode(e);
+  ann(e->ann());
+  type(e->type());
+}
+
+void ImageWriter::item(Item* item) {
+  u(item->iid());
+  loc(item->loc());
+  switch (item->iid()) {
+    case Item::II_INC: {
+      auto* ii = item->cast<IncludeI>();
+      s(ii->f());
+      auto it = _models.find(ii->m());
+      if (it == _models.end()) {
+        throw ImageError();
+      }
+      u(it->second);
+      byte(ii->own() ? 1 : 0);
+    } break;
+    case Item::II_VD:
+      exp(item->cast<VarDeclI>()->e());
+      break;
+    case Item::II_ASN:
+      s(item->cast<AssignI>()->id());
+      exp(item->cast<AssignI>()->e());
+      break;
+    case Item::II_CON:
+      exp(item->cast<ConstraintI>()->e());
+      break;
+    case Item::II_SOL: {
+      auto* si = item->cast<SolveI>();
+      u(si->st());
+      exp(si->e());
+      ann(si->ann());
+    } break;
+    case Item::II_OUT:
+      exp(item->cast<OutputI>()->e());
+      break;
+    case Item::II_FUN: {
+      auto* fi = item->cast<FunctionI>();
+      s(fi->id());
+      exp(fi->ti());
+      exps(fi->params());
+      exp(fi->e());
+      byte(fi->fromStdLib() ? 1 : 0);
+      ann(fi->ann());
+    } break;
+    default:
+      throw ImageError();
+  }
+}
+
+void ImageWriter::model(Model* m) {
+  s(m->filename());
+  s(m->filepath());
+  if (m->parent() == nullptr) {
+    u(0);
+  } else {
+    auto it = _models.find(m->parent());
+    if (it == _models.end()) {
+      throw ImageError();
+    }
+    u(it->second + 1);
+  }
+  u(m->size());
+  for (auto* item : *m) {
+    this->item(item);
+  }
+}
+
+class ImageReader {
+protected:
+  const char* _p;
+  const char* _end;
+  std::vector<ASTString> _strings;
+  std::vector<Expression*> _nodes;
+  const std::vector<Model*>& _models;
+
+public:
+  ImageReader(const char* p, const char* end, const std::vector<Model*>& models)
+      : _p(p), _end(end), _models(models) {}
+  const char* raw(size_t n) {
+    if (static_cast<size_t>(_end - _p) < n) {
+      throw ImageError();
+    }
+    const char* r = _p;
+    _p += n;
+    return r;
+  }
+  unsigned char byte() { return static_cast<unsigned char>(*raw(1)); }
+  unsigned long long int u() {
+    unsigned long long int v = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+      unsigned char b = byte();
+      v |= static_cast<unsigned long long int>(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) {
+        return v;
+      }
+    }
+    throw ImageError();
+  }
+  long long int i() {
+    unsigned long long int v = u();
+    return static_cast<long long int>(v >> 1) ^ -static_cast<long long int>(v & 1);
+  }
+  double d() {
+    double v;
+    std::memcpy(&v, raw(sizeof(double)), sizeof(double));
+    return v;
+  }
+  IntVal intVal() {
+    switch (byte()) {
+      case 0:
+        return IntVal(i());
+      case 1:
+        return IntVal::infinity();
+      case 2:
+        return -IntVal::infinity();
+      default:
+        throw ImageError();
+    }
+  }
+  FloatVal floatVal() {
+    switch (byte()) {
+      case 0:
+        return FloatVal(d());
+      case 1:
+        return FloatVal::infinity();
+      case 2:
+        return -FloatVal::infinity();
+      default:
+        throw ImageError();
+    }
+  }
+  std::string str() {
+    size_t n = u();
+    const char* s = raw(n);
+    return std::string(s, n);
+  }
+  unsigned int count() {
+    unsigned long long int n = u();
+    if (n > static_cast<unsigned long long int>(_end - _p)) {
+      // Every element takes at least one byte
+      throw ImageError();
+    }
+    return static_cast<unsigned int>(n);
+  }
+  ASTString s() {
+    unsigned long long int idx = u();
+    if (idx == 0) {
+      return ASTString();
+    }
+    if (idx == 1) {
+      size_t n = u();
+      const char* st = raw(n);
+      _strings.emplace_back(st, n);
+      return _strings.back();
+    }
+    if (idx - 2 >= _strings.size()) {
+      throw ImageError();
+    }
+    return _strings[idx - 2];
+  }
+  Model* model() {
+    unsigned long long int idx = u();
+    if (idx >= _models.size()) {
+      throw ImageError();
+    }
+    return _models[idx];
+  }
+  Location loc() {
+    unsigned char kind = byte();
+    if (kind == 0) {
+      return Location();
+    }
+    ASTString f = s();
+    auto fl = static_cast<unsigned int>(u());
+    auto fc = static_cast<unsigned int>(u());
+    auto ll = static_cast<unsigned int>(u());
+    auto lc = static_cast<unsigned int>(u());
+    if (ll < fl) {
+      throw ImageError();
+    }
+    Location l(f, fl, fc, ll, lc);
+    return kind == 2 ? l.introduce() : l;
+  }
+  Type type() {
+    Type t = Type::fromInt(static_cast<int>(i()));
+    t.cv(byte() != 0);
+    return t;
+  }
+  void ann(Annotation& a) {
+    unsigned int n = count();
+    for (unsigned int j = 0; j < n; j++) {
+      a.add(exp());
+    }
+  }
+  std::vector<Expression*> exps() {
+    std::vector<Expression*> es(count());
+    for (auto& e : es) {
+      e = exp();
+    }
+    return es;
+  }
+  template <class T>
+  T* exp() {
+    Expression* e = exp();
+    if (e != nullptr && !e->isa<T>()) {
+      throw ImageError();
+    }
+    return static_cast<T*>(e);
+  }
+  Expression* exp();
+  Item* item();
+  void model(Model* m);
+};
+
+Expression* ImageReader::exp() {
+  Expression* ret;
+  switch (byte()) {
+    case T_NULL:
+      return nullptr;
+    case T_REF: {
+      unsigned long long int idx = u();
+      if (idx >= _nodes.size()) {
+        throw ImageError();
+      }
+      return _nodes[idx];
+    }
+    case T_ABSENT:
+      return constants().absent;
+    case T_DECLID:
+      return exp<VarDecl>()->id();
+    case T_INTLIT:
+      return IntLit::a(intVal());
+    case T_FLOATLIT:
+      return FloatLit::a(floatVal());
+    case T_BOOLLIT:
+      return constants().boollit(byte() != 0);
+    case T_SETLIT: {
+      Location l = loc();
+      switch (byte()) {
+        case 0:
+          ret = new SetLit(l, exps());
+          break;
+        case 1: {
+          std::vector<IntSetVal::Range> ranges(count());
+          for (auto& r : ranges) {
+            r.min = intVal();
+            r.max = intVal();
+          }
+          ret = new SetLit(l, IntSetVal::a(ranges));
+        } break;
+        case 2: {
+          std::vector<FloatSetVal::Range> ranges(count());
+          for (auto& r : ranges) {
+            r.min = floatVal();
+            r.max = floatVal();
+          }
+          ret = new SetLit(l, FloatSetVal::a(ranges));
+        } break;
+        default:
+          throw ImageError();
+      }
+    } break;
+    case T_STRINGLIT: {
+      Location l = loc();
+      ret = new StringLit(l, s());
+    } break;
+    case T_ID: {
+      Location l = loc();
+      if (byte() != 0) {
+        ret = new Id(l, s(), nullptr);
+      } else {
+        ret = new Id(l, i(), nullptr);
+      }
+    } break;
+    case T_ANON:
+      ret = new AnonVar(loc());
+      break;
+    case T_ARRAYLIT: {
+      Location l = loc();
+      std::vector<std::pair<int, int>> dims(count());
+      for (auto& dim : dims) {
+        dim.first = static_cast<int>(i());
+        dim.second = static_cast<int>(i());
+      }
+      std::vector<Expression*> elems = exps();
+      ret = new ArrayLit(l, elems, dims);
+    } break;
+    case T_ARRAYACCESS: {
+      Location l = loc();
+      Expression* v = exp();
+      ret = new ArrayAccess(l, v, exps());
+    } break;
+    case T_COMP: {
+      Location l = loc();
+      bool set = byte() != 0;
+      Generators g;
+      unsigned int n = count();
+      for (unsigned int j = 0; j < n; j++) {
+        std::vector<VarDecl*> decls(count());
+        for (auto& decl : decls) {
+          decl = exp<VarDecl>();
+        }
+        Expression* in = exp();
+        Expression* where = exp();
+        g.g.emplace_back(decls, in, where);
+      }
+      Expression* body = exp();
+      ret = new Comprehension(l, body, g, set);
+    } break;
+    case T_ITE: {
+      Location l = loc();
+      std::vector<Expression*> ifThen(2 * static_cast<size_t>(count()));
+      for (auto& e : ifThen) {
+        e = exp();
+      }
+      Expression* elseExp = exp();
+      ret = new ITE(l, ifThen, elseExp);
+    } break;
+    case T_BINOP: {
+      Location l = loc();
+      auto op = static_cast<BinOpType>(u());
+      Expression* lhs = exp();
+      Expression* rhs = exp();
+      ret = new BinOp(l, lhs, op, rhs);
+    } break;
+    case T_UNOP: {
+      Location l = loc();
+      auto op = static_cast<UnOpType>(u());
+      ret = new UnOp(l, op, exp());
+    } break;
+    case T_CALL: {
+      Location l = loc();
+      ASTString id = s();
+      ret = new Call(l, id, exps());
+    } break;
+    case T_VARDECL: {
+      Location l = loc();
+      Location idLoc = loc();
+      Id* id;
+      if (byte() != 0) {
+        id = new Id(idLoc, s(), nullptr);
+      } else {
+        id = new Id(idLoc, i(), nullptr);
+      }
+      unsigned char flags = byte();
+      auto* ti = exp<TypeInst>();
+      if (ti == nullptr) {
+        throw ImageError();
+      }
+      Expression* e = exp();
+      auto* vd = new VarDecl(l, ti, id, e);
+      vd->toplevel((flags & 1) != 0);
+      vd->introduced((flags & 2) != 0);
+      _nodes.push_back(vd);
+      _nodes.push_back(vd->id());
+      ann(vd->ann());
+      vd->type(type());
+      return vd;
+    }
+    case T_LET: {
+      Location l = loc();
+      std::vector<Expression*> let = exps();
+      ret = new Let(l, let, exp());
+    } break;
+    case T_TI: {
+      Location l = loc();
+      bool isEnum = byte() != 0;
+      std::vector<TypeInst*> ranges(count());
+      for (auto& r : ranges) {
+        r = exp<TypeInst>();
+      }
+      Expression* domain = exp();
+      auto* ti = new TypeInst(l, Type(), ASTExprVec<TypeInst>(ranges), domain);
+      ti->setIsEnum(isEnum);
+      ret = ti;
+    } break;
+    case T_TIID: {
+      Location l = loc();
+      ret = new TIId(l, s());
+    } break;
+    default:
+      throw ImageError();
+  }
+  _nodes.push_back(ret);
+  ann(ret->ann());
+  ret->type(type());
+  return ret;
+}
+
+Item* ImageReader::item() {
+  auto iid = static_cast<Item::ItemId>(u());
+  Location l = loc();
+  switch (iid) {
+    case Item::II_INC: {
+      auto* ii = new IncludeI(l, s());
+      Model* m = model();
+      ii->m(m, byte() != 0);
+      return ii;
+    }
+    case Item::II_VD:
+      return new VarDeclI(l, exp<VarDecl>());
+    case Item::II_ASN: {
+      ASTString id = s();
+      return new AssignI(l, id, exp());
+    }
+    case Item::II_CON:
+      return new ConstraintI(l, exp());
+    case Item::II_SOL: {
+      auto st = static_cast<SolveI::SolveType>(u());
+      Expression* e = exp();
+      SolveI* si;
+      switch (st) {
+        case SolveI::ST_SAT:
+          si = SolveI::sat(l);
+          break;
+        case SolveI::ST_MIN:
+          si = SolveI::min(l, e);
+          break;
+        case SolveI::ST_MAX:
+          si = SolveI::max(l, e);
+          break;
+        default:
+          throw ImageError();
+      }
+      ann(si->ann());
+      return si;
+    }
+    case Item::II_OUT:
+      return new OutputI(l, exp());
+    case Item::II_FUN: {
+      ASTString id = s();
+      auto* ti = exp<TypeInst>();
+      std::vector<VarDecl*> params(count());
+      for (auto& p : params) {
+        p = exp<VarDecl>();
+      }
+      Expression* e = exp();
+      bool fromStdLib = byte() != 0;
+      auto* fi = new FunctionI(l, id, ti, ASTExprVec<VarDecl>(params), e, fromStdLib);
+      ann(fi->ann());
+      return fi;
+    }
+    default:
+      throw ImageError();
+  }
+}
+
+void ImageReader::model(Model* m) {
+  m->setFilename(s());
+  m->setFilepath(s());
+  unsigned long long int parent = u();
+  if (parent != 0) {
+    if (parent > _models.size()) {
+      throw ImageError();
+    }
+    m->setParent(_models[parent - 1]);
+  }
+  unsigned int n = count();
+  for (unsigned int j = 0; j < n; j++) {
+    m->addItem(item());
+  }
+}
+
+/// Files and directories whose modification invalidates the image
+struct Stamp {
+  std::string path;
+  long long int size;
+  long long int mtime;
+};
+
+std::vector<Stamp> stamps(const std::vector<std::string>& paths) {
+  std::vector<Stamp> ret;
+  for (const auto& p : paths) {
+    Stamp st{p, 0, 0};
+    if (!FileUtils::file_stat(p, st.size, st.mtime)) {
+      st.size = -1;
+    }
+    ret.push_back(st);
+  }
+  return ret;
+}
+
+/// Collect all models reachable from \a m through include items
+void collect_models(Model* m, std::vector<Model*>& models, std::set<Model*>& seen) {
+  if (!seen.insert(m).second) {
+    return;
+  }
+  models.push_back(m);
+  for (auto* item : *m) {
+    if (auto* ii = item->dynamicCast<IncludeI>()) {
+      if (ii->m() != nullptr) {
+        collect_models(ii->m(), models, seen);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+std::string LibraryImage::defaultFile(const std::vector<std::string>& includePaths) {
+  std::string dir = FileUtils::user_config_dir();
+  if (dir.empty()) {
+    return "";
+  }
+  std::string key = compiler_version();
+  for (const auto& ip : includePaths) {
+    key += "\n" + FileUtils::file_path(ip);
+  }
+  std::ostringstream oss;
+  oss << dir << "/library_cache/" << std::hex << std::setw(16) << std::setfill('0')
+      << static_cast<unsigned long long int>(CStringHash::hash(key.c_str(), key.size()))
+      << ".mzl";
+  return oss.str();
+}
+
+bool LibraryImage::write(const std::string& filename,
+                         const std::vector<std::string>& includePaths) const {
+  GCLock lock;
+  std::vector<Model*> all;
+  std::set<Model*> seen;
+  for (auto* m : roots) {
+    collect_models(m, all, seen);
+  }
+  for (const auto& it : models) {
+    collect_models(it.second, all, seen);
+  }
+  std::vector<std::string> paths;
+  for (const auto& ip : includePaths) {
+    paths.push_back(FileUtils::file_path(ip));
+  }
+  std::vector<std::string> files;
+  for (auto* m : all) {
+    if (m->filepath().size() == 0) {
+      return false;
+    }
+    files.emplace_back(m->filepath().c_str());
+  }
+
+  ImageWriter w(all);
+  w.raw(image_magic, sizeof(image_magic));
+  w.u(image_format);
+  w.str(compiler_version());
+  for (const auto* list : {&paths, &files}) {
+    auto st = stamps(*list);
+    w.u(st.size());
+    for (const auto& s : st) {
+      w.str(s.path);
+      w.i(s.size);
+      w.i(s.mtime);
+    }
+  }
+  try {
+    w.u(all.size());
+    for (auto* m : all) {
+      w.model(m);
+    }
+    std::unordered_map<Model*, unsigned int> index;
+    for (unsigned int j = 0; j < all.size(); j++) {
+      index[all[j]] = j;
+    }
+    w.u(roots.size());
+    for (auto* m : roots) {
+      w.u(index[m]);
+    }
+    w.u(models.size());
+    for (const auto& it : models) {
+      w.str(it.first);
+      w.u(index[it.second]);
+    }
+  } catch (ImageError&) {
+    return false;
+  }
+
+  // Write to a temporary file first, so that concurrent readers never see a partial image
+  std::string tmpName = filename + ".tmp";
+  {
+    std::ofstream os(FILE_PATH(tmpName), std::ios::binary);
+    if (!os.is_open()) {
+      return false;
+    }
+    os.write(w.buffer().data(), static_cast<std::streamsize>(w.buffer().size()));
+    if (!os.good()) {
+      return false;
+    }
+  }
+  std::remove(filename.c_str());
+  return std::rename(tmpName.c_str(), filename.c_str()) == 0;
+}
+
+bool LibraryImage::read(const std::string& filename,
+                        const std::vector<std::string>& includePaths) {
+  FileUtils::MappedFile file(filename);
+  if (!file.isOpen()) {
+    return false;
+  }
+  GCLock lock;
+  std::vector<Model*> all;
+  ImageReader r(file.data(), file.data() + file.size(), all);
+  try {
+    if (std::memcmp(r.raw(sizeof(image_magic)), image_magic, sizeof(image_magic)) != 0 ||
+        r.u() != image_format || r.str() != compiler_version()) {
+      return false;
+    }
+    for (unsigned int list = 0; list < 2; list++) {
+      unsigned int n = r.count();
+      if (list == 0 && n != includePaths.size()) {
+        return false;
+      }
+      for (unsigned int j = 0; j < n; j++) {
+        std::string path = r.str();
+        long long int size = r.i();
+        long long int mtime = r.i();
+        if (list == 0 && path != FileUtils::file_path(includePaths[j])) {
+          return false;
+        }
+        Stamp cur = stamps({path})[0];
+        if (cur.size != size || cur.mtime != mtime) {
+          return false;
+        }
+      }
+    }
+  } catch (ImageError&) {
+    return false;
+  }
+
+  try {
+    all.resize(r.count());
+    for (auto& m : all) {
+      m = new Model;
+    }
+    for (auto* m : all) {
+      r.model(m);
+    }
+    roots.resize(r.count());
+    for (auto& m : roots) {
+      m = r.model();
+    }
+    unsigned int n = r.count();
+    for (unsigned int j = 0; j < n; j++) {
+      std::string name = r.str();
+      models[name] = r.model();
+    }
+  } catch (ImageError&) {
+    // Delete all models that are not owned by another model (which deletes the owned ones)
+    std::set<Model*> owned;
+    for (auto* m : all) {
+      if (m != nullptr) {
+        for (auto* item : *m) {
+          if (auto* ii = item->dynamicCast<IncludeI>()) {
+            if (ii->own()) {
+              owned.insert(ii->m());
+            }
+          }
+        }
+      }
+    }
+    for (auto* m : all) {
+      if (owned.find(m) == owned.end()) {
+        delete m;
+      }
+    }
+    roots.clear();
+    models.clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace MiniZinc
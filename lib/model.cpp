@@ -57,7 +57,12 @@ bool Model::FnEntry::compare(const Model::FnEntry& e1, const Model::FnEntry& e2)
   return false;
 }
 
-Model::Model() : _parent(nullptr), _solveItem(nullptr), _outputItem(nullptr) {}
+Model::Model()
+    : _parent(nullptr),
+      _solveItem(nullptr),
+      _outputItem(nullptr),
+      _dispatchHits(0),
+      _dispatchMisses(0) {}
 
 Model::~Model() {
   for (auto* i : _items) {
@@ -213,11 +218,58 @@ void Model::addPolymorphicInstances(Model::FnEntry& fe, std::vector<FnEntry>& en
   }
 }
 
+size_t Model::DispatchKeyHash::operator()(const DispatchKey& k) const {
+  size_t h = k.id.hash() ^ static_cast<size_t>(k.strictEnums);
+  for (int t : k.t) {
+    h ^= static_cast<size_t>(t) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  }
+  return h;
+}
+
+void Model::dispatchKey(const ASTString& id, bool strictEnums) const {
+  _dispatchKey.id = id;
+  _dispatchKey.strictEnums = strictEnums;
+  _dispatchKey.t.clear();
+}
+
+FunctionI* Model::dispatchFind() const {
+  auto it = _dispatchCache.find(_dispatchKey);
+  if (it == _dispatchCache.end()) {
+    return nullptr;
+  }
+  _dispatchHits++;
+  return it->second;
+}
+
+void Model::dispatchInsert(FunctionI* fi) const {
+  _dispatchMisses++;
+  _dispatchCache.insert(std::make_pair(_dispatchKey, fi));
+}
+
+void Model::dispatchClear() { _dispatchCache.clear(); }
+
+unsigned long long int Model::dispatchCacheHits() const {
+  const Model* m = this;
+  while (m->_parent != nullptr) {
+    m = m->_parent;
+  }
+  return m->_dispatchHits;
+}
+
+unsigned long long int Model::dispatchCacheMisses() const {
+  const Model* m = this;
+  while (m->_parent != nullptr) {
+    m = m->_parent;
+  }
+  return m->_dispatchMisses;
+}
+
 bool Model::registerFn(EnvI& env, FunctionI* fi, bool keepSorted, bool throwIfDuplicate) {
   Model* m = this;
   while (m->_parent != nullptr) {
     m = m->_parent;
   }
+  m->dispatchClear();
   auto i_id = m->_fnmap.find(fi->id());
   if (i_id == m->_fnmap.end()) {
     // new element
@@ -288,6 +340,8 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Type
   if (id == constants().varRedef->id()) {
     return constants().varRedef;
   }
+  // The dispatch cache is shared by all threads of a concurrent type check
+  GCConcurrentLock lock;
   Model* m = this;
   while (m->_parent != nullptr) {
     m = m->_parent;
@@ -296,6 +350,13 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Type
   if (i_id == m->_fnmap.end()) {
     return nullptr;
   }
+  m->dispatchKey(id, strictEnums);
+  for (const auto& ti : t) {
+    m->_dispatchKey.t.push_back(ti.toInt());
+  }
+  if (FunctionI* cached = m->dispatchFind()) {
+    return cached;
+  }
   std::vector<FnEntry>& v = i_id->second;
   for (auto& i : v) {
     std::vector<Type>& fi_t = i.t;
@@ -314,6 +375,7 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Type
         }
       }
       if (match) {
+        m->dispatchInsert(i.fi);
         return i.fi;
       }
     }
@@ -337,6 +399,7 @@ void Model::sortFn() {
   while (m->_parent != nullptr) {
     m = m->_parent;
   }
+  m->dispatchClear();
   for (auto& it : m->_fnmap) {
     // Sort all functions by type
     std::sort(it.second.begin(), it.second.end());
@@ -348,6 +411,7 @@ void Model::fixFnMap() {
   while (m->_parent != nullptr) {
     m = m->_parent;
   }
+  m->dispatchClear();
   for (auto& it : m->_fnmap) {
     for (auto& i : it.second) {
       for (unsigned int j = 0; j < i.t.size(); j++) {
@@ -437,6 +501,7 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Expr
   if (id == constants().varRedef->id()) {
     return constants().varRedef;
   }
+  GCConcurrentLock lock;
   const Model* m = this;
   while (m->_parent != nullptr) {
     m = m->_parent;
@@ -445,6 +510,18 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Expr
   if (it == m->_fnmap.end()) {
     return nullptr;
   }
+  // Calls with bottom-typed arguments need an ambiguity check, and are not cached
+  bool cacheable = true;
+  m->dispatchKey(id, strictEnums);
+  for (auto* arg : args) {
+    cacheable = cacheable && !arg->type().isbot();
+    m->_dispatchKey.t.push_back(arg->type().toInt());
+  }
+  if (cacheable) {
+    if (FunctionI* cached = m->dispatchFind()) {
+      return cached;
+    }
+  }
   const std::vector<FnEntry>& v = it->second;
   std::vector<FunctionI*> matched;
   Expression* botarg;
@@ -453,6 +530,9 @@ FunctionI* Model::matchFn(EnvI& env, const ASTString& id, const std::vector<Expr
     return nullptr;
   }
   if (matched.size() == 1) {
+    if (cacheable) {
+      m->dispatchInsert(matched[0]);
+    }
     return matched[0];
   }
   Type t = matched[0]->ti()->type();
@@ -469,6 +549,7 @@ FunctionI* Model::matchFn(EnvI& env, Call* c, bool strictEnums, bool throwIfNotF
   if (c->id() == constants().varRedef->id()) {
     return constants().varRedef;
   }
+  GCConcurrentLock lock;
   const Model* m = this;
   while (m->_parent != nullptr) {
     m = m->_parent;
@@ -499,6 +580,18 @@ FunctionI* Model::matchFn(EnvI& env, Call* c, bool strictEnums, bool throwIfNotF
     }
     return nullptr;
   }
+  // Calls with bottom-typed arguments need an ambiguity check, and are not cached
+  bool cacheable = true;
+  m->dispatchKey(c->id(), strictEnums);
+  for (unsigned int j = 0; j < c->argCount(); j++) {
+    cacheable = cacheable && !c->arg(j)->type().isbot();
+    m->_dispatchKey.t.push_back(c->arg(j)->type().toInt());
+  }
+  if (cacheable) {
+    if (FunctionI* cached = m->dispatchFind()) {
+      return cached;
+    }
+  }
   const std::vector<FnEntry>& v = it->second;
   std::vector<FunctionI*> matched;
   Expression* botarg = nullptr;
@@ -527,6 +620,9 @@ FunctionI* Model::matchFn(EnvI& env, Call* c, bool strictEnums, bool throwIfNotF
         if (botarg != nullptr) {
           matched.push_back(i.fi);
         } else {
+          if (cacheable) {
+            m->dispatchInsert(i.fi);
+          }
           return i.fi;
         }
       }
@@ -196,7 +196,7 @@ void unify(EnvI& env, std::vector<VarDecl*>& deletedVarDecls, Id* id0, Id* id1)
           if (nd->size() == 0) {
             env.fail();
           } else if (nd->card() != isv1->card()) {
-            id1->decl()->ti()->domain(new SetLit(Location(), nd));
+            id1->decl()->ti()->domain(SetLit::a(nd));
             if (nd->card() == isv0->card()) {
               id1->decl()->ti()->setComputedDomain(id0->decl()->ti()->computedDomain());
             } else {
@@ -223,7 +223,7 @@ void unify(EnvI& env, std::vector<VarDecl*>& deletedVarDecls, Id* id0, Id* id1)
           if (nd->size() == 0) {
             env.fail();
           } else if (!Ranges::equal(nd_r, isv1r_2)) {
-            id1->decl()->ti()->domain(new SetLit(Location(), nd));
+            id1->decl()->ti()->domain(SetLit::a(nd));
             FloatSetRanges nd_r_2(nd);
             FloatSetRanges isv0r_2(isv0);
             if (Ranges::equal(nd_r_2, isv0r_2)) {
@@ -1122,13 +1122,13 @@ bool simplify_constraint(EnvI& env, Item* ii, std::vector<VarDecl*>& deletedVarD
           case Type::BT_INT: {
             IntVal d = eval_int(env, arg);
             if (ti->domain() == nullptr) {
-              ti->domain(new SetLit(Location().introduce(), IntSetVal::a(d, d)));
+              ti->domain(SetLit::a(IntSetVal::a(d, d)));
               ti->setComputedDomain(false);
               canRemove = true;
             } else {
               IntSetVal* isv = eval_intset(env, ti->domain());
               if (isv->contains(d)) {
-                ident->decl()->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(d, d)));
+                ident->decl()->ti()->domain(SetLit::a(IntSetVal::a(d, d)));
                 ident->decl()->ti()->setComputedDomain(false);
                 canRemove = true;
               } else {
@@ -1188,7 +1188,7 @@ bool simplify_constraint(EnvI& env, Item* ii, std::vector<VarDecl*>& deletedVarD
         if (newDomain->card() == 0) {
           env.fail();
         } else {
-          ident->decl()->ti()->domain(new SetLit(Location().introduce(), newDomain));
+          ident->decl()->ti()->domain(SetLit::a(newDomain));
           ident->decl()->ti()->setComputedDomain(false);
 
           if (newDomain->min() == newDomain->max()) {
@@ -1291,7 +1291,7 @@ bool simplify_constraint(EnvI& env, Item* ii, std::vector<VarDecl*>& deletedVarD
             CollectDecls cd(env.varOccurrences, deletedVarDecls, ii);
             top_down(cd, c);
             vd->e(IntLit::a(v));
-            vd->ti()->domain(new SetLit(Location().introduce(), IntSetVal::a(v, v)));
+            vd->ti()->domain(SetLit::a(IntSetVal::a(v, v)));
             vd->ti()->setComputedDomain(true);
             push_vardecl(env, env.varOccurrences.find(vd), vardeclQueue);
             push_dependent_constraints(env, vd->id(), constraintQueue);
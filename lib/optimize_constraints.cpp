@@ -16,13 +16,14 @@
 namespace MiniZinc {
 
 void OptimizeRegistry::reg(const MiniZinc::ASTString& call, optimizer opt) {
-  _m.insert(std::make_pair(call, opt));
+  _names.emplace_back(call.c_str(), call.size());
+  _m.insert(std::make_pair(std::make_pair(_names.back().c_str(), _names.back().size()), opt));
 }
 
 OptimizeRegistry::ConstraintStatus OptimizeRegistry::process(EnvI& env, MiniZinc::Item* i,
                                                              MiniZinc::Call* c,
                                                              Expression*& rewrite) {
-  auto it = _m.find(c->id());
+  auto it = _m.find(std::make_pair(c->id().c_str(), c->id().size()));
   if (it != _m.end()) {
     return it->second(env, i, c, rewrite);
   }
@@ -464,19 +465,11 @@ OptimizeRegistry::ConstraintStatus o_int_le(EnvI& env, Item* i, Call* c, Express
 }
 
 class Register {
-private:
-  Model* _keepAliveModel;
-
 public:
   Register() {
     GCLock lock;
-    _keepAliveModel = new Model;
     ASTString id_element("array_int_element");
     ASTString id_var_element("array_var_int_element");
-    std::vector<Expression*> e;
-    e.push_back(new StringLit(Location(), id_element));
-    e.push_back(new StringLit(Location(), id_var_element));
-    _keepAliveModel->addItem(new ConstraintI(Location(), new ArrayLit(Location(), e)));
     OptimizeRegistry::registry().reg(constants().ids.int_.lin_eq, o_linear);
     OptimizeRegistry::registry().reg(constants().ids.int_.lin_le, o_linear);
     OptimizeRegistry::registry().reg(constants().ids.int_.lin_ne, o_linear);
@@ -492,7 +485,6 @@ public:
     OptimizeRegistry::registry().reg(constants().ids.int_.ne, o_int_ne);
     OptimizeRegistry::registry().reg(constants().ids.int_.le, o_int_le);
   }
-  ~Register() { delete _keepAliveModel; }
 } _r;
 
 }  // namespace Optimizers
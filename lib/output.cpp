@@ -651,7 +651,8 @@ void create_dzn_output_item(EnvI& e, bool outputObjective, bool includeOutputIte
       }
       if (process_var) {
         std::ostringstream s;
-        s << vd->id()->str() << " = ";
+        vd->id()->printStr(s);
+        s << " = ";
         bool needArrayXd = false;
         if (vd->type().dim() > 0) {
           ArrayLit* al = nullptr;
@@ -816,8 +817,9 @@ ArrayLit* create_json_output(EnvI& e, bool outputObjective, bool includeOutputIt
         } else {
           s << ",\n";
         }
-        s << "  \"" << vd->id()->str() << "\""
-          << " : ";
+        s << "  \"";
+        vd->id()->printStr(s);
+        s << "\" : ";
         auto* sl = new StringLit(Location().introduce(), s.str());
         _outputVars.push_back(sl);
 
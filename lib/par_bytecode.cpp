@@ -0,0 +1,1365 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/exception.hh>
+#include <minizinc/par_bytecode.hh>
+
+#include <cmath>
+#include <functional>
+
+namespace MiniZinc {
+
+namespace {
+
+/// Kind of register
+enum Kind { K_NONE, K_INT, K_FLOAT, K_ARRAY };
+
+/// Return kind of register for values of type \a t (K_NONE if not supported)
+Kind kind_of(const Type& t) {
+  if (!t.isPar() || !t.isPresent() || t.cv() || t.st() != Type::ST_PLAIN || t.dim() < 0) {
+    return K_NONE;
+  }
+  switch (t.bt()) {
+    case Type::BT_INT:
+    case Type::BT_BOOL:
+      return t.dim() == 0 ? K_INT : K_ARRAY;
+    case Type::BT_FLOAT:
+      return t.dim() == 0 ? K_FLOAT : K_ARRAY;
+    default:
+      return K_NONE;
+  }
+}
+
+/// Operations of the register machine (i, f and a are the integer, float and array registers)
+enum Op : unsigned char {
+  OP_ICONST,    // i[a] = ints[b]
+  OP_FCONST,    // f[a] = floats[b]
+  OP_IMOV,      // i[a] = i[b]
+  OP_FMOV,      // f[a] = f[b]
+  OP_IADD,      // i[a] = i[b] + i[c]
+  OP_ISUB,      // i[a] = i[b] - i[c]
+  OP_IMUL,      // i[a] = i[b] * i[c]
+  OP_IDIV,      // i[a] = i[b] div i[c]
+  OP_IMOD,      // i[a] = i[b] mod i[c]
+  OP_IPOW,      // i[a] = pow(i[b], i[c])
+  OP_IMIN,      // i[a] = min(i[b], i[c])
+  OP_IMAX,      // i[a] = max(i[b], i[c])
+  OP_INEG,      // i[a] = -i[b]
+  OP_IABS,      // i[a] = abs(i[b])
+  OP_FADD,      // f[a] = f[b] + f[c]
+  OP_FSUB,      // f[a] = f[b] - f[c]
+  OP_FMUL,      // f[a] = f[b] * f[c]
+  OP_FDIV,      // f[a] = f[b] / f[c]
+  OP_FPOW,      // f[a] = pow(f[b], f[c])
+  OP_FMIN,      // f[a] = min(f[b], f[c])
+  OP_FMAX,      // f[a] = max(f[b], f[c])
+  OP_FNEG,      // f[a] = -f[b]
+  OP_FABS,      // f[a] = abs(f[b])
+  OP_ILT,       // i[a] = i[b] < i[c]
+  OP_ILE,       // i[a] = i[b] <= i[c]
+  OP_IEQ,       // i[a] = i[b] = i[c]
+  OP_INE,       // i[a] = i[b] != i[c]
+  OP_FLT,       // i[a] = f[b] < f[c]
+  OP_FLE,       // i[a] = f[b] <= f[c]
+  OP_FEQ,       // i[a] = f[b] = f[c]
+  OP_FNE,       // i[a] = f[b] != f[c]
+  OP_NOT,       // i[a] = not i[b]
+  OP_INRANGE,   // i[a] = i[b] in i[c]..i[d]
+  OP_I2F,       // f[a] = i[b]
+  OP_JMP,       // jump to a
+  OP_JF,        // jump to b if i[a] is false
+  OP_JT,        // jump to b if i[a] is true
+  OP_JGT,       // jump to c if i[a] > i[b]
+  OP_INC,       // i[a] = i[a] + 1
+  OP_FINITE,    // fail if i[a] is infinite
+  OP_CHECK,     // fail if i[a] is false
+  OP_NONNEG,    // fail if i[a] is negative
+  OP_GINT,      // i[a] = value of global parameter b
+  OP_GFLOAT,    // f[a] = value of global parameter b
+  OP_GARRAY,    // a[a] = value of global parameter b
+  OP_GSET,      // i[a]..i[c] = value of global set parameter b
+  OP_INDEXSET,  // i[a]..i[c] = index set of one-dimensional array a[b]
+  OP_AINT,      // i[a] = a[b][i[c], ..., i[c+d-1]]
+  OP_AFLOAT,    // f[a] = a[b][i[c], ..., i[c+d-1]]
+  OP_CALL,      // a = callees[b](registers callArgs[c], ...)
+  OP_RET        // return
+};
+
+/// Instruction of the register machine
+struct Instr {
+  Op op;
+  int a;
+  int b;
+  int c;
+  int d;
+};
+
+/// Maximum depth of nested calls made by programs
+const unsigned int max_depth = 1000;
+
+/// Return the current value of global parameter \a vd
+Expression* global_value(VarDecl* vd) {
+  while (vd->flat() != nullptr && vd->flat() != vd) {
+    vd = vd->flat();
+  }
+  return vd->e();
+}
+
+/// Return literal \a e, or the value of the global parameter \a e refers to
+Expression* literal(Expression* e) {
+  if (e != nullptr && e->isa<Id>()) {
+    VarDecl* vd = e->cast<Id>()->decl();
+    return vd != nullptr && vd->toplevel() ? global_value(vd) : nullptr;
+  }
+  return e;
+}
+
+/// Store integer value of literal \a e in \a v
+bool int_value(Expression* e, IntVal& v) {
+  if (e == nullptr) {
+    return false;
+  }
+  if (auto* il = e->dynamicCast<IntLit>()) {
+    v = il->v();
+    return true;
+  }
+  if (auto* bl = e->dynamicCast<BoolLit>()) {
+    v = bl->v() ? 1 : 0;
+    return true;
+  }
+  return false;
+}
+
+/// Store float value of literal \a e in \a v
+bool float_value(Expression* e, FloatVal& v) {
+  if (e == nullptr) {
+    return false;
+  }
+  if (auto* fl = e->dynamicCast<FloatLit>()) {
+    v = fl->v();
+    return true;
+  }
+  return false;
+}
+
+/// Compute the position of the element of \a al at indices \a idx (false if out of bounds)
+bool element_index(ArrayLit* al, const IntVal* idx, int n, unsigned int& k) {
+  if (static_cast<int>(al->dims()) != n) {
+    return false;
+  }
+  long long int pos = 0;
+  for (int j = 0; j < n; j++) {
+    const IntVal& x = idx[j];
+    const int lo = al->min(j);
+    const int hi = al->max(j);
+    if (!x.isFinite() || x < lo || x > hi) {
+      return false;
+    }
+    pos = pos * (static_cast<long long int>(hi) - lo + 1) + (x.toInt() - lo);
+  }
+  k = static_cast<unsigned int>(pos);
+  return k < al->size();
+}
+
+}  // namespace
+
+class ParBytecode::Program {
+public:
+  enum State { S_COMPILING, S_OK, S_FAILED };
+  State state = S_COMPILING;
+  /// Kind of the result
+  Kind result = K_NONE;
+  /// Register of the result
+  int resultReg = 0;
+  /// Kinds and registers of the parameters
+  std::vector<std::pair<Kind, int> > params;
+  /// The code
+  std::vector<Instr> code;
+  /// Integer constants
+  std::vector<IntVal> ints;
+  /// Float constants
+  std::vector<FloatVal> floats;
+  /// Global parameters
+  std::vector<VarDecl*> globals;
+  /// Called programs
+  std::vector<Program*> callees;
+  /// Argument registers of calls
+  std::vector<int> callArgs;
+  /// Number of registers of each kind
+  int nInts = 0;
+  int nFloats = 0;
+  int nArrays = 0;
+  /// Number of successful runs
+  unsigned long long int runs = 0;
+  /// Number of failed runs
+  unsigned long long int failures = 0;
+
+  /// Whether the program is used (programs that fail more often than not are disabled)
+  bool enabled() const { return state == S_OK && (failures <= 64 || failures <= runs); }
+};
+
+/// Compiler from expressions to programs
+class ParBytecode::Compiler {
+protected:
+  ParBytecode& _pb;
+  Program& _p;
+  /// Registers of parameters, let variables and generator variables
+  std::unordered_map<VarDecl*, int> _regs;
+
+  int emit(Op op, int a = 0, int b = 0, int c = 0, int d = 0) {
+    _p.code.push_back(Instr{op, a, b, c, d});
+    return static_cast<int>(_p.code.size()) - 1;
+  }
+  /// Set target of jump instruction \a i to the next instruction
+  void patch(int i) {
+    Instr& in = _p.code[i];
+    const int here = static_cast<int>(_p.code.size());
+    switch (in.op) {
+      case OP_JMP:
+        in.a = here;
+        break;
+      case OP_JGT:
+        in.c = here;
+        break;
+      default:
+        in.b = here;
+        break;
+    }
+  }
+  int newReg(Kind k) {
+    switch (k) {
+      case K_INT:
+        return _p.nInts++;
+      case K_FLOAT:
+        return _p.nFloats++;
+      default:
+        return _p.nArrays++;
+    }
+  }
+  int intConst(const IntVal& v) {
+    int r = newReg(K_INT);
+    emit(OP_ICONST, r, static_cast<int>(_p.ints.size()));
+    _p.ints.push_back(v);
+    return r;
+  }
+  int floatConst(const FloatVal& v) {
+    int r = newReg(K_FLOAT);
+    emit(OP_FCONST, r, static_cast<int>(_p.floats.size()));
+    _p.floats.push_back(v);
+    return r;
+  }
+  int global(VarDecl* vd) {
+    for (unsigned int i = 0; i < _p.globals.size(); i++) {
+      if (_p.globals[i] == vd) {
+        return static_cast<int>(i);
+      }
+    }
+    _p.globals.push_back(vd);
+    return static_cast<int>(_p.globals.size()) - 1;
+  }
+
+  int compileId(Id* id, Kind k);
+  int compileArray(Expression* e);
+  int compileAccess(ArrayAccess* aa, Kind k);
+  int compileITE(ITE* ite, Kind k);
+  int compileBinOp(BinOp* bo, Kind k);
+  int compileUnOp(UnOp* uo, Kind k);
+  int compileLet(Let* let, Kind k);
+  int compileCall(Call* c, Kind k);
+  int compileUserCall(FunctionI* fn, const std::vector<Expression*>& args, Kind k);
+  int compileAggregate(Call* c, Kind k);
+  bool compileGenerators(Comprehension* comp, unsigned int g, unsigned int d, int lo, int hi,
+                         const std::function<bool()>& body);
+  bool compileRange(Expression* in, int& lo, int& hi);
+  /// Load bounds of set literal \a sl, which must be a single range
+  bool setBounds(SetLit* sl, int& lo, int& hi) {
+    IntSetVal* isv = sl->isv();
+    if (isv == nullptr || isv->size() > 1) {
+      return false;
+    }
+    lo = intConst(isv->size() == 0 ? IntVal(1) : isv->min(0));
+    hi = intConst(isv->size() == 0 ? IntVal(0) : isv->max(0));
+    return true;
+  }
+
+public:
+  Compiler(ParBytecode& pb, Program& p) : _pb(pb), _p(p) {}
+  /// Compile the body of \a fn
+  bool compile(FunctionI* fn);
+  /// Compile \a e into a register of kind \a k (returns -1 if not supported)
+  int compile(Expression* e, Kind k);
+};
+
+bool ParBytecode::Compiler::compile(FunctionI* fn) {
+  if (fn->e() == nullptr) {
+    return false;
+  }
+  _p.result = kind_of(fn->ti()->type());
+  if (_p.result != K_INT && _p.result != K_FLOAT) {
+    return false;
+  }
+  for (unsigned int i = 0; i < fn->params().size(); i++) {
+    VarDecl* vd = fn->params()[i];
+    Kind k = kind_of(vd->type());
+    if (k == K_NONE) {
+      return false;
+    }
+    int r = newReg(k);
+    _regs[vd] = r;
+    _p.params.emplace_back(k, r);
+  }
+  int r = compile(fn->e(), _p.result);
+  if (r < 0) {
+    return false;
+  }
+  _p.resultReg = r;
+  emit(OP_RET);
+  return true;
+}
+
+int ParBytecode::Compiler::compile(Expression* e, Kind k) {
+  if (e == nullptr) {
+    return -1;
+  }
+  Kind ek = kind_of(e->type());
+  if (k == K_FLOAT && ek == K_INT) {
+    int r = compile(e, K_INT);
+    if (r < 0) {
+      return -1;
+    }
+    int f = newReg(K_FLOAT);
+    emit(OP_I2F, f, r);
+    return f;
+  }
+  if (ek != k || (k != K_INT && k != K_FLOAT)) {
+    return -1;
+  }
+  switch (e->eid()) {
+    case Expression::E_INTLIT:
+      return intConst(e->cast<IntLit>()->v());
+    case Expression::E_BOOLLIT:
+      return intConst(e->cast<BoolLit>()->v() ? 1 : 0);
+    case Expression::E_FLOATLIT:
+      return floatConst(e->cast<FloatLit>()->v());
+    case Expression::E_ID:
+      return compileId(e->cast<Id>(), k);
+    case Expression::E_ARRAYACCESS:
+      return compileAccess(e->cast<ArrayAccess>(), k);
+    case Expression::E_ITE:
+      return compileITE(e->cast<ITE>(), k);
+    case Expression::E_BINOP:
+      return compileBinOp(e->cast<BinOp>(), k);
+    case Expression::E_UNOP:
+      return compileUnOp(e->cast<UnOp>(), k);
+    case Expression::E_LET:
+      return compileLet(e->cast<Let>(), k);
+    case Expression::E_CALL:
+      return compileCall(e->cast<Call>(), k);
+    default:
+      return -1;
+  }
+}
+
+int ParBytecode::Compiler::compileId(Id* id, Kind k) {
+  VarDecl* vd = id->decl();
+  if (vd == nullptr || kind_of(vd->type()) != k) {
+    return -1;
+  }
+  auto it = _regs.find(vd);
+  if (it != _regs.end()) {
+    return it->second;
+  }
+  if (!vd->toplevel()) {
+    return -1;
+  }
+  int r = newReg(k);
+  emit(k == K_INT ? OP_GINT : k == K_FLOAT ? OP_GFLOAT : OP_GARRAY, r, global(vd));
+  return r;
+}
+
+int ParBytecode::Compiler::compileArray(Expression* e) {
+  if (e == nullptr || !e->isa<Id>() || kind_of(e->type()) != K_ARRAY) {
+    return -1;
+  }
+  return compileId(e->cast<Id>(), K_ARRAY);
+}
+
+int ParBytecode::Compiler::compileAccess(ArrayAccess* aa, Kind k) {
+  int arr = compileArray(aa->v());
+  if (arr < 0) {
+    return -1;
+  }
+  std::vector<int> idx(aa->idx().size());
+  for (unsigned int i = 0; i < idx.size(); i++) {
+    if (!aa->idx()[i]->type().isint() || (idx[i] = compile(aa->idx()[i], K_INT)) < 0) {
+      return -1;
+    }
+  }
+  // The indices have to be in consecutive registers
+  int first = idx.empty() ? 0 : idx[0];
+  if (idx.size() > 1) {
+    first = _p.nInts;
+    _p.nInts += static_cast<int>(idx.size());
+    for (unsigned int i = 0; i < idx.size(); i++) {
+      emit(OP_IMOV, first + static_cast<int>(i), idx[i]);
+    }
+  }
+  int r = newReg(k);
+  emit(k == K_INT ? OP_AINT : OP_AFLOAT, r, arr, first, static_cast<int>(idx.size()));
+  return r;
+}
+
+int ParBytecode::Compiler::compileITE(ITE* ite, Kind k) {
+  if (ite->elseExpr() == nullptr) {
+    return -1;
+  }
+  const Op mov = k == K_INT ? OP_IMOV : OP_FMOV;
+  int r = newReg(k);
+  std::vector<int> ends;
+  for (int i = 0; i < ite->size(); i++) {
+    if (!ite->ifExpr(i)->type().isbool()) {
+      return -1;
+    }
+    int c = compile(ite->ifExpr(i), K_INT);
+    if (c < 0) {
+      return -1;
+    }
+    int next = emit(OP_JF, c);
+    int t = compile(ite->thenExpr(i), k);
+    if (t < 0) {
+      return -1;
+    }
+    emit(mov, r, t);
+    ends.push_back(emit(OP_JMP));
+    patch(next);
+  }
+  int e = compile(ite->elseExpr(), k);
+  if (e < 0) {
+    return -1;
+  }
+  emit(mov, r, e);
+  for (int i : ends) {
+    patch(i);
+  }
+  return r;
+}
+
+int ParBytecode::Compiler::compileBinOp(BinOp* bo, Kind k) {
+  if (bo->decl() != nullptr && bo->decl()->e() != nullptr) {
+    return compileUserCall(bo->decl(), {bo->lhs(), bo->rhs()}, k);
+  }
+  const Type& lt = bo->lhs()->type();
+  const Type& rt = bo->rhs()->type();
+  if (bo->type().isbool()) {
+    if (lt.isbool() && rt.isbool()) {
+      switch (bo->op()) {
+        case BOT_AND:
+        case BOT_OR:
+        case BOT_IMPL:
+        case BOT_RIMPL: {
+          // Short-circuit evaluation in the same order as eval_bool
+          bool rimpl = bo->op() == BOT_RIMPL;
+          int r = newReg(K_INT);
+          int a = compile(rimpl ? bo->rhs() : bo->lhs(), K_INT);
+          if (a < 0) {
+            return -1;
+          }
+          if (bo->op() == BOT_IMPL || rimpl) {
+            emit(OP_NOT, r, a);
+          } else {
+            emit(OP_IMOV, r, a);
+          }
+          int skip = emit(bo->op() == BOT_AND ? OP_JF : OP_JT, r);
+          int b = compile(rimpl ? bo->lhs() : bo->rhs(), K_INT);
+          if (b < 0) {
+            return -1;
+          }
+          emit(OP_IMOV, r, b);
+          patch(skip);
+          return r;
+        }
+        case BOT_EQUIV:
+        case BOT_XOR:
+        case BOT_LE:
+        case BOT_LQ:
+        case BOT_GR:
+        case BOT_GQ:
+        case BOT_EQ:
+        case BOT_NQ:
+          break;
+        default:
+          return -1;
+      }
+    }
+    if (bo->op() == BOT_IN) {
+      // Only membership in a range
+      if (!lt.isint() || !rt.isIntSet()) {
+        return -1;
+      }
+      int x = compile(bo->lhs(), K_INT);
+      int lo = -1;
+      int hi = -1;
+      if (auto* sl = bo->rhs()->dynamicCast<SetLit>()) {
+        if (x < 0 || !setBounds(sl, lo, hi)) {
+          return -1;
+        }
+      } else {
+        auto* range = bo->rhs()->dynamicCast<BinOp>();
+        if (x < 0 || range == nullptr || range->op() != BOT_DOTDOT ||
+            (range->decl() != nullptr && range->decl()->e() != nullptr)) {
+          return -1;
+        }
+        lo = compile(range->lhs(), K_INT);
+        hi = lo < 0 ? -1 : compile(range->rhs(), K_INT);
+        if (hi < 0) {
+          return -1;
+        }
+      }
+      int r = newReg(K_INT);
+      emit(OP_INRANGE, r, x, lo, hi);
+      return r;
+    }
+    Kind ok;
+    if ((lt.isbool() && rt.isbool()) || (lt.isint() && rt.isint())) {
+      ok = K_INT;
+    } else if (lt.isfloat() && rt.isfloat()) {
+      ok = K_FLOAT;
+    } else {
+      return -1;
+    }
+    int a = compile(bo->lhs(), ok);
+    int b = a < 0 ? -1 : compile(bo->rhs(), ok);
+    if (b < 0) {
+      return -1;
+    }
+    const bool isInt = ok == K_INT;
+    int r = newReg(K_INT);
+    switch (bo->op()) {
+      case BOT_LE:
+        emit(isInt ? OP_ILT : OP_FLT, r, a, b);
+        break;
+      case BOT_LQ:
+        emit(isInt ? OP_ILE : OP_FLE, r, a, b);
+        break;
+      case BOT_GR:
+        emit(isInt ? OP_ILT : OP_FLT, r, b, a);
+        break;
+      case BOT_GQ:
+        emit(isInt ? OP_ILE : OP_FLE, r, b, a);
+        break;
+      case BOT_EQ:
+      case BOT_EQUIV:
+        emit(isInt ? OP_IEQ : OP_FEQ, r, a, b);
+        break;
+      case BOT_NQ:
+      case BOT_XOR:
+        emit(isInt ? OP_INE : OP_FNE, r, a, b);
+        break;
+      default:
+        return -1;
+    }
+    return r;
+  }
+  if (k == K_INT && bo->type().isint()) {
+    if (!lt.isint() || !rt.isint()) {
+      return -1;
+    }
+    Op op;
+    switch (bo->op()) {
+      case BOT_PLUS:
+        op = OP_IADD;
+        break;
+      case BOT_MINUS:
+        op = OP_ISUB;
+        break;
+      case BOT_MULT:
+        op = OP_IMUL;
+        break;
+      case BOT_POW:
+        op = OP_IPOW;
+        break;
+      case BOT_IDIV:
+        op = OP_IDIV;
+        break;
+      case BOT_MOD:
+        op = OP_IMOD;
+        break;
+      default:
+        return -1;
+    }
+    int a = compile(bo->lhs(), K_INT);
+    int b = a < 0 ? -1 : compile(bo->rhs(), K_INT);
+    if (b < 0) {
+      return -1;
+    }
+    int r = newReg(K_INT);
+    emit(op, r, a, b);
+    return r;
+  }
+  if (k == K_FLOAT && bo->type().isfloat()) {
+    Op op;
+    switch (bo->op()) {
+      case BOT_PLUS:
+        op = OP_FADD;
+        break;
+      case BOT_MINUS:
+        op = OP_FSUB;
+        break;
+      case BOT_MULT:
+        op = OP_FMUL;
+        break;
+      case BOT_POW:
+        op = OP_FPOW;
+        break;
+      case BOT_DIV:
+        op = OP_FDIV;
+        break;
+      default:
+        return -1;
+    }
+    int a = compile(bo->lhs(), K_FLOAT);
+    int b = a < 0 ? -1 : compile(bo->rhs(), K_FLOAT);
+    if (b < 0) {
+      return -1;
+    }
+    int r = newReg(K_FLOAT);
+    emit(op, r, a, b);
+    return r;
+  }
+  return -1;
+}
+
+int ParBytecode::Compiler::compileUnOp(UnOp* uo, Kind k) {
+  if (uo->decl() != nullptr && uo->decl()->e() != nullptr) {
+    return compileUserCall(uo->decl(), {uo->e()}, k);
+  }
+  int a = compile(uo->e(), uo->type().isbool() ? K_INT : k);
+  if (a < 0) {
+    return -1;
+  }
+  switch (uo->op()) {
+    case UOT_NOT: {
+      if (!uo->type().isbool()) {
+        return -1;
+      }
+      int r = newReg(K_INT);
+      emit(OP_NOT, r, a);
+      return r;
+    }
+    case UOT_PLUS:
+      return uo->type().isbool() ? -1 : a;
+    case UOT_MINUS: {
+      if (uo->type().isbool()) {
+        return -1;
+      }
+      int r = newReg(k);
+      emit(k == K_INT ? OP_INEG : OP_FNEG, r, a);
+      return r;
+    }
+    default:
+      return -1;
+  }
+}
+
+int ParBytecode::Compiler::compileLet(Let* let, Kind k) {
+  ASTExprVec<Expression> orig = let->letOrig();
+  std::vector<VarDecl*> bound;
+  bool ok = true;
+  for (unsigned int i = 0, j = 0; ok && i < let->let().size(); i++) {
+    if (auto* vd = let->let()[i]->dynamicCast<VarDecl>()) {
+      // Use the original right hand side, the declaration may be bound by an evaluation
+      Expression* init = orig[j++];
+      j += vd->ti()->ranges().size();
+      Kind vk = kind_of(vd->type());
+      int v = -1;
+      if (vd->ti()->domain() == nullptr && (vk == K_INT || vk == K_FLOAT)) {
+        v = compile(init, vk);
+      }
+      ok = v >= 0;
+      if (ok) {
+        _regs[vd] = v;
+        bound.push_back(vd);
+      }
+    } else {
+      // A par constraint that does not hold makes the let undefined
+      int c = let->let()[i]->type().isbool() ? compile(let->let()[i], K_INT) : -1;
+      ok = c >= 0;
+      if (ok) {
+        emit(OP_CHECK, c);
+      }
+    }
+  }
+  int r = ok ? compile(let->in(), k) : -1;
+  for (VarDecl* vd : bound) {
+    _regs.erase(vd);
+  }
+  return r;
+}
+
+int ParBytecode::Compiler::compileUserCall(FunctionI* fn, const std::vector<Expression*>& args,
+                                           Kind k) {
+  // Only functions without builtins, and without parameter or result domains that would have
+  // to be checked
+  if (fn->builtins.e != nullptr || fn->builtins.i != nullptr || fn->builtins.f != nullptr ||
+      fn->builtins.b != nullptr || fn->builtins.s != nullptr || fn->builtins.str != nullptr) {
+    return -1;
+  }
+  if (fn->ti()->domain() != nullptr && !fn->ti()->domain()->isa<TIId>()) {
+    return -1;
+  }
+  if (fn->params().size() != args.size()) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < fn->params().size(); i++) {
+    TypeInst* ti = fn->params()[i]->ti();
+    if (ti->domain() != nullptr && !ti->domain()->isa<TIId>()) {
+      return -1;
+    }
+    for (unsigned int j = 0; j < ti->ranges().size(); j++) {
+      Expression* dom = ti->ranges()[j]->domain();
+      if (dom != nullptr && !dom->isa<TIId>()) {
+        return -1;
+      }
+    }
+  }
+  Program* callee = _pb.program(fn);
+  if (callee == nullptr || callee->result != k) {
+    return -1;
+  }
+  std::vector<int> regs(args.size());
+  for (unsigned int i = 0; i < args.size(); i++) {
+    Kind pk = callee->params[i].first;
+    regs[i] = pk == K_ARRAY ? compileArray(args[i]) : compile(args[i], pk);
+    if (regs[i] < 0) {
+      return -1;
+    }
+  }
+  int r = newReg(callee->result);
+  emit(OP_CALL, r, static_cast<int>(_p.callees.size()), static_cast<int>(_p.callArgs.size()));
+  _p.callees.push_back(callee);
+  _p.callArgs.insert(_p.callArgs.end(), regs.begin(), regs.end());
+  return r;
+}
+
+int ParBytecode::Compiler::compileCall(Call* c, Kind k) {
+  FunctionI* fn = c->decl();
+  if (fn == nullptr) {
+    return -1;
+  }
+  if (fn->e() != nullptr) {
+    std::vector<Expression*> args(c->argCount());
+    for (unsigned int i = 0; i < c->argCount(); i++) {
+      args[i] = c->arg(i);
+    }
+    return compileUserCall(fn, args, k);
+  }
+  if (c->argCount() == 1 && c->arg(0)->isa<Comprehension>() &&
+      (c->id() == constants().ids.sum || c->id() == constants().ids.forall ||
+       c->id() == constants().ids.exists)) {
+    return compileAggregate(c, k);
+  }
+  if (c->argCount() == 1 && c->id() == constants().ids.bool2int && fn->builtins.i != nullptr) {
+    return c->arg(0)->type().isbool() ? compile(c->arg(0), K_INT) : -1;
+  }
+  if (c->argCount() == 1 && c->id() == constants().ids.int2float && fn->builtins.f != nullptr) {
+    return c->arg(0)->type().isint() ? compile(c->arg(0), K_FLOAT) : -1;
+  }
+  const bool isInt = k == K_INT && c->type().isint() && fn->builtins.i != nullptr;
+  const bool isFloat = k == K_FLOAT && c->type().isfloat() && fn->builtins.f != nullptr;
+  if (!isInt && !isFloat) {
+    return -1;
+  }
+  for (unsigned int i = 0; i < c->argCount(); i++) {
+    if (isInt ? !c->arg(i)->type().isint() : !c->arg(i)->type().isfloat()) {
+      return -1;
+    }
+  }
+  if (c->argCount() == 1 && c->id() == "abs") {
+    int a = compile(c->arg(0), k);
+    if (a < 0) {
+      return -1;
+    }
+    int r = newReg(k);
+    emit(isInt ? OP_IABS : OP_FABS, r, a);
+    return r;
+  }
+  if (c->argCount() == 2 && isInt && c->id() == "pow") {
+    // Like b_pow_int, which does not accept negative exponents
+    int a = compile(c->arg(0), k);
+    int b = a < 0 ? -1 : compile(c->arg(1), k);
+    if (b < 0) {
+      return -1;
+    }
+    emit(OP_NONNEG, b);
+    int r = newReg(k);
+    emit(OP_IPOW, r, a, b);
+    return r;
+  }
+  if (c->argCount() == 2 && (c->id() == "min" || c->id() == "max")) {
+    int a = compile(c->arg(0), k);
+    int b = a < 0 ? -1 : compile(c->arg(1), k);
+    if (b < 0) {
+      return -1;
+    }
+    int r = newReg(k);
+    if (c->id() == "min") {
+      emit(isInt ? OP_IMIN : OP_FMIN, r, a, b);
+    } else {
+      emit(isInt ? OP_IMAX : OP_FMAX, r, a, b);
+    }
+    return r;
+  }
+  return -1;
+}
+
+int ParBytecode::Compiler::compileAggregate(Call* c, Kind k) {
+  auto* comp = c->arg(0)->cast<Comprehension>();
+  FunctionI* fn = c->decl();
+  if (comp->set() || comp->numberOfGenerators() == 0) {
+    return -1;
+  }
+  Kind ek;
+  if (c->id() == constants().ids.sum) {
+    if (k == K_INT && comp->e()->type().isint() && fn->builtins.i != nullptr) {
+      ek = K_INT;
+    } else if (k == K_FLOAT && comp->e()->type().isfloat() && fn->builtins.f != nullptr) {
+      ek = K_FLOAT;
+    } else {
+      return -1;
+    }
+  } else if (k == K_INT && comp->e()->type().isbool() && fn->builtins.b != nullptr) {
+    ek = K_INT;
+  } else {
+    return -1;
+  }
+  int acc;
+  std::function<bool()> body;
+  if (c->id() == constants().ids.sum) {
+    // Add the elements in order, starting from 0 (like b_sum_int and b_sum_float)
+    acc = ek == K_INT ? intConst(0) : floatConst(0.0);
+    body = [this, comp, ek, acc]() {
+      int v = compile(comp->e(), ek);
+      if (v < 0) {
+        return false;
+      }
+      emit(ek == K_INT ? OP_IADD : OP_FADD, acc, acc, v);
+      return true;
+    };
+  } else {
+    // All elements are evaluated, so that undefined elements make the program fail
+    const bool forall = c->id() == constants().ids.forall;
+    acc = intConst(forall ? 1 : 0);
+    int value = intConst(forall ? 0 : 1);
+    body = [this, comp, forall, acc, value]() {
+      int v = compile(comp->e(), K_INT);
+      if (v < 0) {
+        return false;
+      }
+      int skip = emit(forall ? OP_JT : OP_JF, v);
+      emit(OP_IMOV, acc, value);
+      patch(skip);
+      return true;
+    };
+  }
+  if (!compileGenerators(comp, 0, 0, -1, -1, body)) {
+    return -1;
+  }
+  return acc;
+}
+
+bool ParBytecode::Compiler::compileRange(Expression* in, int& lo, int& hi) {
+  if (in == nullptr || !in->type().isIntSet() || !in->type().isPar() || in->type().cv()) {
+    return false;
+  }
+  if (auto* sl = in->dynamicCast<SetLit>()) {
+    return setBounds(sl, lo, hi);
+  }
+  if (auto* bo = in->dynamicCast<BinOp>()) {
+    if (bo->op() != BOT_DOTDOT || (bo->decl() != nullptr && bo->decl()->e() != nullptr) ||
+        !bo->lhs()->type().isint() || !bo->rhs()->type().isint()) {
+      return false;
+    }
+    lo = compile(bo->lhs(), K_INT);
+    hi = lo < 0 ? -1 : compile(bo->rhs(), K_INT);
+    return hi >= 0;
+  }
+  if (auto* id = in->dynamicCast<Id>()) {
+    if (id->decl() == nullptr || !id->decl()->toplevel() || _regs.count(id->decl()) != 0) {
+      return false;
+    }
+    lo = newReg(K_INT);
+    hi = newReg(K_INT);
+    emit(OP_GSET, lo, global(id->decl()), hi);
+    return true;
+  }
+  if (auto* c = in->dynamicCast<Call>()) {
+    if (c->id() != "index_set" || c->argCount() != 1 || c->decl() == nullptr ||
+        c->decl()->e() != nullptr || c->decl()->builtins.s == nullptr ||
+        c->arg(0)->type().dim() != 1) {
+      return false;
+    }
+    int arr = compileArray(c->arg(0));
+    if (arr < 0) {
+      return false;
+    }
+    lo = newReg(K_INT);
+    hi = newReg(K_INT);
+    emit(OP_INDEXSET, lo, arr, hi);
+    return true;
+  }
+  return false;
+}
+
+bool ParBytecode::Compiler::compileGenerators(Comprehension* comp, unsigned int g,
+                                              unsigned int d, int lo, int hi,
+                                              const std::function<bool()>& body) {
+  if (g == comp->numberOfGenerators()) {
+    return body();
+  }
+  if (d == 0) {
+    // The set of a generator is evaluated once all previous generators are bound
+    if (!compileRange(comp->in(g), lo, hi)) {
+      return false;
+    }
+    emit(OP_FINITE, lo);
+    emit(OP_FINITE, hi);
+  }
+  VarDecl* vd = comp->decl(g, d);
+  if (!vd->type().isint()) {
+    return false;
+  }
+  int x = newReg(K_INT);
+  _regs[vd] = x;
+  emit(OP_IMOV, x, lo);
+  int loop = static_cast<int>(_p.code.size());
+  int exit = emit(OP_JGT, x, hi);
+  bool ok;
+  if (d + 1 < comp->numberOfDecls(g)) {
+    ok = compileGenerators(comp, g, d + 1, lo, hi, body);
+  } else {
+    int skip = -1;
+    if (Expression* where = comp->where(g)) {
+      if (kind_of(where->type()) != K_INT || !where->type().isbool()) {
+        return false;
+      }
+      int w = compile(where, K_INT);
+      if (w < 0) {
+        return false;
+      }
+      skip = emit(OP_JF, w);
+    }
+    ok = compileGenerators(comp, g + 1, 0, -1, -1, body);
+    if (skip >= 0) {
+      patch(skip);
+    }
+  }
+  _regs.erase(vd);
+  if (!ok) {
+    return false;
+  }
+  emit(OP_INC, x);
+  emit(OP_JMP, loop);
+  patch(exit);
+  return true;
+}
+
+ParBytecode::ParBytecode() : _calls(0), _fallbacks(0) {}
+
+ParBytecode::~ParBytecode() = default;
+
+ParBytecode::Program* ParBytecode::program(FunctionI* fn) {
+  auto it = _programs.find(fn);
+  if (it != _programs.end()) {
+    return it->second->state == Program::S_FAILED ? nullptr : it->second.get();
+  }
+  // Programs that are being compiled can be called (recursive functions), so the entry is
+  // created before compiling and kept if compilation fails
+  Program* p = new Program();
+  _programs[fn].reset(p);
+  Compiler c(*this, *p);
+  p->state = c.compile(fn) ? Program::S_OK : Program::S_FAILED;
+  return p->state == Program::S_OK ? p : nullptr;
+}
+
+unsigned int ParBytecode::compiled() const {
+  unsigned int n = 0;
+  for (const auto& p : _programs) {
+    if (p.second->state == Program::S_OK) {
+      n++;
+    }
+  }
+  return n;
+}
+
+ParBytecode::Program* ParBytecode::prepare(FunctionI* fn, const std::vector<Expression*>& args,
+                                           int kind) {
+  Program* p = program(fn);
+  if (p == nullptr || !p->enabled() || p->result != kind || p->params.size() != args.size()) {
+    return nullptr;
+  }
+  if (_ints.size() < static_cast<size_t>(p->nInts)) {
+    _ints.resize(p->nInts);
+  }
+  if (_floats.size() < static_cast<size_t>(p->nFloats)) {
+    _floats.resize(p->nFloats);
+  }
+  if (_arrays.size() < static_cast<size_t>(p->nArrays)) {
+    _arrays.resize(p->nArrays);
+  }
+  for (unsigned int i = 0; i < args.size(); i++) {
+    const int r = p->params[i].second;
+    bool ok;
+    switch (p->params[i].first) {
+      case K_INT:
+        ok = int_value(args[i], _ints[r]);
+        break;
+      case K_FLOAT:
+        ok = float_value(args[i], _floats[r]);
+        break;
+      default:
+        _arrays[r] = args[i] == nullptr ? nullptr : args[i]->dynamicCast<ArrayLit>();
+        ok = _arrays[r] != nullptr;
+        break;
+    }
+    if (!ok) {
+      _fallbacks++;
+      return nullptr;
+    }
+  }
+  return p;
+}
+
+bool ParBytecode::run(Program* p) {
+  bool ok;
+  try {
+    ok = run(p, 0, 0, 0, 0);
+  } catch (ArithmeticError&) {
+    ok = false;
+  }
+  if (ok) {
+    p->runs++;
+    _calls++;
+  } else {
+    p->failures++;
+    _fallbacks++;
+  }
+  return ok;
+}
+
+bool ParBytecode::run(Program* p, size_t ib, size_t fb, size_t ab, unsigned int depth) {
+  IntVal* ri = _ints.data() + ib;
+  FloatVal* rf = _floats.data() + fb;
+  ArrayLit** ra = _arrays.data() + ab;
+  const Instr* code = p->code.data();
+  for (size_t pc = 0;;) {
+    const Instr& in = code[pc++];
+    switch (in.op) {
+      case OP_ICONST:
+        ri[in.a] = p->ints[in.b];
+        break;
+      case OP_FCONST:
+        rf[in.a] = p->floats[in.b];
+        break;
+      case OP_IMOV:
+        ri[in.a] = ri[in.b];
+        break;
+      case OP_FMOV:
+        rf[in.a] = rf[in.b];
+        break;
+      case OP_IADD:
+        ri[in.a] = ri[in.b] + ri[in.c];
+        break;
+      case OP_ISUB:
+        ri[in.a] = ri[in.b] - ri[in.c];
+        break;
+      case OP_IMUL:
+        ri[in.a] = ri[in.b] * ri[in.c];
+        break;
+      case OP_IDIV:
+        if (ri[in.c] == 0) {
+          return false;
+        }
+        ri[in.a] = ri[in.b] / ri[in.c];
+        break;
+      case OP_IMOD:
+        if (ri[in.c] == 0) {
+          return false;
+        }
+        ri[in.a] = ri[in.b] % ri[in.c];
+        break;
+      case OP_IPOW: {
+        IntVal base = ri[in.b];
+        ri[in.a] = base.pow(ri[in.c]);
+      } break;
+      case OP_IMIN:
+        ri[in.a] = std::min(ri[in.b], ri[in.c]);
+        break;
+      case OP_IMAX:
+        ri[in.a] = std::max(ri[in.b], ri[in.c]);
+        break;
+      case OP_INEG:
+        ri[in.a] = -ri[in.b];
+        break;
+      case OP_IABS:
+        ri[in.a] = std::abs(ri[in.b]);
+        break;
+      case OP_FADD:
+        rf[in.a] = rf[in.b] + rf[in.c];
+        break;
+      case OP_FSUB:
+        rf[in.a] = rf[in.b] - rf[in.c];
+        break;
+      case OP_FMUL:
+        rf[in.a] = rf[in.b] * rf[in.c];
+        break;
+      case OP_FDIV:
+        if (rf[in.c] == 0.0) {
+          return false;
+        }
+        rf[in.a] = rf[in.b] / rf[in.c];
+        break;
+      case OP_FPOW:
+        rf[in.a] = std::pow(rf[in.b].toDouble(), rf[in.c].toDouble());
+        break;
+      case OP_FMIN:
+        rf[in.a] = std::min(rf[in.b], rf[in.c]);
+        break;
+      case OP_FMAX:
+        rf[in.a] = std::max(rf[in.b], rf[in.c]);
+        break;
+      case OP_FNEG:
+        rf[in.a] = -rf[in.b];
+        break;
+      case OP_FABS:
+        rf[in.a] = std::abs(rf[in.b]);
+        break;
+      case OP_ILT:
+        ri[in.a] = ri[in.b] < ri[in.c] ? 1 : 0;
+        break;
+      case OP_ILE:
+        ri[in.a] = ri[in.b] <= ri[in.c] ? 1 : 0;
+        break;
+      case OP_IEQ:
+        ri[in.a] = ri[in.b] == ri[in.c] ? 1 : 0;
+        break;
+      case OP_INE:
+        ri[in.a] = ri[in.b] != ri[in.c] ? 1 : 0;
+        break;
+      case OP_FLT:
+        ri[in.a] = rf[in.b] < rf[in.c] ? 1 : 0;
+        break;
+      case OP_FLE:
+        ri[in.a] = rf[in.b] <= rf[in.c] ? 1 : 0;
+        break;
+      case OP_FEQ:
+        ri[in.a] = rf[in.b] == rf[in.c] ? 1 : 0;
+        break;
+      case OP_FNE:
+        ri[in.a] = rf[in.b] != rf[in.c] ? 1 : 0;
+        break;
+      case OP_NOT:
+        ri[in.a] = ri[in.b] == 0 ? 1 : 0;
+        break;
+      case OP_INRANGE:
+        ri[in.a] = ri[in.c] <= ri[in.b] && ri[in.b] <= ri[in.d] ? 1 : 0;
+        break;
+      case OP_I2F:
+        if (!ri[in.b].isFinite()) {
+          return false;
+        }
+        rf[in.a] = static_cast<double>(ri[in.b].toInt());
+        break;
+      case OP_JMP:
+        pc = in.a;
+        break;
+      case OP_JF:
+        if (ri[in.a] == 0) {
+          pc = in.b;
+        }
+        break;
+      case OP_JT:
+        if (ri[in.a] != 0) {
+          pc = in.b;
+        }
+        break;
+      case OP_JGT:
+        if (ri[in.a] > ri[in.b]) {
+          pc = in.c;
+        }
+        break;
+      case OP_INC:
+        ri[in.a] = ri[in.a] + 1;
+        break;
+      case OP_FINITE:
+        if (!ri[in.a].isFinite()) {
+          return false;
+        }
+        break;
+      case OP_CHECK:
+        if (ri[in.a] == 0) {
+          return false;
+        }
+        break;
+      case OP_NONNEG:
+        if (ri[in.a] < 0) {
+          return false;
+        }
+        break;
+      case OP_GINT:
+        if (!int_value(global_value(p->globals[in.b]), ri[in.a])) {
+          return false;
+        }
+        break;
+      case OP_GFLOAT:
+        if (!float_value(global_value(p->globals[in.b]), rf[in.a])) {
+          return false;
+        }
+        break;
+      case OP_GARRAY: {
+        Expression* e = global_value(p->globals[in.b]);
+        ra[in.a] = e == nullptr ? nullptr : e->dynamicCast<ArrayLit>();
+        if (ra[in.a] == nullptr) {
+          return false;
+        }
+      } break;
+      case OP_GSET: {
+        Expression* e = global_value(p->globals[in.b]);
+        auto* sl = e == nullptr ? nullptr : e->dynamicCast<SetLit>();
+        IntSetVal* isv = sl == nullptr ? nullptr : sl->isv();
+        if (isv == nullptr || isv->size() > 1) {
+          return false;
+        }
+        ri[in.a] = isv->size() == 0 ? IntVal(1) : isv->min(0);
+        ri[in.c] = isv->size() == 0 ? IntVal(0) : isv->max(0);
+      } break;
+      case OP_INDEXSET: {
+        ArrayLit* al = ra[in.b];
+        if (al->dims() != 1) {
+          return false;
+        }
+        ri[in.a] = al->min(0);
+        ri[in.c] = al->max(0);
+      } break;
+      case OP_AINT: {
+        ArrayLit* al = ra[in.b];
+        unsigned int k;
+        if (!element_index(al, ri + in.c, in.d, k)) {
+          return false;
+        }
+        switch (al->parKind()) {
+          case ArrayLit::PK_INT:
+            ri[in.a] = al->parInts()[k];
+            break;
+          case ArrayLit::PK_BOOL:
+            ri[in.a] = al->parBool(k) ? 1 : 0;
+            break;
+          case ArrayLit::PK_FLOAT:
+            return false;
+          default:
+            if (!int_value(literal((*al)[k]), ri[in.a])) {
+              return false;
+            }
+            break;
+        }
+      } break;
+      case OP_AFLOAT: {
+        ArrayLit* al = ra[in.b];
+        unsigned int k;
+        if (!element_index(al, ri + in.c, in.d, k)) {
+          return false;
+        }
+        switch (al->parKind()) {
+          case ArrayLit::PK_FLOAT:
+            rf[in.a] = al->parFloats()[k];
+            break;
+          case ArrayLit::PK_NONE:
+            if (!float_value(literal((*al)[k]), rf[in.a])) {
+              return false;
+            }
+            break;
+          default:
+            return false;
+        }
+      } break;
+      case OP_CALL: {
+        Program* q = p->callees[in.b];
+        if (!q->enabled() || depth >= max_depth) {
+          return false;
+        }
+        const size_t qib = ib + p->nInts;
+        const size_t qfb = fb + p->nFloats;
+        const size_t qab = ab + p->nArrays;
+        if (_ints.size() < qib + q->nInts) {
+          _ints.resize(qib + q->nInts);
+        }
+        if (_floats.size() < qfb + q->nFloats) {
+          _floats.resize(qfb + q->nFloats);
+        }
+        if (_arrays.size() < qab + q->nArrays) {
+          _arrays.resize(qab + q->nArrays);
+        }
+        for (unsigned int i = 0; i < q->params.size(); i++) {
+          const int src = p->callArgs[in.c + i];
+          const int dst = q->params[i].second;
+          switch (q->params[i].first) {
+            case K_INT:
+              _ints[qib + dst] = _ints[ib + src];
+              break;
+            case K_FLOAT:
+              _floats[qfb + dst] = _floats[fb + src];
+              break;
+            default:
+              _arrays[qab + dst] = _arrays[ab + src];
+              break;
+          }
+        }
+        if (!run(q, qib, qfb, qab, depth + 1)) {
+          return false;
+        }
+        // The register files may have been reallocated
+        ri = _ints.data() + ib;
+        rf = _floats.data() + fb;
+        ra = _arrays.data() + ab;
+        if (q->result == K_INT) {
+          ri[in.a] = _ints[qib + q->resultReg];
+        } else {
+          rf[in.a] = _floats[qfb + q->resultReg];
+        }
+      } break;
+      case OP_RET:
+        return true;
+    }
+  }
+}
+
+bool ParBytecode::evalInt(FunctionI* fn, const std::vector<Expression*>& args, IntVal& ret) {
+  Program* p = prepare(fn, args, K_INT);
+  if (p == nullptr || !run(p)) {
+    return false;
+  }
+  ret = _ints[p->resultReg];
+  return true;
+}
+
+bool ParBytecode::evalBool(FunctionI* fn, const std::vector<Expression*>& args, bool& ret) {
+  Program* p = prepare(fn, args, K_INT);
+  if (p == nullptr || !run(p)) {
+    return false;
+  }
+  ret = _ints[p->resultReg] != 0;
+  return true;
+}
+
+bool ParBytecode::evalFloat(FunctionI* fn, const std::vector<Expression*>& args, FloatVal& ret) {
+  Program* p = prepare(fn, args, K_FLOAT);
+  if (p == nullptr || !run(p)) {
+    return false;
+  }
+  ret = _floats[p->resultReg];
+  return true;
+}
+
+}  // namespace MiniZinc
@@ -0,0 +1,1054 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/astiterator.hh>
+#include <minizinc/flatten_internal.hh>
+#include <minizinc/parallel_flatten.hh>
+#include <minizinc/prettyprinter.hh>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+namespace MiniZinc {
+
+std::string FlattenPartition::name(const VarDecl* vd) {
+  long long int idn = vd->id()->idn();
+  if (idn == -1) {
+    return std::string(vd->id()->v().c_str(), vd->id()->v().size());
+  }
+  return "X_INTRODUCED_" + std::to_string(idn) + "_";
+}
+
+namespace {
+
+class UnionFind {
+protected:
+  std::vector<unsigned int> _parent;
+
+public:
+  unsigned int add() {
+    auto a = static_cast<unsigned int>(_parent.size());
+    _parent.push_back(a);
+    return a;
+  }
+  unsigned int find(unsigned int a) {
+    while (_parent[a] != a) {
+      _parent[a] = _parent[_parent[a]];
+      a = _parent[a];
+    }
+    return a;
+  }
+  void unite(unsigned int a, unsigned int b) {
+    a = find(a);
+    b = find(b);
+    if (a < b) {
+      _parent[b] = a;
+    } else if (b < a) {
+      _parent[a] = b;
+    }
+  }
+};
+
+/// Atoms of the partition: atom 0 for the solve item, one atom per top-level variable,
+/// and one per user-defined function that returns a variable
+class PartitionAtoms {
+public:
+  UnionFind uf;
+  std::unordered_map<VarDecl*, unsigned int> vars;
+  struct Fn {
+    /// Atom for calls with par arguments, or -1
+    int atom = -1;
+    /// Atoms used by the function bodies (including all called user-defined functions)
+    std::set<unsigned int> uses;
+    /// Names of the user-defined functions called by the function bodies
+    std::set<std::string> callees;
+  };
+  std::unordered_map<std::string, Fn> fns;
+  PartitionAtoms() { uf.add(); }
+};
+
+/// Collect the atoms used by an expression
+class CollectAtoms : public EVisitor {
+protected:
+  PartitionAtoms& _pa;
+  std::set<unsigned int>& _atoms;
+  /// Names of called functions (only when collecting from a function body)
+  std::set<std::string>* _callees;
+
+  void fn(const ASTString& id, const Type& t, bool parArgs) {
+    std::string name(id.c_str(), id.size());
+    auto it = _pa.fns.find(name);
+    if (it == _pa.fns.end()) {
+      return;
+    }
+    if (_callees != nullptr) {
+      _callees->insert(name);
+    } else {
+      _atoms.insert(it->second.uses.begin(), it->second.uses.end());
+    }
+    if (it->second.atom >= 0 && t.isvar() && parArgs) {
+      _atoms.insert(static_cast<unsigned int>(it->second.atom));
+    }
+  }
+
+public:
+  CollectAtoms(PartitionAtoms& pa, std::set<unsigned int>& atoms,
+               std::set<std::string>* callees = nullptr)
+      : _pa(pa), _atoms(atoms), _callees(callees) {}
+  void vId(const Id& ident) {
+    auto it = _pa.vars.find(ident.decl());
+    if (it != _pa.vars.end()) {
+      _atoms.insert(it->second);
+    }
+  }
+  void vCall(const Call& c) {
+    bool parArgs = true;
+    for (unsigned int i = 0; i < c.argCount(); i++) {
+      parArgs = parArgs && c.arg(i)->type().isPar();
+    }
+    fn(c.id(), c.type(), parArgs);
+  }
+  void vBinOp(const BinOp& bo) {
+    if (bo.decl() != nullptr) {
+      fn(bo.decl()->id(), bo.type(), bo.lhs()->type().isPar() && bo.rhs()->type().isPar());
+    }
+  }
+  void vUnOp(const UnOp& uo) {
+    if (uo.decl() != nullptr) {
+      fn(uo.decl()->id(), uo.type(), uo.e()->type().isPar());
+    }
+  }
+};
+
+/// Collect the declarations referenced by an expression
+class CollectTopLevelDecls : public EVisitor {
+public:
+  std::vector<VarDecl*>& decls;
+  CollectTopLevelDecls(std::vector<VarDecl*>& decls0) : decls(decls0) {}
+  void vId(const Id& ident) {
+    VarDecl* vd = ident.decl();
+    if (vd != nullptr && vd->toplevel()) {
+      decls.push_back(vd);
+    }
+  }
+};
+
+class HasIds : public EVisitor {
+public:
+  bool found = false;
+  bool enter(Expression* /*e*/) const { return !found; }
+  void vId(const Id& /*ident*/) { found = true; }
+};
+
+}  // namespace
+
+bool FlattenPartition::compute(EnvI& env, unsigned int n) {
+  class Items : public ItemVisitor {
+  public:
+    std::vector<VarDecl*> vars;
+    std::vector<VarDecl*> pars;
+    std::vector<ConstraintI*> constraints;
+    std::vector<FunctionI*> fns;
+    SolveI* solve = nullptr;
+    void vVarDeclI(VarDeclI* vdi) {
+      if (vdi->e()->type().isAnn()) {
+        return;
+      }
+      (vdi->e()->type().isvar() ? vars : pars).push_back(vdi->e());
+    }
+    void vConstraintI(ConstraintI* ci) { constraints.push_back(ci); }
+    void vSolveI(SolveI* si) { solve = si; }
+    void vFunctionI(FunctionI* fi) {
+      if (!fi->fromStdLib()) {
+        fns.push_back(fi);
+      }
+    }
+  } items;
+  iter_items(items, env.model);
+
+  PartitionAtoms pa;
+  for (auto* vd : items.vars) {
+    pa.vars[vd] = pa.uf.add();
+  }
+  for (auto* fi : items.fns) {
+    PartitionAtoms::Fn& f = pa.fns[std::string(fi->id().c_str(), fi->id().size())];
+    if (f.atom < 0 && fi->ti()->type().isvar()) {
+      f.atom = static_cast<int>(pa.uf.add());
+    }
+  }
+  // Atoms used by function bodies, closed over the user-defined functions they call
+  for (auto* fi : items.fns) {
+    if (fi->e() != nullptr) {
+      PartitionAtoms::Fn& f = pa.fns[std::string(fi->id().c_str(), fi->id().size())];
+      CollectAtoms ca(pa, f.uses, &f.callees);
+      top_down(ca, fi->e());
+    }
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto& f : pa.fns) {
+      for (const auto& callee : f.second.callees) {
+        if (callee == f.first) {
+          continue;
+        }
+        for (unsigned int a : pa.fns.find(callee)->second.uses) {
+          changed = f.second.uses.insert(a).second || changed;
+        }
+      }
+    }
+  }
+
+  auto collect = [&pa](Expression* e, std::set<unsigned int>& atoms) {
+    if (e != nullptr) {
+      CollectAtoms ca(pa, atoms);
+      top_down(ca, e);
+    }
+  };
+  auto unite = [&pa](unsigned int a, const std::set<unsigned int>& atoms) {
+    for (unsigned int b : atoms) {
+      pa.uf.unite(a, b);
+    }
+  };
+
+  // Par declarations are evaluated in every group, so they must not depend on variables
+  for (auto* vd : items.pars) {
+    std::set<unsigned int> atoms;
+    collect(vd->e(), atoms);
+    collect(vd->ti(), atoms);
+    if (!atoms.empty()) {
+      return false;
+    }
+  }
+  for (auto* vd : items.vars) {
+    std::set<unsigned int> atoms;
+    collect(vd, atoms);
+    unite(pa.vars[vd], atoms);
+  }
+  std::vector<unsigned int> constraintAtoms(items.constraints.size());
+  for (unsigned int i = 0; i < items.constraints.size(); i++) {
+    std::set<unsigned int> atoms;
+    collect(items.constraints[i]->e(), atoms);
+    constraintAtoms[i] = atoms.empty() ? 0 : *atoms.begin();
+    unite(constraintAtoms[i], atoms);
+  }
+  if (items.solve != nullptr) {
+    std::set<unsigned int> atoms;
+    collect(items.solve->e(), atoms);
+    for (ExpressionSetIter it = items.solve->ann().begin(); it != items.solve->ann().end(); ++it) {
+      collect(*it, atoms);
+    }
+    unite(0, atoms);
+  }
+
+  // Components in the order of their first constraint, with their number of constraints
+  std::vector<unsigned int> roots;
+  std::unordered_map<unsigned int, size_t> weight;
+  unsigned int root0 = pa.uf.find(0);
+  if (items.solve != nullptr) {
+    roots.push_back(root0);
+    weight[root0] = 1;
+  }
+  for (unsigned int a : constraintAtoms) {
+    unsigned int r = pa.uf.find(a);
+    if (weight[r]++ == 0) {
+      roots.push_back(r);
+    }
+  }
+  if (roots.size() < 2 || n < 2) {
+    return false;
+  }
+  groups = std::min(n, static_cast<unsigned int>(roots.size()));
+
+  // Assign the largest components first, each to the group with the fewest constraints
+  std::stable_sort(roots.begin(), roots.end(), [&weight, root0](unsigned int a, unsigned int b) {
+    if ((a == root0) != (b == root0)) {
+      return a == root0;
+    }
+    return weight[a] > weight[b];
+  });
+  std::unordered_map<unsigned int, unsigned int> groupOf;
+  std::vector<size_t> load(groups, 0);
+  for (unsigned int r : roots) {
+    unsigned int g = 0;
+    if (r != root0) {
+      for (unsigned int i = 1; i < groups; i++) {
+        if (load[i] < load[g]) {
+          g = i;
+        }
+      }
+    }
+    groupOf[r] = g;
+    load[g] += weight[r];
+  }
+
+  constraintGroup.resize(constraintAtoms.size());
+  for (unsigned int i = 0; i < constraintAtoms.size(); i++) {
+    constraintGroup[i] = groupOf[pa.uf.find(constraintAtoms[i])];
+  }
+  varGroup.clear();
+  for (auto* vd : items.vars) {
+    auto it = groupOf.find(pa.uf.find(pa.vars[vd]));
+    varGroup[name(vd)] = it == groupOf.end() ? 0 : it->second;
+  }
+  return true;
+}
+
+bool FlattenPartition::restrict(EnvI& env, unsigned int group) const {
+  class Restrict : public ItemVisitor {
+  public:
+    const FlattenPartition& p;
+    unsigned int group;
+    unsigned int i = 0;
+    bool ok = true;
+    Restrict(const FlattenPartition& p0, unsigned int group0) : p(p0), group(group0) {}
+    void vConstraintI(ConstraintI* ci) {
+      if (i >= p.constraintGroup.size()) {
+        ok = false;
+      } else if (p.constraintGroup[i] != group) {
+        ci->remove();
+      }
+      i++;
+    }
+    void vSolveI(SolveI* si) {
+      if (group != 0) {
+        si->remove();
+      }
+    }
+  } r(*this, group);
+  iter_items(r, env.model);
+  // Record which items introduce which variables (see removeForeign)
+  env.itemIds.reset(new std::vector<EnvI::ItemIds>());
+  return r.ok && r.i == constraintGroup.size();
+}
+
+bool FlattenPartition::removeForeign(EnvI& env, unsigned int group) const {
+  auto owner = [this](VarDecl* vd) {
+    auto it = varGroup.find(name(vd));
+    return it == varGroup.end() ? -1 : static_cast<int>(it->second);
+  };
+  auto references = [](Item* item, std::vector<VarDecl*>& decls) {
+    CollectTopLevelDecls cd(decls);
+    switch (item->iid()) {
+      case Item::II_VD:
+        top_down(cd, item->cast<VarDeclI>()->e());
+        break;
+      case Item::II_CON:
+        top_down(cd, item->cast<ConstraintI>()->e());
+        break;
+      case Item::II_SOL: {
+        auto* si = item->cast<SolveI>();
+        top_down(cd, si->e());
+        for (ExpressionSetIter it = si->ann().begin(); it != si->ann().end(); ++it) {
+          top_down(cd, *it);
+        }
+      } break;
+      case Item::II_OUT:
+        top_down(cd, item->cast<OutputI>()->e());
+        break;
+      default:
+        break;
+    }
+  };
+
+  // Connected components of the flat model, linked by variables. Par declarations
+  // are shared (e.g. coefficient arrays) and do not link the items that use them.
+  UnionFind uf;
+  std::vector<Item*> items;
+  std::vector<unsigned int> itemAtom;
+  std::unordered_map<std::string, unsigned int> varAtom;
+  for (Item* item : *env.flat()) {
+    if (item->removed() || item->isa<FunctionI>()) {
+      continue;
+    }
+    items.push_back(item);
+    itemAtom.push_back(uf.add());
+    if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+      if (vdi->e()->type().isvar()) {
+        varAtom[name(vdi->e())] = itemAtom.back();
+      }
+    }
+  }
+  for (unsigned int i = 0; i < items.size(); i++) {
+    std::vector<VarDecl*> decls;
+    references(items[i], decls);
+    for (auto* vd : decls) {
+      auto it = varAtom.find(name(vd));
+      if (it != varAtom.end()) {
+        uf.unite(itemAtom[i], it->second);
+      }
+    }
+  }
+  // Introduced variables that are only used for the output belong to the variables
+  // whose output declarations refer to them (which may not be in the flat model)
+  std::vector<std::pair<unsigned int, int> > owners;
+  for (unsigned int i = 0; i < items.size(); i++) {
+    if (auto* vdi = items[i]->dynamicCast<VarDeclI>()) {
+      if (vdi->e()->type().isvar()) {
+        owners.emplace_back(itemAtom[i], owner(vdi->e()));
+      }
+    }
+  }
+  std::unordered_map<std::string, unsigned int> oznAtom(varAtom);
+  for (Item* item : *env.output) {
+    if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+      if (!vdi->removed() && oznAtom.find(name(vdi->e())) == oznAtom.end()) {
+        oznAtom[name(vdi->e())] = uf.add();
+      }
+    }
+  }
+  for (Item* item : *env.output) {
+    if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+      if (vdi->removed()) {
+        continue;
+      }
+      unsigned int a = oznAtom[name(vdi->e())];
+      owners.emplace_back(a, owner(vdi->e()));
+      std::vector<VarDecl*> decls;
+      references(vdi, decls);
+      for (auto* vd : decls) {
+        auto it = oznAtom.find(name(vd));
+        if (vd->id()->idn() != -1 && it != oznAtom.end()) {
+          uf.unite(a, it->second);
+        }
+      }
+    }
+  }
+  // Each component must only contain variables of one group. Components without
+  // top-level variables belong to the group that owns the item whose flattening
+  // introduced their variables: a constraint of the group, or a variable declaration
+  // (which all groups flatten). All other components belong to group 0.
+  std::unordered_map<unsigned int, int> componentGroup;
+  for (auto& o : owners) {
+    if (o.second >= 0) {
+      auto it = componentGroup.emplace(uf.find(o.first), o.second).first;
+      if (it->second != o.second) {
+        return false;
+      }
+    }
+  }
+  std::unordered_map<unsigned int, int> introducedGroup;
+  if (env.itemIds != nullptr) {
+    const std::vector<EnvI::ItemIds>& ids = *env.itemIds;
+    for (unsigned int i = 0; i < items.size(); i++) {
+      auto* vdi = items[i]->dynamicCast<VarDeclI>();
+      if (vdi == nullptr || !vdi->e()->type().isvar() || vdi->e()->id()->idn() == -1) {
+        continue;
+      }
+      long long int idn = vdi->e()->id()->idn();
+      auto r = std::upper_bound(
+          ids.begin(), ids.end(), idn,
+          [](long long int n, const EnvI::ItemIds& ii) { return n < ii.first; });
+      if (r == ids.begin() || idn >= (r - 1)->last) {
+        continue;
+      }
+      Item* item = (r - 1)->item;
+      int g = static_cast<int>(group);
+      if (auto* decl = item->dynamicCast<VarDeclI>()) {
+        g = std::max(0, owner(decl->e()));
+      }
+      auto it = introducedGroup.emplace(uf.find(itemAtom[i]), g).first;
+      if (g == static_cast<int>(group)) {
+        it->second = g;
+      }
+    }
+  }
+  std::unordered_set<std::string> dropped;
+  for (unsigned int i = 0; i < items.size(); i++) {
+    unsigned int c = uf.find(itemAtom[i]);
+    auto it = componentGroup.find(c);
+    auto iit = introducedGroup.find(c);
+    int g = 0;
+    if (it != componentGroup.end()) {
+      g = it->second;
+    } else if (iit != introducedGroup.end()) {
+      g = iit->second;
+    }
+    if (g == static_cast<int>(group)) {
+      continue;
+    }
+    if (auto* vdi = items[i]->dynamicCast<VarDeclI>()) {
+      if (vdi->e()->type().isPar()) {
+        continue;
+      }
+      dropped.insert(name(vdi->e()));
+    } else if (items[i]->isa<SolveI>()) {
+      // Groups without the solve item of the model add a satisfaction solve item
+      if (group == 0) {
+        return false;
+      }
+    } else if (it == componentGroup.end() && iit == introducedGroup.end()) {
+      // Constraints without variables are only generated by group 0
+      return false;
+    }
+    items[i]->remove();
+  }
+
+  // Remove the introduced par declarations that are no longer used
+  std::unordered_set<std::string> usedPars;
+  for (Item* item : items) {
+    if (!item->removed()) {
+      std::vector<VarDecl*> decls;
+      references(item, decls);
+      for (auto* vd : decls) {
+        if (vd->type().isPar()) {
+          usedPars.insert(name(vd));
+        }
+      }
+    }
+  }
+  for (Item* item : items) {
+    if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+      if (vdi->e()->type().isPar() && vdi->e()->introduced() &&
+          usedPars.find(name(vdi->e())) == usedPars.end()) {
+        vdi->remove();
+      }
+    }
+  }
+
+  // The output declarations of foreign variables are kept, but their values come from
+  // the group that owns them. Introduced output declarations that are no longer used
+  // are removed.
+  std::unordered_map<std::string, VarDeclI*> oznDecls;
+  std::unordered_map<std::string, unsigned int> oznRefs;
+  std::unordered_map<Item*, std::vector<VarDecl*> > oznUses;
+  for (Item* item : *env.output) {
+    if (item->removed()) {
+      continue;
+    }
+    if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+      oznDecls[name(vdi->e())] = vdi;
+    }
+    std::vector<VarDecl*>& decls = oznUses[item];
+    references(item, decls);
+    for (auto* vd : decls) {
+      oznRefs[name(vd)]++;
+    }
+  }
+  std::vector<VarDeclI*> queue;
+  auto release = [&](Item* item) {
+    for (auto* vd : oznUses[item]) {
+      std::string n = name(vd);
+      if (--oznRefs[n] == 0 && vd->id()->idn() != -1) {
+        auto it = oznDecls.find(n);
+        if (it != oznDecls.end()) {
+          queue.push_back(it->second);
+        }
+      }
+    }
+    oznUses[item].clear();
+  };
+  for (auto& it : oznDecls) {
+    int g = owner(it.second->e());
+    if (g >= 0 && g != static_cast<int>(group)) {
+      it.second->e()->e(nullptr);
+      release(it.second);
+    }
+  }
+  while (!queue.empty()) {
+    VarDeclI* vdi = queue.back();
+    queue.pop_back();
+    if (!vdi->removed()) {
+      vdi->remove();
+      release(vdi);
+    }
+  }
+  for (auto& it : oznDecls) {
+    if (!it.second->removed() && dropped.find(it.first) != dropped.end() &&
+        owner(it.second->e()) < 0) {
+      return false;
+    }
+  }
+  env.flat()->compact();
+  env.output->compact();
+  return true;
+}
+
+namespace {
+
+/// Thrown when an expression cannot be imported into another Env
+class ImportError {};
+
+/// Copy the flat and output model of a group into the Env of group 0. The expressions
+/// of the group belong to the garbage collector of another thread, so they are only
+/// read and all copies are allocated by the current thread.
+class FlatImporter {
+protected:
+  EnvI& _env;
+  const FlattenPartition& _p;
+  unsigned int _group;
+  /// Par arrays of group 0, by type and value
+  std::unordered_map<std::string, VarDecl*>& _parArrays;
+  /// Output declarations of group 0, by name
+  std::unordered_map<std::string, VarDecl*>& _oznDecls;
+  /// Flat declarations of top-level parameters of group 0, by name
+  std::unordered_map<std::string, VarDecl*>& _flatPars;
+  /// Imported flat declarations
+  std::unordered_map<VarDecl*, VarDecl*> _flatMap;
+  /// Imported output declarations
+  std::unordered_map<VarDecl*, VarDecl*> _oznMap;
+  /// Introduced flat declarations of the group, by name
+  std::unordered_map<std::string, VarDecl*> _flatIntroduced;
+
+  static Location loc() { return Location().introduce(); }
+
+  static Type type(Type t, bool ozn) {
+    // Array enum types are registered per Env, only scalar enums are the same in all groups
+    if (!ozn || t.dim() != 0) {
+      t.enumId(0);
+    }
+    return t;
+  }
+
+  Id* mkId(VarDecl* vd) {
+    Id* ident = vd->id()->idn() == -1 ? new Id(loc(), vd->id()->v(), vd)
+                                      : new Id(loc(), vd->id()->idn(), vd);
+    ident->type(vd->type());
+    return ident;
+  }
+
+  Expression* copyId(Id* ident, bool ozn) {
+    VarDecl* vd = ident->decl();
+    if (vd == nullptr || vd->type().isAnn()) {
+      if (ident->idn() != -1) {
+        throw ImportError();
+      }
+      Id* r = new Id(loc(), std::string(ident->v().c_str(), ident->v().size()), nullptr);
+      r->type(type(ident->type(), ozn));
+      return r;
+    }
+    if (ozn) {
+      return mkId(oznDecl(vd));
+    }
+    auto it = _flatMap.find(vd);
+    if (it == _flatMap.end()) {
+      throw ImportError();
+    }
+    return mkId(it->second);
+  }
+
+  VarDecl* oznDecl(VarDecl* vd) {
+    auto it = _oznMap.find(vd);
+    if (it != _oznMap.end()) {
+      return it->second;
+    }
+    std::string n = FlattenPartition::name(vd);
+    if (vd->id()->idn() == -1) {
+      auto oit = _oznDecls.find(n);
+      if (oit == _oznDecls.end()) {
+        throw ImportError();
+      }
+      _oznMap[vd] = oit->second;
+      return oit->second;
+    }
+    // Introduced output declarations take the name of the flat variable they are assigned from
+    long long int idn = -1;
+    auto fit = _flatIntroduced.find(n);
+    if (fit != _flatIntroduced.end()) {
+      auto mit = _flatMap.find(fit->second);
+      if (mit != _flatMap.end()) {
+        idn = mit->second->id()->idn();
+      }
+    }
+    if (idn == -1) {
+      idn = _env.genId();
+    }
+    auto* nvd = new VarDecl(loc(), copyTi(vd->ti(), true), idn, nullptr);
+    nvd->toplevel(true);
+    nvd->introduced(vd->introduced());
+    _oznMap[vd] = nvd;
+    nvd->e(copy(vd->e(), true));
+    copyAnn(vd, nvd, true);
+    _env.output->addItem(new VarDeclI(loc(), nvd));
+    return nvd;
+  }
+
+  TypeInst* copyTi(TypeInst* ti, bool ozn) {
+    std::vector<TypeInst*> ranges;
+    for (unsigned int i = 0; i < ti->ranges().size(); i++) {
+      ranges.push_back(copyTi(ti->ranges()[i], ozn));
+    }
+    auto* nti = new TypeInst(loc(), type(ti->type(), ozn), copy(ti->domain(), ozn));
+    if (!ranges.empty()) {
+      nti->setRanges(ranges);
+    }
+    nti->setComputedDomain(ti->computedDomain());
+    return nti;
+  }
+
+  void copyAnn(Expression* e, Expression* r, bool ozn) {
+    // Annotation::add inserts a vector in reverse, which keeps the order of the annotations
+    std::vector<Expression*> anns;
+    for (ExpressionSetIter it = e->ann().begin(); it != e->ann().end(); ++it) {
+      anns.push_back(copy(*it, ozn));
+    }
+    r->ann().add(anns);
+  }
+
+  Call* copyCall(Call* c, bool ozn) {
+    std::vector<Expression*> args(c->argCount());
+    for (unsigned int i = 0; i < c->argCount(); i++) {
+      args[i] = copy(c->arg(i), ozn);
+    }
+    auto* r = new Call(loc(), std::string(c->id().c_str(), c->id().size()), args);
+    r->type(type(c->type(), ozn));
+    if (c->decl() != nullptr) {
+      FunctionI* decl = (ozn ? _env.output : _env.model)->matchFn(_env, r, false);
+      if (decl == nullptr) {
+        throw ImportError();
+      }
+      r->decl(decl);
+    }
+    return r;
+  }
+
+public:
+  FlatImporter(EnvI& env, const FlattenPartition& p, unsigned int group,
+               std::unordered_map<std::string, VarDecl*>& parArrays,
+               std::unordered_map<std::string, VarDecl*>& oznDecls,
+               std::unordered_map<std::string, VarDecl*>& flatPars)
+      : _env(env),
+        _p(p),
+        _group(group),
+        _parArrays(parArrays),
+        _oznDecls(oznDecls),
+        _flatPars(flatPars) {}
+
+  /// Key for merging equal par arrays
+  static std::string parKey(VarDecl* vd) {
+    std::ostringstream oss;
+    oss << vd->type().toInt() << ':' << *vd->e();
+    return oss.str();
+  }
+
+  Expression* copy(Expression* e, bool ozn) {
+    if (e == nullptr) {
+      return nullptr;
+    }
+    Expression* r = nullptr;
+    switch (e->eid()) {
+      case Expression::E_INTLIT:
+        r = IntLit::a(e->cast<IntLit>()->v());
+        break;
+      case Expression::E_FLOATLIT:
+        r = FloatLit::a(e->cast<FloatLit>()->v());
+        break;
+      case Expression::E_BOOLLIT:
+        r = e->cast<BoolLit>()->v() ? constants().literalTrue : constants().literalFalse;
+        break;
+      case Expression::E_STRINGLIT: {
+        ASTString s = e->cast<StringLit>()->v();
+        r = new StringLit(loc(), std::string(s.c_str(), s.size()));
+      } break;
+      case Expression::E_SETLIT: {
+        auto* sl = e->cast<SetLit>();
+        if (IntSetVal* isv = sl->isv()) {
+          std::vector<IntSetVal::Range> ranges;
+          for (unsigned int i = 0; i < isv->size(); i++) {
+            ranges.emplace_back(isv->min(i), isv->max(i));
+          }
+          r = new SetLit(loc(), IntSetVal::a(ranges));
+        } else if (FloatSetVal* fsv = sl->fsv()) {
+          std::vector<FloatSetVal::Range> ranges;
+          for (unsigned int i = 0; i < fsv->size(); i++) {
+            ranges.emplace_back(fsv->min(i), fsv->max(i));
+          }
+          r = new SetLit(loc(), FloatSetVal::a(ranges));
+        } else {
+          std::vector<Expression*> v(sl->v().size());
+          for (unsigned int i = 0; i < sl->v().size(); i++) {
+            v[i] = copy(sl->v()[i], ozn);
+          }
+          r = new SetLit(loc(), v);
+        }
+        r->type(type(e->type(), ozn));
+      } break;
+      case Expression::E_ID:
+        r = copyId(e->cast<Id>(), ozn);
+        break;
+      case Expression::E_ARRAYLIT: {
+        auto* al = e->cast<ArrayLit>();
+        std::vector<Expression*> v(al->size());
+        for (unsigned int i = 0; i < al->size(); i++) {
+          v[i] = copy((*al)[i], ozn);
+        }
+        std::vector<std::pair<int, int> > dims(al->dims());
+        for (unsigned int i = 0; i < al->dims(); i++) {
+          dims[i] = std::make_pair(al->min(i), al->max(i));
+        }
+        r = new ArrayLit(loc(), v, dims);
+        r->type(type(e->type(), ozn));
+      } break;
+      case Expression::E_CALL:
+        r = copyCall(e->cast<Call>(), ozn);
+        break;
+      case Expression::E_BINOP: {
+        auto* bo = e->cast<BinOp>();
+        if (bo->decl() != nullptr) {
+          throw ImportError();
+        }
+        r = new BinOp(loc(), copy(bo->lhs(), ozn), bo->op(), copy(bo->rhs(), ozn));
+        r->type(type(e->type(), ozn));
+      } break;
+      case Expression::E_UNOP: {
+        auto* uo = e->cast<UnOp>();
+        if (uo->decl() != nullptr) {
+          throw ImportError();
+        }
+        r = new UnOp(loc(), uo->op(), copy(uo->e(), ozn));
+        r->type(type(e->type(), ozn));
+      } break;
+      default:
+        throw ImportError();
+    }
+    if (!e->ann().isEmpty()) {
+      if (e->isa<IntLit>() || e->isa<FloatLit>() || e->isa<BoolLit>()) {
+        throw ImportError();
+      }
+      copyAnn(e, r, ozn);
+    }
+    return r;
+  }
+
+  /// Import the flat model of \a from
+  void importFlat(EnvI& from) {
+    std::vector<std::pair<VarDecl*, VarDecl*> > decls;
+    std::vector<Item*> items;
+    for (Item* item : *from.flat()) {
+      if (item->removed()) {
+        continue;
+      }
+      if (auto* vdi = item->dynamicCast<VarDeclI>()) {
+        VarDecl* vd = vdi->e();
+        VarDecl* nvd;
+        if (vd->id()->idn() != -1) {
+          _flatIntroduced[FlattenPartition::name(vd)] = vd;
+          if (vd->type().isPar() && vd->e() != nullptr) {
+            HasIds hi;
+            top_down(hi, vd->e());
+            if (!hi.found) {
+              nvd = new VarDecl(loc(), copyTi(vd->ti(), false), 0LL, copy(vd->e(), false));
+              std::string key = parKey(nvd);
+              auto it = _parArrays.find(key);
+              if (it != _parArrays.end()) {
+                _flatMap[vd] = it->second;
+                continue;
+              }
+              nvd->id()->idn(_env.genId());
+              _parArrays[key] = nvd;
+            } else {
+              nvd = new VarDecl(loc(), copyTi(vd->ti(), false), _env.genId());
+            }
+          } else {
+            nvd = new VarDecl(loc(), copyTi(vd->ti(), false), _env.genId());
+          }
+        } else if (vd->type().isPar()) {
+          // Parameters are evaluated in every group
+          auto it = _flatPars.find(FlattenPartition::name(vd));
+          if (it == _flatPars.end()) {
+            throw ImportError();
+          }
+          _flatMap[vd] = it->second;
+          continue;
+        } else {
+          auto it = _p.varGroup.find(FlattenPartition::name(vd));
+          if (it == _p.varGroup.end() || it->second != _group) {
+            throw ImportError();
+          }
+          nvd = new VarDecl(loc(), copyTi(vd->ti(), false), FlattenPartition::name(vd));
+        }
+        nvd->toplevel(true);
+        nvd->introduced(vd->introduced());
+        _flatMap[vd] = nvd;
+        decls.emplace_back(vd, nvd);
+        items.push_back(new VarDeclI(loc(), nvd));
+      } else if (auto* ci = item->dynamicCast<ConstraintI>()) {
+        items.push_back(ci);
+      }
+    }
+    for (auto& d : decls) {
+      if (d.second->e() == nullptr) {
+        d.second->e(copy(d.first->e(), false));
+      }
+      copyAnn(d.first, d.second, false);
+    }
+    for (auto*& item : items) {
+      if (auto* ci = item->dynamicCast<ConstraintI>()) {
+        item = new ConstraintI(loc(), copy(ci->e(), false));
+      }
+      _env.flat()->addItem(item);
+    }
+    _env.counters.reifConstraints += from.counters.reifConstraints;
+    _env.counters.impConstraints += from.counters.impConstraints;
+    _env.counters.impDel += from.counters.impDel;
+    _env.counters.linDel += from.counters.linDel;
+  }
+
+  /// Import the values of the output declarations of the variables owned by the group
+  void importOutput(EnvI& from) {
+    std::unordered_set<std::string> seen;
+    for (Item* item : *from.output) {
+      if (item->removed() || !item->isa<VarDeclI>()) {
+        continue;
+      }
+      VarDecl* vd = item->cast<VarDeclI>()->e();
+      std::string n = FlattenPartition::name(vd);
+      auto git = _p.varGroup.find(n);
+      if (vd->id()->idn() != -1 || git == _p.varGroup.end() || git->second != _group) {
+        continue;
+      }
+      auto it = _oznDecls.find(n);
+      if (it == _oznDecls.end()) {
+        throw ImportError();
+      }
+      it->second->e(copy(vd->e(), true));
+      seen.insert(n);
+    }
+    for (const auto& vg : _p.varGroup) {
+      if (vg.second == _group && _oznDecls.find(vg.first) != _oznDecls.end() &&
+          seen.find(vg.first) == seen.end()) {
+        throw ImportError();
+      }
+    }
+  }
+};
+
+}  // namespace
+
+bool FlattenPartition::merge(EnvI& env, const std::vector<EnvI*>& groups) const {
+  std::unordered_map<std::string, VarDecl*> parArrays;
+  std::unordered_map<std::string, VarDecl*> oznDecls;
+  std::unordered_map<std::string, VarDecl*> flatPars;
+  for (VarDeclIterator it = env.flat()->vardecls().begin(); it != env.flat()->vardecls().end();
+       ++it) {
+    VarDecl* vd = it->e();
+    if (vd->id()->idn() == -1 && vd->type().isPar()) {
+      flatPars[name(vd)] = vd;
+    } else if (vd->id()->idn() != -1 && vd->type().isPar() && vd->e() != nullptr) {
+      HasIds hi;
+      top_down(hi, vd->e());
+      if (!hi.found) {
+        parArrays.emplace(FlatImporter::parKey(vd), vd);
+      }
+    }
+  }
+  for (VarDeclIterator it = env.output->vardecls().begin(); it != env.output->vardecls().end();
+       ++it) {
+    if (it->e()->id()->idn() == -1) {
+      oznDecls[name(it->e())] = it->e();
+    }
+  }
+  try {
+    for (unsigned int g = 0; g < groups.size(); g++) {
+      FlatImporter fi(env, *this, g + 1, parArrays, oznDecls, flatPars);
+      fi.importFlat(*groups[g]);
+      fi.importOutput(*groups[g]);
+    }
+  } catch (ImportError&) {
+    return false;
+  }
+
+  // Restore the FlatZinc item order (see oldflatzinc): par before var declarations,
+  // scalars before arrays, and declarations without right hand side first
+  auto rank = [](Item* i) {
+    switch (i->iid()) {
+      case Item::II_FUN:
+        return 0;
+      case Item::II_VD: {
+        VarDecl* vd = i->cast<VarDeclI>()->e();
+        int r = vd->type().isPar() ? 1 : 7;
+        r += vd->type().dim() == 0 ? 0 : 3;
+        if (vd->e() != nullptr) {
+          r += vd->e()->isa<Id>() ? 2 : 1;
+        }
+        return r;
+      }
+      case Item::II_SOL:
+        return 14;
+      default:
+        return 13;
+    }
+  };
+  std::stable_sort(env.flat()->begin(), env.flat()->end(),
+                   [&rank](Item* i, Item* j) { return rank(i) < rank(j); });
+  return true;
+}
+
+namespace {
+
+class FlattenThreadPool {
+protected:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<std::function<void()> > _queue;
+  /// Number of threads waiting for a job
+  size_t _idle = 0;
+  bool _stop = false;
+
+  void work() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+      _idle++;
+      _cond.wait(lock, [this] { return _stop || !_queue.empty(); });
+      _idle--;
+      if (_queue.empty()) {
+        return;
+      }
+      std::function<void()> job = std::move(_queue.front());
+      _queue.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    }
+  }
+
+public:
+  ~FlattenThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _cond.notify_all();
+    for (auto& t : _threads) {
+      t.join();
+    }
+  }
+
+  bool run(const std::function<void()>& job) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Jobs wait for each other, so each queued job needs a thread of its own
+    if (_idle <= _queue.size()) {
+      try {
+        _threads.emplace_back(&FlattenThreadPool::work, this);
+      } catch (std::system_error&) {
+        return false;
+      }
+    }
+    _queue.push_back(job);
+    _cond.notify_one();
+    return true;
+  }
+
+  static FlattenThreadPool& pool() {
+    static FlattenThreadPool p;
+    return p;
+  }
+};
+
+}  // namespace
+
+bool run_flatten_job(const std::function<void()>& job) {
+  return FlattenThreadPool::pool().run(job);
+}
+
+}  // namespace MiniZinc
@@ -25,18 +25,7 @@ void ParamConfig::load(const std::string& filename) {
       Model m;
       GCLock lock;
       jp.parse(&m, filename, false);
-      for (auto& i : m) {
-        if (auto* ai = i->dynamicCast<AssignI>()) {
-          addValue(ai->id(), ai->e());
-        } else if (auto* ii = i->dynamicCast<IncludeI>()) {
-          auto flag = ParamConfig::flagName(ii->f());
-          if (_blacklist.count(flag) > 0) {
-            throw ParamException("Parameter '" + flag + "' is not allowed in configuration file");
-          }
-          _values.push_back(flag);
-          _values.push_back(ParamConfig::modelToString(*(ii->m())));
-        }
-      }
+      addModel(m);
     } catch (ParamException& e) {
       throw;
     } catch (Exception& e) {
@@ -47,6 +36,40 @@ void ParamConfig::load(const std::string& filename) {
   }
 }
 
+void ParamConfig::loadFromString(const std::string& data) {
+  if (JSONParser::stringIsJSON(data)) {
+    try {
+      Env confenv;
+      JSONParser jp(confenv.envi());
+      Model m;
+      GCLock lock;
+      jp.parseFromString(&m, data, false);
+      addModel(m);
+    } catch (ParamException& e) {
+      throw;
+    } catch (Exception& e) {
+      throw ParamException(e.what());
+    }
+  } else {
+    throw ParamException("Invalid configuration");
+  }
+}
+
+void ParamConfig::addModel(Model& m) {
+  for (auto& i : m) {
+    if (auto* ai = i->dynamicCast<AssignI>()) {
+      addValue(ai->id(), ai->e());
+    } else if (auto* ii = i->dynamicCast<IncludeI>()) {
+      auto flag = ParamConfig::flagName(ii->f());
+      if (_blacklist.count(flag) > 0) {
+        throw ParamException("Parameter '" + flag + "' is not allowed in configuration file");
+      }
+      _values.push_back(flag);
+      _values.push_back(ParamConfig::modelToString(*(ii->m())));
+    }
+  }
+}
+
 void ParamConfig::addValue(const ASTString& flag_input, Expression* e) {
   auto flag = ParamConfig::flagName(flag_input);
   if (_blacklist.count(flag) > 0) {
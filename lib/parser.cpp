@@ -17,12 +17,23 @@
  * Need to get more flexible for multi-pass & multi-solving stuff  TODO
  */
 
+#include <minizinc/astiterator.hh>
 #include <minizinc/file_utils.hh>
 #include <minizinc/json_parser.hh>
+#include <minizinc/library_image.hh>
 #include <minizinc/parser.hh>
 #include <minizinc/prettyprinter.hh>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -31,30 +42,729 @@ void mzn_yyset_extra(void* user_defined, void* yyscanner);
 int mzn_yylex_destroy(void* scanner);
 
 namespace {
-// fastest way to read a file into a string (especially big files)
-// see: http://insanecoding.blogspot.be/2011/11/how-to-read-in-file-in-c.html
-std::string get_file_contents(std::ifstream& in) {
-  if (in) {
-    std::string contents;
-    in.seekg(0, std::ios::end);
-    contents.resize(static_cast<unsigned int>(in.tellg()));
-    in.seekg(0, std::ios::beg);
-    in.read(&contents[0], contents.size());
-    in.close();
-    if (!contents.empty() && contents[0] == '@') {
-      contents = MiniZinc::FileUtils::decode_base64(contents);
-      MiniZinc::FileUtils::inflate_string(contents);
-    }
-    return (contents);
-  }
-  throw(errno);
-}
+/**
+ * \brief Contents of a model or data file
+ *
+ * Files are memory mapped and scanned in place, so that even very large data
+ * files are never copied into memory as a whole. Only compressed (base64
+ * encoded) files are decoded into a string.
+ */
+class SourceFile {
+protected:
+  MiniZinc::FileUtils::MappedFile _file;
+  bool _encoded;
+  std::string _decoded;
+
+public:
+  explicit SourceFile(const std::string& filename)
+      : _file(filename), _encoded(_file.size() > 0 && _file.data()[0] == '@') {
+    if (_encoded) {
+      _decoded = MiniZinc::FileUtils::decode_base64(std::string(_file.data(), _file.size()));
+      MiniZinc::FileUtils::inflate_string(_decoded);
+    } else {
+      _file.willNeed();
+    }
+  }
+  bool isOpen() const { return _file.isOpen(); }
+  /// The mapped file, if data() points into it
+  const MiniZinc::FileUtils::MappedFile* mapped() const {
+    return _encoded || !_file.isMapped() ? nullptr : &_file;
+  }
+  const char* data() const { return _encoded ? _decoded.data() : _file.data(); }
+  size_t size() const { return _encoded ? _decoded.size() : _file.size(); }
+};
 }  // namespace
 
 namespace MiniZinc {
 
-std::string ParserState::canonicalFilename(const std::string& f) const {
-  if (FileUtils::is_absolute(f) || std::string(filename).empty()) {
+namespace {
+
+/// Warn if library file \a fullname is shadowed by a file in the working directory
+void check_shadowed_file(const string& fullname, const string& workingDir, ostream& err) {
+  string basename = FileUtils::base_name(fullname);
+  if (FileUtils::file_path(FileUtils::dir_name(fullname)) != FileUtils::file_path(workingDir) &&
+      FileUtils::file_exists(workingDir + "/" + basename)) {
+    err << "Warning: file " << basename
+        << " included from library, but also exists in current working directory" << endl;
+  }
+}
+
+/// Parse all files in the work list \a files, including the files they include
+bool parse_files(vector<ParseWorkItem>& files, map<string, Model*>& seenModels,
+                 const vector<string>& includePaths, const string& workingDir,
+                 bool parseDocComments, bool verbose, ostream& err,
+                 std::vector<SyntaxError>& syntaxErrors) {
+  while (!files.empty()) {
+    GCLock lock;
+    ParseWorkItem& np = files.back();
+    string parentPath = np.dirName;
+    Model* m = np.m;
+    bool isModelString = np.isModelString;
+    bool isSTDLib = np.isSTDLib;
+    IncludeI* np_ii = np.ii;
+    string f(np.fileName);
+    files.pop_back();
+
+    std::unique_ptr<SourceFile> file;
+    const char* text;
+    size_t textLength;
+    std::string fullname;
+    std::string basename;
+    bool isFzn;
+    if (!isModelString) {
+      for (Model* p = m->parent(); p != nullptr; p = p->parent()) {
+        if (p->filename() == f) {
+          err << "Error: cyclic includes: " << std::endl;
+          for (Model* pe = m; pe != nullptr; pe = pe->parent()) {
+            err << "  " << pe->filename() << std::endl;
+          }
+          return false;
+        }
+      }
+      if (FileUtils::is_absolute(f)) {
+        fullname = f;
+        basename = FileUtils::base_name(fullname);
+        if (FileUtils::file_exists(fullname)) {
+          file.reset(new SourceFile(fullname));
+          if (!file->isOpen()) {
+            file.reset();
+          }
+        }
+      }
+      if (file != nullptr) {
+        check_shadowed_file(fullname, workingDir, err);
+      }
+      for (const auto& includePath : includePaths) {
+        std::string deprecatedName = includePath + "/" + basename + ".deprecated.mzn";
+        if (FileUtils::file_exists(deprecatedName)) {
+          string deprecatedFullPath = FileUtils::file_path(deprecatedName);
+          string deprecatedBaseName = FileUtils::base_name(deprecatedFullPath);
+          string deprecatedDirName = FileUtils::dir_name(deprecatedFullPath);
+          auto* includedModel = new Model;
+          includedModel->setFilename(deprecatedName);
+          files.emplace_back(includedModel, nullptr, "", deprecatedName, isSTDLib, false);
+          seenModels.insert(pair<string, Model*>(deprecatedName, includedModel));
+          Location loc(ASTString(deprecatedName), 0, 0, 0, 0);
+          auto* inc = new IncludeI(loc, includedModel->filename());
+          inc->m(includedModel, true);
+          m->addItem(inc);
+          files.emplace_back(includedModel, inc, deprecatedDirName, deprecatedFullPath, isSTDLib,
+                             false);
+        }
+      }
+      if (file == nullptr) {
+        if (np_ii != nullptr) {
+          err << np_ii->loc().toString() << ":\n";
+          err << "MiniZinc: error in include item, cannot open file '" << f << "'." << endl;
+        } else {
+          err << "Error: cannot open file '" << f << "'." << endl;
+        }
+        return false;
+      }
+      if (verbose) {
+        std::cerr << "processing file '" << fullname << "'" << endl;
+      }
+      text = file->data();
+      textLength = file->size();
+
+      if (m->filepath().size() == 0) {
+        m->setFilepath(fullname);
+      }
+      isFzn = (fullname.compare(fullname.length() - 4, 4, ".fzn") == 0);
+      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".ozn") == 0);
+      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".szn") == 0);
+      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".mzc") == 0);
+    } else {
+      isFzn = false;
+      fullname = f;
+      text = parentPath.c_str();
+      textLength = parentPath.size();
+    }
+    ParserState pp(fullname, text, textLength, err, includePaths, files, seenModels, m, false,
+                   isFzn, isSTDLib, parseDocComments);
+    if (file != nullptr) {
+      pp.mappedFile = file->mapped();
+    }
+    mzn_yylex_init(&pp.yyscanner);
+    mzn_yyset_extra(&pp, pp.yyscanner);
+    mzn_yyparse(&pp);
+    if (pp.yyscanner != nullptr) {
+      mzn_yylex_destroy(pp.yyscanner);
+    }
+    if (pp.hadError) {
+      for (const auto& syntaxError : pp.syntaxErrors) {
+        syntaxErrors.push_back(syntaxError);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * \brief Parser for data files with a fast path for literal data
+ *
+ * Large data files mostly consist of assignments of numbers, ranges and
+ * (one- or two-dimensional or arrayNd) arrays of number or Boolean literals.
+ * Such assignments are recognised by a simple scanner and turned into array
+ * literals directly (which store their elements unboxed), without going
+ * through the lexer and the grammar. Runs of all other items are parsed using
+ * the grammar, starting at their original source location.
+ */
+class DataParser {
+protected:
+  /// Source location of a character
+  struct SrcPos {
+    unsigned int line;
+    unsigned int column;
+  };
+
+  const string& _filename;
+  ASTString _file;
+  const char* _text;
+  size_t _length;
+  const FileUtils::MappedFile* _mapped;
+  Model* _model;
+  const vector<string>& _includePaths;
+  vector<ParseWorkItem>& _files;
+  map<string, Model*>& _seenModels;
+  bool _parseDocComments;
+  ostream& _err;
+  std::vector<SyntaxError>& _syntaxErrors;
+
+  /// Position up to which the source location is known
+  size_t _locPos = 0;
+  /// Line of position _locPos
+  unsigned int _line = 1;
+  /// Start of the line containing _locPos
+  size_t _lineStart = 0;
+  /// Number of characters between _lineStart and _locPos
+  unsigned int _chars = 0;
+  /// Position up to which memory pages have been released
+  size_t _released = 0;
+
+  char at(size_t p) const { return p < _length ? _text[p] : '\0'; }
+  static bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+  static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+  static bool isIdChar(char c) { return isAlpha(c) || isDigit(c) || c == '_'; }
+
+  /// Return source location of position \a p
+  SrcPos locate(size_t p) {
+    if (p < _locPos) {
+      _locPos = 0;
+      _line = 1;
+      _lineStart = 0;
+      _chars = 0;
+    }
+    for (; _locPos < p; _locPos++) {
+      char c = _text[_locPos];
+      if (c == '\n') {
+        _line++;
+        _lineStart = _locPos + 1;
+        _chars = 0;
+      } else if ((c & 0xC0) != 0x80) {
+        _chars++;
+      }
+    }
+    return {_line, _chars + 1};
+  }
+  Location location(const SrcPos& first, const SrcPos& last) const {
+    return Location(_file, first.line, first.column, last.line, last.column);
+  }
+
+  /// Skip whitespace and comments (but not documentation comments) starting at \a p
+  size_t skipSpace(size_t p) const {
+    for (;;) {
+      char c = at(p);
+      if (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f') {
+        p++;
+      } else if (c == '%') {
+        const void* eol = memchr(_text + p, '\n', _length - p);
+        p = eol == nullptr ? _length : static_cast<const char*>(eol) - _text;
+      } else if (c == '/' && at(p + 1) == '*' && at(p + 2) != '*') {
+        size_t q = p + 2;
+        while (q < _length && !(_text[q] == '*' && at(q + 1) == '/')) {
+          q++;
+        }
+        if (q >= _length) {
+          return p;
+        }
+        p = q + 2;
+      } else {
+        return p;
+      }
+    }
+  }
+
+  /// Return the end of the item starting at \a p (after its terminating ';')
+  size_t skipItem(size_t p) const {
+    // Bracket depth of the enclosing code for each open string interpolation
+    std::vector<int> interpolations;
+    int depth = 0;
+    bool inString = false;
+    while (p < _length) {
+      char c = _text[p];
+      if (inString) {
+        if (c == '\\' && at(p + 1) == '(') {
+          interpolations.push_back(depth);
+          depth = 0;
+          inString = false;
+          p += 2;
+        } else if (c == '\\') {
+          p += 2;
+        } else {
+          inString = c != '"';
+          p++;
+        }
+        continue;
+      }
+      switch (c) {
+        case '"':
+          inString = true;
+          break;
+        case '\'': {
+          size_t q = p + 1;
+          while (q < _length && _text[q] != '\'' && _text[q] != '\n') {
+            q++;
+          }
+          if (at(q) == '\'') {
+            p = q;
+          }
+        } break;
+        case '%':
+        case '/': {
+          size_t q = skipSpace(p);
+          if (q == p && c == '/' && at(p + 1) == '*') {
+            // Documentation comment
+            q = p + 2;
+            while (q < _length && !(_text[q] == '*' && at(q + 1) == '/')) {
+              q++;
+            }
+            q = std::min(q + 2, _length);
+          }
+          if (q > p) {
+            p = q;
+            continue;
+          }
+        } break;
+        case '(':
+        case '[':
+        case '{':
+          depth++;
+          break;
+        case ')':
+          if (depth == 0 && !interpolations.empty()) {
+            depth = interpolations.back();
+            interpolations.pop_back();
+            inString = true;
+          } else {
+            depth--;
+          }
+          break;
+        case ']':
+        case '}':
+          depth--;
+          break;
+        case ';':
+          if (depth <= 0 && interpolations.empty()) {
+            return p + 1;
+          }
+          break;
+        default:
+          break;
+      }
+      p++;
+    }
+    return _length;
+  }
+
+  /// Kind of literal
+  enum LitKind { LK_INT, LK_FLOAT, LK_BOOL };
+
+  /// Parse a (signed) literal at \a p and advance \a p past it, or return nullptr
+  Expression* literal(size_t& p, LitKind& kind) const {
+    size_t q = p;
+    bool negative = false;
+    if (at(q) == '-' || at(q) == '+') {
+      negative = at(q) == '-';
+      q++;
+      if (!isDigit(at(q))) {
+        return nullptr;
+      }
+    } else if (!isDigit(at(q))) {
+      for (bool b : {true, false}) {
+        const char* word = b ? "true" : "false";
+        size_t n = b ? 4 : 5;
+        if (q + n <= _length && strncmp(_text + q, word, n) == 0 && !isIdChar(at(q + n))) {
+          kind = LK_BOOL;
+          p = q + n;
+          return constants().boollit(b);
+        }
+      }
+      return nullptr;
+    }
+    size_t start = q;
+    long long int v = 0;
+    bool overflow = false;
+    for (; isDigit(at(q)); q++) {
+      int d = at(q) - '0';
+      if (v > (LLONG_MAX - d) / 10) {
+        overflow = true;
+      } else {
+        v = v * 10 + d;
+      }
+    }
+    bool isFloat = false;
+    if (at(q) == '.' && isDigit(at(q + 1))) {
+      isFloat = true;
+      for (q += 2; isDigit(at(q)); q++) {
+      }
+    }
+    if (at(q) == 'e' || at(q) == 'E') {
+      size_t r = q + 1;
+      if (at(r) == '+' || at(r) == '-') {
+        r++;
+      }
+      if (isDigit(at(r))) {
+        isFloat = true;
+        for (q = r; isDigit(at(q)); q++) {
+        }
+      }
+    }
+    if (isIdChar(at(q))) {
+      return nullptr;
+    }
+    if (isFloat) {
+      std::string str(_text + start, q - start);
+      char* end;
+      errno = 0;
+      double d = strtod(str.c_str(), &end);
+      if (errno != 0 || end != str.c_str() + str.size()) {
+        return nullptr;
+      }
+      kind = LK_FLOAT;
+      p = q;
+      return FloatLit::a(negative ? -d : d);
+    }
+    if (overflow) {
+      return nullptr;
+    }
+    kind = LK_INT;
+    p = q;
+    return IntLit::a(negative ? -v : v);
+  }
+
+  /// Parse an integer range at \a p, setting \a last to the location of its last character
+  SetLit* range(size_t& p, SrcPos& last) {
+    SrcPos first = locate(p);
+    LitKind kind;
+    size_t q = p;
+    Expression* lb = literal(q, kind);
+    if (lb == nullptr || kind != LK_INT) {
+      return nullptr;
+    }
+    q = skipSpace(q);
+    if (at(q) != '.' || at(q + 1) != '.') {
+      return nullptr;
+    }
+    q = skipSpace(q + 2);
+    Expression* ub = literal(q, kind);
+    if (ub == nullptr || kind != LK_INT) {
+      return nullptr;
+    }
+    last = locate(q - 1);
+    p = q;
+    return new SetLit(location(first, last),
+                      IntSetVal::a(lb->cast<IntLit>()->v(), ub->cast<IntLit>()->v()));
+  }
+
+  /// Parse elements of the same kind into \a v until \a end or '|', starting at \a p
+  bool elements(size_t& p, char end, std::vector<Expression*>& v, LitKind& kind, bool& first) {
+    for (;;) {
+      LitKind k;
+      Expression* e = literal(p, k);
+      if (e == nullptr || (!first && k != kind)) {
+        return false;
+      }
+      kind = k;
+      first = false;
+      v.push_back(e);
+      p = skipSpace(p);
+      if (at(p) == ',') {
+        p = skipSpace(p + 1);
+        if (at(p) == end || at(p) == '|') {
+          return true;
+        }
+      } else {
+        return at(p) == end || at(p) == '|';
+      }
+    }
+  }
+
+  /// Parse a one- or two-dimensional array of literals at \a p
+  ArrayLit* arrayLiteral(size_t& p, SrcPos& last) {
+    SrcPos first = locate(p);
+    std::vector<Expression*> v;
+    LitKind kind = LK_INT;
+    bool none = true;
+    size_t q;
+    if (at(p + 1) != '|') {
+      q = skipSpace(p + 1);
+      if (at(q) != ']' && (!elements(q, ']', v, kind, none) || at(q) != ']')) {
+        return nullptr;
+      }
+      last = locate(q);
+      p = q + 1;
+      return new ArrayLit(location(first, last), v);
+    }
+    int rows = 0;
+    size_t columns = 0;
+    q = skipSpace(p + 2);
+    if (!(at(q) == '|' && at(q + 1) == ']')) {
+      for (;;) {
+        size_t n = v.size();
+        if (!elements(q, '|', v, kind, none) || at(q) != '|') {
+          return nullptr;
+        }
+        if (rows == 0) {
+          columns = v.size() - n;
+        } else if (v.size() - n != columns) {
+          return nullptr;
+        }
+        rows++;
+        if (at(q + 1) == ']') {
+          break;
+        }
+        q = skipSpace(q + 1);
+        if (at(q) == '|' && at(q + 1) == ']') {
+          break;
+        }
+      }
+    }
+    last = locate(q + 1);
+    p = q + 2;
+    std::vector<std::pair<int, int> > dims = {{1, rows}, {1, static_cast<int>(columns)}};
+    return new ArrayLit(location(first, last), v, dims);
+  }
+
+  /// Parse a call to arrayNd with literal ranges and array at \a p (the identifier)
+  Call* arrayNd(size_t& p, SrcPos& last) {
+    SrcPos first = locate(p);
+    size_t q = p + 5;
+    if (strncmp(_text + p, "array", 5) != 0 || at(q) < '1' || at(q) > '6' || at(q + 1) != 'd' ||
+        isIdChar(at(q + 2))) {
+      return nullptr;
+    }
+    std::string name(_text + p, 7);
+    q = skipSpace(q + 2);
+    if (at(q) != '(') {
+      return nullptr;
+    }
+    q = skipSpace(q + 1);
+    std::vector<Expression*> args;
+    for (;;) {
+      SrcPos argLast;
+      if (at(q) == '[') {
+        ArrayLit* al = arrayLiteral(q, argLast);
+        if (al == nullptr) {
+          return nullptr;
+        }
+        args.push_back(al);
+        q = skipSpace(q);
+        if (at(q) != ')') {
+          return nullptr;
+        }
+        break;
+      }
+      SetLit* r = range(q, argLast);
+      if (r == nullptr) {
+        return nullptr;
+      }
+      args.push_back(r);
+      q = skipSpace(q);
+      if (at(q) != ',') {
+        return nullptr;
+      }
+      q = skipSpace(q + 1);
+    }
+    last = locate(q);
+    p = q + 1;
+    return new Call(location(first, last), name, args);
+  }
+
+  /// Parse a literal assignment starting at \a p, setting \a end to the end of the item
+  AssignI* assignment(size_t p, size_t& end) {
+    static const char* const keywords[] = {
+        "ann",     "annotation", "any",    "array",          "bool",     "case",      "constraint",
+        "default", "diff",       "div",    "else",           "elseif",   "endif",     "enum",
+        "false",   "float",      "function", "if",           "in",       "include",   "infinity",
+        "int",     "intersect",  "let",    "list",           "maximize", "minimize",  "mod",
+        "not",     "of",         "opt",    "output",         "par",      "predicate", "record",
+        "satisfy", "set",        "solve",  "string",         "subset",   "superset",  "symdiff",
+        "test",    "then",       "true",   "tuple",          "type",     "union",     "var",
+        "variant_record", "where", "xor"};
+    if (!isAlpha(at(p))) {
+      return nullptr;
+    }
+    size_t q = p;
+    while (isIdChar(at(q))) {
+      q++;
+    }
+    std::string name(_text + p, q - p);
+    for (const char* kw : keywords) {
+      if (name == kw) {
+        return nullptr;
+      }
+    }
+    SrcPos first = locate(p);
+    q = skipSpace(q);
+    if (at(q) != '=' || at(q + 1) == '=') {
+      return nullptr;
+    }
+    q = skipSpace(q + 1);
+    SrcPos last;
+    Expression* e;
+    if (at(q) == '[') {
+      e = arrayLiteral(q, last);
+    } else if (isAlpha(at(q)) && at(q) != 't' && at(q) != 'f') {
+      e = arrayNd(q, last);
+    } else {
+      size_t r = q;
+      LitKind kind;
+      e = literal(r, kind);
+      if (e != nullptr && kind == LK_INT && at(skipSpace(r)) == '.') {
+        e = range(q, last);
+      } else if (e != nullptr) {
+        last = locate(r - 1);
+        q = r;
+      }
+    }
+    if (e == nullptr) {
+      return nullptr;
+    }
+    q = skipSpace(q);
+    if (at(q) == ';' && at(skipSpace(q + 1)) != ';') {
+      end = q + 1;
+    } else if (q >= _length) {
+      end = _length;
+    } else {
+      return nullptr;
+    }
+    return new AssignI(location(first, last), name, e);
+  }
+
+  /// Parse the items between \a begin and \a end using the grammar
+  bool parseItems(size_t begin, size_t end) {
+    SrcPos start = locate(begin);
+    size_t lineStart = _lineStart;
+    ParserState pp(_filename, _text + lineStart, end - lineStart, _err, _includePaths, _files,
+                   _seenModels, _model, true, false, false, _parseDocComments);
+    pp.mappedFile = _mapped;
+    pp.textLength = _length - lineStart;
+    pp.startAt(begin - lineStart, start.line, start.column);
+    mzn_yylex_init(&pp.yyscanner);
+    mzn_yyset_extra(&pp, pp.yyscanner);
+    mzn_yyparse(&pp);
+    if (pp.yyscanner != nullptr) {
+      mzn_yylex_destroy(pp.yyscanner);
+    }
+    if (pp.hadError) {
+      for (const auto& syntaxError : pp.syntaxErrors) {
+        _syntaxErrors.push_back(syntaxError);
+      }
+      return false;
+    }
+    return true;
+  }
+
+public:
+  DataParser(const string& filename, const char* text, size_t length,
+             const FileUtils::MappedFile* mapped, Model* model, const vector<string>& includePaths,
+             vector<ParseWorkItem>& files, map<string, Model*>& seenModels,
+             bool parseDocComments, ostream& err, std::vector<SyntaxError>& syntaxErrors)
+      : _filename(filename),
+        _file(filename),
+        _text(text),
+        _length(length),
+        _mapped(mapped),
+        _model(model),
+        _includePaths(includePaths),
+        _files(files),
+        _seenModels(seenModels),
+        _parseDocComments(parseDocComments),
+        _err(err),
+        _syntaxErrors(syntaxErrors) {}
+
+  /// Parse all items, return whether there were no syntax errors
+  bool run() {
+    size_t p = 0;
+    // Start of the items that have to be parsed using the grammar
+    size_t pending = _length;
+    for (;;) {
+      size_t item = skipSpace(p);
+      if (item >= _length) {
+        break;
+      }
+      size_t end;
+      AssignI* ai = assignment(item, end);
+      if (ai == nullptr) {
+        if (pending == _length) {
+          pending = item;
+        }
+        p = skipItem(item);
+        continue;
+      }
+      if (pending != _length) {
+        if (!parseItems(pending, item)) {
+          return false;
+        }
+        pending = _length;
+      }
+      _model->addItem(ai);
+      GC::unlock();
+      GC::lock();
+      p = end;
+      if (_mapped != nullptr && p >= _released + (16 << 20)) {
+        _mapped->release(_released, p);
+        _released = p;
+      }
+    }
+    return pending == _length || parseItems(pending, _length);
+  }
+};
+
+/// Find library file \a libname in the include paths
+string find_library_file(const vector<string>& includePaths, const string& libname) {
+  for (const auto& ip : includePaths) {
+    string n = FileUtils::file_path(ip + "/" + libname);
+    if (FileUtils::file_exists(n)) {
+      return n;
+    }
+  }
+  return "";
+}
+
+/// Library files included into every model, together with whether they are part of the stdlib
+const std::pair<const char*, bool> library_files[] = {{"solver_redefinitions.mzn", false},
+                                                      {"stdlib.mzn", true}};
+
+/// Add the library files to the work list (stdlib.mzn last, so it is processed first)
+void add_library_files(const vector<string>& includePaths, vector<ParseWorkItem>& files,
+                       map<string, Model*>& seenModels, std::vector<Model*>& libs) {
+  for (const auto& lf : library_files) {
+    auto* lib = new Model;
+    std::string fullname = find_library_file(includePaths, lf.first);
+    lib->setFilename(fullname);
+    files.emplace_back(lib, nullptr, "./", fullname, lf.second);
+    seenModels.insert(pair<string, Model*>(fullname, lib));
+    libs.push_back(lib);
+  }
+}
+
+/// Resolve file name \a f included from \a parent in the same way as include items
+string canonical_filename(const vector<string>& includePaths, const string& parent,
+                          const string& f) {
+  if (FileUtils::is_absolute(f) || parent.empty()) {
     return f;
   }
   for (const auto& ip : includePaths) {
@@ -63,7 +773,7 @@ std::string ParserState::canonicalFilename(const std::string& f) const {
       return fullname;
     }
   }
-  std::string parentPath = FileUtils::dir_name(filename);
+  std::string parentPath = FileUtils::dir_name(parent);
   if (parentPath.empty()) {
     parentPath = ".";
   }
@@ -74,11 +784,339 @@ std::string ParserState::canonicalFilename(const std::string& f) const {
   return f;
 }
 
+/// Skip white space and comments in \a t (of length \a n) from position \a p
+size_t skip_space(const char* t, size_t n, size_t p) {
+  while (p < n) {
+    if (isspace(static_cast<unsigned char>(t[p])) != 0) {
+      p++;
+    } else if (t[p] == '%') {
+      while (p < n && t[p] != '\n') {
+        p++;
+      }
+    } else if (t[p] == '/' && p + 1 < n && t[p + 1] == '*') {
+      p += 2;
+      while (p + 1 < n && (t[p] != '*' || t[p + 1] != '/')) {
+        p++;
+      }
+      p = std::min(n, p + 2);
+    } else {
+      break;
+    }
+  }
+  return p;
+}
+
+/// Read the identifier starting at position \a p of \a t (empty if there is none)
+string scan_identifier(const char* t, size_t n, size_t& p) {
+  size_t start = p;
+  if (p < n && (isalpha(static_cast<unsigned char>(t[p])) != 0 || t[p] == '_')) {
+    while (p < n && (isalnum(static_cast<unsigned char>(t[p])) != 0 || t[p] == '_')) {
+      p++;
+    }
+  }
+  return string(t + start, p - start);
+}
+
+/// Skip to the end of the item containing position \a p (after the terminating semicolon)
+size_t skip_item(const char* t, size_t n, size_t p) {
+  int depth = 0;
+  while (p < n) {
+    size_t q = skip_space(t, n, p);
+    if (q != p) {
+      p = q;
+      continue;
+    }
+    char c = t[p++];
+    if (c == '"') {
+      while (p < n && t[p] != '"') {
+        p += t[p] == '\\' ? 2 : 1;
+      }
+      p++;
+    } else if (c == '(' || c == '[' || c == '{') {
+      depth++;
+    } else if (c == ')' || c == ']' || c == '}') {
+      depth--;
+    } else if (c == ';' && depth <= 0) {
+      break;
+    }
+  }
+  return std::min(n, p);
+}
+
+/**
+ * \brief Scan the items of library file \a t (of length \a n) without parsing them
+ *
+ * Collects the included files into \a includes and the names of the defined
+ * functions and predicates into \a names. Returns false if the file contains
+ * any other kind of item (or a definition that is not recognised).
+ */
+bool scan_library_file(const char* t, size_t n, vector<string>& includes, vector<string>& names) {
+  bool onlyFunctions = true;
+  size_t p = skip_space(t, n, 0);
+  while (p < n) {
+    size_t start = p;
+    string kw = scan_identifier(t, n, p);
+    p = skip_space(t, n, p);
+    if (kw == "include") {
+      if (p < n && t[p] == '"') {
+        size_t end = p + 1;
+        while (end < n && t[end] != '"') {
+          end++;
+        }
+        includes.emplace_back(t + p + 1, end - p - 1);
+      } else {
+        onlyFunctions = false;
+      }
+    } else if (kw == "predicate" || kw == "test" || kw == "function") {
+      if (kw == "function") {
+        // Skip the return type
+        int depth = 0;
+        while (p < n && (t[p] != ':' || depth > 0) && !(t[p] == ';' && depth == 0)) {
+          depth += (t[p] == '(' || t[p] == '[') ? 1 : ((t[p] == ')' || t[p] == ']') ? -1 : 0);
+          p++;
+        }
+        p = p < n && t[p] == ':' ? skip_space(t, n, p + 1) : n;
+      }
+      string name = scan_identifier(t, n, p);
+      if (name.empty()) {
+        onlyFunctions = false;
+      } else {
+        names.push_back(name);
+      }
+    } else if (start == p || t[start] != ';') {
+      onlyFunctions = false;
+    }
+    p = skip_space(t, n, skip_item(t, n, start));
+  }
+  return onlyFunctions;
+}
+
+/**
+ * \brief Index of the global constraint library
+ *
+ * Maps the names of the functions and predicates defined in the include
+ * closure of globals.mzn to the files that define them. The files are only
+ * scanned, which is much cheaper than parsing and type checking all of them.
+ */
+class GlobalsIndex {
+public:
+  /// Files defining each function name
+  std::unordered_map<string, vector<string>> definitions;
+  /// Files that have to be loaded in any case (they contain items other than functions)
+  vector<string> eagerFiles;
+
+  /// Build the index for the global constraint library \a globalsFile
+  void build(const vector<string>& includePaths, const string& globalsFile) {
+    std::unordered_set<string> seen;
+    vector<string> todo = {globalsFile};
+    while (!todo.empty()) {
+      string f = todo.back();
+      todo.pop_back();
+      if (!seen.insert(f).second) {
+        continue;
+      }
+      vector<string> scanned = {f};
+      // Deprecated definitions are loaded together with the file
+      for (const auto& ip : includePaths) {
+        string deprecatedName = ip + "/" + FileUtils::base_name(f) + ".deprecated.mzn";
+        if (FileUtils::file_exists(deprecatedName)) {
+          scanned.push_back(deprecatedName);
+        }
+      }
+      bool onlyFunctions = true;
+      vector<string> names;
+      for (const auto& sf : scanned) {
+        SourceFile file(sf);
+        vector<string> includes;
+        if (!file.isOpen()) {
+          // Report the error when the file is parsed
+          onlyFunctions = false;
+          continue;
+        }
+        onlyFunctions = scan_library_file(file.data(), file.size(), includes, names) &&
+                        onlyFunctions;
+        for (const auto& inc : includes) {
+          todo.push_back(canonical_filename(includePaths, sf, inc));
+        }
+      }
+      if (!onlyFunctions) {
+        eagerFiles.push_back(f);
+      }
+      std::sort(names.begin(), names.end());
+      names.erase(std::unique(names.begin(), names.end()), names.end());
+      for (const auto& name : names) {
+        definitions[name].push_back(f);
+      }
+    }
+  }
+};
+
+/// Collect the names of all functions called in the items of \a m
+void collect_called_functions(Model* m, ASTStringSet& called) {
+  class CollectCalls : public EVisitor {
+  public:
+    ASTStringSet& called;
+    CollectCalls(ASTStringSet& called0) : called(called0) {}
+    void vCall(const Call& c) { called.insert(c.id()); }
+  } cc(called);
+  for (Item* it : *m) {
+    switch (it->iid()) {
+      case Item::II_VD:
+        top_down(cc, it->cast<VarDeclI>()->e());
+        break;
+      case Item::II_ASN:
+        top_down(cc, it->cast<AssignI>()->e());
+        break;
+      case Item::II_CON:
+        top_down(cc, it->cast<ConstraintI>()->e());
+        break;
+      case Item::II_SOL: {
+        auto* si = it->cast<SolveI>();
+        top_down(cc, si->e());
+        for (ExpressionSetIter a = si->ann().begin(); a != si->ann().end(); ++a) {
+          top_down(cc, *a);
+        }
+      } break;
+      case Item::II_OUT:
+        top_down(cc, it->cast<OutputI>()->e());
+        break;
+      case Item::II_FUN: {
+        auto* fi = it->cast<FunctionI>();
+        top_down(cc, fi->ti());
+        for (auto* p : fi->params()) {
+          top_down(cc, p);
+        }
+        top_down(cc, fi->e());
+        for (ExpressionSetIter a = fi->ann().begin(); a != fi->ann().end(); ++a) {
+          top_down(cc, *a);
+        }
+      } break;
+      default:
+        break;
+    }
+  }
+}
+
+/// Calls introduced by the compiler when it encounters a call to the first function
+const std::pair<const char*, const char*> introduced_calls[] = {
+    {"count", "count_eq"},  {"count", "count_neq"}, {"count", "count_lt"},
+    {"count", "count_leq"}, {"count", "count_gt"},  {"count", "count_geq"},
+    {"sum", "count_eq"},    {"sum", "count_neq"},   {"sum", "count_lt"},
+    {"sum", "count_leq"},   {"sum", "count_gt"},    {"sum", "count_geq"},
+    {"fzn_regular", "regular"}};
+
+/**
+ * \brief Load the parts of the global constraint library \a globals that are used
+ *
+ * The model \a globals stands for globals.mzn and is initially empty. Files of
+ * the library are included into it whenever a model in \a seenModels calls a
+ * function they define (or a reified version of it), until no more files are
+ * needed.
+ */
+bool load_globals(Model* globals, map<string, Model*>& seenModels, Model* model,
+                  const vector<string>& includePaths, const string& workingDir,
+                  bool parseDocComments, bool verbose, ostream& err,
+                  std::vector<SyntaxError>& syntaxErrors) {
+  GCLock lock;
+  string globalsFile = globals->filepath().c_str();
+  GlobalsIndex index;
+  index.build(includePaths, globalsFile);
+  vector<ParseWorkItem> files;
+  auto load = [&](const string& f) {
+    if (seenModels.find(f) != seenModels.end()) {
+      return;
+    }
+    if (f == globalsFile) {
+      // globals.mzn itself cannot be loaded on demand, parse the whole library
+      files.emplace_back(globals, nullptr, "", f);
+      seenModels.insert(pair<string, Model*>(f, globals));
+      return;
+    }
+    auto* im = new Model;
+    im->setParent(globals);
+    im->setFilename(f);
+    Location loc(ASTString(globalsFile), 0, 0, 0, 0);
+    auto* ii = new IncludeI(loc, ASTString(FileUtils::base_name(f)));
+    ii->m(im, true);
+    globals->addItem(ii);
+    files.emplace_back(im, ii, FileUtils::dir_name(globalsFile), f);
+    seenModels.insert(pair<string, Model*>(f, im));
+  };
+  for (const auto& f : index.eagerFiles) {
+    load(f);
+  }
+  std::vector<Model*> scan = {model};
+  for (const auto& it : seenModels) {
+    if (it.second != globals) {
+      scan.push_back(it.second);
+    }
+  }
+  ASTStringSet called;
+  for (;;) {
+    ASTStringSet newCalls;
+    for (Model* m : scan) {
+      collect_called_functions(m, newCalls);
+    }
+    vector<string> names;
+    for (const auto& c : newCalls) {
+      if (called.insert(c).second) {
+        names.emplace_back(c.c_str());
+      }
+    }
+    for (unsigned int i = 0; i < names.size(); i++) {
+      for (const auto& ic : introduced_calls) {
+        if (names[i] == ic.first) {
+          names.emplace_back(ic.second);
+        }
+      }
+      for (const string& n : {names[i], names[i] + "_reif", names[i] + "_imp"}) {
+        auto def = index.definitions.find(n);
+        if (def != index.definitions.end()) {
+          for (const auto& f : def->second) {
+            load(f);
+          }
+        }
+      }
+    }
+    if (files.empty()) {
+      return true;
+    }
+    std::set<Model*> before;
+    for (const auto& it : seenModels) {
+      before.insert(it.second);
+    }
+    for (const auto& f : files) {
+      before.erase(f.m);
+    }
+    if (verbose) {
+      err << "loading " << files.size() << " global constraint files on demand" << endl;
+    }
+    if (!parse_files(files, seenModels, includePaths, workingDir, parseDocComments, verbose, err,
+                     syntaxErrors)) {
+      return false;
+    }
+    scan.clear();
+    for (const auto& it : seenModels) {
+      if (before.find(it.second) == before.end()) {
+        scan.push_back(it.second);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+std::string ParserState::canonicalFilename(const std::string& f) const {
+  return canonical_filename(includePaths, filename, f);
+}
+
 void parse(Env& env, Model*& model, const vector<string>& filenames,
            const vector<string>& datafiles, const std::string& modelString,
            const std::string& modelStringName, const vector<string>& ip, bool isFlatZinc,
            bool ignoreStdlib, bool parseDocComments, bool verbose, ostream& err,
-           std::vector<SyntaxError>& syntaxErrors) {
+           std::vector<SyntaxError>& syntaxErrors, const std::string& libraryImage = "",
+           bool lazyGlobals = false, Model* library = nullptr,
+           const vector<string>* libraryFiles = nullptr, vector<string>* parsedFiles = nullptr) {
   vector<string> includePaths;
   for (const auto& i : ip) {
     includePaths.push_back(i);
@@ -135,20 +1173,7 @@ void parse(Env& env, Model*& model, const vector<string>& filenames,
     files.emplace_back(model, nullptr, modelString, modelStringName, false, true);
   }
 
-  auto include_file = [&](const std::string& libname, bool builtin) {
-    GCLock lock;
-    auto* lib = new Model;
-    std::string fullname;
-    for (const auto& ip : includePaths) {
-      std::string n = FileUtils::file_path(ip + "/" + libname);
-      if (FileUtils::file_exists(n)) {
-        fullname = n;
-        break;
-      }
-    }
-    lib->setFilename(fullname);
-    files.emplace_back(lib, nullptr, "./", fullname, builtin);
-    seenModels.insert(pair<string, Model*>(fullname, lib));
+  auto include_lib = [&](const std::string& libname, Model* lib) {
     Location libloc(ASTString(model->filename()), 0, 0, 0, 0);
     auto* libinc = new IncludeI(libloc, libname);
     libinc->m(lib, true);
@@ -157,151 +1182,153 @@ void parse(Env& env, Model*& model, const vector<string>& filenames,
 
   // TODO: It should be possible to use just flatzinc builtins instead of stdlib when parsing
   // FlatZinc if (!isFlatZinc) {
-  if (!ignoreStdlib) {
-    include_file("solver_redefinitions.mzn", false);
-    include_file("stdlib.mzn", true);  // Added last, so it is processed first
-  }
-  // } else {
-  //   include_file("flatzincbuiltins.mzn", true);
-  // }
-
-  while (!files.empty()) {
+  if (library != nullptr) {
+    // The library has been parsed before, including any of its files refers to it
     GCLock lock;
-    ParseWorkItem& np = files.back();
-    string parentPath = np.dirName;
-    Model* m = np.m;
-    bool isModelString = np.isModelString;
-    bool isSTDLib = np.isSTDLib;
-    IncludeI* np_ii = np.ii;
-    string f(np.fileName);
-    files.pop_back();
-
-    std::string s;
-    std::string fullname;
-    std::string basename;
-    bool isFzn;
-    if (!isModelString) {
-      for (Model* p = m->parent(); p != nullptr; p = p->parent()) {
-        if (p->filename() == f) {
-          err << "Error: cyclic includes: " << std::endl;
-          for (Model* pe = m; pe != nullptr; pe = pe->parent()) {
-            err << "  " << pe->filename() << std::endl;
-          }
-          goto error;
-        }
-      }
-      ifstream file;
-      if (FileUtils::is_absolute(f)) {
-        fullname = f;
-        basename = FileUtils::base_name(fullname);
-        if (FileUtils::file_exists(fullname)) {
-          file.open(FILE_PATH(fullname), std::ios::binary);
-        }
-      }
-      if (file.is_open() &&
-          FileUtils::file_path(FileUtils::dir_name(fullname)) != FileUtils::file_path(workingDir) &&
-          FileUtils::file_exists(workingDir + "/" + basename)) {
-        err << "Warning: file " << basename
-            << " included from library, but also exists in current working directory" << endl;
-      }
-      for (const auto& includePath : includePaths) {
-        std::string deprecatedName = includePath + "/" + basename + ".deprecated.mzn";
-        if (FileUtils::file_exists(deprecatedName)) {
-          string deprecatedFullPath = FileUtils::file_path(deprecatedName);
-          string deprecatedBaseName = FileUtils::base_name(deprecatedFullPath);
-          string deprecatedDirName = FileUtils::dir_name(deprecatedFullPath);
-          auto* includedModel = new Model;
-          includedModel->setFilename(deprecatedName);
-          files.emplace_back(includedModel, nullptr, "", deprecatedName, isSTDLib, false);
-          seenModels.insert(pair<string, Model*>(deprecatedName, includedModel));
-          Location loc(ASTString(deprecatedName), 0, 0, 0, 0);
-          auto* inc = new IncludeI(loc, includedModel->filename());
-          inc->m(includedModel, true);
-          m->addItem(inc);
-          files.emplace_back(includedModel, inc, deprecatedDirName, deprecatedFullPath, isSTDLib,
-                             false);
+    for (const auto& f : *libraryFiles) {
+      seenModels.insert(pair<string, Model*>(f, library));
+    }
+    include_lib("stdlib.mzn", library);
+  } else if (!ignoreStdlib) {
+    LibraryImage image;
+    bool useImage =
+        !libraryImage.empty() && !parseDocComments && image.read(libraryImage, includePaths);
+    if (useImage) {
+      useImage = image.roots.size() == sizeof(library_files) / sizeof(library_files[0]);
+      for (const auto& it : image.models) {
+        if (seenModels.find(it.first) != seenModels.end()) {
+          // A library file is also given on the command line, parse it normally
+          useImage = false;
+          break;
         }
       }
-      if (!file.is_open()) {
-        if (np_ii != nullptr) {
-          err << np_ii->loc().toString() << ":\n";
-          err << "MiniZinc: error in include item, cannot open file '" << f << "'." << endl;
-        } else {
-          err << "Error: cannot open file '" << f << "'." << endl;
+      if (!useImage) {
+        for (auto* lib : image.roots) {
+          delete lib;
         }
-        goto error;
       }
+    }
+    if (useImage) {
+      GCLock lock;
       if (verbose) {
-        std::cerr << "processing file '" << fullname << "'" << endl;
+        std::cerr << "loading library image '" << libraryImage << "'" << endl;
       }
-      s = get_file_contents(file);
-
-      if (m->filepath().size() == 0) {
-        m->setFilepath(fullname);
+      for (const auto& it : image.models) {
+        seenModels.insert(it);
+        check_shadowed_file(it.second->filepath().c_str(), workingDir, err);
+      }
+      for (unsigned int i = 0; i < image.roots.size(); i++) {
+        include_lib(library_files[i].first, image.roots[i]);
       }
-      isFzn = (fullname.compare(fullname.length() - 4, 4, ".fzn") == 0);
-      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".ozn") == 0);
-      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".szn") == 0);
-      isFzn |= (fullname.compare(fullname.length() - 4, 4, ".mzc") == 0);
     } else {
-      isFzn = false;
-      fullname = f;
-      s = parentPath;
-    }
-    ParserState pp(fullname, s, err, includePaths, files, seenModels, m, false, isFzn, isSTDLib,
-                   parseDocComments);
-    mzn_yylex_init(&pp.yyscanner);
-    mzn_yyset_extra(&pp, pp.yyscanner);
-    mzn_yyparse(&pp);
-    if (pp.yyscanner != nullptr) {
-      mzn_yylex_destroy(pp.yyscanner);
-    }
-    if (pp.hadError) {
-      for (const auto& syntaxError : pp.syntaxErrors) {
-        syntaxErrors.push_back(syntaxError);
+      GCLock lock;
+      std::vector<Model*> libs;
+      add_library_files(includePaths, files, seenModels, libs);
+      for (unsigned int i = 0; i < libs.size(); i++) {
+        include_lib(library_files[i].first, libs[i]);
       }
-      goto error;
+    }
+  }
+  // } else {
+  //   include_file("flatzincbuiltins.mzn", true);
+  // }
+
+  // In lazy mode, globals.mzn stands for the library files that are actually used
+  Model* globals = nullptr;
+  if (lazyGlobals && !isFlatZinc && !parseDocComments) {
+    std::string globalsFile = find_library_file(includePaths, "globals.mzn");
+    if (!globalsFile.empty() && seenModels.find(globalsFile) == seenModels.end()) {
+      GCLock lock;
+      globals = new Model;
+      globals->setFilename(globalsFile);
+      globals->setFilepath(globalsFile);
+      seenModels.insert(pair<string, Model*>(globalsFile, globals));
     }
   }
 
+  if (!parse_files(files, seenModels, includePaths, workingDir, parseDocComments, verbose, err,
+                   syntaxErrors)) {
+    goto error;
+  }
+
   for (const auto& f : datafiles) {
     GCLock lock;
     if (f.size() >= 6 && f.substr(f.size() - 5, string::npos) == ".json") {
       JSONParser jp(env.envi());
       jp.parse(model, f, true);
     } else {
-      string s;
+      std::unique_ptr<SourceFile> file;
+      const char* text;
+      size_t textLength;
       if (f.size() > 5 && f.substr(0, 5) == "cmd:/") {
-        s = f.substr(5);
+        text = f.c_str() + 5;
+        textLength = f.size() - 5;
       } else {
-        std::ifstream file(FILE_PATH(f), std::ios::binary);
-        if (!FileUtils::file_exists(f) || !file.is_open()) {
+        if (FileUtils::file_exists(f)) {
+          file.reset(new SourceFile(f));
+        }
+        if (file == nullptr || !file->isOpen()) {
           err << "Error: cannot open data file '" << f << "'." << endl;
           goto error;
         }
         if (verbose) {
           std::cerr << "processing data file '" << f << "'" << endl;
         }
-        s = get_file_contents(file);
+        text = file->data();
+        textLength = file->size();
       }
 
-      ParserState pp(f, s, err, includePaths, files, seenModels, model, true, false, false,
-                     parseDocComments);
-      mzn_yylex_init(&pp.yyscanner);
-      mzn_yyset_extra(&pp, pp.yyscanner);
-      mzn_yyparse(&pp);
-      if (pp.yyscanner != nullptr) {
-        mzn_yylex_destroy(pp.yyscanner);
+      DataParser dp(f, text, textLength, file != nullptr ? file->mapped() : nullptr, model,
+                    includePaths, files, seenModels, parseDocComments, err, syntaxErrors);
+      if (!dp.run()) {
+        goto error;
       }
-      if (pp.hadError) {
-        for (const auto& syntaxError : pp.syntaxErrors) {
-          syntaxErrors.push_back(syntaxError);
+    }
+  }
+
+  if (globals != nullptr) {
+    // Find the first include of globals.mzn, which becomes its owner
+    IncludeI* globalsInclude = nullptr;
+    Model* includer = nullptr;
+    std::set<Model*> visited;
+    std::vector<Model*> todo = {model};
+    while (!todo.empty() && globalsInclude == nullptr) {
+      Model* m = todo.back();
+      todo.pop_back();
+      if (!visited.insert(m).second) {
+        continue;
+      }
+      for (Item* it : *m) {
+        if (auto* ii = it->dynamicCast<IncludeI>()) {
+          if (ii->m() == globals) {
+            globalsInclude = ii;
+            includer = m;
+            break;
+          }
+          if (ii->m() != nullptr) {
+            todo.push_back(ii->m());
+          }
         }
+      }
+    }
+    if (globalsInclude == nullptr) {
+      seenModels.erase(globals->filepath().c_str());
+      delete globals;
+    } else {
+      globalsInclude->m(globals, true);
+      globals->setParent(includer);
+      if (!load_globals(globals, seenModels, model, includePaths, workingDir, parseDocComments,
+                        verbose, err, syntaxErrors)) {
         goto error;
       }
     }
   }
 
+  if (parsedFiles != nullptr) {
+    for (const auto& it : seenModels) {
+      parsedFiles->push_back(it.first);
+    }
+  }
   return;
 error:
   delete model;
@@ -311,9 +1338,32 @@ error:
 Model* parse(Env& env, const vector<string>& filenames, const vector<string>& datafiles,
              const string& textModel, const string& textModelName,
              const vector<string>& includePaths, bool isFlatZinc, bool ignoreStdlib,
-             bool parseDocComments, bool verbose, ostream& err) {
+             bool parseDocComments, bool verbose, ostream& err, const string& libraryImage,
+             bool lazyGlobals) {
+  if (filenames.empty() && textModel.empty()) {
+    err << "Error: no model given" << std::endl;
+    return nullptr;
+  }
+
+  Model* model;
+  {
+    GCLock lock;
+    model = new Model();
+  }
+  std::vector<SyntaxError> se;
+  parse(env, model, filenames, datafiles, textModel, textModelName, includePaths, isFlatZinc,
+        ignoreStdlib, parseDocComments, verbose, err, se, libraryImage, lazyGlobals);
+  return model;
+}
+
+Model* parse(Env& env, Model* library, const vector<string>& libraryFiles,
+             const vector<string>& filenames, const vector<string>& datafiles,
+             const string& textModel, const string& textModelName,
+             const vector<string>& includePaths, bool isFlatZinc, bool parseDocComments,
+             bool verbose, ostream& err, bool lazyGlobals) {
   if (filenames.empty() && textModel.empty()) {
     err << "Error: no model given" << std::endl;
+    delete library;
     return nullptr;
   }
 
@@ -324,7 +1374,20 @@ Model* parse(Env& env, const vector<string>& filenames, const vector<string>& da
   }
   std::vector<SyntaxError> se;
   parse(env, model, filenames, datafiles, textModel, textModelName, includePaths, isFlatZinc,
-        ignoreStdlib, parseDocComments, verbose, err, se);
+        false, parseDocComments, verbose, err, se, "", lazyGlobals, library, &libraryFiles);
+  return model;
+}
+
+Model* parse_library(Env& env, const vector<string>& includePaths, bool verbose, ostream& err,
+                     const string& libraryImage, vector<string>& libraryFiles) {
+  Model* model;
+  {
+    GCLock lock;
+    model = new Model();
+  }
+  std::vector<SyntaxError> se;
+  parse(env, model, vector<string>(), vector<string>(), "", "", includePaths, false, false, false,
+        verbose, err, se, libraryImage, false, nullptr, nullptr, &libraryFiles);
   return model;
 }
 
@@ -354,4 +1417,29 @@ Model* parse_from_string(Env& env, const string& text, const string& filename,
   return model;
 }
 
+bool precompile_library(const vector<string>& includePaths, const string& imageFile, bool verbose,
+                        ostream& err) {
+  vector<ParseWorkItem> files;
+  map<string, Model*> seenModels;
+  LibraryImage image;
+  {
+    GCLock lock;
+    add_library_files(includePaths, files, seenModels, image.roots);
+  }
+  std::vector<SyntaxError> syntaxErrors;
+  bool ok = parse_files(files, seenModels, includePaths, FileUtils::working_directory(), false,
+                        verbose, err, syntaxErrors);
+  if (ok) {
+    image.models = seenModels;
+    ok = image.write(imageFile, includePaths);
+    if (!ok) {
+      err << "Error: cannot write library image '" << imageFile << "'." << endl;
+    }
+  }
+  for (auto* lib : image.roots) {
+    delete lib;
+  }
+  return ok;
+}
+
 }  // namespace MiniZinc
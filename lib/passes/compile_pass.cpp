@@ -135,17 +135,19 @@ Env* CompilePass::run(Env* store, std::ostream& log) {
   }
   new_env->envi().ignoreUnknownIds = _ignoreUnknownIds;
 
-  vector<TypeError> typeErrors;
-  MiniZinc::typecheck(*new_env, new_env->model(), typeErrors,
-                      _compflags.modelCheckOnly || _compflags.modelInterfaceOnly,
-                      _compflags.allowMultiAssign);
-  if (!typeErrors.empty()) {
-    std::ostringstream errstream;
-    for (auto& typeError : typeErrors) {
-      errstream << typeError.what() << ": " << typeError.msg() << std::endl;
-      errstream << typeError.loc() << std::endl;
+  if (!_compflags.typechecked || _changeLibrary) {
+    vector<TypeError> typeErrors;
+    MiniZinc::typecheck(*new_env, new_env->model(), typeErrors,
+                        _compflags.modelCheckOnly || _compflags.modelInterfaceOnly,
+                        _compflags.allowMultiAssign);
+    if (!typeErrors.empty()) {
+      std::ostringstream errstream;
+      for (auto& typeError : typeErrors) {
+        errstream << typeError.what() << ": " << typeError.msg() << std::endl;
+        errstream << typeError.loc() << std::endl;
+      }
+      throw Error(errstream.str());
     }
-    throw Error(errstream.str());
   }
 
   register_builtins(*new_env);
@@ -161,6 +163,14 @@ Env* CompilePass::run(Env* store, std::ostream& log) {
     new_env->dumpErrorStack(errstream);
     errstream << "  " << e.msg() << std::endl;
     throw Error(errstream.str());
+  } catch (MemoryLimit& e) {
+    if (_compflags.verbose) {
+      log << std::endl;
+    }
+    std::ostringstream errstream;
+    errstream << e.msg() << std::endl;
+    new_env->dumpErrorStack(errstream);
+    throw MemoryLimit(errstream.str());
   }
 
   if (!_compflags.noMIPdomains) {
@@ -341,7 +341,18 @@ public:
       case Expression::E_ARRAYLIT: {
         const ArrayLit& al = *e->cast<ArrayLit>();
         unsigned int n = al.dims();
-        if (n == 1 && al.min(0) == 1) {
+        if (n == 1 && al.min(0) == 1 && al.parKind() == ArrayLit::PK_INT) {
+          // print unboxed integers directly
+          const long long int* v = al.parInts();
+          _os << "[";
+          for (unsigned int i = 0; i < al.size(); i++) {
+            _os << v[i];
+            if (i < al.size() - 1) {
+              _os << ",";
+            }
+          }
+          _os << "]";
+        } else if (n == 1 && al.min(0) == 1) {
           _os << "[";
           for (unsigned int i = 0; i < al.size(); i++) {
             p(al[i]);
@@ -0,0 +1,618 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <minizinc/file_utils.hh>
+#include <minizinc/param_config.hh>
+#include <minizinc/server.hh>
+#include <minizinc/timer.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace MiniZinc {
+
+#ifndef _WIN32
+namespace {
+/// Stream buffer reading from and writing to a connected socket
+class SocketBuf : public std::streambuf {
+protected:
+  int _fd;
+  char _in[4096];
+  char _out[4096];
+
+public:
+  SocketBuf(int fd) : _fd(fd) {
+    setg(_in, _in, _in);
+    setp(_out, _out + sizeof(_out));
+  }
+  ~SocketBuf() override { sync(); }
+
+protected:
+  int_type underflow() override {
+    ssize_t n;
+    do {
+      n = ::recv(_fd, _in, sizeof(_in), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      return traits_type::eof();
+    }
+    setg(_in, _in, _in + n);
+    return traits_type::to_int_type(*gptr());
+  }
+  int_type overflow(int_type c) override {
+    if (sync() != 0) {
+      return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+  int sync() override {
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+    const char* p = pbase();
+    while (p < pptr()) {
+      ssize_t n = ::send(_fd, p, pptr() - p, flags);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        setp(_out, _out + sizeof(_out));
+        return -1;
+      }
+      p += n;
+    }
+    setp(_out, _out + sizeof(_out));
+    return 0;
+  }
+};
+}  // namespace
+#endif
+
+struct MznServer::JobPool {
+  struct Job {
+    /// The JSON object describing the job
+    std::string text;
+    /// Whether the job has finished
+    bool done = false;
+    int status = 0;
+    /// Standard output of the job
+    std::string out;
+    /// Error output of the job
+    std::string err;
+  };
+  std::vector<std::thread> threads;
+  /// Protects all other members
+  std::mutex mutex;
+  /// Signalled when a job is queued or finished, and when the pool is stopped
+  std::condition_variable cond;
+  /// Jobs waiting for a thread
+  std::deque<std::shared_ptr<Job>> queue;
+  /// Jobs whose output has not been printed yet, in the order of the input
+  std::deque<std::shared_ptr<Job>> pending;
+  bool stop = false;
+};
+
+MznServer::MznServer(std::vector<std::string> args, std::string exeName)
+    : _args(std::move(args)), _exeName(std::move(exeName)) {}
+
+MznServer::~MznServer() {
+  if (_pool) {
+    {
+      std::lock_guard<std::mutex> lock(_pool->mutex);
+      _pool->stop = true;
+    }
+    _pool->cond.notify_all();
+    for (auto& t : _pool->threads) {
+      t.join();
+    }
+  }
+}
+
+bool MznServer::processOptions(std::vector<std::string>& args, std::string& socketPath,
+                               unsigned int& threads) {
+  bool server = false;
+  for (auto it = args.begin(); it != args.end();) {
+    if (*it == "--server") {
+      server = true;
+      it = args.erase(it);
+    } else if (*it == "--server-socket" && it + 1 != args.end()) {
+      server = true;
+      socketPath = *(it + 1);
+      it = args.erase(it, it + 2);
+    } else if (*it == "--server-threads" && it + 1 != args.end()) {
+      int n = atoi((it + 1)->c_str());
+      threads = n > 0 ? static_cast<unsigned int>(n) : 1;
+      it = args.erase(it, it + 2);
+    } else {
+      ++it;
+    }
+  }
+  return server;
+}
+
+bool MznServer::processBatchOptions(std::vector<std::string>& args, std::string& listFile,
+                                    unsigned int& workers) {
+  bool batch = false;
+  for (auto it = args.begin(); it != args.end();) {
+    if (*it == "--data-batch" && it + 1 != args.end()) {
+      batch = true;
+      listFile = *(it + 1);
+      it = args.erase(it, it + 2);
+    } else if (*it == "--data-batch-workers" && it + 1 != args.end()) {
+      int n = atoi((it + 1)->c_str());
+      workers = n > 0 ? static_cast<unsigned int>(n) : 1;
+      it = args.erase(it, it + 2);
+    } else {
+      ++it;
+    }
+  }
+  return batch;
+}
+
+int MznServer::runJob(const std::string& job, const std::shared_ptr<LibraryModel>& library,
+                      std::ostream& os, std::ostream& log) {
+  std::vector<std::string> args = _args;
+  std::string modelText;
+  try {
+    ParamConfig pc;
+    pc.blacklist({"--server", "--server-socket", "--server-threads", "-", "--input-from-stdin"});
+    pc.loadFromString(job);
+    // The options of the job are appended to the options of the server
+    const auto& jobArgs = pc.argv();
+    for (unsigned int i = 0; i < jobArgs.size(); i++) {
+      if (jobArgs[i] == "--model-text" && i + 1 < jobArgs.size()) {
+        modelText += jobArgs[++i];
+      } else {
+        args.push_back(jobArgs[i]);
+      }
+    }
+  } catch (ParamException& e) {
+    log << "Invalid job: " << e.msg() << std::endl;
+    return 1;
+  }
+  return runArgs(args, modelText, library, os, log);
+}
+
+int MznServer::runInstance(const std::string& dataFile) {
+  std::vector<std::string> args = _args;
+  args.emplace_back("--data");
+  args.push_back(dataFile);
+  // Files written by default (e.g. when compiling) are named after the data file
+  size_t dot = dataFile.find_last_of('.');
+  size_t sep = dataFile.find_last_of("/\\");
+  args.emplace_back("--output-base");
+  args.push_back(dot != std::string::npos && (sep == std::string::npos || dot > sep)
+                     ? dataFile.substr(0, dot)
+                     : dataFile);
+  return runArgs(args, "", nullptr, std::cout, std::cerr);
+}
+
+int MznServer::runArgs(const std::vector<std::string>& args, const std::string& modelText,
+                       const std::shared_ptr<LibraryModel>& library, std::ostream& os,
+                       std::ostream& log) {
+  Timer starttime;
+  bool fSuccess = false;
+  std::unique_ptr<MznSolver> slv;
+  try {
+    {
+      std::lock_guard<std::mutex> lock(_solverConfigsMutex);
+      slv.reset(_solverConfigs ? new MznSolver(*_solverConfigs, os, log) : new MznSolver(os, log));
+    }
+    if (_batchModel) {
+      slv->setBatchModel(_batchModel);
+    }
+    if (library) {
+      slv->setLibraryModel(library);
+    }
+    fSuccess = (slv->run(args, modelText, _exeName) != SolverInstance::ERROR);
+  } catch (const LocationException& e) {
+    if (slv && slv->getFlagVerbose()) {
+      log << std::endl;
+    }
+    log << e.loc() << ":" << std::endl;
+    log << e.what() << ": " << e.msg() << std::endl;
+  } catch (const Exception& e) {
+    if (slv && slv->getFlagVerbose()) {
+      log << std::endl;
+    }
+    std::string what = e.what();
+    log << what << (what.empty() ? "" : ": ") << e.msg() << std::endl;
+  } catch (const std::exception& e) {
+    if (slv && slv->getFlagVerbose()) {
+      log << std::endl;
+    }
+    log << e.what() << std::endl;
+  } catch (...) {
+    if (slv && slv->getFlagVerbose()) {
+      log << std::endl;
+    }
+    log << "  UNKNOWN EXCEPTION." << std::endl;
+  }
+  if (slv) {
+    if (slv->getFlagVerbose()) {
+      log << "   Done (";
+      log << "overall time " << starttime.stoptime() << ")." << std::endl;
+    }
+    std::lock_guard<std::mutex> lock(_solverConfigsMutex);
+    if (!_solverConfigs && slv->getSolverConfigs() != nullptr) {
+      _solverConfigs.reset(new SolverConfigs(*slv->getSolverConfigs()));
+    }
+  }
+  return fSuccess ? 0 : 1;
+}
+
+void MznServer::work() {
+  JobPool& pool = *_pool;
+  // Models are garbage collected per thread, so each thread has its own library
+  auto library = std::make_shared<LibraryModel>();
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  for (;;) {
+    pool.cond.wait(lock, [&pool] { return pool.stop || !pool.queue.empty(); });
+    if (pool.queue.empty()) {
+      return;
+    }
+    std::shared_ptr<JobPool::Job> job = pool.queue.front();
+    pool.queue.pop_front();
+    lock.unlock();
+    std::ostringstream out;
+    std::ostringstream err;
+    job->status = runJob(job->text, library, out, err);
+    job->out = out.str();
+    job->err = err.str();
+    lock.lock();
+    job->done = true;
+    // Print the output of the finished jobs at the front of the input order
+    while (!pool.pending.empty() && pool.pending.front()->done) {
+      const JobPool::Job& front = *pool.pending.front();
+      std::cerr << front.err;
+      std::cerr.flush();
+      std::cout << front.out << "%%%mzn-job-end: " << front.status << std::endl;
+      pool.pending.pop_front();
+    }
+    pool.cond.notify_all();
+  }
+}
+
+void MznServer::serve(std::istream& is, unsigned int threads) {
+  if (threads > 1 && !_pool) {
+    _pool.reset(new JobPool());
+    for (unsigned int i = 0; i < threads; i++) {
+      try {
+        _pool->threads.emplace_back(&MznServer::work, this);
+      } catch (std::system_error&) {
+        // Continue with the threads that could be started
+        break;
+      }
+    }
+    if (_pool->threads.empty()) {
+      _pool.reset();
+    }
+  }
+  std::string job;
+  while (std::getline(is, job)) {
+    if (job.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    if (!_pool) {
+      if (!_library) {
+        _library = std::make_shared<LibraryModel>();
+      }
+      int status = runJob(job, _library, std::cout, std::cerr);
+      std::cerr.flush();
+      std::cout << "%%%mzn-job-end: " << status << std::endl;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_pool->mutex);
+    // Don't read too far ahead of the jobs that are running
+    _pool->cond.wait(lock, [this] { return _pool->pending.size() < 2 * _pool->threads.size(); });
+    auto j = std::make_shared<JobPool::Job>();
+    j->text = job;
+    _pool->queue.push_back(j);
+    _pool->pending.push_back(j);
+    _pool->cond.notify_all();
+  }
+  if (_pool) {
+    // Wait until the output of all jobs has been printed
+    std::unique_lock<std::mutex> lock(_pool->mutex);
+    _pool->cond.wait(lock, [this] { return _pool->pending.empty(); });
+  }
+}
+
+void MznServer::serve(const std::string& path, unsigned int threads) {
+#ifdef _WIN32
+  std::cerr << "Error: --server-socket is not supported on this platform." << std::endl;
+#else
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Error: socket path '" << path << "' is too long." << std::endl;
+    return;
+  }
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    std::cerr << "Error: cannot create socket: " << std::strerror(errno) << std::endl;
+    return;
+  }
+  // Remove a socket left behind by a previous server
+  struct stat st;
+  if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    ::unlink(path.c_str());
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0) {
+    std::cerr << "Error: cannot listen on socket '" << path << "': " << std::strerror(errno)
+              << std::endl;
+    ::close(fd);
+    return;
+  }
+  for (;;) {
+    int conn = ::accept(fd, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Error: cannot accept connection: " << std::strerror(errno) << std::endl;
+      break;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    ::setsockopt(conn, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    {
+      // Jobs (and the solvers they run) write to std::cout and std::cerr,
+      // so both are redirected to the connection while it is served
+      SocketBuf buf(conn);
+      std::istream in(&buf);
+      std::streambuf* out = std::cout.rdbuf(&buf);
+      std::streambuf* err = std::cerr.rdbuf(&buf);
+      serve(in, threads);
+      std::cout.flush();
+      std::cout.rdbuf(out);
+      std::cerr.rdbuf(err);
+      std::cout.clear();
+      std::cerr.clear();
+    }
+    ::close(conn);
+  }
+  ::close(fd);
+  ::unlink(path.c_str());
+#endif
+}
+
+#ifndef _WIN32
+namespace {
+/// Write \a n bytes from \a buf to \a fd
+bool write_all(int fd, const char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t w = ::write(fd, buf, n);
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+    if (w <= 0) {
+      return false;
+    }
+    buf += w;
+    n -= w;
+  }
+  return true;
+}
+}  // namespace
+#endif
+
+int MznServer::runBatch(const std::string& listFile, unsigned int workers) {
+  for (const auto& arg : _args) {
+    if ((arg.size() >= 2 && arg.compare(0, 2, "-o") == 0) || arg == "--output-to-file" ||
+        arg == "--fzn" || arg == "--output-fzn-to-file" || arg == "--ozn" ||
+        arg == "--output-ozn-to-file" || arg == "--output-paths-to-file" ||
+        arg == "--output-base") {
+      std::cerr << "Error: " << arg
+                << " cannot be used with --data-batch, as all instances would write to the "
+                   "same file."
+                << std::endl;
+      return 1;
+    }
+  }
+  std::ifstream is(FILE_PATH(listFile));
+  if (!is.good()) {
+    std::cerr << "Error: cannot open data batch file '" << listFile << "'." << std::endl;
+    return 1;
+  }
+  // One data file per line, relative to the directory of the list file
+  std::vector<std::string> dataFiles;
+  std::string line;
+  while (std::getline(is, line)) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '%') {
+      continue;
+    }
+    size_t last = line.find_last_not_of(" \t\r");
+    std::string f = line.substr(first, last - first + 1);
+    dataFiles.push_back(FileUtils::is_absolute(f)
+                            ? f
+                            : FileUtils::file_path(f, FileUtils::dir_name(listFile)));
+  }
+
+  _batchModel = std::make_shared<BatchModel>();
+  int status = 0;
+  auto output = [&](size_t i, int instanceStatus, const std::string& text) {
+    std::cout << "%%%mzn-batch-instance: " << dataFiles[i] << "\n"
+              << text << "%%%mzn-job-end: " << instanceStatus << std::endl;
+    if (instanceStatus != 0) {
+      status = 1;
+    }
+  };
+  // The first instance is always run by this process, so that the shared
+  // model and the solver configurations are available to the workers
+  size_t next = 0;
+  if (workers <= 1 || dataFiles.size() <= 2) {
+    for (; next < dataFiles.size(); next++) {
+      std::cout << "%%%mzn-batch-instance: " << dataFiles[next] << std::endl;
+      int instanceStatus = runInstance(dataFiles[next]);
+      std::cerr.flush();
+      std::cout << "%%%mzn-job-end: " << instanceStatus << std::endl;
+      status = instanceStatus != 0 ? 1 : status;
+    }
+    return status;
+  }
+#ifdef _WIN32
+  std::cerr << "Warning: --data-batch-workers is not supported on this platform." << std::endl;
+  return runBatch(listFile, 1);
+#else
+  {
+    std::ostringstream oss;
+    std::streambuf* out = std::cout.rdbuf(oss.rdbuf());
+    std::streambuf* err = std::cerr.rdbuf(oss.rdbuf());
+    int instanceStatus = runInstance(dataFiles[0]);
+    std::cout.rdbuf(out);
+    std::cerr.rdbuf(err);
+    output(0, instanceStatus, oss.str());
+    next = 1;
+  }
+  std::cout.flush();
+  std::cerr.flush();
+
+  // Worker k solves instances 1+k, 1+k+workers, ... and sends each result to
+  // the parent as a block "<index> <status> <length>\n<output>"
+  workers = std::min(workers, static_cast<unsigned int>(dataFiles.size() - 1));
+  std::vector<int> fds;
+  std::vector<pid_t> pids;
+  for (unsigned int k = 0; k < workers; k++) {
+    int p[2];
+    if (::pipe(p) != 0) {
+      std::cerr << "Error: cannot create pipe: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    pid_t pid = ::fork();
+    if (pid == 0) {
+      ::close(p[0]);
+      for (int fd : fds) {
+        ::close(fd);
+      }
+      for (size_t i = 1 + k; i < dataFiles.size(); i += workers) {
+        std::ostringstream oss;
+        std::streambuf* out = std::cout.rdbuf(oss.rdbuf());
+        std::streambuf* err = std::cerr.rdbuf(oss.rdbuf());
+        int instanceStatus = runInstance(dataFiles[i]);
+        std::cout.rdbuf(out);
+        std::cerr.rdbuf(err);
+        std::string text = oss.str();
+        std::ostringstream header;
+        header << i << " " << instanceStatus << " " << text.size() << "\n";
+        if (!write_all(p[1], header.str().c_str(), header.str().size()) ||
+            !write_all(p[1], text.c_str(), text.size())) {
+          break;
+        }
+      }
+      ::close(p[1]);
+      ::_exit(0);
+    }
+    ::close(p[1]);
+    if (pid < 0) {
+      std::cerr << "Error: cannot start worker process: " << std::strerror(errno) << std::endl;
+      ::close(p[0]);
+      break;
+    }
+    fds.push_back(p[0]);
+    pids.push_back(pid);
+  }
+
+  // Print the results in the order of the list file
+  std::map<size_t, std::pair<int, std::string>> done;
+  std::vector<std::string> buffers(fds.size());
+  std::vector<pollfd> pfds(fds.size());
+  for (unsigned int k = 0; k < fds.size(); k++) {
+    pfds[k].fd = fds[k];
+    pfds[k].events = POLLIN;
+  }
+  size_t open = fds.size();
+  while (open > 0) {
+    if (::poll(pfds.data(), pfds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    for (unsigned int k = 0; k < pfds.size(); k++) {
+      if (pfds[k].fd < 0 || pfds[k].revents == 0) {
+        continue;
+      }
+      char buf[4096];
+      ssize_t n = ::read(pfds[k].fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        ::close(pfds[k].fd);
+        pfds[k].fd = -1;
+        open--;
+        continue;
+      }
+      buffers[k].append(buf, n);
+      for (;;) {
+        size_t nl = buffers[k].find('\n');
+        if (nl == std::string::npos) {
+          break;
+        }
+        std::istringstream header(buffers[k].substr(0, nl));
+        size_t i;
+        int instanceStatus;
+        size_t length;
+        header >> i >> instanceStatus >> length;
+        if (buffers[k].size() < nl + 1 + length) {
+          break;
+        }
+        done[i] = std::make_pair(instanceStatus, buffers[k].substr(nl + 1, length));
+        buffers[k].erase(0, nl + 1 + length);
+      }
+      for (auto it = done.find(next); it != done.end(); it = done.find(next)) {
+        output(next, it->second.first, it->second.second);
+        done.erase(it);
+        next++;
+      }
+    }
+  }
+  for (pid_t pid : pids) {
+    ::waitpid(pid, nullptr, 0);
+  }
+  // Instances whose worker failed
+  for (; next < dataFiles.size(); next++) {
+    auto it = done.find(next);
+    if (it != done.end()) {
+      output(next, it->second.first, it->second.second);
+    } else {
+      output(next, 1, "Error: worker process terminated unexpectedly.\n");
+    }
+  }
+  return status;
+#endif
+}
+
+}  // namespace MiniZinc
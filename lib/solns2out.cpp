@@ -329,7 +329,8 @@ void Solns2Out::checkSolution(std::ostream& oss) {
     for (auto& i : *getModel()) {
       if (auto* vdi = i->dynamicCast<VarDeclI>()) {
         if (vdi->e()->ann().contains(constants().ann.mzn_check_var)) {
-          checker << vdi->e()->id()->str() << " = ";
+          vdi->e()->id()->printStr(checker);
+          checker << " = ";
           Expression* e = eval_par(getEnv()->envi(), vdi->e()->e());
           auto* al = e->dynamicCast<ArrayLit>();
           std::vector<Id*> enumids;
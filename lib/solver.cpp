@@ -142,13 +142,15 @@ SolverInstanceBase* SolverFactory::createSI(Env& env, std::ostream& log,
   if (pSI == nullptr) {
     throw InternalError("SolverFactory: failed to initialize solver " + getDescription());
   }
+  std::lock_guard<std::mutex> guard(_sistorageMutex);
   _sistorage.resize(_sistorage.size() + 1);
   _sistorage.back().reset(pSI);
   return pSI;
 }
 
 /// also providing a destroy function for a DLL or just special allocator etc.
-void SolverFactory::destroySI(SolverInstanceBase* pSI) {
+bool SolverFactory::destroySI(SolverInstanceBase* pSI) {
+  std::lock_guard<std::mutex> guard(_sistorageMutex);
   auto it = _sistorage.begin();
   for (; it != _sistorage.end(); ++it) {
     if (it->get() == pSI) {
@@ -156,10 +158,10 @@ void SolverFactory::destroySI(SolverInstanceBase* pSI) {
     }
   }
   if (_sistorage.end() == it) {
-    cerr << "  SolverFactory: failed to remove solver at " << pSI << endl;
-    throw InternalError("  SolverFactory: failed to remove solver");
+    return false;
   }
   _sistorage.erase(it);
+  return true;
 }
 
 MznSolver::MznSolver(std::ostream& os0, std::ostream& log0)
@@ -170,13 +172,25 @@ MznSolver::MznSolver(std::ostream& os0, std::ostream& log0)
       _log(log0),
       s2out(os0, log0, _solverConfigs.mznlibDir()) {}
 
+MznSolver::MznSolver(const SolverConfigs& solverConfigs, std::ostream& os0, std::ostream& log0)
+    : _solverConfigs(solverConfigs),
+      _solverConfigsPopulated(true),
+      _flt(os0, log0, _solverConfigs.mznlibDir()),
+      _executableName("<executable>"),
+      _os(os0),
+      _log(log0),
+      s2out(os0, log0, _solverConfigs.mznlibDir()) {}
+
 MznSolver::~MznSolver() {
-  //   if (si)                         // first the solver
-  //     CleanupSolverInterface(si);
-  // TODO cleanup the used solver interfaces
+  // Destroy the solver instance (which owns the options), otherwise its factory keeps it
+  // alive for the whole process
+  if (_si != nullptr) {
+    (void)_sf->destroySI(_si);
+  } else {
+    delete _siOpt;
+  }
   _si = nullptr;
   _siOpt = nullptr;
-  GC::trigger();
 }
 
 bool MznSolver::ifMzn2Fzn() const { return _isMzn2fzn; }
@@ -247,7 +261,20 @@ void MznSolver::printHelp(const std::string& selectedSolver) {
       << "  --compiler-statistics\n    Print statistics for compilation." << std::endl
       << "  -c, --compile\n    Compile only (do not run solver)." << std::endl
       << "  --config-dirs\n    Output configuration directories." << std::endl
-      << "  --param-file <file>\n    Load parameters from the given JSON file." << std::endl;
+      << "  --param-file <file>\n    Load parameters from the given JSON file." << std::endl
+      << "  --server\n    Run jobs read from standard input, one JSON object per line, in a\n"
+         "    single process."
+      << std::endl
+      << "  --server-socket <path>\n    Run jobs read from connections to the Unix domain "
+         "socket <path>."
+      << std::endl
+      << "  --server-threads <n>\n    Run the jobs of --server or --server-socket in <n> "
+         "threads (default 1)."
+      << std::endl
+      << "  --data-batch <file>\n    Solve the model for each data file listed in <file>, in a\n"
+         "    single process."
+      << std::endl
+      << "  --data-batch-workers <n>\n    Use <n> worker processes for --data-batch." << std::endl;
 
   if (selectedSolver.empty()) {
     _flt.printHelp(_os);
@@ -458,7 +485,10 @@ MznSolver::OptionStatus MznSolver::processOptions(std::vector<std::string>& argv
   }
 
   // After this point all solver configurations must be available
-  _solverConfigs.populate(_log);
+  if (!_solverConfigsPopulated) {
+    _solverConfigs.populate(_log);
+    _solverConfigsPopulated = true;
+  }
 
   for (i = 1; i < argc; ++i) {
     if (argv[i] == "-h" || argv[i] == "--help") {
@@ -849,6 +879,9 @@ SolverInstance::Status MznSolver::solve() {
     GCLock lock;
     getSI()->processFlatZinc();
   }
+  // The model has been handed to the solver instance: collect garbage from
+  // compilation, which returns empty heap pages to the operating system
+  GC::trigger();
   SolverInstance::Status status = getSI()->solve();
   GCLock lock;
   if (!getSI()->getSolns2Out()->fStatusPrinted) {
@@ -16,8 +16,13 @@
 #include <minizinc/prettyprinter.hh>
 #include <minizinc/typecheck.hh>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
@@ -123,30 +128,14 @@ VarDecl* Scopes::findSimilar(Id* ident) {
 
 class VarDeclCmp {
 private:
-  std::unordered_map<VarDecl*, int>& _pos;
+  std::vector<int>& _pos;
 
 public:
-  VarDeclCmp(std::unordered_map<VarDecl*, int>& pos) : _pos(pos) {}
+  VarDeclCmp(std::vector<int>& pos) : _pos(pos) {}
   bool operator()(Expression* e0, Expression* e1) {
     if (auto* vd0 = Expression::dynamicCast<VarDecl>(e0)) {
       if (auto* vd1 = Expression::dynamicCast<VarDecl>(e1)) {
-        return _pos[vd0] < _pos[vd1];
-      }
-      return true;
-    }
-    return false;
-  }
-};
-class ItemCmp {
-private:
-  std::unordered_map<VarDecl*, int>& _pos;
-
-public:
-  ItemCmp(std::unordered_map<VarDecl*, int>& pos) : _pos(pos) {}
-  bool operator()(Item* i0, Item* i1) {
-    if (auto* vd0 = i0->cast<VarDeclI>()) {
-      if (auto* vd1 = i1->cast<VarDeclI>()) {
-        return _pos[vd0->e()] < _pos[vd1->e()];
+        return _pos[vd0->payload()] < _pos[vd1->payload()];
       }
       return true;
     }
@@ -1183,7 +1172,7 @@ VarDecl* TopoSorter::get(EnvI& env, const ASTString& id_v, const Location& loc)
   return decl;
 }
 
-VarDecl* TopoSorter::checkId(EnvI& env, Id* ident, const Location& loc) {
+VarDecl* TopoSorter::find(EnvI& env, Id* ident, const Location& loc) {
   VarDecl* decl = scopes.find(ident);
   if (decl == nullptr) {
     std::ostringstream ss;
@@ -1194,19 +1183,22 @@ VarDecl* TopoSorter::checkId(EnvI& env, Id* ident, const Location& loc) {
     }
     throw TypeError(env, loc, ss.str());
   }
-  auto pi = pos.find(decl);
-  if (pi == pos.end()) {
+  int id = denseId(decl);
+  if (id != -1 && pos[id] == -1) {
+    std::ostringstream ss;
+    ss << "circular definition of `" << ident->str() << "'";
+    throw TypeError(env, loc, ss.str());
+  }
+  return decl;
+}
+
+VarDecl* TopoSorter::checkId(EnvI& env, Id* ident, const Location& loc) {
+  VarDecl* decl = find(env, ident, loc);
+  if (denseId(decl) == -1) {
     // new id
     scopes.pushToplevel();
     run(env, decl);
     scopes.pop();
-  } else {
-    // previously seen, check if circular
-    if (pi->second == -1) {
-      std::ostringstream ss;
-      ss << "circular definition of `" << ident->str() << "'";
-      throw TypeError(env, loc, ss.str());
-    }
   }
   return decl;
 }
@@ -1221,6 +1213,83 @@ void TopoSorter::run(EnvI& env, Expression* e) {
   if (e == nullptr) {
     return;
   }
+  // Tasks are pushed in reverse order, so that they are processed in the
+  // same order as a depth-first recursive traversal
+  size_t base = _todo.size();
+  _todo.emplace_back(TK_VISIT, e);
+  while (_todo.size() > base) {
+    Task t = _todo.back();
+    _todo.pop_back();
+    switch (t.kind) {
+      case TK_VISIT:
+        visit(env, t.e);
+        break;
+      case TK_VISIT_ANN: {
+        size_t todoSize = _todo.size();
+        size_t scopesSize = scopes.size();
+        try {
+          run(env, t.e);
+        } catch (TypeError&) {
+          _todo.resize(todoSize, Task(TK_VISIT, nullptr));
+          while (scopes.size() > scopesSize) {
+            scopes.pop();
+          }
+          t.annotated->ann().remove(t.e);
+        }
+      } break;
+      case TK_OPERAND:
+        if (auto* bo = t.e->dynamicCast<BinOp>()) {
+          // Annotations of nested operators are visited before their operands
+          size_t first = _todo.size();
+          for (ExpressionSetIter it = bo->ann().begin(); it != bo->ann().end(); ++it) {
+            _todo.emplace_back(TK_VISIT, *it);
+          }
+          _todo.emplace_back(TK_OPERAND, bo->rhs());
+          _todo.emplace_back(TK_OPERAND, bo->lhs());
+          std::reverse(_todo.begin() + static_cast<std::ptrdiff_t>(first), _todo.end());
+        } else {
+          visit(env, t.e);
+        }
+        break;
+      case TK_PUSH:
+        scopes.push();
+        break;
+      case TK_PUSH_TOPLEVEL:
+        scopes.pushToplevel();
+        break;
+      case TK_POP:
+        scopes.pop();
+        break;
+      case TK_ADD:
+        scopes.add(env, t.e->cast<VarDecl>());
+        break;
+      case TK_DECL_DONE: {
+        auto* vd = t.e->cast<VarDecl>();
+        pos[vd->payload()] = static_cast<int>(decls.size());
+        decls.push_back(vd);
+      } break;
+      case TK_LET_DONE: {
+        Let* let = t.e->cast<Let>();
+        VarDeclCmp poscmp(pos);
+        std::stable_sort(let->let().begin(), let->let().end(), poscmp);
+        for (unsigned int i = 0, j = 0; i < let->let().size(); i++) {
+          if (auto* vd = let->let()[i]->dynamicCast<VarDecl>()) {
+            let->letOrig()[j++] = vd->e();
+            for (unsigned int k = 0; k < vd->ti()->ranges().size(); k++) {
+              let->letOrig()[j++] = vd->ti()->ranges()[k]->domain();
+            }
+          }
+        }
+      } break;
+    }
+  }
+}
+
+void TopoSorter::visit(EnvI& env, Expression* e) {
+  if (e == nullptr) {
+    return;
+  }
+  size_t first = _todo.size();
   switch (e->eid()) {
     case Expression::E_INTLIT:
     case Expression::E_FLOATLIT:
@@ -1232,146 +1301,116 @@ void TopoSorter::run(EnvI& env, Expression* e) {
       auto* sl = e->cast<SetLit>();
       if (sl->isv() == nullptr && sl->fsv() == nullptr) {
         for (unsigned int i = 0; i < sl->v().size(); i++) {
-          run(env, sl->v()[i]);
+          _todo.emplace_back(TK_VISIT, sl->v()[i]);
         }
       }
     } break;
     case Expression::E_ID: {
       if (e != constants().absent) {
-        VarDecl* vd = checkId(env, e->cast<Id>(), e->loc());
+        VarDecl* vd = find(env, e->cast<Id>(), e->loc());
+        if (denseId(vd) == -1) {
+          // new id
+          _todo.emplace_back(TK_PUSH_TOPLEVEL, nullptr);
+          _todo.emplace_back(TK_VISIT, vd);
+          _todo.emplace_back(TK_POP, nullptr);
+        }
         e->cast<Id>()->decl(vd);
       }
     } break;
     case Expression::E_ARRAYLIT: {
       auto* al = e->cast<ArrayLit>();
       for (unsigned int i = 0; i < al->size(); i++) {
-        run(env, (*al)[i]);
+        _todo.emplace_back(TK_VISIT, (*al)[i]);
       }
     } break;
     case Expression::E_ARRAYACCESS: {
       auto* ae = e->cast<ArrayAccess>();
-      run(env, ae->v());
+      _todo.emplace_back(TK_VISIT, ae->v());
       for (unsigned int i = 0; i < ae->idx().size(); i++) {
-        run(env, ae->idx()[i]);
+        _todo.emplace_back(TK_VISIT, ae->idx()[i]);
       }
     } break;
     case Expression::E_COMP: {
       auto* ce = e->cast<Comprehension>();
-      scopes.push();
+      _todo.emplace_back(TK_PUSH, nullptr);
       for (int i = 0; i < ce->numberOfGenerators(); i++) {
-        run(env, ce->in(i));
+        _todo.emplace_back(TK_VISIT, ce->in(i));
         for (int j = 0; j < ce->numberOfDecls(i); j++) {
-          run(env, ce->decl(i, j));
-          scopes.add(env, ce->decl(i, j));
-        }
-        if (ce->where(i) != nullptr) {
-          run(env, ce->where(i));
+          _todo.emplace_back(TK_VISIT, ce->decl(i, j));
+          _todo.emplace_back(TK_ADD, ce->decl(i, j));
         }
+        _todo.emplace_back(TK_VISIT, ce->where(i));
       }
-      run(env, ce->e());
-      scopes.pop();
+      _todo.emplace_back(TK_VISIT, ce->e());
+      _todo.emplace_back(TK_POP, nullptr);
     } break;
     case Expression::E_ITE: {
       ITE* ite = e->cast<ITE>();
       for (int i = 0; i < ite->size(); i++) {
-        run(env, ite->ifExpr(i));
-        run(env, ite->thenExpr(i));
+        _todo.emplace_back(TK_VISIT, ite->ifExpr(i));
+        _todo.emplace_back(TK_VISIT, ite->thenExpr(i));
       }
-      run(env, ite->elseExpr());
+      _todo.emplace_back(TK_VISIT, ite->elseExpr());
     } break;
     case Expression::E_BINOP: {
       auto* be = e->cast<BinOp>();
-      std::vector<Expression*> todo;
-      todo.push_back(be->lhs());
-      todo.push_back(be->rhs());
-      while (!todo.empty()) {
-        Expression* be = todo.back();
-        todo.pop_back();
-        if (auto* e_bo = be->dynamicCast<BinOp>()) {
-          todo.push_back(e_bo->lhs());
-          todo.push_back(e_bo->rhs());
-          for (ExpressionSetIter it = e_bo->ann().begin(); it != e_bo->ann().end(); ++it) {
-            run(env, *it);
-          }
-        } else {
-          run(env, be);
-        }
-      }
+      _todo.emplace_back(TK_OPERAND, be->rhs());
+      _todo.emplace_back(TK_OPERAND, be->lhs());
     } break;
     case Expression::E_UNOP: {
       UnOp* ue = e->cast<UnOp>();
-      run(env, ue->e());
+      _todo.emplace_back(TK_VISIT, ue->e());
     } break;
     case Expression::E_CALL: {
       Call* ce = e->cast<Call>();
       for (unsigned int i = 0; i < ce->argCount(); i++) {
-        run(env, ce->arg(i));
+        _todo.emplace_back(TK_VISIT, ce->arg(i));
       }
     } break;
     case Expression::E_VARDECL: {
       auto* ve = e->cast<VarDecl>();
-      auto pi = pos.find(ve);
-      if (pi == pos.end()) {
-        pos.insert(std::pair<VarDecl*, int>(ve, -1));
-        run(env, ve->ti());
-        run(env, ve->e());
-        ve->payload(static_cast<int>(decls.size()));
-        decls.push_back(ve);
-        pi = pos.find(ve);
-        pi->second = static_cast<int>(decls.size()) - 1;
+      if (denseId(ve) == -1) {
+        ve->payload(static_cast<int>(ids.size()));
+        ids.push_back(ve);
+        pos.push_back(-1);
+        _todo.emplace_back(TK_VISIT, ve->ti());
+        _todo.emplace_back(TK_VISIT, ve->e());
+        _todo.emplace_back(TK_DECL_DONE, ve);
       } else {
-        assert(pi->second != -1);
+        assert(pos[denseId(ve)] != -1);
       }
     } break;
     case Expression::E_TI: {
       auto* ti = e->cast<TypeInst>();
       for (unsigned int i = 0; i < ti->ranges().size(); i++) {
-        run(env, ti->ranges()[i]);
+        _todo.emplace_back(TK_VISIT, ti->ranges()[i]);
       }
-      run(env, ti->domain());
+      _todo.emplace_back(TK_VISIT, ti->domain());
     } break;
     case Expression::E_TIID:
       break;
     case Expression::E_LET: {
       Let* let = e->cast<Let>();
-      scopes.push();
+      _todo.emplace_back(TK_PUSH, nullptr);
       for (unsigned int i = 0; i < let->let().size(); i++) {
-        run(env, let->let()[i]);
+        _todo.emplace_back(TK_VISIT, let->let()[i]);
         if (auto* vd = let->let()[i]->dynamicCast<VarDecl>()) {
-          scopes.add(env, vd);
+          _todo.emplace_back(TK_ADD, vd);
         }
       }
-      run(env, let->in());
-      VarDeclCmp poscmp(pos);
-      std::stable_sort(let->let().begin(), let->let().end(), poscmp);
-      for (unsigned int i = 0, j = 0; i < let->let().size(); i++) {
-        if (auto* vd = let->let()[i]->dynamicCast<VarDecl>()) {
-          let->letOrig()[j++] = vd->e();
-          for (unsigned int k = 0; k < vd->ti()->ranges().size(); k++) {
-            let->letOrig()[j++] = vd->ti()->ranges()[k]->domain();
-          }
-        }
-      }
-      scopes.pop();
+      _todo.emplace_back(TK_VISIT, let->in());
+      _todo.emplace_back(TK_LET_DONE, let);
+      _todo.emplace_back(TK_POP, nullptr);
     } break;
   }
-  if (env.ignoreUnknownIds) {
-    std::vector<Expression*> toDelete;
-    for (ExpressionSetIter it = e->ann().begin(); it != e->ann().end(); ++it) {
-      try {
-        run(env, *it);
-      } catch (TypeError&) {
-        toDelete.push_back(*it);
-      }
-      for (Expression* de : toDelete) {
-        e->ann().remove(de);
-      }
-    }
-  } else {
-    for (ExpressionSetIter it = e->ann().begin(); it != e->ann().end(); ++it) {
-      run(env, *it);
+  for (ExpressionSetIter it = e->ann().begin(); it != e->ann().end(); ++it) {
+    if (env.ignoreUnknownIds) {
+      _todo.emplace_back(TK_VISIT_ANN, *it, e);
+    } else {
+      _todo.emplace_back(TK_VISIT, *it);
     }
   }
+  std::reverse(_todo.begin() + static_cast<std::ptrdiff_t>(first), _todo.end());
 }
 
 KeepAlive add_coercion(EnvI& env, Model* m, Expression* e, const Type& funarg_t) {
@@ -1509,10 +1548,46 @@ private:
   Model* _model;
   std::vector<TypeError>& _typeErrors;
   bool _ignoreUndefined;
+  /// Whether calls to functions that only forward to another function are replaced
+  bool _expandMacros;
+  /// Whether the bodies of the functions in EnvI::checkedFunctions count as checked (which
+  /// they would only be once the items before them have been checked)
+  bool _checkedBodies;
+  /// Positions in item order of the functions whose bodies were checked concurrently
+  const std::unordered_map<const FunctionI*, size_t>* _fnOrder;
+  /// Number of concurrently checked functions that have been reached in item order
+  size_t _fnReached;
+
+  /// Whether the body of \a fi counts as checked at this point of a check in item order
+  bool bodyChecked(const FunctionI* fi) const {
+    if (_env.checkedFunctions.count(fi) != 0) {
+      return _checkedBodies;
+    }
+    if (_fnOrder != nullptr) {
+      auto it = _fnOrder->find(fi);
+      return it == _fnOrder->end() || it->second < _fnReached;
+    }
+    return true;
+  }
 
 public:
-  Typer(EnvI& env, Model* model, std::vector<TypeError>& typeErrors, bool ignoreUndefined)
-      : _env(env), _model(model), _typeErrors(typeErrors), _ignoreUndefined(ignoreUndefined) {}
+  Typer(EnvI& env, Model* model, std::vector<TypeError>& typeErrors, bool ignoreUndefined,
+        bool expandMacros = true)
+      : _env(env),
+        _model(model),
+        _typeErrors(typeErrors),
+        _ignoreUndefined(ignoreUndefined),
+        _expandMacros(expandMacros),
+        _checkedBodies(false),
+        _fnOrder(nullptr),
+        _fnReached(0) {}
+  void checkedBodies(bool b) { _checkedBodies = b; }
+  /// Set the positions of the functions checked concurrently, and how many have been reached
+  void functionOrder(const std::unordered_map<const FunctionI*, size_t>* order, size_t reached) {
+    _fnOrder = order;
+    _fnReached = reached;
+  }
+  void functionsReached(size_t n) { _fnReached = n; }
   /// Check annotations when expression is finished
   void exit(Expression* e) {
     for (ExpressionSetIter it = e->ann().begin(); it != e->ann().end(); ++it) {
@@ -1531,6 +1606,8 @@ public:
   void vBoolLit(const BoolLit& /*b*/) {}
   /// Visit set literal
   void vSetLit(SetLit& sl) {
+    // Set literals can be shared between concurrently checked bodies
+    GCConcurrentLock lock;
     Type ty;
     ty.st(Type::ST_SET);
     if (sl.isv() != nullptr) {
@@ -1597,7 +1674,11 @@ public:
   void vId(Id& id) {
     if (&id != constants().absent) {
       assert(!id.decl()->type().isunknown());
-      id.type(id.decl()->type());
+      // Identifiers can be shared between concurrently checked bodies
+      GCConcurrentLock lock;
+      if (id.type() != id.decl()->type()) {
+        id.type(id.decl()->type());
+      }
     }
   }
   /// Visit anonymous variable
@@ -2305,6 +2386,58 @@ public:
     }
   }
 
+  /// Return the function called by \a call (with arguments \a args) to \a fi, after
+  /// replacing the call by the call that the body of \a fi forwards to (if it only forwards)
+  FunctionI* expandMacro(Call& call, const std::vector<Expression*>& args, FunctionI* fi) {
+    if (!_expandMacros || fi->e() == nullptr || !fi->e()->isa<Call>() || !bodyChecked(fi)) {
+      return fi;
+    }
+    Call* next_call = fi->e()->cast<Call>();
+    if ((next_call->decl() != nullptr) && next_call->argCount() == fi->params().size() &&
+        _model->sameOverloading(_env, args, fi, next_call->decl())) {
+      bool macro = true;
+      for (unsigned int i = 0; i < fi->params().size(); i++) {
+        if (!Expression::equal(next_call->arg(i), fi->params()[i]->id())) {
+          macro = false;
+          break;
+        }
+      }
+      if (macro) {
+        // Call is not a macro if it has a reification implementation
+        GCLock lock;
+        ASTString reif_id = _env.reifyId(fi->id());
+        std::vector<Type> tt(fi->params().size() + 1);
+        for (unsigned int i = 0; i < fi->params().size(); i++) {
+          tt[i] = fi->params()[i]->type();
+        }
+        tt[fi->params().size()] = Type::varbool();
+
+        macro = _model->matchFn(_env, reif_id, tt, true) == nullptr;
+      }
+      if (macro) {
+        call.decl(next_call->decl());
+        for (ExpressionSetIter esi = next_call->ann().begin(); esi != next_call->ann().end();
+             ++esi) {
+          call.addAnnotation(*esi);
+        }
+        call.rehash();
+        fi = next_call->decl();
+      }
+    }
+    return fi;
+  }
+  /// Replace \a call by the call that the body of its (already checked) callee forwards to
+  void expandMacro(Call& call) {
+    if (call.decl() == nullptr) {
+      return;
+    }
+    std::vector<Expression*> args(call.argCount());
+    for (unsigned int i = 0; i < args.size(); i++) {
+      args[i] = call.arg(i);
+    }
+    expandMacro(call, args, call.decl());
+  }
+
   /// Visit call
   void vCall(Call& call) {
     std::vector<Expression*> args(call.argCount());
@@ -2325,40 +2458,7 @@ public:
       fi = _model->matchFn(_env, &call, true, true);
     }
 
-    if ((fi->e() != nullptr) && fi->e()->isa<Call>()) {
-      Call* next_call = fi->e()->cast<Call>();
-      if ((next_call->decl() != nullptr) && next_call->argCount() == fi->params().size() &&
-          _model->sameOverloading(_env, args, fi, next_call->decl())) {
-        bool macro = true;
-        for (unsigned int i = 0; i < fi->params().size(); i++) {
-          if (!Expression::equal(next_call->arg(i), fi->params()[i]->id())) {
-            macro = false;
-            break;
-          }
-        }
-        if (macro) {
-          // Call is not a macro if it has a reification implementation
-          GCLock lock;
-          ASTString reif_id = _env.reifyId(fi->id());
-          std::vector<Type> tt(fi->params().size() + 1);
-          for (unsigned int i = 0; i < fi->params().size(); i++) {
-            tt[i] = fi->params()[i]->type();
-          }
-          tt[fi->params().size()] = Type::varbool();
-
-          macro = _model->matchFn(_env, reif_id, tt, true) == nullptr;
-        }
-        if (macro) {
-          call.decl(next_call->decl());
-          for (ExpressionSetIter esi = next_call->ann().begin(); esi != next_call->ann().end();
-               ++esi) {
-            call.addAnnotation(*esi);
-          }
-          call.rehash();
-          fi = next_call->decl();
-        }
-      }
-    }
+    fi = expandMacro(call, args, fi);
 
     bool cv = false;
     for (unsigned int i = 0; i < args.size(); i++) {
@@ -2636,8 +2736,130 @@ public:
   void vTIId(TIId& id) {}
 };
 
+namespace {
+
+/// Type check the annotations and return type-inst of function \a fi
+void typecheck_fn_signature(EnvI& env, BottomUpIterator<Typer<true>>& bottomUpTyper,
+                            FunctionI* fi) {
+  for (ExpressionSetIter it = fi->ann().begin(); it != fi->ann().end(); ++it) {
+    bottomUpTyper.run(*it);
+    if (!(*it)->type().isAnn()) {
+      throw TypeError(env, (*it)->loc(),
+                      "expected annotation, got `" + (*it)->type().toString(env) + "'");
+    }
+  }
+  bottomUpTyper.run(fi->ti());
+}
+
+/// Check the type of the (already type checked) body of \a fi against its return type
+void typecheck_fn_return(EnvI& env, Model* m, FunctionI* fi) {
+  if ((fi->e() != nullptr) && !env.isSubtype(fi->e()->type(), fi->ti()->type(), true)) {
+    throw TypeError(env, fi->e()->loc(),
+                    "return type of function does not match body, declared type is `" +
+                        fi->ti()->type().toString(env) + "', body type is `" +
+                        fi->e()->type().toString(env) + "'");
+  }
+  if ((fi->e() != nullptr) && fi->e()->type().isPar() && fi->ti()->type().isvar()) {
+    // this is a par function declared as var, so change declared return type
+    Type fi_t = fi->ti()->type();
+    fi_t.ti(Type::TI_PAR);
+    fi->ti()->type(fi_t);
+  }
+  if (fi->e() != nullptr) {
+    fi->e(add_coercion(env, m, fi->e(), fi->ti()->type())());
+  }
+}
+
+/**
+ * \brief Replace the calls in the signature and body of \a fi that forward to other functions
+ *
+ * Bodies that are checked concurrently do not replace calls by the calls they forward to,
+ * as that depends on which callees have been checked already. This pass does so afterwards
+ * for each function in item order, which gives the same result as a sequential check.
+ */
+void expand_fn_macros(Typer<true>& ty, FunctionI* fi) {
+  class ExpandMacros : public EVisitor {
+  public:
+    Typer<true>& ty;
+    ExpandMacros(Typer<true>& ty0) : ty(ty0) {}
+    void vCall(Call& call) { ty.expandMacro(call); }
+  } _em(ty);
+  BottomUpIterator<ExpandMacros> bottomUp(_em);
+  for (ExpressionSetIter it = fi->ann().begin(); it != fi->ann().end(); ++it) {
+    bottomUp.run(*it);
+  }
+  bottomUp.run(fi->ti());
+  bottomUp.run(fi->e());
+}
+
+/// Result of checking a function concurrently with other functions
+struct FunctionCheck {
+  FunctionI* fi;
+  /// Errors reported for the function
+  std::vector<TypeError> errors;
+  /// Exception that stopped checking the function
+  std::exception_ptr exception;
+  FunctionCheck(FunctionI* fi0) : fi(fi0) {}
+};
+
+/**
+ * \brief Type check signatures and bodies of functions \a fns
+ *
+ * The signatures are checked in order, the bodies using \a nThreads threads.
+ * Return types are not changed, so the result of checking a body does not
+ * depend on the order in which bodies are checked (see typecheck_fn_return).
+ */
+void typecheck_fns_concurrently(EnvI& env, Model* m, std::vector<FunctionCheck>& fns,
+                                bool ignoreUndefined, unsigned int nThreads) {
+  for (auto& fc : fns) {
+    Typer<true> ty(env, m, fc.errors, ignoreUndefined);
+    BottomUpIterator<Typer<true>> bottomUpTyper(ty);
+    try {
+      typecheck_fn_signature(env, bottomUpTyper, fc.fi);
+    } catch (...) {
+      fc.exception = std::current_exception();
+    }
+  }
+  GCConcurrentSection section;
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    GCConcurrentSection::Worker worker(section);
+    for (size_t i = next++; i < fns.size(); i = next++) {
+      FunctionCheck& fc = fns[i];
+      if (fc.exception || fc.fi->e() == nullptr) {
+        continue;
+      }
+      // Whether a callee's body has been checked yet depends on the schedule, so calls are
+      // replaced by the calls they forward to afterwards (see expand_fn_macros)
+      Typer<true> ty(env, m, fc.errors, ignoreUndefined, false);
+      BottomUpIterator<Typer<true>> bottomUpTyper(ty);
+      try {
+        bottomUpTyper.run(fc.fi->e());
+      } catch (...) {
+        fc.exception = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < nThreads && i < fns.size(); i++) {
+    try {
+      threads.emplace_back(work);
+    } catch (std::system_error&) {
+      // Continue with the threads that could be started
+      break;
+    }
+  }
+  work();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+}  // namespace
+
 void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
-               bool ignoreUndefinedParameters, bool allowMultiAssignment, bool isFlatZinc) {
+               bool ignoreUndefinedParameters, bool allowMultiAssignment, bool isFlatZinc,
+               bool makePar) {
   Model* m;
   if (!isFlatZinc && origModel == env.model()) {
     // Combine all items into single model
@@ -2823,6 +3045,9 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
     }
     void vOutputI(OutputI* i) { ts.run(env, i->e()); }
     void vFunctionI(FunctionI* fi) {
+      if (env.checkedFunctions.count(fi) != 0) {
+        return;
+      }
       ts.run(env, fi->ti());
       for (unsigned int i = 0; i < fi->params().size(); i++) {
         ts.run(env, fi->params()[i]);
@@ -2843,20 +3068,22 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
   m->sortFn();
 
   {
-    struct SortByPayload {
+    struct SortByPosition {
+      TopoSorter& ts;
+      SortByPosition(TopoSorter& ts0) : ts(ts0) {}
       bool operator()(Item* i0, Item* i1) {
         if (i0->isa<IncludeI>()) {
           return !i1->isa<IncludeI>();
         }
         if (auto* vdi0 = i0->dynamicCast<VarDeclI>()) {
           if (auto* vdi1 = i1->dynamicCast<VarDeclI>()) {
-            return vdi0->e()->payload() < vdi1->e()->payload();
+            return ts.pos[vdi0->e()->payload()] < ts.pos[vdi1->e()->payload()];
           }
           return !i1->isa<IncludeI>();
         }
         return false;
       }
-    } _sbp;
+    } _sbp(ts);
 
     std::stable_sort(m->begin(), m->end(), _sbp);
   }
@@ -2870,6 +3097,9 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
       ty.vVarDecl(*decl);
     }
     for (auto& functionItem : functionItems) {
+      if (env.envi().checkedFunctions.count(functionItem) != 0) {
+        continue;
+      }
       bottomUpTyper.run(functionItem->ti());
       for (unsigned int j = 0; j < functionItem->params().size(); j++) {
         bottomUpTyper.run(functionItem->params()[j]);
@@ -2879,21 +3109,61 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
 
   m->fixFnMap();
 
+  // Function bodies can be checked concurrently once the types of all declarations are known
+  bool concurrent = env.envi().typecheckThreads > 1;
+  for (auto& decl : ts.decls) {
+    concurrent = concurrent && !decl->type().isunknown();
+  }
+  std::vector<FunctionCheck> fns;
+  std::unordered_map<const FunctionI*, size_t> fnOrder;
+  if (concurrent) {
+    class CollectFns : public ItemVisitor {
+    public:
+      EnvI& env;
+      std::vector<FunctionCheck>& fns;
+      CollectFns(EnvI& env0, std::vector<FunctionCheck>& fns0) : env(env0), fns(fns0) {}
+      void vFunctionI(FunctionI* fi) {
+        if (env.checkedFunctions.count(fi) == 0) {
+          fns.emplace_back(fi);
+        }
+      }
+    } _cf(env.envi(), fns);
+    iter_items(_cf, m);
+    typecheck_fns_concurrently(env.envi(), m, fns, ignoreUndefinedParameters,
+                               env.envi().typecheckThreads);
+    for (size_t i = 0; i < fns.size(); i++) {
+      fnOrder.emplace(fns[i].fi, i);
+    }
+  }
+
   {
     Typer<true> ty(env.envi(), m, typeErrors, ignoreUndefinedParameters);
+    if (concurrent) {
+      // Only the bodies of the functions before an item count as checked
+      ty.functionOrder(&fnOrder, 0);
+    }
     BottomUpIterator<Typer<true>> bottomUpTyper(ty);
 
     class TSV2 : public ItemVisitor {
     private:
       EnvI& _env;
       Model* _m;
+      Typer<true>& _ty;
       BottomUpIterator<Typer<true>>& _bottomUpTyper;
       std::vector<TypeError>& _typeErrors;
+      std::vector<FunctionCheck>* _fns;
+      size_t _fnIdx;
 
     public:
-      TSV2(EnvI& env0, Model* m0, BottomUpIterator<Typer<true>>& b,
-           std::vector<TypeError>& typeErrors)
-          : _env(env0), _m(m0), _bottomUpTyper(b), _typeErrors(typeErrors) {}
+      TSV2(EnvI& env0, Model* m0, Typer<true>& ty, BottomUpIterator<Typer<true>>& b,
+           std::vector<TypeError>& typeErrors, std::vector<FunctionCheck>* fns)
+          : _env(env0),
+            _m(m0),
+            _ty(ty),
+            _bottomUpTyper(b),
+            _typeErrors(typeErrors),
+            _fns(fns),
+            _fnIdx(0) {}
       void vVarDeclI(VarDeclI* i) {
         _bottomUpTyper.run(i->e());
         if (i->e()->ti()->hasTiVariable()) {
@@ -2995,32 +3265,28 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
         }
       }
       void vFunctionI(FunctionI* i) {
-        for (ExpressionSetIter it = i->ann().begin(); it != i->ann().end(); ++it) {
-          _bottomUpTyper.run(*it);
-          if (!(*it)->type().isAnn()) {
-            throw TypeError(_env, (*it)->loc(),
-                            "expected annotation, got `" + (*it)->type().toString(_env) + "'");
+        if (_env.checkedFunctions.count(i) != 0) {
+          // The items after the already checked functions can rely on their bodies
+          _ty.checkedBodies(true);
+          return;
+        }
+        if (_fns != nullptr) {
+          // Function was checked concurrently, report its errors in item order
+          FunctionCheck& fc = (*_fns)[_fnIdx];
+          assert(fc.fi == i);
+          _typeErrors.insert(_typeErrors.end(), fc.errors.begin(), fc.errors.end());
+          if (fc.exception) {
+            std::rethrow_exception(fc.exception);
           }
+          expand_fn_macros(_ty, i);
+          _ty.functionsReached(++_fnIdx);
+        } else {
+          typecheck_fn_signature(_env, _bottomUpTyper, i);
+          _bottomUpTyper.run(i->e());
         }
-        _bottomUpTyper.run(i->ti());
-        _bottomUpTyper.run(i->e());
-        if ((i->e() != nullptr) && !_env.isSubtype(i->e()->type(), i->ti()->type(), true)) {
-          throw TypeError(_env, i->e()->loc(),
-                          "return type of function does not match body, declared type is `" +
-                              i->ti()->type().toString(_env) + "', body type is `" +
-                              i->e()->type().toString(_env) + "'");
-        }
-        if ((i->e() != nullptr) && i->e()->type().isPar() && i->ti()->type().isvar()) {
-          // this is a par function declared as var, so change declared return type
-          Type i_t = i->ti()->type();
-          i_t.ti(Type::TI_PAR);
-          i->ti()->type(i_t);
-        }
-        if (i->e() != nullptr) {
-          i->e(add_coercion(_env, _m, i->e(), i->ti()->type())());
-        }
+        typecheck_fn_return(_env, _m, i);
       }
-    } _tsv2(env.envi(), m, bottomUpTyper, typeErrors);
+    } _tsv2(env.envi(), m, ty, bottomUpTyper, typeErrors, concurrent ? &fns : nullptr);
     iter_items(_tsv2, m);
   }
 
@@ -3052,7 +3318,7 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
   // that has a body that can be made par
   std::unordered_map<FunctionI*, std::pair<bool, std::vector<FunctionI*>>> fnsToMakePar;
   for (auto& f : m->functions()) {
-    if (f.id() == "mzn_reverse_map_var") {
+    if (!makePar || f.id() == "mzn_reverse_map_var") {
       continue;
     }
     if (f.e() != nullptr && f.ti()->type().bt() != Type::BT_ANN) {
@@ -3225,6 +3491,10 @@ void typecheck(Env& env, Model* origModel, std::vector<TypeError>& typeErrors,
         if (didRegister) {
           m->addItem(cp);
           parFunctions.push_back(cp);
+          if (env.envi().checkedFunctions.count(p.first) != 0) {
+            // Par versions of library functions belong to the library
+            env.envi().checkedFunctions.insert(cp);
+          }
         }
       }
     }
@@ -3366,6 +3636,116 @@ void typecheck(Env& env, Model* m, AssignI* ai) {
   }
 }
 
+bool typecheck_data(Env& env, Model* m, Model* data) {
+  ASTStringMap<VarDecl*> decls;
+  for (auto* i : *m) {
+    if (auto* vdi = i->dynamicCast<VarDeclI>()) {
+      if (!vdi->removed()) {
+        decls.insert(std::make_pair(vdi->e()->id()->str(), vdi->e()));
+      }
+    }
+  }
+  auto isUndefined = [](VarDecl* vd) {
+    return vd->e() == nullptr || vd->ann().contains(constants().ann.mzn_was_undefined);
+  };
+
+  // Check that all assignments are simple enough to be bound without a full type check:
+  // no scopes (comprehensions or lets), and identifiers only referring to
+  // declarations that are defined by the model itself
+  class CheckData : public EVisitor {
+  public:
+    ASTStringMap<VarDecl*>& decls;
+    bool ok = true;
+    CheckData(ASTStringMap<VarDecl*>& decls0) : decls(decls0) {}
+    bool enter(Expression* e) {
+      switch (e->eid()) {
+        case Expression::E_COMP:
+        case Expression::E_LET:
+        case Expression::E_ANON:
+        case Expression::E_VARDECL:
+        case Expression::E_TI:
+        case Expression::E_TIID:
+          ok = false;
+          break;
+        case Expression::E_ID: {
+          if (e != constants().absent) {
+            auto it = decls.find(e->cast<Id>()->v());
+            if (it == decls.end() || it->second->e() == nullptr ||
+                it->second->ann().contains(constants().ann.mzn_was_undefined)) {
+              ok = false;
+            }
+          }
+        } break;
+        default:
+          break;
+      }
+      return ok;
+    }
+  } _cd(decls);
+  std::vector<std::pair<AssignI*, VarDecl*>> assignments;
+  ASTStringSet assigned;
+  for (auto* i : *data) {
+    auto* ai = i->dynamicCast<AssignI>();
+    if (ai == nullptr) {
+      return false;
+    }
+    auto it = decls.find(ai->id());
+    if (it == decls.end() || !isUndefined(it->second) || !assigned.insert(ai->id()).second) {
+      return false;
+    }
+    top_down(_cd, ai->e());
+    if (!_cd.ok) {
+      return false;
+    }
+    assignments.emplace_back(ai, it->second);
+  }
+
+  GCLock lock;
+  std::vector<TypeError> typeErrors;
+  Typer<true> ty(env.envi(), m, typeErrors, false);
+  BottomUpIterator<Typer<true>> bottomUpTyper(ty);
+  class ResolveIds : public EVisitor {
+  public:
+    ASTStringMap<VarDecl*>& decls;
+    ResolveIds(ASTStringMap<VarDecl*>& decls0) : decls(decls0) {}
+    void vId(Id& ident) {
+      if (&ident != constants().absent) {
+        ident.decl(decls.find(ident.v())->second);
+      }
+    }
+  } _ri(decls);
+  try {
+    for (auto& a : assignments) {
+      top_down(_ri, a.first->e());
+      bottomUpTyper.run(a.first->e());
+      if (!typeErrors.empty()) {
+        return false;
+      }
+      VarDecl* vd = a.second;
+      if (vd->e() != nullptr) {
+        // Optional parameter that was set to <> because it was undefined
+        vd->ann().remove(constants().ann.mzn_was_undefined);
+      }
+      vd->e(a.first->e());
+      vd->ann().add(constants().ann.rhs_from_assignment);
+      ty.vVarDecl(*vd);
+      if (!typeErrors.empty()) {
+        return false;
+      }
+    }
+  } catch (TypeError&) {
+    return false;
+  }
+
+  for (auto& it : decls) {
+    VarDecl* vd = it.second;
+    if (vd->type().isPar() && !vd->type().isAnn() && vd->e() == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void output_var_desc_json(Env& env, VarDecl* vd, std::ostream& os, bool extra = false) {
   os << "    \"" << *vd->id() << "\" : {";
   os << "\"type\" : ";
@@ -3479,6 +3859,65 @@ void output_model_variable_types(Env& env, Model* m, std::ostream& os,
   os << "}}\n";
 }
 
+bool check_library_overloading(Env& env, Model* m) {
+  EnvI& envi = env.envi();
+  // Identifiers that are overloaded both by the already checked library and by the model
+  ASTStringSet checkedIds;
+  ASTStringSet mixedIds;
+  for (auto& fi : m->functions()) {
+    if (envi.checkedFunctions.count(&fi) != 0) {
+      checkedIds.insert(fi.id());
+    }
+  }
+  for (auto& fi : m->functions()) {
+    if (envi.checkedFunctions.count(&fi) == 0 && checkedIds.count(fi.id()) != 0) {
+      mixedIds.insert(fi.id());
+    }
+  }
+  if (mixedIds.empty()) {
+    return true;
+  }
+
+  // Calls in library functions must still resolve to the same declarations
+  class CheckCalls : public EVisitor {
+  public:
+    EnvI& env;
+    Model* m;
+    const ASTStringSet& ids;
+    bool ok = true;
+    CheckCalls(EnvI& env0, Model* m0, const ASTStringSet& ids0) : env(env0), m(m0), ids(ids0) {}
+    bool enter(Expression* /*e*/) const { return ok; }
+    void check(const FunctionI* decl, const ASTString& id, const std::vector<Expression*>& args) {
+      if (decl != nullptr && ids.count(id) != 0) {
+        ok = m->matchFn(env, id, args, true) == decl;
+      }
+    }
+    void vCall(Call& c) {
+      std::vector<Expression*> args(c.argCount());
+      for (unsigned int i = 0; i < c.argCount(); i++) {
+        args[i] = c.arg(i);
+      }
+      check(c.decl(), c.id(), args);
+    }
+    void vBinOp(BinOp& bo) { check(bo.decl(), bo.opToString(), {bo.lhs(), bo.rhs()}); }
+    void vUnOp(UnOp& uo) { check(uo.decl(), uo.opToString(), {uo.e()}); }
+  } _cc(envi, m, mixedIds);
+  for (auto& fi : m->functions()) {
+    if (envi.checkedFunctions.count(&fi) == 0) {
+      continue;
+    }
+    top_down(_cc, fi.ti());
+    for (auto* p : fi.params()) {
+      top_down(_cc, p);
+    }
+    top_down(_cc, fi.e());
+    if (!_cc.ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void output_model_interface(Env& env, Model* m, std::ostream& os,
                             const std::vector<std::string>& skipDirs) {
   class IfcVisitor : public ItemVisitor {
@@ -18,6 +18,7 @@
  * Need to get more flexible for multi-pass & multi-solving stuff  TODO
  */
 
+#include <minizinc/server.hh>
 #include <minizinc/solver.hh>
 
 #include <chrono>
@@ -41,21 +42,42 @@ int main(int argc, const char** argv) {
   Timer starttime;
   bool fSuccess = false;
 
-  try {
-    MznSolver slv(std::cout, std::cerr);
-    try {
-      std::vector<std::string> args(argc - 1);
+  std::vector<std::string> args(argc - 1);
 #ifdef _WIN32
-      for (int i = 1; i < argc; i++) {
-        args[i - 1] = FileUtils::wide_to_utf8(argv[i]);
-      }
-      fSuccess = (slv.run(args, "", FileUtils::wide_to_utf8(argv[0])) != SolverInstance::ERROR);
+  for (int i = 1; i < argc; i++) {
+    args[i - 1] = FileUtils::wide_to_utf8(argv[i]);
+  }
+  std::string exeName = FileUtils::wide_to_utf8(argv[0]);
 #else
-      for (int i = 1; i < argc; i++) {
-        args[i - 1] = argv[i];
-      }
-      fSuccess = (slv.run(args, "", argv[0]) != SolverInstance::ERROR);
+  for (int i = 1; i < argc; i++) {
+    args[i - 1] = argv[i];
+  }
+  std::string exeName = argv[0];
 #endif
+
+  std::string batchFile;
+  unsigned int batchWorkers = 1;
+  if (MznServer::processBatchOptions(args, batchFile, batchWorkers)) {
+    MznServer server(args, exeName);
+    return server.runBatch(batchFile, batchWorkers) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  std::string serverSocket;
+  unsigned int serverThreads = 1;
+  if (MznServer::processOptions(args, serverSocket, serverThreads)) {
+    MznServer server(args, exeName);
+    if (serverSocket.empty()) {
+      server.serve(std::cin, serverThreads);
+      return EXIT_SUCCESS;
+    }
+    server.serve(serverSocket, serverThreads);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    MznSolver slv(std::cout, std::cerr);
+    try {
+      fSuccess = (slv.run(args, "", exeName) != SolverInstance::ERROR);
     } catch (const LocationException& e) {
       if (slv.getFlagVerbose()) {
         std::cerr << std::endl;
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+## Stress test for compiling several models concurrently in one process.
+##
+## Sends the same stream of jobs to `minizinc --server`, once with a single thread and
+## once with `--server-threads N`, and checks that every job produces the same output
+## and status in both runs. By default, the jobs compile the models found in the spec
+## test directory to FlatZinc; other models can be given on the command line. The time
+## taken by both runs is reported as well.
+##
+## Some constraints (e.g. clauses) order their arguments by the address of the expressions
+## in memory, which differs between runs of a server that has already compiled other
+## models. Outputs are therefore compared after sorting their lines and the elements of
+## every array literal, and only differences that remain after this are reported.
+##
+## USAGE: concurrent_compile.py [--minizinc PATH] [--solver ID] [--threads 4] [--rounds 3] [MODEL ...]
+
+import argparse, glob, json, os, re, subprocess, sys, timeit
+
+SPEC_DIR = os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), "..", "spec" )
+
+JOB_END = "%%%mzn-job-end: "
+
+def find_models():
+    models = glob.glob( os.path.join( SPEC_DIR, "**", "*.mzn" ), recursive=True )
+    ## Models with a data file of the same name need it to compile
+    return sorted( m for m in models if not os.path.exists( m[:-4] + ".dzn" ) )
+
+def sort_array( m ):
+    return "[" + ",".join( sorted( m.group( 1 ).split( "," ) ) ) + "]"
+
+def normalise( output ):
+    return sorted( re.sub( r"\[([^\[\]]*)\]", sort_array, line ) for line in output.splitlines() )
+
+def run_server( cmd, jobs ):
+    tm = timeit.default_timer()
+    res = subprocess.run( cmd, input="".join( json.dumps( j ) + "\n" for j in jobs ),
+                          stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                          universal_newlines=True )
+    tm = timeit.default_timer() - tm
+    if res.returncode != 0:
+        sys.exit( "server exited with status {}".format( res.returncode ) )
+    outputs = []
+    current = []
+    for line in res.stdout.splitlines( True ):
+        if line.startswith( JOB_END ):
+            outputs.append( ( "".join( current ), line[len( JOB_END ):].strip() ) )
+            current = []
+        else:
+            current.append( line )
+    if len( outputs ) != len( jobs ):
+        sys.exit( "expected output of {} jobs, got {}".format( len( jobs ), len( outputs ) ) )
+    return outputs, tm
+
+def main():
+    parser = argparse.ArgumentParser( description="Compare concurrent with sequential compilation" )
+    parser.add_argument( "--minizinc", default="minizinc", help="minizinc executable" )
+    parser.add_argument( "--solver", default="org.minizinc.mzn-fzn",
+                         help="solver to compile the models for" )
+    parser.add_argument( "--threads", type=int, default=4, help="number of server threads" )
+    parser.add_argument( "--rounds", type=int, default=3,
+                         help="how often every model is compiled in one run" )
+    parser.add_argument( "models", nargs="*", help="models to compile (default: spec test models)" )
+    args = parser.parse_args()
+    models = [ os.path.abspath( m ) for m in args.models ] or find_models()
+    jobs = [ { "model": m, "output-fzn-to-stdout": True, "no-output-ozn": True }
+             for _ in range( args.rounds ) for m in models ]
+    cmd = [ args.minizinc, "--server", "-c", "--solver", args.solver ]
+
+    expected, seq_time = run_server( cmd, jobs )
+    actual, par_time = run_server( cmd + [ "--server-threads", str( args.threads ) ], jobs )
+    failures = 0
+    reordered = 0
+    for job, exp, act in zip( jobs, expected, actual ):
+        if exp == act:
+            continue
+        if exp[1] == act[1] and normalise( exp[0] ) == normalise( act[0] ):
+            reordered += 1
+        else:
+            failures += 1
+            print( "different output for {}".format( job["model"] ) )
+    print( "{} jobs, {} with reordered output, {} with different output".format(
+        len( jobs ), reordered, failures ) )
+    print( "1 thread: {:.3f} s, {} threads: {:.3f} s".format( seq_time, args.threads, par_time ) )
+    sys.exit( 1 if failures else 0 )
+
+if __name__ == "__main__":
+    main()
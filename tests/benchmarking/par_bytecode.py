@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+## Benchmark for evaluating par functions using compiled bytecode.
+##
+## Generates a data-heavy model whose constraints are selected by par functions (sums
+## over comprehensions, array lookups, nested calls and lets) evaluated for every pair
+## of indices, and compiles it with and without `--no-par-bytecode`. Reports the best
+## time of each run, the bytecode statistics, and checks that the FlatZinc is the same.
+##
+## USAGE: par_bytecode.py [--minizinc PATH] [--solver ID] [--size 300] [--window 40] [--repeat 3]
+
+import argparse, os, re, subprocess, sys, tempfile, timeit
+
+def gen_model( size, window ):
+    yield "int: n = {};\n".format( size )
+    yield "int: k = {};\n".format( window )
+    yield "array[1..n] of int: w = [ (i * 7919) mod 1000 | i in 1..n ];\n"
+    yield "array[1..n] of bool: even = [ i mod 2 = 0 | i in 1..n ];\n"
+    yield "array[1..n] of float: r = [ i / 7.0 | i in 1..n ];\n"
+    yield "function int: window(int: i) = sum(j in max(1, i - k)..min(n, i + k) where even[j])(w[j]);\n"
+    yield "function int: dist(int: i, int: j) =\n" \
+          "  let { int: d = abs(w[i] - w[j]) } in if d > 500 then 1000 - d else d endif;\n"
+    yield "function bool: related(int: i, int: j) =\n" \
+          "  i < j /\\ (window(i) + window(j)) mod 7 = dist(i, j) mod 7 /\\ r[i] * 2.0 < r[j] + 3.0;\n"
+    yield "function bool: separated(int: i) = forall(j in 1..n where j != i)(dist(i, j) > 0 \\/ w[i] = w[j]);\n"
+    yield "array[1..n] of var 0..1000: x;\n"
+    yield "constraint forall(i, j in 1..n where related(i, j))(x[i] + dist(i, j) <= x[j]);\n"
+    yield "constraint forall(i in 1..n where separated(i))(x[i] >= window(i) mod 100);\n"
+    yield "solve satisfy;\n"
+
+def compile_model( cmd, repeat ):
+    best, out = None, None
+    for _ in range( repeat ):
+        tm = timeit.default_timer()
+        res = subprocess.run( cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE )
+        tm = timeit.default_timer() - tm
+        if res.returncode != 0:
+            return None, res.stderr.decode( errors="replace" ).strip().splitlines()[-1:]
+        best = tm if best is None else min( best, tm )
+        out = res.stdout.decode()
+    return best, out
+
+def split_output( out ):
+    stats = dict( re.findall( r"^%%%mzn-stat: (parBytecode\w+)=(\d+)$", out, re.M ) )
+    fzn = [ l for l in out.splitlines() if not l.startswith( "%" ) ]
+    return fzn, stats
+
+def main():
+    parser = argparse.ArgumentParser( description="Flattening time with and without par bytecode" )
+    parser.add_argument( "--minizinc", default="minizinc", help="minizinc executable" )
+    parser.add_argument( "--solver", default="org.minizinc.mzn-fzn", help="solver to compile for" )
+    parser.add_argument( "--size", type=int, default=300, help="number of indices" )
+    parser.add_argument( "--window", type=int, default=40, help="width of the summed windows" )
+    parser.add_argument( "--repeat", type=int, default=3, help="runs per mode (best is reported)" )
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join( tmp, "data.mzn" )
+        with open( path, "w" ) as f:
+            f.writelines( gen_model( args.size, args.window ) )
+        cmd = [ args.minizinc, "-c", "--solver", args.solver, path, "--output-fzn-to-stdout",
+                "--statistics", "--ozn", os.path.join( tmp, "data.ozn" ) ]
+        base, out = compile_model( cmd + [ "--no-par-bytecode" ], args.repeat )
+        if base is None:
+            sys.exit( "minizinc failed: {}".format( out ) )
+        expected, _ = split_output( out )
+        tm, out = compile_model( cmd, args.repeat )
+        if tm is None:
+            sys.exit( "minizinc failed: {}".format( out ) )
+        fzn, stats = split_output( out )
+        print( "{:>12} {:>10} {:>8} {:>10} {:>10} {:>10} {:>8}".format(
+            "evaluator", "time (s)", "speedup", "functions", "calls", "fallbacks", "same" ) )
+        print( "{:>12} {:>10.3f} {:>8.2f} {:>10} {:>10} {:>10} {:>8}".format(
+            "tree", base, 1.0, "-", "-", "-", "-" ) )
+        print( "{:>12} {:>10.3f} {:>8.2f} {:>10} {:>10} {:>10} {:>8}".format(
+            "bytecode", tm, base / tm, stats.get( "parBytecodeFunctions", "?" ),
+            stats.get( "parBytecodeCalls", "?" ), stats.get( "parBytecodeFallbacks", "?" ),
+            "yes" if fzn == expected else "NO" ) )
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+
+## Benchmark for flattening independent groups of constraints on several threads.
+##
+## Generates a model made of a number of independent sub-problems (each one a small
+## scheduling problem over its own variables) and compiles it with
+## `--flatten-threads 1` and with each of the given thread counts. Reports the best
+## time of each run, the CPU time of all its threads, and checks that the FlatZinc is
+## the same as the sequential one, up to the names of introduced variables and the
+## order of the items. A speedup needs at least as many cores as threads.
+##
+## USAGE: parallel_flatten.py [--minizinc PATH] [--solver ID] [--blocks 8] [--size 60] [--threads 2,4,8] [--repeat 3]
+
+import argparse, os, re, resource, subprocess, sys, tempfile, timeit
+
+def gen_model( blocks, size ):
+    yield "include \"globals.mzn\";\n"
+    yield "int: n = {};\n".format( size )
+    for b in range( blocks ):
+        yield "array[1..n] of var 0..10*n: s{};\n".format( b )
+        yield "array[1..n] of int: d{} = [ (i * {} + 3) mod 7 + 1 | i in 1..n ];\n".format( b, b + 1 )
+        yield "constraint forall(i, j in 1..n where i < j)" \
+              " (s{0}[i] + d{0}[i] <= s{0}[j] \\/ s{0}[j] + d{0}[j] <= s{0}[i]);\n".format( b )
+        yield "constraint all_different(s{});\n".format( b )
+    yield "solve satisfy;\n"
+
+def normalise( fzn ):
+    lines = []
+    for line in fzn.splitlines():
+        line = re.sub( r"X_INTRODUCED_[0-9]+_", "X", line )
+        anns = sorted( a.strip() for a in line.rstrip( ";" ).split( "::" )[1:] )
+        lines.append( line.split( "::" )[0].strip() + " ".join( anns ) )
+    return sorted( lines )
+
+def cpu_time():
+    usage = resource.getrusage( resource.RUSAGE_CHILDREN )
+    return usage.ru_utime + usage.ru_stime
+
+def compile_model( cmd, repeat ):
+    best, out = None, None
+    for _ in range( repeat ):
+        cpu = cpu_time()
+        tm = timeit.default_timer()
+        res = subprocess.run( cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE )
+        tm = timeit.default_timer() - tm
+        cpu = cpu_time() - cpu
+        if res.returncode != 0:
+            return None, res.stderr.decode( errors="replace" ).strip().splitlines()[-1:]
+        if best is None or tm < best[0]:
+            best = ( tm, cpu )
+        out = res.stdout.decode()
+    return best, out
+
+def main():
+    parser = argparse.ArgumentParser( description="Flattening time by number of threads" )
+    parser.add_argument( "--minizinc", default="minizinc", help="minizinc executable" )
+    parser.add_argument( "--solver", default="org.minizinc.mzn-fzn", help="solver to compile for" )
+    parser.add_argument( "--blocks", type=int, default=8, help="number of independent sub-problems" )
+    parser.add_argument( "--size", type=int, default=60, help="number of tasks per sub-problem" )
+    parser.add_argument( "--threads", default="2,4,8", help="comma separated numbers of threads" )
+    parser.add_argument( "--repeat", type=int, default=3, help="runs per thread count (best is reported)" )
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join( tmp, "blocks.mzn" )
+        with open( path, "w" ) as f:
+            f.writelines( gen_model( args.blocks, args.size ) )
+        cmd = [ args.minizinc, "-c", "--solver", args.solver, path, "--output-fzn-to-stdout",
+                "--ozn", os.path.join( tmp, "blocks.ozn" ) ]
+        threads = [ int( t ) for t in args.threads.split( "," ) ]
+        if os.cpu_count() is not None and os.cpu_count() < max( threads ):
+            print( "note: only {} core(s) available".format( os.cpu_count() ) )
+        base, fzn = compile_model( cmd + [ "--flatten-threads", "1" ], args.repeat )
+        if base is None:
+            sys.exit( "minizinc failed: {}".format( fzn ) )
+        expected = normalise( fzn )
+        print( "{:>8} {:>10} {:>10} {:>8} {:>8}".format( "threads", "time (s)", "cpu (s)", "speedup", "same" ) )
+        print( "{:>8} {:>10.3f} {:>10.3f} {:>8.2f} {:>8}".format( 1, base[0], base[1], 1.0, "-" ) )
+        for n in threads:
+            tm, fzn = compile_model( cmd + [ "--flatten-threads", str( n ) ], args.repeat )
+            if tm is None:
+                print( "{:>8} {:>10} {}".format( n, "failed", " ".join( fzn ) ) )
+            else:
+                same = "yes" if normalise( fzn ) == expected else "NO"
+                print( "{:>8} {:>10.3f} {:>10.3f} {:>8.2f} {:>8}".format( n, tm[0], tm[1], base[0] / tm[0], same ) )
+
+if __name__ == "__main__":
+    main()
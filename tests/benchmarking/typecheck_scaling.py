@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+
+## Micro-benchmark for the topological sorting of declarations during type checking.
+##
+## Generates models with a growing number of top-level declarations and reports the
+## time `minizinc --model-check-only` takes for each of them, minus the time for an
+## empty model (i.e., the cost of loading the standard library). The "chain" shape
+## makes every declaration depend on the previous one, which produces dependency
+## chains as long as the model; "flat" declarations only depend on literals; "let"
+## declarations each contain a small let expression.
+##
+## USAGE: typecheck_scaling.py [--minizinc PATH] [--solver ID] [--sizes 1000,10000,100000] [--repeat 3]
+
+import argparse, os, subprocess, sys, tempfile, timeit
+
+def gen_chain( n ):
+    yield "int: x0 = 0;\n"
+    for i in range( 1, n ):
+        yield "int: x{} = x{} + 1;\n".format( i, i-1 )
+
+def gen_flat( n ):
+    for i in range( n ):
+        yield "var 0..{}: x{};\n".format( i+1, i )
+
+def gen_let( n ):
+    for i in range( n ):
+        yield "int: x{0} = let {{ int: a = {0}; int: b = a + 1 }} in a * b;\n".format( i )
+
+SHAPES = { "chain": gen_chain, "flat": gen_flat, "let": gen_let }
+
+def time_model( cmd, path, repeat ):
+    best = None
+    for _ in range( repeat ):
+        tm = timeit.default_timer()
+        res = subprocess.run( cmd + [path],
+                              stdout=subprocess.DEVNULL, stderr=subprocess.PIPE )
+        tm = timeit.default_timer() - tm
+        if res.returncode != 0:
+            return None, res.stderr.decode( errors="replace" ).strip().splitlines()[-1:]
+        best = tm if best is None else min( best, tm )
+    return best, None
+
+def main():
+    parser = argparse.ArgumentParser( description="Type checking time by number of declarations" )
+    parser.add_argument( "--minizinc", default="minizinc", help="minizinc executable" )
+    parser.add_argument( "--solver", help="solver to check the model for (default: minizinc's default)" )
+    parser.add_argument( "--sizes", default="1000,10000,100000",
+                         help="comma separated numbers of declarations" )
+    parser.add_argument( "--shapes", default=",".join( SHAPES ),
+                         help="comma separated model shapes ({})".format( ", ".join( SHAPES ) ) )
+    parser.add_argument( "--repeat", type=int, default=3, help="runs per model (best is reported)" )
+    args = parser.parse_args()
+    sizes = [ int( s ) for s in args.sizes.split( "," ) ]
+    cmd = [ args.minizinc, "--model-check-only" ]
+    if args.solver:
+        cmd += [ "--solver", args.solver ]
+
+    with tempfile.TemporaryDirectory() as tmp:
+        empty = os.path.join( tmp, "empty.mzn" )
+        with open( empty, "w" ) as f:
+            f.write( "" )
+        base, err = time_model( cmd, empty, args.repeat )
+        if base is None:
+            sys.exit( "minizinc failed on an empty model: {}".format( err ) )
+        print( "{:>8} {:>10} {:>10} {:>12}".format( "shape", "decls", "time (s)", "us per decl" ) )
+        for shape in args.shapes.split( "," ):
+            for n in sizes:
+                path = os.path.join( tmp, "{}_{}.mzn".format( shape, n ) )
+                with open( path, "w" ) as f:
+                    f.writelines( SHAPES[shape]( n ) )
+                tm, err = time_model( cmd, path, args.repeat )
+                if tm is None:
+                    print( "{:>8} {:>10} {:>10} {}".format( shape, n, "failed", " ".join( err ) ) )
+                else:
+                    tm = max( tm - base, 0.0 )
+                    print( "{:>8} {:>10} {:>10.3f} {:>12.2f}".format( shape, n, tm, tm * 1e6 / n ) )
+
+if __name__ == "__main__":
+    main()
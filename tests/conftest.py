@@ -8,6 +8,7 @@ from py.xml import html
 from html import escape
 import pytest_html
 import re
+import shutil
 import minizinc as mzn
 from difflib import HtmlDiff
 import sys
@@ -48,6 +49,18 @@ def pytest_addoption(parser):
     )
 
 
+@pytest.fixture
+def minizinc_exe(request):
+    """
+    Path of the MiniZinc executable, for tests that run it directly
+    """
+    search = request.config.getoption("--driver")
+    exe = shutil.which("minizinc", path=search)
+    if exe is None:
+        pytest.skip("MiniZinc executable not found")
+    return exe
+
+
 def pytest_collect_file(parent, path):
     if path.ext == ".mzn":
         return MznFile.from_parent(parent, fspath=path)
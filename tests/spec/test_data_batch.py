@@ -0,0 +1,146 @@
+"""
+Tests for solving a model for several data files with `minizinc --data-batch`
+"""
+
+import subprocess
+
+INSTANCE = "%%%mzn-batch-instance: "
+JOB_END = "%%%mzn-job-end: "
+
+COMPILE = ["-c", "--solver", "org.minizinc.mzn-fzn"]
+TO_STDOUT = ["--output-fzn-to-stdout", "--no-output-ozn"]
+
+
+def write_instances(tmp_path, model, data):
+    """
+    Writes the model and one data file per element of data, returns the list file
+    """
+    (tmp_path / "model.mzn").write_text(model)
+    names = []
+    for i, d in enumerate(data):
+        names.append("data{}.dzn".format(i))
+        (tmp_path / names[-1]).write_text(d)
+    (tmp_path / "list.txt").write_text("".join(n + "\n" for n in names))
+    return tmp_path / "list.txt"
+
+
+def run(exe, args, cwd):
+    return subprocess.run(
+        [exe] + args,
+        cwd=str(cwd),
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        universal_newlines=True,
+    )
+
+
+def run_batch(exe, tmp_path, options=[]):
+    """
+    Runs the batch and returns the data file, output and status of every instance
+    """
+    res = run(
+        exe,
+        COMPILE + TO_STDOUT + options + ["model.mzn", "--data-batch", "list.txt"],
+        tmp_path,
+    )
+    instances = []
+    current = None
+    for line in res.stdout.splitlines(True):
+        if line.startswith(INSTANCE):
+            current = [line[len(INSTANCE) :].strip(), ""]
+        elif line.startswith(JOB_END):
+            instances.append((current[0], current[1], int(line[len(JOB_END) :])))
+            current = None
+        else:
+            current[1] += line
+    assert current is None, "output after the last instance"
+    assert res.returncode == (0 if all(s == 0 for _, _, s in instances) else 1)
+    return instances
+
+
+def check_batch(exe, tmp_path, model, data):
+    """
+    Checks that every instance of the batch compiles like a separate run
+    """
+    write_instances(tmp_path, model, data)
+    instances = run_batch(exe, tmp_path)
+    assert len(instances) == len(data)
+    for i, (data_file, output, status) in enumerate(instances):
+        assert data_file == str(tmp_path / "data{}.dzn".format(i))
+        single = run(exe, COMPILE + TO_STDOUT + ["model.mzn", data_file], tmp_path)
+        assert status == single.returncode
+        assert output == single.stdout
+    return instances
+
+
+def test_data_batch(minizinc_exe, tmp_path):
+    instances = check_batch(
+        minizinc_exe,
+        tmp_path,
+        "int: n; var 1..n: x; solve maximize x;",
+        ["n = 3;", "n = 5;", "n = 2;"],
+    )
+    assert "var 1..5: x" in instances[1][1]
+
+
+def test_data_batch_error(minizinc_exe, tmp_path):
+    instances = check_batch(
+        minizinc_exe,
+        tmp_path,
+        "int: n; var 1..n: x; solve maximize x;",
+        ["n = 3;", "n = 1.5;", "n = 4;"],
+    )
+    assert [status for _, _, status in instances] == [0, 1, 0]
+
+
+def test_data_batch_data_enum(minizinc_exe, tmp_path):
+    # Enums defined in the data require type checking the whole model for each instance
+    check_batch(
+        minizinc_exe,
+        tmp_path,
+        "enum E; var E: x; constraint x != max(E); solve satisfy;",
+        ["E = {A, B};", "E = {C, D, F};"],
+    )
+
+
+def test_data_batch_model_enum(minizinc_exe, tmp_path):
+    # Enums defined in the model only need the data to be bound and type checked
+    check_batch(
+        minizinc_exe,
+        tmp_path,
+        "enum E = {A, B, C}; E: lo; var lo..C: x; solve minimize x;",
+        ["lo = B;", "lo = A;"],
+    )
+
+
+def test_data_batch_workers(minizinc_exe, tmp_path):
+    write_instances(
+        tmp_path,
+        "int: n; array [1..n] of var 1..n: x; constraint x[1] < x[n]; solve satisfy;",
+        ["n = {};".format(n) for n in range(2, 9)],
+    )
+    expected = run_batch(minizinc_exe, tmp_path)
+    assert len(expected) == 7
+    assert run_batch(minizinc_exe, tmp_path, ["--data-batch-workers", "3"]) == expected
+
+
+def test_data_batch_output_files(minizinc_exe, tmp_path):
+    # Files written by default are named after the data files
+    write_instances(
+        tmp_path, "int: n; var 1..n: x; solve maximize x;", ["n = 3;", "n = 5;"]
+    )
+    res = run(
+        minizinc_exe, COMPILE + ["model.mzn", "--data-batch", "list.txt"], tmp_path
+    )
+    assert res.returncode == 0, res.stderr
+    assert "var 1..3: x" in (tmp_path / "data0.fzn").read_text()
+    assert "var 1..5: x" in (tmp_path / "data1.fzn").read_text()
+    assert (tmp_path / "data1.ozn").exists()
+    # Giving a single output file is an error
+    res = run(
+        minizinc_exe,
+        COMPILE + ["model.mzn", "--data-batch", "list.txt", "-o", "out.fzn"],
+        tmp_path,
+    )
+    assert res.returncode != 0
+    assert not (tmp_path / "out.fzn").exists()
@@ -0,0 +1,79 @@
+"""
+Tests for running several jobs in one process with `minizinc --server`
+"""
+
+import json
+import subprocess
+
+JOB_END = "%%%mzn-job-end: "
+
+JOBS = [
+    {"model-text": "var 1..3: x; constraint x > 1; solve satisfy;"},
+    {"model-text": "var 1..5: y; constraint y < 4; solve maximize y;"},
+]
+
+
+def run_server(exe, jobs, options=[]):
+    """
+    Runs the jobs in one server and returns the output and status of every job
+    """
+    res = subprocess.run(
+        [exe, "--server", "-c", "--solver", "org.minizinc.mzn-fzn"]
+        + ["--output-fzn-to-stdout", "--no-output-ozn"]
+        + options,
+        input="".join(json.dumps(job) + "\n" for job in jobs),
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        universal_newlines=True,
+    )
+    assert res.returncode == 0, res.stderr
+    outputs = []
+    current = []
+    for line in res.stdout.splitlines(True):
+        if line.startswith(JOB_END):
+            outputs.append(("".join(current), int(line[len(JOB_END) :])))
+            current = []
+        else:
+            current.append(line)
+    assert current == [], "output after the last job"
+    return outputs
+
+
+def run_single(exe, job, tmp_path):
+    """
+    Runs the job in a separate process and returns its output
+    """
+    model = tmp_path / "model.mzn"
+    model.write_text(job["model-text"])
+    res = subprocess.run(
+        [exe, "-c", "--solver", "org.minizinc.mzn-fzn"]
+        + ["--output-fzn-to-stdout", "--no-output-ozn", str(model)],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        universal_newlines=True,
+    )
+    assert res.returncode == 0, res.stderr
+    return res.stdout
+
+
+def test_server_jobs(minizinc_exe, tmp_path):
+    outputs = run_server(minizinc_exe, JOBS)
+    assert len(outputs) == len(JOBS)
+    for job, (output, status) in zip(JOBS, outputs):
+        assert status == 0
+        assert output == run_single(minizinc_exe, job, tmp_path)
+    assert "solve  satisfy;" in outputs[0][0]
+    assert "solve  maximize y;" in outputs[1][0]
+
+
+def test_server_invalid_job(minizinc_exe):
+    outputs = run_server(minizinc_exe, [{"model-text": "var bool: x = 1;"}] + JOBS)
+    assert len(outputs) == len(JOBS) + 1
+    assert outputs[0][1] != 0
+    assert [status for _, status in outputs[1:]] == [0] * len(JOBS)
+
+
+def test_server_threads(minizinc_exe):
+    jobs = JOBS * 4
+    expected = run_server(minizinc_exe, jobs)
+    assert run_server(minizinc_exe, jobs, ["--server-threads", "2"]) == expected